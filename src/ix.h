@@ -99,7 +99,8 @@ public:
     RC CreateIndex  (const char *fileName,          // Create new index
                      int        indexNo,
                      AttrType   attrType,
-                     int        attrLength);
+                     int        attrLength,
+                     int        pageBytes = PF_MIN_PAGE_BYTES);
     RC DestroyIndex (const char *fileName,          // Destroy index
                      int        indexNo);
     RC OpenIndex    (const char *fileName,          // Open index
@@ -111,8 +112,8 @@ private:
     PF_Manager *pPfManager;
 
     std::string GetIndexFileName(const char *fileName, int indexNo);
-    int GetKeyNumPerPage(int _attrLenght) const;
-    int GetRidNumPerPage(int _attrLenght) const;
+    int GetKeyNumPerPage(int _attrLenght, int pageSize) const;
+    int GetRidNumPerPage(int _attrLenght, int pageSize) const;
 };
 
 //
@@ -136,14 +137,21 @@ private:
     char *pValue;
     bool (*Operate)(void *pValue1, void *pValue2, AttrType attrType, int attrLength);
 
+    ClientHint pinHint;
+
     // 记录当前遍历位置
     int currentNode;
     int currentEntryPos;
     int currentBucket;
     int currentRidPos;
 
+    // 当前bucket；pinHint为KEEP_PINNED时在两次GetNextEntry之间保持pin
+    PF_PageGuard bucketGuard;
+
     RC FindLeaf(PageNum &thisNode);
     RC GetNextPos();
+    RC PinBucket    (char *&pBucketData);
+    RC ReleaseBucket();
 };
 
 //
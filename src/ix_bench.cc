@@ -0,0 +1,292 @@
+//
+// File:        ix_bench.cc
+// Description: Benchmarks for the IX component
+//
+// Usage:  ix_bench [benchmark ...]
+//
+// With no arguments every benchmark is run.  The benchmarks are:
+//
+//   search    - nanoseconds per binary search of a node as full as a
+//             4 KB page allows, for each key type, with the comparison
+//             dispatched on the key type at every step (as BinarySearch
+//             did) and specialized for the key type (as it does now)
+//   lookup    - equality lookups per second through IX_IndexScan on an
+//             index of each key type, and entries per second of a
+//             range scan over half of each index
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+#include "ix_internal.h"
+#include "operations.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define BENCHFILE        "ix_bench.dat"
+#define STRLEN           16             // bytes per STRING key
+#define SEARCHES         2000000        // searches per case
+#define NUM_KEYS         20000          // keys in each index
+#define LOOKUPS          200000         // lookups per index
+#define BUFFER_PAGES     8192           // buffer pages, more than an index
+
+//
+// Now
+//
+// Desc: Wall clock time in seconds
+//
+static double Now()
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//
+// MakeKey
+//
+// Desc: Key number i of a type: i itself, i as a float, or "key" and i
+//       zero-padded so that the strings sort as the numbers do
+// Out:  pKey - attrLength bytes
+//
+static void MakeKey(AttrType attrType, int i, char *pKey)
+{
+   float f = i;
+   char str[STRLEN + 8];
+
+   switch (attrType) {
+   case INT:   memcpy(pKey, &i, 4); break;
+   case FLOAT: memcpy(pKey, &f, 4); break;
+   default:
+      memset(pKey, 0, STRLEN);
+      snprintf(str, sizeof(str), "key%010d", i);
+      memcpy(pKey, str, STRLEN);
+      break;
+   }
+}
+
+//
+// GenericSearch
+//
+// Desc: The search loop of BinarySearch with a comparison that switches
+//       on the key type at every step
+// Ret:  index of the largest key not greater than the target
+//
+static int GenericSearch(const char *pKeys, int keyNum, void *pTarget,
+                         AttrType attrType, int attrLength)
+{
+   int entryLength = attrLength + 4;
+   int start = 0, end = keyNum - 1;
+
+   while (start < end) {
+      int mid = (start + end + 1) / 2;
+      if (LessThanOrEqual((void *)(pKeys + mid * entryLength), pTarget,
+                          attrType, attrLength))
+         start = mid;
+      else
+         end = mid - 1;
+   }
+   return (start);
+}
+
+//
+// SpecializedSearch
+//
+// Desc: The same loop with the comparison specialized for the key type
+//
+template <AttrType type>
+static int SpecializedSearch(const char *pKeys, int keyNum, void *pTarget,
+                             AttrType attrType, int attrLength)
+{
+   int entryLength = attrLength + 4;
+   int start = 0, end = keyNum - 1;
+
+   while (start < end) {
+      int mid = (start + end + 1) / 2;
+      if (Compare<type, LE_OP>(pKeys + mid * entryLength, pTarget,
+                               attrLength))
+         start = mid;
+      else
+         end = mid - 1;
+   }
+   return (start);
+}
+
+//
+// BenchSearch
+//
+static RC BenchSearch()
+{
+   static const AttrType types[] = { INT, FLOAT, STRING };
+   static const char *names[] = { "INT", "FLOAT", "STRING" };
+   static int (*const specialized[])(const char *, int, void *, AttrType,
+                                     int) = {
+      SpecializedSearch<INT>, SpecializedSearch<FLOAT>,
+      SpecializedSearch<STRING>
+   };
+
+   cout << "Binary search of a full node of a 4 KB page, ns per search\n";
+   cout << setw(8) << "type" << setw(7) << "keys" << setw(10) << "generic"
+        << setw(13) << "specialized" << setw(10) << "speedup" << "\n";
+
+   for (int t = 0; t < 3; t++) {
+      int attrLength = types[t] == STRING ? STRLEN : 4;
+      int keyNum = (PF_PAGE_SIZE - (int)sizeof(IX_NodeHdr)) /
+                   (attrLength + (int)sizeof(PageNum));
+      int entryLength = attrLength + 4;
+      vector<char> keys(keyNum * entryLength);
+      vector<char> targets(1024 * attrLength);
+      double ns[2];
+      long long sum[2] = { 0, 0 };
+
+      // Keys 0, 2, 4, ...; targets hit and miss
+      for (int i = 0; i < keyNum; i++)
+         MakeKey(types[t], 2 * i, &keys[i * entryLength]);
+      srand(1);
+      for (int i = 0; i < 1024; i++)
+         MakeKey(types[t], rand() % (2 * keyNum), &targets[i * attrLength]);
+
+      for (int k = 0; k < 2; k++) {
+         int (*Search)(const char *, int, void *, AttrType, int) =
+            k == 0 ? GenericSearch : specialized[t];
+
+         double start = Now();
+         for (int i = 0; i < SEARCHES; i++)
+            sum[k] += Search(keys.data(), keyNum,
+                             &targets[(i & 1023) * attrLength], types[t],
+                             attrLength);
+         ns[k] = (Now() - start) * 1e9 / SEARCHES;
+      }
+
+      if (sum[0] != sum[1]) {
+         cout << "searches disagree\n";
+         exit(1);
+      }
+      cout << setw(8) << names[t] << setw(7) << keyNum << fixed
+           << setprecision(1) << setw(10) << ns[0] << setw(13) << ns[1]
+           << setprecision(2) << setw(9) << ns[0] / ns[1] << "x\n";
+   }
+   return (0);
+}
+
+//
+// BenchLookup
+//
+static RC BenchLookup()
+{
+   static const AttrType types[] = { INT, FLOAT, STRING };
+   static const char *names[] = { "INT", "FLOAT", "STRING" };
+   PF_Manager pfm;
+   IX_Manager ixm(pfm);
+   char key[STRLEN];
+   RC rc;
+
+   if ((rc = pfm.ResizeBuffer(BUFFER_PAGES)))
+      return (rc);
+
+   cout << "Index of " << NUM_KEYS << " keys, all pages buffered\n";
+   cout << setw(8) << "type" << setw(14) << "lookups/s"
+        << setw(16) << "range entries/s" << "\n";
+
+   for (int t = 0; t < 3; t++) {
+      int attrLength = types[t] == STRING ? STRLEN : 4;
+      IX_IndexHandle ih;
+      IX_IndexScan scan;
+      RID rid;
+
+      ixm.DestroyIndex(BENCHFILE, t);
+      if ((rc = ixm.CreateIndex(BENCHFILE, t, types[t], attrLength)) ||
+          (rc = ixm.OpenIndex(BENCHFILE, t, ih)))
+         return (rc);
+
+      // Insert in a scrambled order, so that the tree is not built from
+      // sorted keys only
+      for (int i = 0; i < NUM_KEYS; i++) {
+         int k = (int)(((long long)i * 7919) % NUM_KEYS);
+         MakeKey(types[t], k, key);
+         if ((rc = ih.InsertEntry(key, RID(k + 1, 1))))
+            return (rc);
+      }
+
+      srand(1);
+      long long found = 0;
+      double start = Now();
+      for (int i = 0; i < LOOKUPS; i++) {
+         MakeKey(types[t], rand() % NUM_KEYS, key);
+         if ((rc = scan.OpenScan(ih, EQ_OP, key)))
+            return (rc);
+         while ((rc = scan.GetNextEntry(rid)) == OK_RC)
+            found++;
+         if (rc != IX_EOF || (rc = scan.CloseScan()))
+            return (rc);
+      }
+      double lookups = LOOKUPS / (Now() - start);
+
+      long long entries = 0;
+      MakeKey(types[t], NUM_KEYS / 2, key);
+      start = Now();
+      for (int r = 0; r < 10; r++) {
+         if ((rc = scan.OpenScan(ih, GE_OP, key)))
+            return (rc);
+         while ((rc = scan.GetNextEntry(rid)) == OK_RC)
+            entries++;
+         if (rc != IX_EOF || (rc = scan.CloseScan()))
+            return (rc);
+      }
+      double range = entries / (Now() - start);
+
+      if (found != LOOKUPS || entries != 10LL * (NUM_KEYS - NUM_KEYS / 2)) {
+         cout << "wrong entries returned\n";
+         exit(1);
+      }
+      cout << setw(8) << names[t] << fixed << setprecision(0)
+           << setw(14) << lookups << setw(16) << range << "\n";
+
+      if ((rc = ixm.CloseIndex(ih)) ||
+          (rc = ixm.DestroyIndex(BENCHFILE, t)))
+         return (rc);
+   }
+   return (0);
+}
+
+//
+// Table of benchmarks
+//
+static struct {
+   const char *name;
+   RC (*run)();
+} benchmarks[] = {
+   { "search",  BenchSearch },
+   { "lookup",  BenchLookup },
+};
+
+int main(int argc, char *argv[])
+{
+   int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+   RC rc;
+
+   for (int b = 0; b < numBenchmarks; b++) {
+      bool bRun = (argc == 1);
+      for (int i = 1; i < argc; i++)
+         if (strcmp(argv[i], benchmarks[b].name) == 0)
+            bRun = true;
+      if (!bRun)
+         continue;
+
+      if ((rc = benchmarks[b].run())) {
+         IX_PrintError(rc);
+         return (1);
+      }
+      cout << "\n";
+   }
+
+   return (0);
+}
@@ -4,6 +4,7 @@
 // Authors:     L0-0m (rzwang@mail.ustc.edu.cn)
 //
 
+#include <utility>
 #include "ix_internal.h"
 #include "operations.h"
 
@@ -37,9 +38,13 @@ IX_IndexHandle::~IX_IndexHandle()
 //
 RC IX_IndexHandle::InsertEntry(void *key, const RID &rid)
 {   
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, IX_LAT_INSERTENTRY);
+#endif
+
     RC rc;
     PageNum childNode = hdr.root;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData, *pTemp = new char[hdr.attrLength];
     void *pKey = pTemp;
     int pos;
@@ -61,8 +66,8 @@ RC IX_IndexHandle::InsertEntry(void *key, const RID &rid)
             return (rc);
 
         // 获得内容指针
-        if((rc = pfFh.GetThisPage(hdr.root, ph))    ||
-           (rc = ph.GetData(pData)))
+        if((rc = pfFh.GetThisPage(hdr.root, pg))    ||
+           (rc = pg.GetData(pData)))
            return (rc);
 
         // 设置extra指针
@@ -81,8 +86,8 @@ RC IX_IndexHandle::InsertEntry(void *key, const RID &rid)
         *(PageNum*)(pData + sizeof(IX_NodeHdr) + hdr.attrLength) = childNode;
         ((IX_NodeHdr*)pData)->keyNum++;
 
-        if((rc = pfFh.MarkDirty(hdr.root)   ||
-           (rc = pfFh.UnpinPage(hdr.root))))
+        if((rc = pg.MarkDirty())   ||
+           (rc = pg.UnpinPage()))
             return (rc);
     }
 
@@ -101,6 +106,10 @@ RC IX_IndexHandle::InsertEntry(void *key, const RID &rid)
 //
 RC IX_IndexHandle::DeleteEntry(void *pKey, const RID &rid)
 {
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, IX_LAT_DELETEENTRY);
+#endif
+
     RC rc;
     PageNum root = hdr.root;
     PageNum done = IX_INVALID_NODE;
@@ -131,7 +140,7 @@ RC IX_IndexHandle::DeleteEntry(void *pKey, const RID &rid)
 RC IX_IndexHandle::ForcePages()
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
     PageNum hdrPageNum;
 
@@ -143,8 +152,8 @@ RC IX_IndexHandle::ForcePages()
     if(bHdrChanged)
     {
         // 读入hdr对应page
-        if((rc = pfFh.GetFirstPage(ph))         ||
-           (rc = ph.GetPageNum(hdrPageNum)))
+        if((rc = pfFh.GetFirstPage(pg))         ||
+           (rc = pg.GetPageNum(hdrPageNum)))
             return (rc);
 
         // 检查存储hdr的page合法性
@@ -152,14 +161,14 @@ RC IX_IndexHandle::ForcePages()
             return (IX_ISNOTHDRPAGE);
 
         // 更新hdr信息
-        if(rc = ph.GetData(pData))
+        if(rc = pg.GetData(pData))
             return (rc);
 
         *(IX_IndexHdr*)pData = this->hdr;
 
         // set dirty, unpinned
-        if((rc = pfFh.MarkDirty(hdrPageNum))    ||
-           (rc = pfFh.UnpinPage(hdrPageNum)))
+        if((rc = pg.MarkDirty())    ||
+           (rc = pg.UnpinPage()))
             return (rc);
 
         // This function is declared const, but we need to change the
@@ -192,15 +201,15 @@ RC IX_IndexHandle::InsertKey(void *&pKey, PageNum &thisNode, const RID &rid)
     RC rc;
     PageNum childNode, tempNode = IX_INVALID_NODE;
     char *pData;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     int pos;
 
     // 查找thisNode上key对应childNode，返回(pos, childNode)
     rc = BinarySearch(pKey, thisNode, pos, childNode);
 
     // 获得thisNode数据指针
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     // 递归向下
@@ -214,7 +223,7 @@ RC IX_IndexHandle::InsertKey(void *&pKey, PageNum &thisNode, const RID &rid)
     if(pKey == NULL)
     {
         // unpin
-        if(rc = pfFh.UnpinPage(thisNode))
+        if(rc = pg.UnpinPage())
             return (rc);
         
         thisNode = IX_INVALID_NODE;
@@ -269,8 +278,8 @@ RC IX_IndexHandle::InsertKey(void *&pKey, PageNum &thisNode, const RID &rid)
     }
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisNode))  ||
-       (rc = pfFh.UnpinPage(thisNode)))
+    if((rc = pg.MarkDirty())  ||
+       (rc = pg.UnpinPage()))
         return (rc);    
 
     if(tempNode != IX_INVALID_NODE)
@@ -290,7 +299,7 @@ RC IX_IndexHandle::InsertKey(void *&pKey, PageNum &thisNode, const RID &rid)
 RC IX_IndexHandle::CreateNode(PageNum &newNode, int level)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char* pData;
     int offset;
 
@@ -298,9 +307,9 @@ RC IX_IndexHandle::CreateNode(PageNum &newNode, int level)
         return (IX_INVALIDNODEHEIGHT);
 
     // 分配新page
-    if((rc = pfFh.AllocatePage(ph)) ||
-       (rc = ph.GetData(pData))     ||
-       (rc = ph.GetPageNum(newNode)))
+    if((rc = pfFh.AllocatePage(pg)) ||
+       (rc = pg.GetData(pData))     ||
+       (rc = pg.GetPageNum(newNode)))
         return (rc);
 
     // 若为root则更新树高
@@ -330,8 +339,8 @@ RC IX_IndexHandle::CreateNode(PageNum &newNode, int level)
     }
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(newNode))   ||
-       (rc = pfFh.UnpinPage(newNode)))
+    if((rc = pg.MarkDirty())   ||
+       (rc = pg.UnpinPage()))
        return (rc);
 
     return (OK_RC);
@@ -347,14 +356,14 @@ RC IX_IndexHandle::CreateNode(PageNum &newNode, int level)
 RC IX_IndexHandle::CreateBucket(PageNum &newNode)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char* pData;
     int i;
 
     // 分配新page
-    if((rc = pfFh.AllocatePage(ph)) ||
-       (rc = ph.GetData(pData))     ||
-       (rc = ph.GetPageNum(newNode)))
+    if((rc = pfFh.AllocatePage(pg)) ||
+       (rc = pg.GetData(pData))     ||
+       (rc = pg.GetPageNum(newNode)))
         return (rc);
 
     int ridEntrySize = sizeof(IX_RidEntry);
@@ -377,8 +386,8 @@ RC IX_IndexHandle::CreateBucket(PageNum &newNode)
     ((IX_RidEntry*)(pData + offset))->next = IX_RID_LIST_END;
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(newNode))   ||
-       (rc = pfFh.UnpinPage(newNode)))
+    if((rc = pg.MarkDirty())   ||
+       (rc = pg.UnpinPage()))
        return (rc);
 
     return (OK_RC);
@@ -401,12 +410,12 @@ RC IX_IndexHandle::CreateBucket(PageNum &newNode)
 RC IX_IndexHandle::SplitNode(void *&pKey, PageNum &childNode, PageNum thisNode, int pos)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard thisPg, newPg, tempPg;
     char *pThisData, *pNewData;
 
     // 读取当前node
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pThisData)))
+    if((rc = pfFh.GetThisPage(thisNode, thisPg))    ||
+       (rc = thisPg.GetData(pThisData)))
        return (rc);
 
     int level  = ((IX_NodeHdr*)pThisData)->level;
@@ -415,11 +424,7 @@ RC IX_IndexHandle::SplitNode(void *&pKey, PageNum &childNode, PageNum thisNode,
 
     // 判断是否需要分裂
     if(keyNum < hdr.keyNumPerPage)
-    {
-        // unpin
-        pfFh.UnpinPage(thisNode);
-        return (IX_DONTNEEDSPLIT);
-    }
+        return (IX_DONTNEEDSPLIT);      // thisPg析构时unpin
 
     PageNum newNode, tempChildNode;
     char *pTempKey = new char[hdr.attrLength];  // 临时空间
@@ -447,8 +452,8 @@ RC IX_IndexHandle::SplitNode(void *&pKey, PageNum &childNode, PageNum thisNode,
 
     // 新建newNode
     if((rc = CreateNode(newNode, level))    ||
-       (rc = pfFh.GetThisPage(newNode, ph)) ||
-       (rc = ph.GetData(pNewData)))
+       (rc = pfFh.GetThisPage(newNode, newPg)) ||
+       (rc = newPg.GetData(pNewData)))
         return (rc);
 
     // 计算thisNode、newNode分裂后keyNum
@@ -500,68 +505,47 @@ RC IX_IndexHandle::SplitNode(void *&pKey, PageNum &childNode, PageNum thisNode,
         // 调整next leaf
         if(tempNode != IX_INVALID_NODE)
         {
-            if((rc = pfFh.GetThisPage(tempNode, ph))  ||
-               (rc = ph.GetData(pTemp)))
+            if((rc = pfFh.GetThisPage(tempNode, tempPg))  ||
+               (rc = tempPg.GetData(pTemp)))
                 return (rc);
 
             ((IX_NodeHdr*)pTemp)->prevPtr = newNode;
             
-            if((rc = pfFh.MarkDirty(tempNode))  ||
-               (rc = pfFh.UnpinPage(tempNode)))
+            if((rc = tempPg.MarkDirty())  ||
+               (rc = tempPg.UnpinPage()))
                 return (rc);
         }
     }
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisNode))  ||
-       (rc = pfFh.UnpinPage(thisNode))  ||
-       (rc = pfFh.MarkDirty(newNode))   ||
-       (rc = pfFh.UnpinPage(newNode)))
+    if((rc = thisPg.MarkDirty())  ||
+       (rc = thisPg.UnpinPage())  ||
+       (rc = newPg.MarkDirty())   ||
+       (rc = newPg.UnpinPage()))
         return (rc);
 
     return (OK_RC);
 }
 
 //
-// BinarySearch
+// SearchNode
 //
-// Desc: 对 内部节点 或 叶节点 进行二分查找，并
-//       返回 最佳插入位置 和 targetKey对应的ptr (即childNode)。
-//       查找过程将寻找不大于targetKey的最大key位置。
-//       对于leaf可能查找失败，则返回无效pageNum。 TODO 优化计算过程
-// In:   pTargetKey - 指向待查找键值的指针。
-//       thisNode   - 待查找node的pageNum。
-// Out:  pos        - 等价于按数组查找时的下标。
-//       childNode  - targetKey对应的ptr。
-// Ret:  IX return code
+// Desc: BinarySearch的查找部分，按键类型特化：比较在循环中内联，不再每次
+//       按AttrType分派。
+// In:   pData      - node内容，node不为空。
+//       pTargetKey - 指向待查找键值的指针。
+//       attrLength - 键长。
+// Out:  pos, childNode - 同BinarySearch。
 //
-RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &pos, PageNum &childNode) const
+template <AttrType type>
+static void SearchNode(const char *pData, const void *pTargetKey, int attrLength,
+                       int &pos, PageNum &childNode)
 {
-    // 参数检查
-    if((!pTargetKey) || (thisNode == IX_INVALID_NODE))
-        return (IX_SEARCHFAILED);
-
-    RC rc;
-    PF_PageHandle ph;
-    char *pData;
-
-    // 读取Node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
-        return (rc);
-
-    int keyNum = ((IX_NodeHdr*)pData)->keyNum;
-    int level  = ((IX_NodeHdr*)pData)->level;
-
-    // 待查找node不能为空
-    if (keyNum == 0)
-    {
-        pfFh.UnpinPage(thisNode);
-        return (IX_SEARCHEMPTYNODE);
-    }
+    int keyNum = ((const IX_NodeHdr*)pData)->keyNum;
+    int level  = ((const IX_NodeHdr*)pData)->level;
 
     int nodeHdrSize = sizeof(IX_NodeHdr);
-    int entryLength = hdr.attrLength + 4;       // key-pointer对长度
+    int entryLength = attrLength + 4;           // key-pointer对长度
     int start, mid, end;
     start = 0;
     end = keyNum - 1;
@@ -572,7 +556,7 @@ RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &p
         mid = (start + end + 1) / 2;      // 向上取整
         pos = nodeHdrSize + mid * entryLength;
 
-        if(LessThanOrEqual(pData + pos, pTargetKey, hdr.attrType, hdr.attrLength))
+        if(Compare<type, LE_OP>(pData + pos, pTargetKey, attrLength))
         {   // key <= target
             start = mid;
         }
@@ -588,11 +572,11 @@ RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &p
     // 得到返回值 (pos, childNode)
     if(level == IX_LEAF_LEVEL)
     {
-        if(Equal(pData + pos, pTargetKey, hdr.attrType, hdr.attrLength))
+        if(Compare<type, EQ_OP>(pData + pos, pTargetKey, attrLength))
         {
-            childNode = *(PageNum*)(pData + pos + hdr.attrLength);
+            childNode = *(const PageNum*)(pData + pos + attrLength);
         }
-        else if(LessThan(pData + pos, pTargetKey, hdr.attrType, hdr.attrLength))
+        else if(Compare<type, LT_OP>(pData + pos, pTargetKey, attrLength))
         {   // key < target
             pos += entryLength;
             childNode = IX_INVALID_NODE;
@@ -605,19 +589,66 @@ RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &p
     else if(level > IX_LEAF_LEVEL)
     {
         // 判断是否找到
-        if(LessThanOrEqual(pData + pos, pTargetKey, hdr.attrType, hdr.attrLength))
+        if(Compare<type, LE_OP>(pData + pos, pTargetKey, attrLength))
         {   // key <= target
-            childNode = *(PageNum*)(pData + pos + hdr.attrLength);
+            childNode = *(const PageNum*)(pData + pos + attrLength);
             pos += entryLength;
         }
         else
         {   // key > target，比最小key更小，返回extra指针
-             childNode = ((IX_NodeHdr*)pData)->extraPtr;
+             childNode = ((const IX_NodeHdr*)pData)->extraPtr;
         }
     }
+}
+
+//
+// BinarySearch
+//
+// Desc: 对 内部节点 或 叶节点 进行二分查找，并
+//       返回 最佳插入位置 和 targetKey对应的ptr (即childNode)。
+//       查找过程将寻找不大于targetKey的最大key位置。
+//       对于leaf可能查找失败，则返回无效pageNum。
+//       按键类型分派一次，查找由特化的SearchNode完成。
+// In:   pTargetKey - 指向待查找键值的指针。
+//       thisNode   - 待查找node的pageNum。
+// Out:  pos        - 等价于按数组查找时的下标。
+//       childNode  - targetKey对应的ptr。
+// Ret:  IX return code
+//
+RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &pos, PageNum &childNode) const
+{
+    // 参数检查
+    if((!pTargetKey) || (thisNode == IX_INVALID_NODE))
+        return (IX_SEARCHFAILED);
+
+    RC rc;
+    PF_PageGuard pg;
+    char *pData;
+
+    // 读取Node信息
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
+        return (rc);
+
+    // 待查找node不能为空
+    if (((IX_NodeHdr*)pData)->keyNum == 0)
+        return (IX_SEARCHEMPTYNODE);    // pg析构时unpin
+
+    switch(hdr.attrType)
+    {
+        case INT:
+            SearchNode<INT>(pData, pTargetKey, hdr.attrLength, pos, childNode);
+            break;
+        case FLOAT:
+            SearchNode<FLOAT>(pData, pTargetKey, hdr.attrLength, pos, childNode);
+            break;
+        default:
+            SearchNode<STRING>(pData, pTargetKey, hdr.attrLength, pos, childNode);
+            break;
+    }
 
     // unpin
-    if(rc = pfFh.UnpinPage(thisNode))
+    if((rc = pg.UnpinPage()))
        return (rc);
 
     return (OK_RC);
@@ -634,20 +665,17 @@ RC IX_IndexHandle::BinarySearch(void *pTargetKey, const PageNum thisNode, int &p
 RC IX_IndexHandle::InsertNode(void *pKey, PageNum thisNode, PageNum childNode , int pos)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
 
     // 读取Node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     // Node必须未满
     if(((IX_NodeHdr*)pData)->keyNum >= hdr.keyNumPerPage)
-    {    
-        pfFh.UnpinPage(thisNode);
-        return (IX_INSERTNODEFILED);
-    }
+        return (IX_INSERTNODEFILED);    // pg析构时unpin
 
     // 若不为最后一个，则腾出位置
     int entryLength = hdr.attrLength + 4;
@@ -663,8 +691,8 @@ RC IX_IndexHandle::InsertNode(void *pKey, PageNum thisNode, PageNum childNode ,
     ((IX_NodeHdr*)pData)->keyNum++;
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisNode))   ||
-       (rc = pfFh.UnpinPage(thisNode)))
+    if((rc = pg.MarkDirty())   ||
+       (rc = pg.UnpinPage()))
        return (rc);   
     
     return (OK_RC);
@@ -681,22 +709,19 @@ RC IX_IndexHandle::InsertNode(void *pKey, PageNum thisNode, PageNum childNode ,
 RC IX_IndexHandle::InsertBucket(PageNum thisNode, const RID &rid)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg, newPg;
     char *pData, *pOldData;
     int pos;
     PageNum newBucket;
 
     // 读取Node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     // node类型判断
     if(((IX_BucketHdr*)pData)->level != IX_BUCKET_LEVEL)
-    {    
-        pfFh.UnpinPage(thisNode);
-        return (IX_INSERTBUCKETFILED);
-    }
+        return (IX_INSERTBUCKETFILED);  // pg析构时unpin
 
     // 找到一个有空间的bucket，若整个链上bucket全满，则新建空Bucket
     while(((IX_BucketHdr*)pData)->ridNum >= hdr.ridNumPerPage)
@@ -708,8 +733,8 @@ RC IX_IndexHandle::InsertBucket(PageNum thisNode, const RID &rid)
             newBucket = ((IX_BucketHdr*)pData)->nextPtr;
 
             // 读取Node信息
-            if((rc = pfFh.GetThisPage(newBucket, ph))    ||
-               (rc = ph.GetData(pData)))
+            if((rc = pfFh.GetThisPage(newBucket, newPg))    ||
+               (rc = newPg.GetData(pData)))
                 return (rc);
         }
         else
@@ -719,8 +744,8 @@ RC IX_IndexHandle::InsertBucket(PageNum thisNode, const RID &rid)
 
             // 新建bucket，并读取其信息
             if((rc = CreateBucket(newBucket))         ||
-            (rc = pfFh.GetThisPage(newBucket, ph))    ||
-            (rc = ph.GetData(pData)))
+            (rc = pfFh.GetThisPage(newBucket, newPg)) ||
+            (rc = newPg.GetData(pData)))
                 return (rc);
             
             // 将新bucket与当前bucket连接
@@ -729,14 +754,15 @@ RC IX_IndexHandle::InsertBucket(PageNum thisNode, const RID &rid)
             ((IX_BucketHdr*)pData)->prevPtr = thisNode;
 
             // set dirty
-            if(rc = pfFh.MarkDirty(thisNode))
+            if(rc = pg.MarkDirty())
                 return (rc);
         }
     
-        // unpin
-        if(rc = pfFh.UnpinPage(thisNode))
+        // unpin，newBucket成为当前bucket
+        if(rc = pg.UnpinPage())
             return (rc);
 
+        pg = std::move(newPg);
         thisNode = newBucket;
     }
 
@@ -755,8 +781,8 @@ RC IX_IndexHandle::InsertBucket(PageNum thisNode, const RID &rid)
     ((IX_BucketHdr*)pData)->ridNum++;
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisNode))   ||
-       (rc = pfFh.UnpinPage(thisNode)))
+    if((rc = pg.MarkDirty())   ||
+       (rc = pg.UnpinPage()))
        return (rc);
 
     return (OK_RC);
@@ -785,7 +811,7 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
     RC rc;
     PageNum removeNode = IX_INVALID_NODE, nextNode;
     PageNum nextLeft, nextRight, nextAncL, nextAncR;
-    PF_PageHandle ph;
+    PF_PageGuard pg, tempPg;
     char* pData;
     int pos, entryLength = hdr.attrLength + 4;
 
@@ -794,8 +820,8 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
     //////////////////////////////////////////////////////////////////////////////
 
     // 获取当前node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-    (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+    (rc = pg.GetData(pData)))
         return (rc);
 
     // 计算underflow边界
@@ -825,8 +851,8 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
             nextLeft = IX_INVALID_NODE;
             if(leftNode != IX_INVALID_NODE)
             {
-                if((rc = pfFh.GetThisPage(leftNode, ph)) ||
-                   (rc = ph.GetData(pTmepData)))
+                if((rc = pfFh.GetThisPage(leftNode, tempPg)) ||
+                   (rc = tempPg.GetData(pTmepData)))
                    return (rc);
 
                 tempOffset = sizeof(IX_NodeHdr)
@@ -835,7 +861,7 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
                 
                 memcpy(&nextLeft, pTmepData + tempOffset, 4);
 
-                if(rc = pfFh.UnpinPage(leftNode))
+                if(rc = tempPg.UnpinPage())
                     return (rc);
             }
         }
@@ -859,13 +885,13 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
             nextRight = IX_INVALID_NODE;
             if(rightNode != IX_INVALID_NODE)
             {
-                if((rc = pfFh.GetThisPage(rightNode, ph)) ||
-                   (rc = ph.GetData(pTmepData)))
+                if((rc = pfFh.GetThisPage(rightNode, tempPg)) ||
+                   (rc = tempPg.GetData(pTmepData)))
                    return (rc);
                 
                 nextRight = ((IX_NodeHdr*)pTmepData)->extraPtr;
 
-                if(rc = pfFh.UnpinPage(rightNode))
+                if(rc = tempPg.UnpinPage())
                     return (rc);
             }
         }
@@ -943,14 +969,14 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
             ((IX_NodeHdr*)pData)->keyNum--;
                 
             // make dirty
-            if(rc = pfFh.MarkDirty(thisNode))
+            if(rc = pg.MarkDirty())
                 return (rc);
         }
     }
 
     int thisLevel = ((IX_NodeHdr*)pData)->level;
     // unpin，前面子函数中包含了make dirty
-    if(rc = pfFh.UnpinPage(thisNode))
+    if(rc = pg.UnpinPage())
         return (rc);
 
     // 删除结束后，检查thisNode需要哪种rebalance
@@ -987,7 +1013,7 @@ RC IX_IndexHandle::FindRebalance(PageNum &done,     PageNum thisNode, PageNum le
 RC IX_IndexHandle::DeleteBucket(PageNum &thisBucket, const RID &rid)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg, tempPg;
     char *pData;
     int pos;
 
@@ -1000,8 +1026,8 @@ RC IX_IndexHandle::DeleteBucket(PageNum &thisBucket, const RID &rid)
         return (OK_RC);
 
     // 读取Node信息
-    if((rc = pfFh.GetThisPage(thisBucket, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisBucket, pg))    ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     // 删除pos位置上的rid，并调整list
@@ -1028,15 +1054,15 @@ RC IX_IndexHandle::DeleteBucket(PageNum &thisBucket, const RID &rid)
         if(nextBucket != IX_INVALID_NODE)
         {
             // 读取Node信息
-            if((rc = pfFh.GetThisPage(nextBucket, ph))    ||
-            (rc = ph.GetData(pTempData)))
+            if((rc = pfFh.GetThisPage(nextBucket, tempPg))    ||
+            (rc = tempPg.GetData(pTempData)))
                 return (rc);
 
             ((IX_BucketHdr*)pTempData)->prevPtr = prevBucket;
 
             // set dirty、unpin
-            if((rc = pfFh.MarkDirty(nextBucket))   ||
-            (rc = pfFh.UnpinPage(nextBucket)))
+            if((rc = tempPg.MarkDirty())   ||
+            (rc = tempPg.UnpinPage()))
                 return (rc);
         }
 
@@ -1044,22 +1070,22 @@ RC IX_IndexHandle::DeleteBucket(PageNum &thisBucket, const RID &rid)
         if(prevBucket != IX_INVALID_NODE)
         {
             // 读取Node信息
-            if((rc = pfFh.GetThisPage(prevBucket, ph))    ||
-            (rc = ph.GetData(pTempData)))
+            if((rc = pfFh.GetThisPage(prevBucket, tempPg))    ||
+            (rc = tempPg.GetData(pTempData)))
                 return (rc);
 
             ((IX_BucketHdr*)pTempData)->nextPtr = nextBucket;
 
             // set dirty、unpin
-            if((rc = pfFh.MarkDirty(prevBucket))   ||
-            (rc = pfFh.UnpinPage(prevBucket)))
+            if((rc = tempPg.MarkDirty())   ||
+            (rc = tempPg.UnpinPage()))
                 return (rc);
         }
     }
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisBucket))   ||
-        (rc = pfFh.UnpinPage(thisBucket)))
+    if((rc = pg.MarkDirty())   ||
+        (rc = pg.UnpinPage()))
         return (rc);  
 
     if(ridNum == 0)
@@ -1089,7 +1115,7 @@ RC IX_IndexHandle::DeleteBucket(PageNum &thisBucket, const RID &rid)
 RC IX_IndexHandle::FindRid(int &pos, PageNum &thisBucket, const RID &rid)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
     PageNum nextBucket;
 
@@ -1098,8 +1124,8 @@ RC IX_IndexHandle::FindRid(int &pos, PageNum &thisBucket, const RID &rid)
 
     do{
         // 读取Node信息
-        if((rc = pfFh.GetThisPage(thisBucket, ph))    ||
-           (rc = ph.GetData(pData)))
+        if((rc = pfFh.GetThisPage(thisBucket, pg))    ||
+           (rc = pg.GetData(pData)))
             return (rc);
 
         // assert(((IX_BucketHdr*)pData)->ridNum > 0)
@@ -1119,7 +1145,7 @@ RC IX_IndexHandle::FindRid(int &pos, PageNum &thisBucket, const RID &rid)
         nextBucket = ((IX_BucketHdr*)pData)->nextPtr;
         
         // unpin
-        if(rc = pfFh.UnpinPage(thisBucket))
+        if(rc = pg.UnpinPage())
         return (rc);   
         
         // 更新thisBucket
@@ -1147,12 +1173,12 @@ RC IX_IndexHandle::FindRid(int &pos, PageNum &thisBucket, const RID &rid)
 RC IX_IndexHandle::CollapseRoot(PageNum &newRoot, PageNum thisNode)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char* pData; 
 
     // 读取数据
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     if(((IX_NodeHdr*)pData)->level == IX_LEAF_LEVEL)   
@@ -1165,7 +1191,7 @@ RC IX_IndexHandle::CollapseRoot(PageNum &newRoot, PageNum thisNode)
     bHdrChanged = TRUE;
 
     // unpin、dispose
-    if((rc = pfFh.UnpinPage(thisNode))  ||
+    if((rc = pg.UnpinPage())  ||
        (rc = pfFh.DisposePage(thisNode)))
         return (rc);
 
@@ -1190,43 +1216,43 @@ RC IX_IndexHandle::Rebalance(PageNum &done,     PageNum thisNode, PageNum leftNo
     RC rc;
     PageNum anchorNode, mergeNode, tempNode;
     IX_NodeHdr thisHdr, leftNodeHdr, rightNodeHdr, balanHdr;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
     int pos;
 
     // 读取thisNode的Hdr信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))    ||
+       (rc = pg.GetData(pData)))
        return (rc);
     
     thisHdr = *(IX_NodeHdr*)pData;
 
-    if(rc = pfFh.UnpinPage(thisNode))
+    if(rc = pg.UnpinPage())
         return (rc);
 
     // 读取leftNode的Hdr信息
     if(leftNode != IX_INVALID_NODE)
     {    
-        if((rc = pfFh.GetThisPage(leftNode, ph))    ||
-            (rc = ph.GetData(pData)))
+        if((rc = pfFh.GetThisPage(leftNode, pg))    ||
+            (rc = pg.GetData(pData)))
             return (rc);
         
         leftNodeHdr = *(IX_NodeHdr*)pData;
 
-        if(rc = pfFh.UnpinPage(leftNode))
+        if(rc = pg.UnpinPage())
             return (rc);
     }
 
     // 读取rightNode的Hdr信息
     if(rightNode != IX_INVALID_NODE)
     {    
-        if((rc = pfFh.GetThisPage(rightNode, ph))    ||
-            (rc = ph.GetData(pData)))
+        if((rc = pfFh.GetThisPage(rightNode, pg))    ||
+            (rc = pg.GetData(pData)))
             return (rc);
         
         rightNodeHdr = *(IX_NodeHdr*)pData;
 
-        if(rc = pfFh.UnpinPage(rightNode))
+        if(rc = pg.UnpinPage())
             return (rc);
     }
 
@@ -1265,26 +1291,26 @@ RC IX_IndexHandle::Rebalance(PageNum &done,     PageNum thisNode, PageNum leftNo
         // 读取leftAnchor的level
         if(lAnchor != IX_INVALID_NODE)
         {    
-            if((rc = pfFh.GetThisPage(lAnchor, ph))    ||
-            (rc = ph.GetData(pData)))
+            if((rc = pfFh.GetThisPage(lAnchor, pg))    ||
+            (rc = pg.GetData(pData)))
             return (rc);
             
             lAnchorLevel = (*(IX_NodeHdr*)pData).level;
 
-            if(rc = pfFh.UnpinPage(lAnchor))
+            if(rc = pg.UnpinPage())
                 return (rc);
         }
 
         // 读取rightAnchor的level
         if(rAnchor != IX_INVALID_NODE)
         {    
-            if((rc = pfFh.GetThisPage(rAnchor, ph))    ||
-            (rc = ph.GetData(pData)))
+            if((rc = pfFh.GetThisPage(rAnchor, pg))    ||
+            (rc = pg.GetData(pData)))
             return (rc);
             
             rAnchorLevel = (*(IX_NodeHdr*)pData).level;
 
-            if(rc = pfFh.UnpinPage(rAnchor))
+            if(rc = pg.UnpinPage())
                 return (rc);
         }
 
@@ -1323,18 +1349,18 @@ RC IX_IndexHandle::Rebalance(PageNum &done,     PageNum thisNode, PageNum leftNo
 RC IX_IndexHandle::Shift(PageNum &done, PageNum thisNode, PageNum neighborNode, PageNum anchorNode)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard thisPg, neighborPg, anchorPg;
     char *pThisData, *pNeighborData, *pAnchorData;
     int entryLength = hdr.attrLength + 4;
     int nodeHdrSize = sizeof(IX_NodeHdr);
 
     // 获得Node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    || 
-       (rc = ph.GetData(pThisData))         ||
-       (rc = pfFh.GetThisPage(neighborNode, ph))||
-       (rc = ph.GetData(pNeighborData))         ||
-       (rc = pfFh.GetThisPage(anchorNode, ph))  ||
-       (rc = ph.GetData(pAnchorData)))
+    if((rc = pfFh.GetThisPage(thisNode, thisPg))    || 
+       (rc = thisPg.GetData(pThisData))         ||
+       (rc = pfFh.GetThisPage(neighborNode, neighborPg))||
+       (rc = neighborPg.GetData(pNeighborData))         ||
+       (rc = pfFh.GetThisPage(anchorNode, anchorPg))  ||
+       (rc = anchorPg.GetData(pAnchorData)))
        return (rc);
 
     // 判断thisNode是否在anchor右边
@@ -1477,12 +1503,12 @@ RC IX_IndexHandle::Shift(PageNum &done, PageNum thisNode, PageNum neighborNode,
     ((IX_NodeHdr*)pNeighborData)->keyNum = numNeighbor;
 
     // set dirty、unpin
-    if((rc = pfFh.MarkDirty(thisNode))    || 
-       (rc = pfFh.UnpinPage(thisNode))    ||
-       (rc = pfFh.MarkDirty(neighborNode))||
-       (rc = pfFh.UnpinPage(neighborNode))||
-       (rc = pfFh.MarkDirty(anchorNode))  ||
-       (rc = pfFh.UnpinPage(anchorNode)))
+    if((rc = thisPg.MarkDirty())    || 
+       (rc = thisPg.UnpinPage())    ||
+       (rc = neighborPg.MarkDirty())||
+       (rc = neighborPg.UnpinPage())||
+       (rc = anchorPg.MarkDirty())  ||
+       (rc = anchorPg.UnpinPage()))
        return (rc);
 
     balanceNode = IX_INVALID_NODE;
@@ -1502,18 +1528,18 @@ RC IX_IndexHandle::Shift(PageNum &done, PageNum thisNode, PageNum neighborNode,
 RC IX_IndexHandle::Merge(PageNum &done, PageNum thisNode, PageNum neighborNode, PageNum anchorNode)
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard thisPg, neighborPg, anchorPg, tempPg;
     char *pThisData, *pNeighborData, *pAnchorData;
     int entryLength = hdr.attrLength + 4;
     int nodeHdrSize = sizeof(IX_NodeHdr);
 
     // 获得Node信息
-    if((rc = pfFh.GetThisPage(thisNode, ph))    || 
-       (rc = ph.GetData(pThisData))             ||
-       (rc = pfFh.GetThisPage(neighborNode, ph))||
-       (rc = ph.GetData(pNeighborData))         ||
-       (rc = pfFh.GetThisPage(anchorNode, ph))  ||
-       (rc = ph.GetData(pAnchorData)))
+    if((rc = pfFh.GetThisPage(thisNode, thisPg))    || 
+       (rc = thisPg.GetData(pThisData))             ||
+       (rc = pfFh.GetThisPage(neighborNode, neighborPg))||
+       (rc = neighborPg.GetData(pNeighborData))         ||
+       (rc = pfFh.GetThisPage(anchorNode, anchorPg))  ||
+       (rc = anchorPg.GetData(pAnchorData)))
        return (rc);
 
     // 判断thisNode是否在anchor右边
@@ -1621,14 +1647,14 @@ RC IX_IndexHandle::Merge(PageNum &done, PageNum thisNode, PageNum neighborNode,
         tempNode = ((IX_NodeHdr*)pThisData)->extraPtr;
         if(tempNode != IX_INVALID_NODE)
         {
-            if((rc = pfFh.GetThisPage(tempNode, ph))  ||
-               (rc = ph.GetData(pTemp)))
+            if((rc = pfFh.GetThisPage(tempNode, tempPg))  ||
+               (rc = tempPg.GetData(pTemp)))
                 return (rc);
 
             ((IX_NodeHdr*)pTemp)->prevPtr = ((IX_NodeHdr*)pThisData)->prevPtr;
             
-            if((rc = pfFh.MarkDirty(tempNode))  ||
-               (rc = pfFh.UnpinPage(tempNode)))
+            if((rc = tempPg.MarkDirty())  ||
+               (rc = tempPg.UnpinPage()))
                 return (rc);
         }
 
@@ -1636,14 +1662,14 @@ RC IX_IndexHandle::Merge(PageNum &done, PageNum thisNode, PageNum neighborNode,
         tempNode = ((IX_NodeHdr*)pThisData)->prevPtr;
         if(tempNode != IX_INVALID_NODE)
         {
-            if((rc = pfFh.GetThisPage(tempNode, ph))  ||
-               (rc = ph.GetData(pTemp)))
+            if((rc = pfFh.GetThisPage(tempNode, tempPg))  ||
+               (rc = tempPg.GetData(pTemp)))
                 return (rc);
 
             ((IX_NodeHdr*)pTemp)->extraPtr = ((IX_NodeHdr*)pThisData)->extraPtr;
             
-            if((rc = pfFh.MarkDirty(tempNode))  ||
-               (rc = pfFh.UnpinPage(tempNode)))
+            if((rc = tempPg.MarkDirty())  ||
+               (rc = tempPg.UnpinPage()))
                 return (rc);
         }
         else// 若 thisNode 为第一个，则调整leafList
@@ -1661,11 +1687,11 @@ RC IX_IndexHandle::Merge(PageNum &done, PageNum thisNode, PageNum neighborNode,
         balanceNode = anchorNode;
 
     // set dirty（除anchor）、unpin
-    if((rc = pfFh.MarkDirty(thisNode))    || 
-       (rc = pfFh.UnpinPage(thisNode))    ||
-       (rc = pfFh.MarkDirty(neighborNode))||
-       (rc = pfFh.UnpinPage(neighborNode))||
-       (rc = pfFh.UnpinPage(anchorNode)))
+    if((rc = thisPg.MarkDirty())    || 
+       (rc = thisPg.UnpinPage())    ||
+       (rc = neighborPg.MarkDirty())||
+       (rc = neighborPg.UnpinPage())||
+       (rc = anchorPg.UnpinPage()))
        return (rc);
 
     done = thisNode;    // 交由上层释放thisNode
@@ -1683,15 +1709,15 @@ RC IX_IndexHandle::Merge(PageNum &done, PageNum thisNode, PageNum neighborNode,
 RC IX_IndexHandle::PrintNode(PageNum thisNode, int spOff) const
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
     int offset = sizeof(IX_NodeHdr);
     int attrLen = hdr.attrLength;
     int entryLen = attrLen + sizeof(PageNum);
     int i, j;
 
-    if((rc = pfFh.GetThisPage(thisNode, ph))  ||
-        (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(thisNode, pg))  ||
+        (rc = pg.GetData(pData)))
         return (rc);
 
     // print IndexHdr
@@ -1722,7 +1748,7 @@ RC IX_IndexHandle::PrintNode(PageNum thisNode, int spOff) const
     for(j = 0; j < spOff; ++j)   printf(" ");
     puts    ("------------------------------");
 
-    if(rc = pfFh.UnpinPage(thisNode))
+    if(rc = pg.UnpinPage())
         return (rc);
 
     return (OK_RC);
@@ -1737,7 +1763,7 @@ RC IX_IndexHandle::PrintNode(PageNum thisNode, int spOff) const
 RC IX_IndexHandle::PrintTree()  const
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     std::vector<PageNum> child = { hdr.root };
     char *pData;
     int attrLen = hdr.attrLength;
@@ -1750,8 +1776,8 @@ RC IX_IndexHandle::PrintTree()  const
         std::vector<PageNum> temp;
         for(j = 0; j < child.size(); ++j)
         {
-            if((rc = pfFh.GetThisPage(child[j], ph))    ||
-               (rc = ph.GetData(pData)))
+            if((rc = pfFh.GetThisPage(child[j], pg))    ||
+               (rc = pg.GetData(pData)))
                 return (rc);
 
             // ptint node
@@ -1775,7 +1801,7 @@ RC IX_IndexHandle::PrintTree()  const
             }
 
             // unpin
-            if(rc = pfFh.UnpinPage(child[j]))
+            if(rc = pg.UnpinPage())
                 return (rc);
         }
         child = temp;
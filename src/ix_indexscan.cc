@@ -15,6 +15,7 @@
 IX_IndexScan::IX_IndexScan()
 {
     bScanOpen = FALSE;
+    pValue = NULL;
 }
 
 //
@@ -62,6 +63,8 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle  &_indexHandle,
     
     // Scan打开
     bScanOpen = TRUE;
+    pinHint = _pinHint;
+    pValue = NULL;
 
     // 设定位置参数初值
     currentRidPos = IX_RID_LIST_END;
@@ -80,16 +83,8 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle  &_indexHandle,
 
     // 若执行条件查询...
 
-    // 初始化比较函数
-	switch (compOp)
-	{
-		case EQ_OP: Operate = Equal;                break;
-		case LT_OP: Operate = LessThan;             break;
-		case GT_OP: Operate = GreaterThan;          break;
-		case LE_OP: Operate = LessThanOrEqual;      break;
-		case GE_OP: Operate = GreaterThanOrEqual;   break;
-		case NE_OP: Operate = NotEqual;             break;
-	}
+    // 根据键类型和比较算符选出特化的比较函数
+    Operate = GetOperation(pIxIh->hdr.attrType, compOp);
 
     // 复制value
     pValue = new char[pIxIh->hdr.attrLength];
@@ -101,7 +96,7 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle  &_indexHandle,
         return (rc);
 
     // 获取leaf上信息
-    if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph))  ||
+    if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph, pinHint))  ||
        (rc = ph.GetData(pData)))
         return (rc);
 
@@ -170,8 +165,11 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle  &_indexHandle,
 //
 RC IX_IndexScan::GetNextEntry(RID &rid)
 {
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, IX_LAT_GETNEXTENTRY);
+#endif
+
     RC rc;
-    PF_PageHandle ph;
     char *pBucketData;
 
     // 判断位置参数合理性
@@ -179,8 +177,7 @@ RC IX_IndexScan::GetNextEntry(RID &rid)
     {   // 参数有效，获取返回值...
 
         // 获取Bucket上信息
-        if((rc = pIxIh->pfFh.GetThisPage(currentBucket, ph))  ||
-           (rc = ph.GetData(pBucketData)))
+        if((rc = PinBucket(pBucketData)))
             return (rc);
 
         if(currentRidPos == IX_RID_LIST_END)
@@ -188,9 +185,6 @@ RC IX_IndexScan::GetNextEntry(RID &rid)
 
         rid = ((IX_RidEntry*)(pBucketData + currentRidPos))->rid;
 
-        if(rc = pIxIh->pfFh.UnpinPage(currentBucket))     // unpin
-            return (rc);    
-
         // 更新位置参数
         if(rc = GetNextPos())
             return (rc);
@@ -216,7 +210,6 @@ RC IX_IndexScan::GetNextPos()
     char *pNodeData, *pBucketData, *pNewNodeData;
     int entryLength = pIxIh->hdr.attrLength + 4;
     int hdrSize = sizeof(IX_NodeHdr);
-    PageNum tempNode;
     int keyNum;
     
     PageNum newNode;
@@ -229,9 +222,7 @@ RC IX_IndexScan::GetNextPos()
 
             do
             {   // 获取Bucket上信息
-                tempNode = currentBucket;
-                if((rc = pIxIh->pfFh.GetThisPage(tempNode, ph))  ||
-                (rc = ph.GetData(pBucketData)))
+                if((rc = PinBucket(pBucketData)))
                     return (rc);
 
                 // 更新ridPos
@@ -241,18 +232,12 @@ RC IX_IndexScan::GetNextPos()
                     currentRidPos = ((IX_RidEntry*)(pBucketData + currentRidPos))->next;
 
                 if(currentRidPos != IX_RID_LIST_END)
-                {
-                    // unpin currentBucket
-                    if(rc = pIxIh->pfFh.UnpinPage(tempNode))
-                        return (rc);
-                    
-                    return (OK_RC);
-                }
+                    return (ReleaseBucket());
 
                 currentBucket = ((IX_BucketHdr*)pBucketData)->nextPtr;
             
                 // unpin currentBucket
-                if(rc = pIxIh->pfFh.UnpinPage(tempNode))
+                if((rc = bucketGuard.UnpinPage()))
                     return (rc);
 
             }while (currentBucket != IX_INVALID_NODE);
@@ -269,7 +254,7 @@ RC IX_IndexScan::GetNextPos()
 
 
             // 获得当前node上keyNum
-            if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph))  ||
+            if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph, pinHint))  ||
                (rc = ph.GetData(pNodeData)))                                    return (rc);
                 
             keyNum = ((IX_NodeHdr*)pNodeData)->keyNum;
@@ -281,7 +266,7 @@ RC IX_IndexScan::GetNextPos()
             if((currentEntryPos < hdrSize)  ||  (currentEntryPos == hdrSize + entryLength * keyNum))
             {   
                 // 获得newNode
-                if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph))  ||
+                if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph, pinHint))  ||
                    (rc = ph.GetData(pNodeData)))                                return (rc);
 
                 if(bNext)
@@ -296,7 +281,7 @@ RC IX_IndexScan::GetNextPos()
                     newNode = ((IX_NodeHdr*)pNodeData)->prevPtr;
                     if(newNode != IX_INVALID_NODE)
                     {
-                        if((rc = pIxIh->pfFh.GetThisPage(newNode, ph))  ||
+                        if((rc = pIxIh->pfFh.GetThisPage(newNode, ph, pinHint))  ||
                            (rc = ph.GetData(pNewNodeData)))             return (rc);
 
                         // 从最后一个entry开始
@@ -319,7 +304,7 @@ RC IX_IndexScan::GetNextPos()
             //                       判断新entry是否符合条件                   //
             //////////////////////////////////////////////////////////////////
 
-            if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph))  ||
+            if((rc = pIxIh->pfFh.GetThisPage(currentNode, ph, pinHint))  ||
                (rc = ph.GetData(pNodeData)))                                    return (rc);
 
             if((pValue != NULL)     &&
@@ -357,6 +342,11 @@ RC IX_IndexScan::CloseScan()
 
     if(pValue != NULL)
         delete []pValue;
+    pValue = NULL;
+
+    // 释放KEEP_PINNED时仍pin着的bucket
+    if(bucketGuard.IsPinned())
+        bucketGuard.UnpinPage();
 
 	pIxIh = NULL;
 
@@ -389,4 +379,44 @@ RC IX_IndexScan::FindLeaf(PageNum &thisNode)
     }
 
     return (OK_RC);
-}
\ No newline at end of file
+}
+//
+// PinBucket
+//
+// Desc: 保证bucketGuard pin住currentBucket。KEEP_PINNED时上次的bucket
+//       可能仍被pin着，是同一个则直接使用，否则先unpin。
+// Out:  pBucketData - currentBucket的内容
+// Ret:  PF return code
+//
+RC IX_IndexScan::PinBucket(char *&pBucketData)
+{
+    RC rc;
+    PageNum pageNum;
+
+    if(bucketGuard.IsPinned())
+    {
+        if((rc = bucketGuard.GetPageNum(pageNum)))
+            return (rc);
+        if(pageNum == currentBucket)
+            return (bucketGuard.GetData(pBucketData));
+        if((rc = bucketGuard.UnpinPage()))
+            return (rc);
+    }
+
+    if((rc = pIxIh->pfFh.GetThisPage(currentBucket, bucketGuard, pinHint)))
+        return (rc);
+    return (bucketGuard.GetData(pBucketData));
+}
+
+//
+// ReleaseBucket
+//
+// Desc: 读完当前bucket后unpin它，KEEP_PINNED时留到下次使用
+// Ret:  PF return code
+//
+RC IX_IndexScan::ReleaseBucket()
+{
+    if(pinHint == KEEP_PINNED || !bucketGuard.IsPinned())
+        return (OK_RC);
+    return (bucketGuard.UnpinPage());
+}
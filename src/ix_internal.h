@@ -13,6 +13,12 @@
 #include <vector>
 #include "ix.h"
 
+// 开启PF_STATS时，记录各操作的延迟。统计管理器定义在pf_buffermgr.cc中
+#ifdef PF_STATS
+#include "statistics.h"
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
 //
 // IX_NodeHdr: Header structure for node
 //
@@ -48,8 +54,8 @@ struct IX_RidEntry {
 //
 const int IX_LEAF_LEVEL   = 1;
 const int IX_BUCKET_LEVEL = 0;
-const int IX_NODE_SIZE = PF_PAGE_SIZE - sizeof(IX_NodeHdr);     // IX Node 的可用空间
-const int IX_BUCKET_SIZE = PF_PAGE_SIZE - sizeof(IX_BucketHdr); // IX Bucket 的可用空间
+const int IX_NODE_SIZE = PF_PAGE_SIZE - sizeof(IX_NodeHdr);     // 默认page大小下IX Node 的可用空间
+const int IX_BUCKET_SIZE = PF_PAGE_SIZE - sizeof(IX_BucketHdr); // 默认page大小下IX Bucket 的可用空间
 const PageNum IX_INVALID_NODE = -1;								// B+树中的空Node
 const int IX_RID_LIST_END = -1;								// bucket中rid链表的尾部
 
@@ -33,12 +33,14 @@ IX_Manager::~IX_Manager  ()
 // Desc: Create a new IX file named "fileName.indexNo"
 //       分配 page 0 并向其中存入IX文件头信息。
 // In:   fileName - name of file to create
+//       pageBytes - PF page size of the index (PF_MIN_PAGE_BYTES by default)
 // Ret:  IX return code
 //
 RC IX_Manager::CreateIndex  (const char *fileName,
                               int        _indexNo,
                               AttrType   _attrType,
-                              int        _attrLength)
+                              int        _attrLength,
+                              int        pageBytes)
 {
     // 进行参数检查
 	if((_attrType < INT)                            ||
@@ -58,24 +60,27 @@ RC IX_Manager::CreateIndex  (const char *fileName,
     PF_PageHandle ph;
     char *pData;
     PageNum hdrPageNum;
+    int pageSize;
     
     // 构造 index 文件名
     std::string indexFileName = GetIndexFileName(fileName, _indexNo);
     
     // 创建文件，并返回 page 0
-    if((rc = pPfManager->CreateFile(indexFileName.c_str()))     ||
-       (rc = pPfManager->OpenFile(indexFileName.c_str(), fh))   ||
+    if((rc = pPfManager->CreateFile(indexFileName.c_str(), pageBytes)) ||
+       (rc = pPfManager->OpenFile(indexFileName.c_str(), fh,
+                                  PF_OPEN_BUFFERED, PF_POOL_INDEX)) ||
+       (rc = fh.GetPageSize(pageSize))                  ||
        (rc = fh.AllocatePage(ph))                       ||
        (rc = ph.GetData(pData)))
         return (rc);
 
-    // 计算每个page容纳key-pointer对个数
-    int keyNumPerPage = GetKeyNumPerPage(_attrLength);
+    // 计算每个page容纳key-pointer对个数，由文件实际的page大小决定
+    int keyNumPerPage = GetKeyNumPerPage(_attrLength, pageSize);
     if(keyNumPerPage < 1)
         return (IX_INVALIDKEYNUM);
 
     // 计算每个page容纳key-pointer对个数
-    int ridNumPerPage = GetRidNumPerPage(_attrLength);
+    int ridNumPerPage = GetRidNumPerPage(_attrLength, pageSize);
     if(ridNumPerPage < 1)
         return (IX_INVALIDRIDNUM);
 
@@ -169,8 +174,9 @@ RC IX_Manager::OpenIndex(const char     *fileName,
     // 构造 index 文件名
     std::string indexFileName = GetIndexFileName(fileName, _indexNo);
 
-    // 打开文件
-    if(rc = pPfManager->OpenFile(indexFileName.c_str(), indexHandle.pfFh))
+    // 打开文件，页放在索引缓冲池
+    if(rc = pPfManager->OpenFile(indexFileName.c_str(), indexHandle.pfFh,
+                                 PF_OPEN_BUFFERED, PF_POOL_INDEX))
         return (rc);    
 
     // 读取头部信息
@@ -251,27 +257,31 @@ std::string IX_Manager::GetIndexFileName(const char *fileName, int indexNo)
 // GetKeyNumPerPage
 //
 // Desc: 计算Node中容纳的key-pointer个数
-// In:   
+// In:   _attrLength - key的长度
+//       pageSize - PF page的可用空间
 // Out:
 // Ret:
 //
-int IX_Manager::GetKeyNumPerPage(int _attrLength) const
+int IX_Manager::GetKeyNumPerPage(int _attrLength, int pageSize) const
 {
-    return IX_NODE_SIZE / (_attrLength + sizeof(PageNum));
+    int nodeSize = pageSize - sizeof(IX_NodeHdr);     // IX Node 的可用空间
+    return nodeSize / (_attrLength + sizeof(PageNum));
 }
 
 //
 // GetRidNumPerPage
 //
 // Desc: 计算Buceket中容纳的rid个数
-// In:   
+// In:   _attrLength - key的长度
+//       pageSize - PF page的可用空间
 // Out:
 // Ret:
 //
-int IX_Manager::GetRidNumPerPage(int _attrLength) const
+int IX_Manager::GetRidNumPerPage(int _attrLength, int pageSize) const
 {
     // bucket中每个元素存放 rid 和 一个next 指针
     // TODO 考虑使用内存操作
     // return IX_BUCKET_SIZE / (sizeof(RID) + sizeof(short));
-    return IX_BUCKET_SIZE / (sizeof(IX_RidEntry));
+    int bucketSize = pageSize - sizeof(IX_BucketHdr); // IX Bucket 的可用空间
+    return bucketSize / (sizeof(IX_RidEntry));
 }
\ No newline at end of file
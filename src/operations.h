@@ -9,6 +9,7 @@
 
 #include "redbase.h"
 #include <cstring>
+#include <type_traits>
 
 //
 //  Operation Functions
@@ -88,4 +89,86 @@ inline bool NoComp(void *pValue1, void *pValue2, AttrType attrType, int attrLeng
   return TRUE;
 }
 
+//
+//  CompareValues
+//
+//  Desc: x op y，op为编译期常量，switch在实例化时消去。Compare和rm_filter.cc
+//        中的kernel共用这一个比较。
+//  Ret:  bool，NO_OP为TRUE
+//
+template <typename T, CompOp op>
+inline bool CompareValues(T x, T y)
+{
+  switch(op)
+  {
+	case EQ_OP: return (x == y);
+	case NE_OP: return (x != y);
+	case LT_OP: return (x < y);
+	case GT_OP: return (x > y);
+	case LE_OP: return (x <= y);
+	case GE_OP: return (x >= y);
+	default:    return TRUE;
+  }
+}
+
+//
+//  Compare
+//
+//  Desc: 编译期特化的比较 pValue1 op pValue2：类型和算符都是模板参数，
+//        switch在实例化时消去，调用处可以内联，不再每次按AttrType分派。
+//        INT/FLOAT经memcpy读出，不要求对齐。STRING与上面的函数一样用
+//        strncmp：定长串在NUL之后的字节没有规定（ix_test用空格填充，查找
+//        的键则可能是任意值），不能用memcmp比较整个定长串。
+//  In:   attrLength - STRING的长度
+//  Ret:  bool
+//
+template <AttrType type, CompOp op>
+inline bool Compare(const void *pValue1, const void *pValue2, int attrLength)
+{
+  if(type == STRING)
+	return CompareValues<int, op>(strncmp((const char *) pValue1,
+	                                      (const char *) pValue2, attrLength), 0);
+
+  typedef typename std::conditional<type == INT, int, float>::type T;
+  T x, y;
+  memcpy(&x, pValue1, sizeof(T));
+  memcpy(&y, pValue2, sizeof(T));
+  return CompareValues<T, op>(x, y);
+}
+
+//
+//  Operation
+//
+//  Desc: Compare的实例，签名与上面7个函数相同，可赋给scan中的函数指针
+//
+template <AttrType type, CompOp op>
+bool Operation(void *pValue1, void *pValue2, AttrType attrType, int attrLength)
+{
+  return Compare<type, op>(pValue1, pValue2, attrLength);
+}
+
+typedef bool (*OperateFunc)(void *pValue1, void *pValue2, AttrType attrType, int attrLength);
+
+//
+//  GetOperation
+//
+//  Desc: 按(attrType, compOp)选出Operation的实例，OpenScan时调用一次
+//  Ret:  比较函数，NO_OP及未定义的类型、算符为NoComp
+//
+inline OperateFunc GetOperation(AttrType attrType, CompOp compOp)
+{
+  static const OperateFunc operations[3][6] = {
+	{ Operation<INT, EQ_OP>,    Operation<INT, NE_OP>,    Operation<INT, LT_OP>,
+	  Operation<INT, GT_OP>,    Operation<INT, LE_OP>,    Operation<INT, GE_OP> },
+	{ Operation<FLOAT, EQ_OP>,  Operation<FLOAT, NE_OP>,  Operation<FLOAT, LT_OP>,
+	  Operation<FLOAT, GT_OP>,  Operation<FLOAT, LE_OP>,  Operation<FLOAT, GE_OP> },
+	{ Operation<STRING, EQ_OP>, Operation<STRING, NE_OP>, Operation<STRING, LT_OP>,
+	  Operation<STRING, GT_OP>, Operation<STRING, LE_OP>, Operation<STRING, GE_OP> },
+  };
+
+  if(attrType < INT || attrType > STRING || compOp < EQ_OP || compOp > GE_OP)
+	return NoComp;
+  return operations[attrType][compOp - EQ_OP];
+}
+
 #endif  // OPERATIONS_H
\ No newline at end of file
@@ -16,6 +16,8 @@
 #ifndef PF_H
 #define PF_H
 
+#include <vector>
+#include <string>
 #include "redbase.h"
 
 //
@@ -32,6 +34,57 @@ typedef int PageNum;
 //
 const int PF_PAGE_SIZE = 4096 - sizeof(int);
 
+// That is the size of the pages of a file unless another one is chosen
+// when the file is created.  A page takes a power of two bytes, from
+// PF_MIN_PAGE_BYTES to PF_MAX_PAGE_BYTES, in the file and in the buffer,
+// and sizeof(int) less than that is left for the data.
+const int PF_MIN_PAGE_BYTES = 4096;
+const int PF_MAX_PAGE_BYTES = 65536;
+const int PF_PAGE_CLASSES = 5;      // # of page sizes, one buffer each
+
+//
+// PF_ReplacePolicy: how the buffer pool chooses the page to replace
+//
+enum PF_ReplacePolicy {
+   PF_REPLACE_LRU,                               // least recently used
+   PF_REPLACE_CLOCK,                             // CLOCK sweep, usage counts
+   PF_REPLACE_2Q,                                // 2Q (A1in/A1out/Am)
+   PF_REPLACE_LRUK                               // LRU-K with K = 2
+};
+
+//
+// PF_IOEngineType: how the buffer pool reads and writes pages
+//
+enum PF_IOEngineType {
+   PF_IO_SYNC,                                   // blocking pread/pwrite
+   PF_IO_DIRECT,                                 // O_DIRECT, bypassing the
+                                                 // OS page cache
+   PF_IO_URING                                   // io_uring, many requests
+                                                 // in flight at once
+};
+
+//
+// PF_OpenMode: how the pages of an open file are read
+//
+enum PF_OpenMode {
+   PF_OPEN_BUFFERED,                             // copied into buffer frames
+   PF_OPEN_MMAP                                  // read in place through a
+                                                 // read-only mapping
+};
+
+//
+// PF_PoolId: buffer pool a file's pages are kept in.  Each pool has its
+// own size and replacement policy, so the pages of one kind of file only
+// ever evict pages of the same kind.
+//
+enum PF_PoolId {
+   PF_POOL_DATA,                                 // heap files, the default
+   PF_POOL_CATALOG,                              // system catalogs
+   PF_POOL_INDEX,                                // index files
+   PF_POOL_TEMP                                  // temporary files
+};
+const int PF_NUM_POOLS = 4;
+
 //
 // PF_PageHandle: PF page interface
 //
@@ -55,19 +108,74 @@ private:
    char *pPageData;                               // pointer to page data
 };
 
+//
+// PF_PageGuard: pinned page that unpins itself
+//
+// A page guard is filled in by the PF_FileHandle methods that pin a page
+// and holds that pin until UnpinPage() is called, the guard is filled
+// with another page, or the guard goes out of scope.  It remembers the
+// buffer slot of its page, so MarkDirty() and UnpinPage() through the
+// guard do not have to look the page up again.  Guards can be moved but
+// not copied, so a pin always has exactly one owner.
+//
+class PF_BufferMgr;
+class PF_FileMap;
+class PF_PageMap;
+
+class PF_PageGuard {
+   friend class PF_FileHandle;
+public:
+   PF_PageGuard   ();                            // Default constructor
+   ~PF_PageGuard  ();                            // Unpins the page, if any
+
+   // Move constructor and move assignment; the source guard is left empty
+   PF_PageGuard   (PF_PageGuard &&pageGuard);
+   PF_PageGuard& operator=(PF_PageGuard &&pageGuard);
+
+   RC GetData     (char *&pData) const;           // Set pData to point to
+                                                  // the page contents
+   RC GetPageNum  (PageNum &pageNum) const;       // Return the page number
+   RC MarkDirty   () const;                       // Mark the page dirty
+   RC UnpinPage   ();                             // Give up the pin now
+
+   int IsPinned   () const { return (pPageData != NULL); }
+
+private:
+   PF_PageGuard   (const PF_PageGuard &) = delete;
+   PF_PageGuard& operator=(const PF_PageGuard &) = delete;
+
+   // Take over the pin on the page in slot, or in pFileMap if slot is
+   // INVALID_SLOT
+   void Attach    (PF_BufferMgr *pBufferMgr, PF_FileMap *pFileMap, int slot,
+                   PageNum pageNum, char *pPageData);
+
+   PF_BufferMgr *pBufferMgr;                      // buffer holding the page
+   PF_FileMap *pFileMap;                          // mapping of its file
+   int  slot;                                     // buffer slot of the page,
+                                                  // INVALID_SLOT if mapped
+   PageNum pageNum;                               // page number
+   char *pPageData;                               // pointer to page data
+};
+
 //
 // PF_FileHdr: Header structure for files
 //
 struct PF_FileHdr {
-   int firstFree;     // first free page in the linked list
+   int firstFree;     // first free page in the linked list (files made
+                      // before the page map only)
    int numPages;      // # of pages in the file
+   int pageBytes;     // bytes per page (0 in files made before page sizes
+                      // could be chosen, meaning PF_MIN_PAGE_BYTES)
+   int numReserved;   // # of pages after the last one that are allocated
+                      // on disk but not in use yet
+   int bPageMap;      // TRUE if free pages are tracked in the page map
+                      // instead of the free list
+   int firstDir;      // first directory page of the page map
 };
 
 //
 // PF_FileHandle: PF File interface
 //
-class PF_BufferMgr;
-
 class PF_FileHandle {
    friend class PF_Manager;                      // Mgr可以管理某个文件Hdl
 public:
@@ -80,20 +188,50 @@ public:
    // Overload =
    PF_FileHandle& operator=(const PF_FileHandle &fileHandle);
 
+   // The methods getting a page take a hint on how the page will be
+   // used.  A scan that reads each page once passes SEQUENTIAL_ONCE, so
+   // that the pages it reads do not push others out of the buffer.
+
    // Get the first page
-   RC GetFirstPage(PF_PageHandle &pageHandle) const;
+   RC GetFirstPage(PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get the next page after current
-   RC GetNextPage (PageNum current, PF_PageHandle &pageHandle) const;
+   RC GetNextPage (PageNum current, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get a specific page
-   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle) const;
+   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
    // Get the last page
-   RC GetLastPage(PF_PageHandle &pageHandle) const;
+   RC GetLastPage(PF_PageHandle &pageHandle,
+                  ClientHint hint = NO_HINT) const;
    // Get the prev page after current
-   RC GetPrevPage (PageNum current, PF_PageHandle &pageHandle) const;
+   RC GetPrevPage (PageNum current, PF_PageHandle &pageHandle,
+                   ClientHint hint = NO_HINT) const;
 
    RC AllocatePage(PF_PageHandle &pageHandle);    // Allocate a new page
+
+   // Bytes of data a page of this file holds (PF_PAGE_SIZE by default)
+   RC GetPageSize (int &pageSize) const;
+
+   // The same methods filling in a page guard.  Whatever page the guard
+   // held before is unpinned first.
+   RC GetFirstPage(PF_PageGuard &pageGuard, ClientHint hint = NO_HINT) const;
+   RC GetNextPage (PageNum current, PF_PageGuard &pageGuard,
+                   ClientHint hint = NO_HINT) const;
+   RC GetThisPage (PageNum pageNum, PF_PageGuard &pageGuard,
+                   ClientHint hint = NO_HINT) const;
+   RC GetLastPage (PF_PageGuard &pageGuard, ClientHint hint = NO_HINT) const;
+   RC GetPrevPage (PageNum current, PF_PageGuard &pageGuard,
+                   ClientHint hint = NO_HINT) const;
+   RC AllocatePage(PF_PageGuard &pageGuard);
+
    RC DisposePage (PageNum pageNum);              // Dispose of a page
-   RC MarkDirty   (PageNum pageNum) const;        // Mark page as dirty
+
+   // Mark page as dirty.  A page of a PF_OPEN_MMAP file that was pinned
+   // in the mapping is read-only (PF_MAPPEDPAGE); it has to be in the
+   // buffer pool, e.g. through PrefetchPages, when it is pinned in order
+   // to be changed.
+   RC MarkDirty   (PageNum pageNum) const;
    RC UnpinPage   (PageNum pageNum) const;        // Unpin the page
 
    // Flush pages from buffer pool.  Will write dirty pages to disk.
@@ -102,39 +240,142 @@ public:
    // Force a page or pages to disk (but do not remove from the buffer pool)
    RC ForcePages  (PageNum pageNum=ALL_PAGES) const;
 
+   // Read the given pages into the buffer pool, without pinning them, with
+   // all the reads issued at once.  Pages already in the buffer and
+   // invalid page numbers are skipped.
+   RC PrefetchPages(const PageNum *pageNums, int numPages) const;
+
 private:
 
+   // Write the file header and the page map back if they have changed
+   RC WriteHdr        () const;
+
    // IsValidPageNum will return TRUE if page number is valid and FALSE
    // otherwise
    int IsValidPageNum (PageNum pageNum) const;
 
+   // Pin pageNum if it is a used page; set pPageBuf and slot
+   // (INVALID_SLOT if it was pinned in the mapping of the file)
+   RC PinUsedPage     (PageNum pageNum, char *&pPageBuf, int &slot,
+                       ClientHint hint = NO_HINT) const;
+   // Pin pageNum of a mapped file in the buffer if it is there, in the
+   // mapping otherwise; PF_PAGENOTINBUF if it is not mapped
+   RC PinMappedPage   (PageNum pageNum, char *&pPageBuf, int &slot) const;
+   // TRUE if pageNum is pinned in the mapping of the file
+   int IsMappedPin    (PageNum pageNum) const;
+   // Pin the first used page after (step 1) or before (step -1) current
+   // and set current to its number
+   RC PinNextUsedPage (PageNum &current, int step, char *&pPageBuf,
+                       int &slot, ClientHint hint = NO_HINT) const;
+   // Allocate a page and pin it; set pageNum, pPageBuf and slot
+   RC PinNewPage      (PageNum &pageNum, char *&pPageBuf, int &slot);
+   // Allocate the next extent of the file on disk
+   RC ReserveExtent   ();
+   // Read the page map; hdrBuf is the file header page
+   RC ReadPageMap     (const char *hdrBuf);
+   // Add directory pages until the page map covers the file and numNew
+   // pages more
+   RC CoverPages      (int numNew);
+   // Put the changed directory pages of the page map into the buffer
+   RC WriteDirPages   () const;
+
    PF_BufferMgr *pBufferMgr;                      // pointer to buffer manager
+   PF_FileMap *pFileMap;                          // mapping of the file, NULL
+                                                  // unless PF_OPEN_MMAP
+   PF_PageMap *pPageMap;                          // which pages are used
    PF_FileHdr hdr;                                // file header
    int bFileOpen;                                 // file open flag
    int bHdrChanged;                               // w
    int unixfd;                                    // OS file descriptor
+   int extentPages;                               // # of pages the file
+                                                  // grows by on disk
 };
 
 //
 // PF_Manager: provides PF file management
 //
+struct PF_FileTable;
+
 class PF_Manager {
 public:
-   PF_Manager    ();                              // Constructor
+   // Constructor; policy selects the page replacement policy of the
+   // buffer pool shared by all files opened through this manager, and
+   // ioEngine the way that pool reads and writes pages
+   PF_Manager    (PF_ReplacePolicy policy = PF_REPLACE_LRU,
+                  PF_IOEngineType ioEngine = PF_IO_SYNC);
    ~PF_Manager   ();                              // Destructor
-   RC CreateFile    (const char *fileName);       // Create a new file
+   // Create a new file whose pages take pageBytes bytes (a power of two
+   // from PF_MIN_PAGE_BYTES to PF_MAX_PAGE_BYTES)
+   RC CreateFile    (const char *fileName,
+                     int pageBytes = PF_MIN_PAGE_BYTES);
    RC DestroyFile   (const char *fileName);       // Delete a file
 
-   // Open and close file methods
-   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle);
+   // Open and close file methods.  With PF_OPEN_MMAP the pages the file
+   // has are read through a mapping of it instead of the buffer pool,
+   // except for pages the buffer pool already holds.  The pages go to the
+   // pool given; each pool has a buffer of its own for each page size.
+   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle,
+                     PF_OpenMode mode = PF_OPEN_BUFFERED,
+                     PF_PoolId pool = PF_POOL_DATA);
    RC CloseFile     (PF_FileHandle &fileHandle);
 
+   // Keep the pages of up to numFiles closed files in the buffer pools (0,
+   // the default, keeps none).  Closing the last handle on a file then
+   // writes its dirty pages but leaves them resident, and its descriptor
+   // open, so that opening the file again finds them there.  The files
+   // closed longest ago are let go first.
+   RC SetKeepClosed (int numFiles);
+
+   // Warm-up of the buffer pools across restarts.  SaveWarmList writes the
+   // names and pools of the open and kept files, open ones and then the
+   // most recently closed first, with their resident pages, hottest
+   // first, to the file listName.  WarmUp starts reading such a list back
+   // in the background: the pages of each file that is unchanged since
+   // are prefetched, in file order, into the frames of its pool that are
+   // still free, and the file is kept as if just closed; a file opened
+   // meanwhile gets them too.  Files are not kept, and so not warmed up,
+   // unless SetKeepClosed was called first.
+   RC SaveWarmList  (const char *listName);
+   RC WarmUp        (const char *listName);
+
    // Three methods that manipulate the buffer manager.  The calls are
-   // forwarded to the PF_BufferMgr instance and are called by parse.y
-   // when the user types in a system command.
+   // forwarded to the PF_BufferMgr instances and are called by parse.y
+   // when the user types in a system command.  iNewSize is in pages of
+   // PF_MIN_PAGE_BYTES; the pool of a larger page size gets as many
+   // bytes, in fewer pages.  ResizeBuffer resizes the data pool.
    RC ClearBuffer   ();
    RC PrintBuffer   ();
-   RC ResizeBuffer  (int iNewSize);
+   // numShards splits the buffer into that many latched partitions
+   // (rounded down to a power of two); 0 picks a number from the size of
+   // the buffer and the number of cores
+   RC ResizeBuffer  (int iNewSize, int numShards = 0);
+
+   // Set the size, in pages of PF_MIN_PAGE_BYTES, and the replacement
+   // policy of a pool.  No page of the pool may be pinned.  The catalog
+   // and index pools are small and apart from the data pool by default,
+   // so that scans of heap files do not evict them; the index pool uses
+   // LRU-2, under which the inner nodes every lookup goes through outlive
+   // the leaves.
+   RC SetPool       (PF_PoolId pool, int numPages, PF_ReplacePolicy policy);
+
+   // Set the number of pages read at once when a file is scanned
+   // sequentially (PF_READAHEAD_PAGES by default, 1 turns it off)
+   RC SetReadAhead  (int numPages);
+
+   // Tune the background writer, which writes dirty pages ahead of their
+   // eviction so that GetPage rarely has to.  cleanRatio is the fraction
+   // of the buffer, taken from the replacement end, that it keeps clean;
+   // 0 (the default) turns it off.  maxWritesPerSec caps its rate; 0
+   // means unlimited.
+   RC SetWriterTarget(double cleanRatio);
+   RC SetWriterRate (int maxWritesPerSec);
+
+   // Set the number of pages a file grows by on disk when it runs out of
+   // pages (PF_EXTENT_PAGES by default, 1 turns preallocation off).  The
+   // pages are allocated at once and handed out by AllocatePage one by
+   // one; a large file grows by more, half its size at a time.  Applies
+   // to the files opened afterwards.
+   RC SetFileExtent (int numPages);
 
    // Three Methods for manipulating raw memory buffers.  These memory
    // locations are handled by the buffer manager, but are not
@@ -150,13 +391,105 @@ public:
    // Return the size of the block that can be allocated.
    RC GetBlockSize  (int &length) const;
 
-   // Allocate a memory chunk that lives in buffer manager
-   RC AllocateBlock (char *&buffer);
+   // Allocate a memory chunk that lives in buffer manager, in the pages
+   // of PF_MIN_PAGE_BYTES of a pool
+   RC AllocateBlock (char *&buffer, PF_PoolId pool = PF_POOL_DATA);
    // Dispose of a memory chunk managed by the buffer manager.
-   RC DisposeBlock  (char *buffer);
+   RC DisposeBlock  (char *buffer, PF_PoolId pool = PF_POOL_DATA);
+
+private:
+   // Buffer of a pool for pages of pageBytes bytes, created on first use
+   RC GetBuffer     (PF_PoolId pool, int pageBytes, PF_BufferMgr *&pBufferMgr);
+   // Number of pages of the buffer of a pool for class c
+   int ClassPages   (int pool, int c) const;
+   // Body of the warm-up thread, and the warm-up of one file in it
+   void WarmFiles   (const char *listName);
+   void WarmFile    (const char *fileName, PF_PoolId pool, long long ino,
+                     long long size, long long mtime, PageNum *pageNums,
+                     int numPages, int rank);
+   // Descriptor of fileName opened with the flags of the I/O engine
+   int  OpenFd      (const char *fileName);
+
+   PF_BufferMgr *pBufferMgrs[PF_NUM_POOLS][PF_PAGE_CLASSES];
+                                                  // page-buffer manager of
+                                                  // each pool and page size,
+                                                  // from PF_MIN_PAGE_BYTES up
+   int poolPages[PF_NUM_POOLS];                   // size and policy of each
+   PF_ReplacePolicy poolPolicy[PF_NUM_POOLS];     // pool
+   PF_IOEngineType ioEngine;                      // settings that the pools
+   int numShards;                                 // created later get too
+   int readAhead;
+   double cleanRatio;
+   int maxWritesPerSec;
+   int extentPages;
+   PF_FileTable *pFiles;                          // files open and kept
+};
+
+//
+// PF_Arena: work memory of a query operator, bounded by the buffer pool
+//
+// An arena takes blocks from the temp pool, at most maxBlocks at a time,
+// and hands out memory inside them: bump allocation, for data that lives
+// until the next Spill or Reset, and slabs of objects of one size that
+// are freed one by one.  Every block is a pinned frame, so the memory of
+// all arenas together never exceeds the temp pool.  When the budget or
+// the pool runs out, allocation returns PF_ARENAFULL; the operator then
+// spills what it has bump-allocated to a temporary file and carries on.
+// Release gives every block back and destroys the spill files.
+//
+class PF_Arena {
+public:
+   PF_Arena       ();                            // Default constructor
+   ~PF_Arena      ();                            // Calls Release()
+
+   // Take blocks from the temp pool of pfm, at most maxBlocks at a time
+   RC Init        (PF_Manager &pfm, int maxBlocks);
+
+   // Largest allocation, the same as the data of a page of a spill file
+   int BlockSize  () const { return (PF_PAGE_SIZE); }
+
+   // Bump allocation of length bytes, aligned to 8 bytes.  Allocations
+   // do not straddle blocks.
+   RC Alloc       (int length, char *&pData);
+
+   // Slab allocation: NewSlab sets up a slab of objects of objSize bytes,
+   // aligned to 8 bytes, that SlabAlloc and SlabFree hand out and take
+   // back.  Slab blocks are kept until Release.
+   RC NewSlab     (int objSize, int &slab);
+   RC SlabAlloc   (int slab, char *&pData);
+   RC SlabFree    (int slab, char *pData);
+
+   // Write the bump-allocated blocks, in the order they were taken, to a
+   // new temporary file in the temp pool, a page each, and give them
+   // back.  The file stays open in *pFileHandle until Release; its pages
+   // read back in order with GetFirstPage and GetNextPage.
+   RC Spill       (PF_FileHandle *&pFileHandle);
+   // Give the bump-allocated blocks back without writing them
+   RC Reset       ();
+   // Give every block back and destroy the spill files
+   RC Release     ();
+
+   int NumBlocks  () const { return (numBlocks); }  // blocks taken now
 
 private:
-   PF_BufferMgr *pBufferMgr;                      // page-buffer manager
+   RC NewBlock    (char *&pBlock);                // take a block
+
+   struct Slab {
+      int  objSize;                               // bytes per object
+      char *pFree;                                // free objects, linked
+                                                  // through their first
+                                                  // bytes
+   };
+
+   PF_Manager *pPfManager;
+   int  maxBlocks;                                // budget
+   int  numBlocks;                                // blocks taken
+   std::vector<char *> bumpBlocks;                // in order of allocation
+   int  bumpUsed;                                 // bytes used of the last
+   std::vector<char *> slabBlocks;
+   std::vector<Slab> slabs;
+   std::vector<PF_FileHandle *> spillFiles;       // open spill files
+   std::vector<std::string> spillNames;           // and their names
 };
 
 //
@@ -173,7 +506,13 @@ void PF_PrintError(RC rc);
 #define PF_PAGEUNPINNED    (START_PF_WARN + 6) // page already unpinned
 #define PF_EOF             (START_PF_WARN + 7) // end of file
 #define PF_TOOSMALL        (START_PF_WARN + 8) // Resize buffer too small
-#define PF_LASTWARN        PF_TOOSMALL
+#define PF_BADPARAM        (START_PF_WARN + 9) // bad buffer tuning value
+#define PF_MAPPEDPAGE      (START_PF_WARN + 10) // page pinned read-only in
+                                                // a file mapping
+#define PF_BADPAGESIZE     (START_PF_WARN + 11) // invalid page size
+#define PF_ARENAFULL       (START_PF_WARN + 12) // arena budget or temp
+                                                // pool used up
+#define PF_LASTWARN        PF_ARENAFULL
 
 #define PF_NOMEM           (START_PF_ERR - 0)  // no memory
 #define PF_NOBUF           (START_PF_ERR - 1)  // no buffer space
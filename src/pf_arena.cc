@@ -0,0 +1,311 @@
+//
+// File:        pf_arena.cc
+// Description: PF_Arena class implementation
+//
+// Blocks come from PF_Manager::AllocateBlock in the temp pool.  Only the
+// first PF_PAGE_SIZE bytes of a block are handed out, so that a block
+// spills to exactly one page.
+//
+
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+#include "pf_internal.h"
+
+//
+// Defines
+//
+#define ARENA_ALIGN    8               // alignment of every allocation
+
+// Numbers the spill files of the process
+static std::atomic<int> spillCount(0);
+
+static int AlignUp(int length)
+{
+   return ((length + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1));
+}
+
+//
+// PF_Arena
+//
+// Desc: Default constructor.  The arena has no budget until Init.
+//
+PF_Arena::PF_Arena()
+{
+   pPfManager = NULL;
+   maxBlocks = 0;
+   numBlocks = 0;
+   bumpUsed = 0;
+}
+
+//
+// ~PF_Arena
+//
+// Desc: Destructor.  Gives every block back and destroys the spill
+//       files; errors cannot be reported from here, call Release() to
+//       see them.
+//
+PF_Arena::~PF_Arena()
+{
+   Release();
+}
+
+//
+// Init
+//
+// Desc: Set the manager the blocks come from and the budget.  Blocks
+//       taken already are given back first.
+// In:   pfm - manager whose temp pool holds the blocks
+//       maxBlocks - most blocks held at once, 1 or more
+// Ret:  PF_BADPARAM if maxBlocks is less than 1, or another PF return code
+//
+RC PF_Arena::Init(PF_Manager &pfm, int _maxBlocks)
+{
+   RC rc;
+
+   if (_maxBlocks < 1)
+      return (PF_BADPARAM);
+   if ((rc = Release()))
+      return (rc);
+
+   pPfManager = &pfm;
+   maxBlocks = _maxBlocks;
+   return (0);
+}
+
+//
+// NewBlock
+//
+// Desc: Internal.  Take a block from the temp pool, within the budget
+// Out:  pBlock - the block
+// Ret:  PF_ARENAFULL if the budget is used up or every frame of the pool
+//       is pinned, or another PF return code
+//
+RC PF_Arena::NewBlock(char *&pBlock)
+{
+   RC rc;
+
+   if (pPfManager == NULL)
+      return (PF_BADPARAM);
+   if (numBlocks >= maxBlocks)
+      return (PF_ARENAFULL);
+   if ((rc = pPfManager->AllocateBlock(pBlock, PF_POOL_TEMP)))
+      return (rc == PF_NOBUF ? PF_ARENAFULL : rc);
+   numBlocks++;
+   return (0);
+}
+
+//
+// Alloc
+//
+// Desc: Bump allocation, from the last block taken or a new one
+// In:   length - bytes wanted, 1 to BlockSize()
+// Out:  pData - the memory, aligned to ARENA_ALIGN bytes
+// Ret:  PF_BADPARAM if length is out of range, PF_ARENAFULL if a new block
+//       is needed and cannot be had, or another PF return code
+//
+RC PF_Arena::Alloc(int length, char *&pData)
+{
+   RC rc;
+
+   if (length < 1 || length > BlockSize())
+      return (PF_BADPARAM);
+
+   if (bumpBlocks.empty() || bumpUsed + length > BlockSize()) {
+      char *pBlock;
+      if ((rc = NewBlock(pBlock)))
+         return (rc);
+      bumpBlocks.push_back(pBlock);
+      bumpUsed = 0;
+   }
+
+   pData = bumpBlocks.back() + bumpUsed;
+   bumpUsed = std::min(AlignUp(bumpUsed + length), BlockSize());
+   return (0);
+}
+
+//
+// NewSlab
+//
+// Desc: Set up a slab of objects of one size.  It takes no block until
+//       the first object is allocated.
+// In:   objSize - bytes per object, 1 to BlockSize()
+// Out:  slab - the slab, for SlabAlloc and SlabFree
+// Ret:  PF_BADPARAM if objSize is out of range, 0 otherwise
+//
+RC PF_Arena::NewSlab(int objSize, int &slab)
+{
+   if (objSize < 1 || objSize > BlockSize())
+      return (PF_BADPARAM);
+
+   Slab s = { AlignUp(std::max(objSize, (int)sizeof(char *))), NULL };
+   slabs.push_back(s);
+   slab = slabs.size() - 1;
+   return (0);
+}
+
+//
+// SlabAlloc
+//
+// Desc: Allocate an object of a slab.  A slab with no free object takes
+//       a new block and cuts it into objects.
+// In:   slab - the slab
+// Out:  pData - the object
+// Ret:  PF_BADPARAM if slab is not a slab, PF_ARENAFULL if a new block is
+//       needed and cannot be had, or another PF return code
+//
+RC PF_Arena::SlabAlloc(int slab, char *&pData)
+{
+   RC rc;
+
+   if (slab < 0 || slab >= (int)slabs.size())
+      return (PF_BADPARAM);
+   Slab &s = slabs[slab];
+
+   if (s.pFree == NULL) {
+      char *pBlock;
+      if ((rc = NewBlock(pBlock)))
+         return (rc);
+      slabBlocks.push_back(pBlock);
+      for (int offset = (BlockSize() / s.objSize - 1) * s.objSize;
+            offset >= 0; offset -= s.objSize) {
+         *(char **)(pBlock + offset) = s.pFree;
+         s.pFree = pBlock + offset;
+      }
+   }
+
+   pData = s.pFree;
+   s.pFree = *(char **)pData;
+   return (0);
+}
+
+//
+// SlabFree
+//
+// Desc: Give an object back to its slab
+// In:   slab - the slab it was allocated from
+//       pData - the object
+// Ret:  PF_BADPARAM if slab is not a slab, 0 otherwise
+//
+RC PF_Arena::SlabFree(int slab, char *pData)
+{
+   if (slab < 0 || slab >= (int)slabs.size())
+      return (PF_BADPARAM);
+
+   *(char **)pData = slabs[slab].pFree;
+   slabs[slab].pFree = pData;
+   return (0);
+}
+
+//
+// Spill
+//
+// Desc: Write the bump-allocated blocks to a new temporary file and give
+//       them back.  Each block is copied aside and given back before its
+//       page is allocated, so the page can take its frame even when the
+//       temp pool is pinned full.
+// Out:  pFileHandle - the spill file, open until Release
+// Ret:  PF return code
+//
+RC PF_Arena::Spill(PF_FileHandle *&pFileHandle)
+{
+   RC rc;
+   char name[64];
+
+   if (pPfManager == NULL)
+      return (PF_BADPARAM);
+
+   sprintf(name, "pf_spill.%d.%d", (int)getpid(), spillCount++);
+   if ((rc = pPfManager->CreateFile(name)))
+      return (rc);
+   pFileHandle = new PF_FileHandle;
+   if ((rc = pPfManager->OpenFile(name, *pFileHandle, PF_OPEN_BUFFERED,
+         PF_POOL_TEMP))) {
+      delete pFileHandle;
+      pPfManager->DestroyFile(name);
+      return (rc);
+   }
+   spillFiles.push_back(pFileHandle);
+   spillNames.push_back(name);
+
+   std::vector<char> copy(BlockSize());
+   for (unsigned i = 0; i < bumpBlocks.size(); i++) {
+      PF_PageGuard pageGuard;
+      char *pData;
+
+      memcpy(&copy[0], bumpBlocks[i], BlockSize());
+      if ((rc = pPfManager->DisposeBlock(bumpBlocks[i], PF_POOL_TEMP)))
+         return (rc);
+      bumpBlocks[i] = NULL;
+      numBlocks--;
+
+      if ((rc = pFileHandle->AllocatePage(pageGuard)) ||
+            (rc = pageGuard.GetData(pData)))
+         return (rc);
+      memcpy(pData, &copy[0], BlockSize());
+      if ((rc = pageGuard.MarkDirty()) ||
+            (rc = pageGuard.UnpinPage()))
+         return (rc);
+   }
+
+   bumpBlocks.clear();
+   bumpUsed = 0;
+   return (0);
+}
+
+//
+// Reset
+//
+// Desc: Give the bump-allocated blocks back; the slabs are left alone
+// Ret:  PF return code
+//
+RC PF_Arena::Reset()
+{
+   RC rc = 0, rcBlock;
+
+   for (unsigned i = 0; i < bumpBlocks.size(); i++)
+      if (bumpBlocks[i] != NULL) {
+         if ((rcBlock = pPfManager->DisposeBlock(bumpBlocks[i],
+               PF_POOL_TEMP)) && rc == 0)
+            rc = rcBlock;
+         numBlocks--;
+      }
+   bumpBlocks.clear();
+   bumpUsed = 0;
+   return (rc);
+}
+
+//
+// Release
+//
+// Desc: Give every block back, forget the slabs and close and destroy the
+//       spill files.  Everything is released even if some step fails.
+// Ret:  the first PF return code that is not 0
+//
+RC PF_Arena::Release()
+{
+   RC rc, rcStep;
+
+   rc = Reset();
+   for (unsigned i = 0; i < slabBlocks.size(); i++) {
+      if ((rcStep = pPfManager->DisposeBlock(slabBlocks[i], PF_POOL_TEMP))
+            && rc == 0)
+         rc = rcStep;
+      numBlocks--;
+   }
+   slabBlocks.clear();
+   slabs.clear();
+
+   for (unsigned i = 0; i < spillFiles.size(); i++) {
+      if ((rcStep = pPfManager->CloseFile(*spillFiles[i])) && rc == 0)
+         rc = rcStep;
+      if ((rcStep = pPfManager->DestroyFile(spillNames[i].c_str())) &&
+            rc == 0)
+         rc = rcStep;
+      delete spillFiles[i];
+   }
+   spillFiles.clear();
+   spillNames.clear();
+   return (rc);
+}
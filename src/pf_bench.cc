@@ -0,0 +1,1469 @@
+//
+// File:        pf_bench.cc
+// Description: Benchmarks for the PF component
+//
+// Usage:  pf_bench [benchmark ...]
+//
+// With no arguments every benchmark is run.  The benchmarks are:
+//
+//   replace - hit rate and eviction cost of each page replacement policy
+//             on a trace that mixes point lookups (mostly on a small hot
+//             set) with periodic full scans of a large file, with the
+//             scans passing no hint and SEQUENTIAL_ONCE
+//   hash    - cost of a buffer page table lookup (hit and miss) for growing
+//             numbers of resident pages, against the chained table with a
+//             fixed number of buckets that PF_HashTable used to be
+//   flush   - closing a file whose pages were dirtied in random order in a
+//             large buffer: write calls issued and time to close
+//   scan    - a GetNextPage scan of a large file, with the file dropped
+//             from the OS page cache first, for several read-ahead windows
+//   io      - random page fetches in batches (PrefetchPages, then a pin of
+//             each page, as an index RID fetch would), with each I/O engine,
+//             followed by rewriting every fetched page
+//   bgwriter  - a read-only pass over one file right after every page of
+//             another file was dirtied in a buffer holding all of them,
+//             for several background writer targets (O_DIRECT, so the
+//             writes done at eviction really reach the device)
+//   resize    - grow and shrink a buffer full of pages, then read back the
+//             pages that should have stayed resident
+//   arena     - time to set up buffers of growing sizes, against giving
+//             every frame its own zeroed allocation as the buffer manager
+//             used to
+//   mt        - page lookups per second from growing numbers of threads
+//             sharing one file, spread over the file and all on one hot
+//             page, with a single buffer shard and with several
+//   mmap      - a cold and a warm scan of a file opened buffered, with a
+//             buffer as large as the file, and opened memory-mapped, with
+//             the default buffer: throughput and the memory the process
+//             uses (anonymous, i.e. frames, and mapped file pages)
+//   grow      - two files loaded side by side, a page of each in turn, for
+//             several file extents: time, preallocations and the number
+//             of pieces the file system split each file into
+//   free      - disposing of most pages of a file, scanning what is left
+//             and allocating the freed pages again, with a cold OS cache:
+//             time and page reads and writes of each step
+//   pools     - lookups on the pages of a small index-like file between
+//             scans of a large heap file, with both files in one pool and
+//             with the small file in the index pool, for the same memory
+//   workmem   - records bump-allocated in a PF_Arena with a budget, spilled
+//             to temporary files whenever it runs out and read back, as
+//             the run generation of an external sort would, for several
+//             budgets: spills, pages written while filling and time
+//   warm      - looking up the hot pages of a file after a restart, with
+//             a cold OS cache, from an empty buffer and from a buffer
+//             warmed up from the list saved when the file was last closed
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include "pf.h"
+#include "pf_internal.h"
+#include "pf_hashtable.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+//
+// Defines
+//
+#define BENCHFILE        "pf_bench.dat"
+#define BENCHFILE2       "pf_bench2.dat"
+#define SCAN_PAGES       400            // pages in the benchmark file
+#define HOT_PAGES        24             // pages hit by point lookups
+#define ROUNDS           40             // rounds of the mixed trace
+#define LOOKUPS_PER_ROUND 2000          // point lookups per round
+#define COLD_PERCENT     10             // % of lookups outside the hot set
+#define SCAN_EVERY       4              // rounds between full scans
+#define HASH_FILES       4              // files sharing the page table
+#define HASH_LOOKUPS     1000000        // lookups per table size
+#define FLUSH_PAGES      4000           // pages dirtied before the close
+#define SEQ_PAGES        8000           // pages in the sequential scan file
+#define IO_BATCH         64             // pages fetched per batch
+#define IO_BATCHES       64             // batches per engine
+#define BG_PAGES         2000           // buffer pages, and pages dirtied
+#define BG_IDLE_MS       500            // pause between load and query
+#define RESIZE_PAGES     4000           // buffer pages before resizing
+#define ARENA_MAX_MB     4096           // largest buffer set up
+#define ARENA_FRAMES_MB  1024           // largest one allocated per frame
+#define MT_PAGES         4096           // pages in the multi-thread file
+#define MT_OPS           200000         // lookups per thread
+#define MT_MAX_THREADS   8              // most threads run at once
+#define MT_SHARDS        16             // shards of the partitioned buffer
+#define MMAP_PAGES       16384          // pages in the mapped file
+#define WM_RECORDS       200000         // records put in the arena
+#define WM_RECLEN        40             // bytes per record
+#define WM_TEMP_PAGES    256            // pages of the temp pool
+#define WARM_PAGES       1024           // hot pages, and buffer pages
+#define WARMLIST         "pf_bench.warm" // warm-up list of the benchmark
+#define GROW_PAGES       16384          // pages loaded into each file
+
+//
+// Now
+//
+// Desc: Wall clock time in seconds
+//
+static double Now()
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//
+// GetStat
+//
+// Desc: Current value of a PF statistic, 0 if it was never registered
+//
+static int GetStat(const char *psKey)
+{
+#ifdef PF_STATS
+   int *piValue = pStatisticsMgr->Get(psKey);
+   int iValue = piValue ? *piValue : 0;
+   delete piValue;
+   return iValue;
+#else
+   return 0;
+#endif
+}
+
+static void ResetStats()
+{
+#ifdef PF_STATS
+   pStatisticsMgr->Reset();
+#endif
+}
+
+//
+// CreateBenchFile
+//
+// Desc: Create a PF file of numPages pages, each holding its page number
+//
+static RC CreateBenchFile(const char *fileName, int numPages)
+{
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageHandle ph;
+   PageNum pageNum;
+   char *pData;
+   RC rc;
+
+   unlink(fileName);
+   if ((rc = pfm.CreateFile(fileName)) ||
+         (rc = pfm.OpenFile(fileName, fh)))
+      return (rc);
+
+   for (int i = 0; i < numPages; i++) {
+      if ((rc = fh.AllocatePage(ph)) ||
+            (rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNum)))
+         return (rc);
+      memcpy(pData, &pageNum, sizeof(PageNum));
+      if ((rc = fh.MarkDirty(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   return (pfm.CloseFile(fh));
+}
+
+//
+// Lookup
+//
+// Desc: Pin and unpin one page, checking its contents
+//
+static RC Lookup(PF_FileHandle &fh, PageNum pageNum)
+{
+   PF_PageHandle ph;
+   char *pData;
+   RC rc;
+
+   if ((rc = fh.GetThisPage(pageNum, ph)) ||
+         (rc = ph.GetData(pData)))
+      return (rc);
+   if (memcmp(pData, &pageNum, sizeof(PageNum))) {
+      cerr << "Page " << pageNum << " has wrong contents\n";
+      exit(1);
+   }
+   return (fh.UnpinPage(pageNum));
+}
+
+// Sum of the words Scan reads, kept so that the reads are not optimized out
+static volatile long scanSum;
+
+//
+// Scan
+//
+// Desc: Pin and unpin every page of the file in order, checking its
+//       contents and reading a word of every cache line, so that a mapped
+//       file is faulted in as a buffered one is read
+//
+static RC Scan(PF_FileHandle &fh, ClientHint hint = NO_HINT)
+{
+   PF_PageHandle ph;
+   PageNum pageNum;
+   char *pData;
+   int pageSize;
+   long sum = 0;
+   RC rc;
+
+   if ((rc = fh.GetPageSize(pageSize)))
+      return (rc);
+   for (rc = fh.GetFirstPage(ph, hint); rc == 0;
+         rc = fh.GetNextPage(pageNum, ph, hint)) {
+      if ((rc = ph.GetPageNum(pageNum)) ||
+            (rc = ph.GetData(pData)))
+         return (rc);
+      if (memcmp(pData, &pageNum, sizeof(PageNum))) {
+         cerr << "Page " << pageNum << " has wrong contents\n";
+         exit(1);
+      }
+      for (int i = 0; i + (int)sizeof(long) <= pageSize; i += 64) {
+         long word;
+         memcpy(&word, pData + i, sizeof(long));
+         sum += word;
+      }
+      if ((rc = fh.UnpinPage(pageNum)))
+         return (rc);
+   }
+   scanSum = sum;
+   return (rc == PF_EOF ? 0 : rc);
+}
+
+//
+// BenchReplace
+//
+// Desc: Run the mixed scan and point lookup trace under every replacement
+//       policy.  The hot set fits comfortably in the buffer; a good policy
+//       keeps it resident across the scans, and so does any policy when
+//       the scans say they read each page once.
+//
+static RC BenchReplace()
+{
+   static const PF_ReplacePolicy policies[] = {
+      PF_REPLACE_LRU, PF_REPLACE_CLOCK, PF_REPLACE_2Q, PF_REPLACE_LRUK
+   };
+   static const char *names[] = { "LRU", "CLOCK", "2Q", "LRU-2" };
+   RC rc;
+
+   cout << "replace: " << SCAN_PAGES << " page file, " << HOT_PAGES
+      << " hot pages, " << PF_BUFFER_SIZE << " buffer pages, a full scan"
+      << " every " << SCAN_EVERY << " rounds of " << LOOKUPS_PER_ROUND
+      << " lookups (" << COLD_PERCENT << "% cold)\n";
+   cout << setw(8) << "policy" << setw(17) << "scan hint" << setw(10)
+      << "hit %" << setw(12)
+      << "hot hit %" << setw(10) << "victims" << setw(14) << "probes/victim"
+      << setw(12) << "ns/access" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SCAN_PAGES)))
+      return (rc);
+
+   for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+   for (int h = 0; h < 2; h++) {
+      ClientHint hint = h ? SEQUENTIAL_ONCE : NO_HINT;
+      PF_Manager pfm(policies[p]);
+      PF_FileHandle fh;
+      long accesses = 0;
+      int hotHits = 0, hotGets = 0;
+
+      if ((rc = pfm.OpenFile(BENCHFILE, fh)))
+         return (rc);
+
+      srand(1);
+      ResetStats();
+      double start = Now();
+
+      for (int round = 0; round < ROUNDS; round++) {
+         if (round % SCAN_EVERY == SCAN_EVERY - 1) {
+            if ((rc = Scan(fh, hint)))
+               return (rc);
+            accesses += SCAN_PAGES;
+         }
+
+         for (int i = 0; i < LOOKUPS_PER_ROUND; i++) {
+            if (rand() % 100 < COLD_PERCENT) {
+               if ((rc = Lookup(fh, rand() % SCAN_PAGES)))
+                  return (rc);
+               continue;
+            }
+
+            int found = GetStat(PF_PAGEFOUND);
+            if ((rc = Lookup(fh, rand() % HOT_PAGES)))
+               return (rc);
+            hotHits += GetStat(PF_PAGEFOUND) - found;
+            hotGets++;
+         }
+         accesses += LOOKUPS_PER_ROUND;
+      }
+
+      double elapsed = Now() - start;
+      int gets = GetStat(PF_GETPAGE);
+      int victims = GetStat(PF_VICTIMS);
+      int probes = GetStat(PF_VICTIMPROBES);
+
+      cout << setw(8) << names[p]
+         << setw(17) << (h ? "SEQUENTIAL_ONCE" : "none")
+         << fixed << setprecision(2)
+         << setw(10) << (gets ? 100.0 * GetStat(PF_PAGEFOUND) / gets : 0)
+         << setw(12) << 100.0 * hotHits / hotGets
+         << setw(10) << victims
+         << setw(14) << (victims ? (double)probes / victims : 0)
+         << setw(12) << setprecision(0) << elapsed * 1e9 / accesses << "\n";
+
+      if ((rc = pfm.CloseFile(fh)))
+         return (rc);
+   }
+
+#ifndef PF_STATS
+   cout << "Note: statistics are not compiled in, hit rates are not counted\n";
+#endif
+
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// PF_ChainedTable
+//
+// Desc: The chained page table PF_HashTable used to be: a fixed number of
+//       buckets, one heap node per entry, hashed on (fd + pageNum).  Kept
+//       here only as a baseline for BenchHash.
+//
+class PF_ChainedTable {
+public:
+   PF_ChainedTable(int _numBuckets) : numBuckets(_numBuckets)
+   {
+      buckets = new Entry*[numBuckets];
+      memset(buckets, 0, numBuckets * sizeof(Entry *));
+   }
+   ~PF_ChainedTable()
+   {
+      for (int i = 0; i < numBuckets; i++)
+         while (buckets[i]) {
+            Entry *pNext = buckets[i]->next;
+            delete buckets[i];
+            buckets[i] = pNext;
+         }
+      delete[] buckets;
+   }
+   void Insert(int fd, PageNum pageNum, int slot)
+   {
+      Entry *e = new Entry;
+      int bucket = Hash(fd, pageNum);
+      e->fd = fd;
+      e->pageNum = pageNum;
+      e->slot = slot;
+      e->next = buckets[bucket];
+      buckets[bucket] = e;
+   }
+   RC Find(int fd, PageNum pageNum, int &slot)
+   {
+      for (Entry *e = buckets[Hash(fd, pageNum)]; e; e = e->next)
+         if (e->fd == fd && e->pageNum == pageNum) {
+            slot = e->slot;
+            return (0);
+         }
+      return (PF_HASHNOTFOUND);
+   }
+
+private:
+   struct Entry {
+      Entry *next;
+      int fd;
+      PageNum pageNum;
+      int slot;
+   };
+   int Hash(int fd, PageNum pageNum) const
+   { return ((fd + pageNum) % numBuckets); }
+
+   int numBuckets;
+   Entry **buckets;
+};
+
+//
+// TimeLookups
+//
+// Desc: Average ns per Find() of numLookups keys from keys[] (numKeys
+//       entries of (fd, pageNum) pairs).  Exits if a hit is not found or a
+//       miss is.
+//
+template <class Table>
+static double TimeLookups(Table &table, const int *keys, int numKeys,
+                          int numLookups, bool bHit)
+{
+   int slot, found = 0;
+   double start = Now();
+
+   for (int i = 0; i < numLookups; i++) {
+      const int *key = keys + 2 * (i % numKeys);
+      if (table.Find(key[0], key[1], slot) == 0)
+         found++;
+   }
+
+   double elapsed = Now() - start;
+   if (found != (bHit ? numLookups : 0)) {
+      cerr << "hash: wrong number of entries found\n";
+      exit(1);
+   }
+   return (elapsed * 1e9 / numLookups);
+}
+
+//
+// BenchHash
+//
+// Desc: Fill the page table with the pages of HASH_FILES files and time
+//       random lookups of resident and of non-resident pages
+//
+static RC BenchHash()
+{
+   static const int sizes[] = { PF_BUFFER_SIZE, 1024, 16384, 131072 };
+   RC rc;
+
+   cout << "hash: " << HASH_LOOKUPS << " lookups over " << HASH_FILES
+      << " files, ns/lookup\n";
+   cout << setw(10) << "pages" << setw(14) << "open hit" << setw(14)
+      << "open miss" << setw(14) << "chained hit" << setw(14)
+      << "chained miss" << "\n";
+
+   for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      int numPages = sizes[s];
+      int *hits = new int[2 * numPages];
+      int *misses = new int[2 * numPages];
+      PF_HashTable table(numPages);
+      PF_ChainedTable chained(PF_HASH_TBL_SIZE);
+      // The chains grow with the table, so do fewer chained lookups
+      int chainedLookups = HASH_LOOKUPS / (numPages / PF_BUFFER_SIZE);
+
+      // Files are filled in turn with consecutive page numbers, as the
+      // buffer would hold them after scanning each file
+      for (int i = 0; i < numPages; i++) {
+         int fd = 3 + i % HASH_FILES;
+         PageNum pageNum = i / HASH_FILES;
+         if ((rc = table.Insert(fd, pageNum, i)))
+            return (rc);
+         chained.Insert(fd, pageNum, i);
+      }
+
+      // Probe in random order; misses are pages past the resident ones
+      srand(1);
+      for (int i = 0; i < numPages; i++) {
+         int j = rand() % numPages;
+         hits[2 * i] = 3 + j % HASH_FILES;
+         hits[2 * i + 1] = j / HASH_FILES;
+         misses[2 * i] = hits[2 * i];
+         misses[2 * i + 1] = hits[2 * i + 1] + numPages;
+      }
+
+      cout << setw(10) << numPages << fixed << setprecision(1)
+         << setw(14) << TimeLookups(table, hits, numPages, HASH_LOOKUPS,
+                                    true)
+         << setw(14) << TimeLookups(table, misses, numPages, HASH_LOOKUPS,
+                                    false)
+         << setw(14) << TimeLookups(chained, hits, numPages, chainedLookups,
+                                    true)
+         << setw(14) << TimeLookups(chained, misses, numPages, chainedLookups,
+                                    false)
+         << "\n";
+
+      delete[] hits;
+      delete[] misses;
+   }
+
+   return (0);
+}
+
+//
+// BenchFlush
+//
+// Desc: Dirty every page of a file in random order, then time CloseFile,
+//       which writes them all back
+//
+static RC BenchFlush()
+{
+   PageNum *order = new PageNum[FLUSH_PAGES];
+   RC rc;
+
+   cout << "flush: " << FLUSH_PAGES << " dirty pages, buffer of "
+      << FLUSH_PAGES << " pages\n";
+
+   // Every PF_Manager owns the statistics, so the file is created before
+   // the manager that is measured
+   if ((rc = CreateBenchFile(BENCHFILE, FLUSH_PAGES)))
+      return (rc);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageGuard pg;
+
+   if ((rc = pfm.ResizeBuffer(FLUSH_PAGES)) ||
+         (rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   // Shuffle the page numbers
+   srand(1);
+   for (int i = 0; i < FLUSH_PAGES; i++)
+      order[i] = i;
+   for (int i = FLUSH_PAGES - 1; i > 0; i--) {
+      int j = rand() % (i + 1);
+      PageNum t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+   }
+
+   for (int i = 0; i < FLUSH_PAGES; i++) {
+      if ((rc = fh.GetThisPage(order[i], pg)) ||
+            (rc = pg.MarkDirty()) ||
+            (rc = pg.UnpinPage()))
+         return (rc);
+   }
+
+   ResetStats();
+   double start = Now();
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+   double elapsed = Now() - start;
+
+   cout << setw(10) << "pages" << setw(14) << "write calls" << setw(12)
+      << "ms" << setw(12) << "MB/s" << "\n";
+   cout << setw(10) << GetStat(PF_WRITEPAGE) << setw(14) << GetStat(PF_WRITEV)
+      << fixed << setprecision(2) << setw(12) << elapsed * 1e3
+      << setw(12) << FLUSH_PAGES * (double)PF_PAGE_SIZE / elapsed / 1e6
+      << "\n";
+
+   delete[] order;
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// DropCache
+//
+// Desc: Ask the OS to drop the cached pages of a file, so that the next
+//       scan of it really goes to the disk
+//
+static void DropCache(const char *fileName)
+{
+   int fd = open(fileName, O_RDONLY);
+   if (fd < 0)
+      return;
+   fdatasync(fd);
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+   close(fd);
+}
+
+//
+// BenchScan
+//
+// Desc: Scan a file with GetNextPage, as RM_FileScan does, for several
+//       read-ahead windows, starting from a cold OS cache each time
+//
+static RC BenchScan()
+{
+   static const int windows[] = { 1, 4, 8, 16 };
+   RC rc;
+
+   cout << "scan: " << SEQ_PAGES << " page file, " << PF_BUFFER_SIZE
+      << " buffer pages (windows are capped at a quarter of them)\n";
+   cout << setw(8) << "window" << setw(10) << "reads" << setw(10) << "readv"
+      << setw(12) << "prefetched" << setw(10) << "hits" << setw(10)
+      << "wasted" << setw(12) << "ms" << setw(12) << "MB/s" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SEQ_PAGES)))
+      return (rc);
+
+   for (unsigned w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+      PF_Manager pfm;
+      PF_FileHandle fh;
+
+      if ((rc = pfm.SetReadAhead(windows[w])))
+         return (rc);
+
+      DropCache(BENCHFILE);
+      ResetStats();
+      double start = Now();
+      if ((rc = pfm.OpenFile(BENCHFILE, fh)) ||
+            (rc = Scan(fh)) ||
+            (rc = pfm.CloseFile(fh)))
+         return (rc);
+      double elapsed = Now() - start;
+
+      // Every read call brings in one page that was asked for
+      int reads = GetStat(PF_READPAGE) - GetStat(PF_PREFETCHED);
+      cout << setw(8) << windows[w] << setw(10) << reads
+         << setw(10) << GetStat(PF_READV)
+         << setw(12) << GetStat(PF_PREFETCHED)
+         << setw(10) << GetStat(PF_PREFETCHHITS)
+         << setw(10) << GetStat(PF_PREFETCHWASTED)
+         << fixed << setprecision(2) << setw(12) << elapsed * 1e3
+         << setw(12) << SEQ_PAGES * (double)PF_PAGE_SIZE / elapsed / 1e6
+         << "\n";
+   }
+
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// BenchIO
+//
+// Desc: Fetch random pages of a file with a cold OS cache, IO_BATCH pages
+//       at a time, under each I/O engine; then dirty them all and time
+//       the close that writes them back
+//
+static RC BenchIO()
+{
+   static const PF_IOEngineType engines[] = {
+      PF_IO_SYNC, PF_IO_DIRECT, PF_IO_URING
+   };
+   static const char *names[] = { "sync", "direct", "uring" };
+   const int numPages = IO_BATCH * IO_BATCHES;
+   PageNum *pages = new PageNum[SEQ_PAGES];
+   RC rc;
+
+   cout << "io: " << IO_BATCHES << " batches of " << IO_BATCH
+      << " random pages from a " << SEQ_PAGES << " page file\n";
+   cout << setw(8) << "engine" << setw(10) << "requests" << setw(12)
+      << "fetch ms" << setw(12) << "pages/s" << setw(12) << "write ms"
+      << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SEQ_PAGES)))
+      return (rc);
+
+   // The same distinct pages for every engine: the first numPages of a
+   // shuffle of the file
+   srand(1);
+   for (int i = 0; i < SEQ_PAGES; i++)
+      pages[i] = i;
+   for (int i = SEQ_PAGES - 1; i > 0; i--) {
+      int j = rand() % (i + 1);
+      PageNum t = pages[i];
+      pages[i] = pages[j];
+      pages[j] = t;
+   }
+
+   for (unsigned e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+      PF_Manager pfm(PF_REPLACE_LRU, engines[e]);
+      PF_FileHandle fh;
+      PF_PageGuard pg;
+
+      if ((rc = pfm.ResizeBuffer(numPages)) ||
+            (rc = pfm.OpenFile(BENCHFILE, fh)))
+         return (rc);
+
+      DropCache(BENCHFILE);
+      ResetStats();
+      double start = Now();
+      for (int b = 0; b < IO_BATCHES; b++) {
+         PageNum *batch = pages + b * IO_BATCH;
+         if ((rc = fh.PrefetchPages(batch, IO_BATCH)))
+            return (rc);
+         for (int i = 0; i < IO_BATCH; i++)
+            if ((rc = Lookup(fh, batch[i])))
+               return (rc);
+      }
+      double fetched = Now() - start;
+      int requests = GetStat(PF_READV);
+
+      for (int i = 0; i < numPages; i++)
+         if ((rc = fh.GetThisPage(pages[i], pg)) ||
+               (rc = pg.MarkDirty()) ||
+               (rc = pg.UnpinPage()))
+            return (rc);
+
+      start = Now();
+      if ((rc = pfm.CloseFile(fh)))
+         return (rc);
+      double written = Now() - start;
+
+      cout << setw(8) << names[e] << setw(10) << requests
+         << fixed << setprecision(2) << setw(12) << fetched * 1e3
+         << setw(12) << setprecision(0) << numPages / fetched
+         << setw(12) << setprecision(2) << written * 1e3 << "\n";
+   }
+
+   delete[] pages;
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// BenchBgWriter
+//
+// Desc: Dirty a whole buffer of pages of one file, as a load would, pause,
+//       then read every page of another file and time it, with the
+//       background writer off and with several clean targets
+//
+static RC BenchBgWriter()
+{
+   static const double targets[] = { 0, 0.25, 1 };
+   RC rc;
+
+   cout << "bgwriter: " << BG_PAGES << " dirty pages, then " << BG_PAGES
+      << " page reads, buffer of " << BG_PAGES << " pages, "
+      << BG_IDLE_MS << " ms apart\n";
+   cout << setw(8) << "target" << setw(14) << "dirty victims" << setw(12)
+      << "bg writes" << setw(12) << "read ms" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, BG_PAGES)) ||
+         (rc = CreateBenchFile(BENCHFILE2, BG_PAGES)))
+      return (rc);
+
+   for (unsigned t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+      PF_Manager pfm(PF_REPLACE_LRU, PF_IO_DIRECT);
+      PF_FileHandle fhLoad, fhQuery;
+      PF_PageGuard pg;
+
+      if ((rc = pfm.ResizeBuffer(BG_PAGES)) ||
+            (rc = pfm.SetWriterTarget(targets[t])) ||
+            (rc = pfm.OpenFile(BENCHFILE, fhLoad)) ||
+            (rc = pfm.OpenFile(BENCHFILE2, fhQuery)))
+         return (rc);
+
+      // The writer keeps running, so the statistics are not reset
+      int victims = GetStat(PF_DIRTYVICTIMS);
+      int bgWrites = GetStat(PF_BGWRITES);
+
+      for (int i = 0; i < BG_PAGES; i++)
+         if ((rc = fhLoad.GetThisPage(i, pg)) ||
+               (rc = pg.MarkDirty()) ||
+               (rc = pg.UnpinPage()))
+            return (rc);
+      usleep(BG_IDLE_MS * 1000);
+
+      double start = Now();
+      for (int i = 0; i < BG_PAGES; i++)
+         if ((rc = Lookup(fhQuery, i)))
+            return (rc);
+      double elapsed = Now() - start;
+
+      cout << setw(8) << fixed << setprecision(2) << targets[t]
+         << setw(14) << GetStat(PF_DIRTYVICTIMS) - victims
+         << setw(12) << GetStat(PF_BGWRITES) - bgWrites
+         << setw(12) << elapsed * 1e3 << "\n";
+
+      if ((rc = pfm.CloseFile(fhQuery)) ||
+            (rc = pfm.CloseFile(fhLoad)))
+         return (rc);
+   }
+
+   unlink(BENCHFILE);
+   unlink(BENCHFILE2);
+   return (0);
+}
+
+//
+// BenchResize
+//
+// Desc: Read every page of a file into a buffer that holds them all, then
+//       double the buffer and read them all again, then halve it and read
+//       the half that was read last.  No page should have to be read
+//       again from the file.
+//
+static RC BenchResize()
+{
+   static const struct {
+      int numPages;           // new buffer size
+      PageNum first;          // pages read back afterwards
+   } steps[] = {
+      { RESIZE_PAGES * 2, 0 },
+      { RESIZE_PAGES / 2, RESIZE_PAGES / 2 },
+   };
+   RC rc;
+
+   cout << "resize: " << RESIZE_PAGES << " resident pages, LRU\n";
+   cout << setw(10) << "pages" << setw(12) << "resize ms" << setw(12)
+      << "pages read" << setw(12) << "from file" << "\n";
+
+   // The file is created before the manager that owns the statistics
+   if ((rc = CreateBenchFile(BENCHFILE, RESIZE_PAGES)))
+      return (rc);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+
+   if ((rc = pfm.ResizeBuffer(RESIZE_PAGES)) ||
+         (rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   for (int i = 0; i < RESIZE_PAGES; i++)
+      if ((rc = Lookup(fh, i)))
+         return (rc);
+
+   for (unsigned s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+      double start = Now();
+      if ((rc = pfm.ResizeBuffer(steps[s].numPages)))
+         return (rc);
+      double elapsed = Now() - start;
+
+      ResetStats();
+      for (int i = steps[s].first; i < RESIZE_PAGES; i++)
+         if ((rc = Lookup(fh, i)))
+            return (rc);
+
+      cout << setw(10) << steps[s].numPages << fixed << setprecision(2)
+         << setw(12) << elapsed * 1e3
+         << setw(12) << RESIZE_PAGES - steps[s].first
+         << setw(12) << GetStat(PF_READPAGE) << "\n";
+   }
+
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// BenchArena
+//
+// Desc: Time ResizeBuffer to buffers of 64 MB up to ARENA_MAX_MB, and the
+//       allocation of the same number of separately zeroed frames
+//
+static RC BenchArena()
+{
+   int pageSize = PF_PAGE_SIZE + sizeof(PF_PageHdr);
+   RC rc;
+
+   cout << "arena: buffer set up time\n";
+   cout << setw(8) << "MB" << setw(10) << "pages" << setw(12) << "arena ms"
+      << setw(12) << "frames ms" << "\n";
+
+   for (int mb = 64; mb <= ARENA_MAX_MB; mb *= 4) {
+      int numPages = (int)((long)mb * 1024 * 1024 / pageSize);
+
+      PF_Manager pfm;
+      double start = Now();
+      if ((rc = pfm.ResizeBuffer(numPages)))
+         return (rc);
+      double arena = Now() - start;
+
+      cout << setw(8) << mb << setw(10) << numPages << fixed
+         << setprecision(2) << setw(12) << arena * 1e3;
+      if (mb > ARENA_FRAMES_MB) {
+         cout << setw(12) << "-" << "\n";
+         continue;
+      }
+
+      char **frames = new char *[numPages];
+      start = Now();
+      for (int i = 0; i < numPages; i++) {
+         void *pFrame;
+         if (posix_memalign(&pFrame, PF_FRAME_ALIGN, pageSize))
+            return (PF_NOMEM);
+         memset(pFrame, 0, pageSize);
+         frames[i] = (char *)pFrame;
+      }
+      double perFrame = Now() - start;
+      for (int i = 0; i < numPages; i++)
+         free(frames[i]);
+      delete[] frames;
+
+      cout << setw(12) << perFrame * 1e3 << "\n";
+   }
+
+   return (0);
+}
+
+//
+// MTWorker
+//
+// Desc: Body of one benchmark thread: MT_OPS lookups, on random pages of
+//       the file or all on page 0
+// Out:  rc - result of the thread
+//
+static void MTWorker(PF_FileHandle *pFileHandle, bool bHot, unsigned seed,
+                     RC *rc)
+{
+   *rc = 0;
+   for (int i = 0; i < MT_OPS && *rc == 0; i++) {
+      PageNum pageNum = bHot ? 0 : rand_r(&seed) % MT_PAGES;
+      *rc = Lookup(*pFileHandle, pageNum);
+   }
+}
+
+//
+// BenchMT
+//
+static RC BenchMT()
+{
+   static const int shards[] = { 1, MT_SHARDS };
+   RC rc;
+
+   cout << "mt: " << MT_PAGES << " resident pages, " << MT_OPS
+      << " lookups per thread, " << thread::hardware_concurrency()
+      << " cores\n";
+   cout << setw(8) << "shards" << setw(10) << "threads" << setw(14)
+      << "spread Mops/s" << setw(14) << "hot Mops/s" << "\n";
+
+   // The file is created before the manager that owns the statistics
+   if ((rc = CreateBenchFile(BENCHFILE, MT_PAGES)))
+      return (rc);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+
+   if ((rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   for (unsigned s = 0; s < sizeof(shards) / sizeof(shards[0]); s++) {
+      if ((rc = pfm.ResizeBuffer(MT_PAGES * 2, shards[s])))
+         return (rc);
+      for (int i = 0; i < MT_PAGES; i++)
+         if ((rc = Lookup(fh, i)))
+            return (rc);
+
+      for (int numThreads = 1; numThreads <= MT_MAX_THREADS; numThreads *= 2) {
+         double mops[2];
+
+         for (int hot = 0; hot < 2; hot++) {
+            vector<thread> threads;
+            vector<RC> results(numThreads);
+
+            double start = Now();
+            for (int t = 0; t < numThreads; t++)
+               threads.push_back(thread(MTWorker, &fh, hot != 0,
+                                        (unsigned)t + 1, &results[t]));
+            for (int t = 0; t < numThreads; t++)
+               threads[t].join();
+            double elapsed = Now() - start;
+
+            for (int t = 0; t < numThreads; t++)
+               if (results[t])
+                  return (results[t]);
+            mops[hot] = (double)numThreads * MT_OPS / elapsed / 1e6;
+         }
+
+         cout << setw(8) << shards[s] << setw(10) << numThreads << fixed
+            << setprecision(2) << setw(14) << mops[0] << setw(14) << mops[1]
+            << "\n";
+      }
+   }
+
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// GetRss
+//
+// Desc: Resident memory of the process from /proc/self/status
+// Out:  anonKB - anonymous memory (heap, buffer frames), in KB
+//       fileKB - mapped file pages, in KB
+//
+static void GetRss(long &anonKB, long &fileKB)
+{
+   char line[256];
+   FILE *f = fopen("/proc/self/status", "r");
+
+   anonKB = fileKB = 0;
+   if (f == NULL)
+      return;
+   while (fgets(line, sizeof(line), f) != NULL) {
+      sscanf(line, "RssAnon: %ld", &anonKB);
+      sscanf(line, "RssFile: %ld", &fileKB);
+   }
+   fclose(f);
+}
+
+//
+// BenchMmap
+//
+// Desc: Scan a file twice, first with a cold OS cache, through the buffer
+//       and through a mapping of the file
+//
+static RC BenchMmap()
+{
+   static const PF_OpenMode modes[] = { PF_OPEN_BUFFERED, PF_OPEN_MMAP };
+   static const char *names[] = { "buffered", "mmap" };
+   const double mb = MMAP_PAGES * (double)PF_PAGE_SIZE / 1e6;
+   RC rc;
+
+   cout << "mmap: two scans of a " << MMAP_PAGES << " page file\n";
+   cout << setw(10) << "mode" << setw(14) << "cold MB/s" << setw(14)
+      << "warm MB/s" << setw(14) << "anon RSS MB" << setw(14)
+      << "file RSS MB" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, MMAP_PAGES)))
+      return (rc);
+
+   for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+      long anon0, file0, anon1, file1;
+      double elapsed[2];
+
+      GetRss(anon0, file0);
+      {
+         PF_Manager pfm;
+         PF_FileHandle fh;
+
+         if (modes[m] == PF_OPEN_BUFFERED &&
+               (rc = pfm.ResizeBuffer(MMAP_PAGES)))
+            return (rc);
+
+         DropCache(BENCHFILE);
+         if ((rc = pfm.OpenFile(BENCHFILE, fh, modes[m])))
+            return (rc);
+         for (int pass = 0; pass < 2; pass++) {
+            double start = Now();
+            if ((rc = Scan(fh)))
+               return (rc);
+            elapsed[pass] = Now() - start;
+         }
+         GetRss(anon1, file1);
+
+         if ((rc = pfm.CloseFile(fh)))
+            return (rc);
+      }
+
+      cout << setw(10) << names[m] << fixed << setprecision(2)
+         << setw(14) << mb / elapsed[0] << setw(14) << mb / elapsed[1]
+         << setw(14) << (anon1 - anon0) / 1024.0
+         << setw(14) << (file1 - file0) / 1024.0 << "\n";
+   }
+
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// CountExtents
+//
+// Desc: Number of extents the file system stores a file in, -1 if it
+//       cannot tell
+//
+static int CountExtents(const char *fileName)
+{
+   struct fiemap fm;
+   int fd, rc;
+
+   if ((fd = open(fileName, O_RDONLY)) < 0)
+      return (-1);
+   memset(&fm, 0, sizeof(fm));
+   fm.fm_length = FIEMAP_MAX_OFFSET;
+   fm.fm_flags = FIEMAP_FLAG_SYNC;
+   rc = ioctl(fd, FS_IOC_FIEMAP, &fm);
+   close(fd);
+   return (rc < 0 ? -1 : (int)fm.fm_mapped_extents);
+}
+
+//
+// BenchGrow
+//
+// Desc: Load two files at once, as a bulk load of a table and its index
+//       would, and see how the file extent affects their layout on disk
+//
+static RC BenchGrow()
+{
+   static const int extents[] = { 1, 8, PF_EXTENT_PAGES, 512 };
+   static const PF_IOEngineType engines[] = { PF_IO_SYNC, PF_IO_DIRECT };
+   static const char *names[] = { "sync", "direct" };
+   RC rc;
+
+   cout << "grow: " << GROW_PAGES << " pages appended to each of two files"
+      << " in turn\n";
+   cout << setw(8) << "engine" << setw(8) << "extent" << setw(12)
+      << "seconds" << setw(14) << "fallocates" << setw(16)
+      << "disk extents" << "\n";
+
+   for (unsigned n = 0; n < sizeof(engines) / sizeof(engines[0]); n++)
+   for (unsigned e = 0; e < sizeof(extents) / sizeof(extents[0]); e++) {
+      PF_Manager pfm(PF_REPLACE_LRU, engines[n]);
+      PF_FileHandle fh[2];
+      PF_PageHandle ph;
+      const char *fileNames[2] = { BENCHFILE, BENCHFILE2 };
+      PageNum pageNum;
+
+      unlink(BENCHFILE);
+      unlink(BENCHFILE2);
+      if ((rc = pfm.SetFileExtent(extents[e])))
+         return (rc);
+      for (int f = 0; f < 2; f++)
+         if ((rc = pfm.CreateFile(fileNames[f])) ||
+               (rc = pfm.OpenFile(fileNames[f], fh[f])))
+            return (rc);
+
+      ResetStats();
+      double start = Now();
+      for (int i = 0; i < GROW_PAGES; i++)
+         for (int f = 0; f < 2; f++)
+            if ((rc = fh[f].AllocatePage(ph)) ||
+                  (rc = ph.GetPageNum(pageNum)) ||
+                  (rc = fh[f].UnpinPage(pageNum)))
+               return (rc);
+      for (int f = 0; f < 2; f++)
+         if ((rc = pfm.CloseFile(fh[f])))
+            return (rc);
+      double elapsed = Now() - start;
+
+      cout << setw(8) << names[n] << setw(8) << extents[e]
+         << fixed << setprecision(3)
+         << setw(12) << elapsed << setw(14) << GetStat(PF_EXTENTS)
+         << setw(16) << CountExtents(BENCHFILE) << "\n";
+   }
+
+   unlink(BENCHFILE);
+   unlink(BENCHFILE2);
+   return (0);
+}
+
+//
+// BenchFree
+//
+// Desc: Free three pages out of four of a file, then scan it and fill it
+//       up again, counting the page I/O each step takes
+//
+static RC BenchFree()
+{
+   RC rc;
+
+   cout << "free: " << SEQ_PAGES << " page file, 3 pages out of 4 freed\n";
+   cout << setw(10) << "step" << setw(12) << "ms" << setw(10) << "reads"
+      << setw(10) << "writes" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SEQ_PAGES)))
+      return (rc);
+
+   PF_Manager pfm;
+   PF_FileHandle fh;
+   PF_PageGuard pg;
+   PageNum pageNum;
+
+   DropCache(BENCHFILE);
+   if ((rc = pfm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   for (int step = 0; step < 3; step++) {
+      static const char *names[] = { "dispose", "scan", "allocate" };
+
+      ResetStats();
+      double start = Now();
+      if (step == 0) {
+         for (PageNum p = 0; p < SEQ_PAGES; p++)
+            if (p % 4 != 0 && (rc = fh.DisposePage(p)))
+               return (rc);
+      }
+      else if (step == 1) {
+         if ((rc = Scan(fh)))
+            return (rc);
+      }
+      else {
+         for (int i = 0; i < SEQ_PAGES / 4 * 3; i++)
+            if ((rc = fh.AllocatePage(pg)) ||
+                  (rc = pg.GetPageNum(pageNum)) ||
+                  (rc = pg.UnpinPage()))
+               return (rc);
+      }
+      if ((rc = fh.FlushPages()))
+         return (rc);
+      double elapsed = Now() - start;
+
+      cout << setw(10) << names[step] << fixed << setprecision(2)
+         << setw(12) << elapsed * 1e3 << setw(10) << GetStat(PF_READPAGE)
+         << setw(10) << GetStat(PF_WRITEPAGE) << "\n";
+   }
+
+   if ((rc = pfm.CloseFile(fh)))
+      return (rc);
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// BenchPools
+//
+// Desc: Look up every page of a HOT_PAGES page file, then scan a
+//       SCAN_PAGES page file, ROUNDS times, first with both files in a
+//       data pool of PF_BUFFER_SIZE + HOT_PAGES pages, then with the
+//       small file in an index pool of HOT_PAGES pages.  Counts the page
+//       reads of the lookups.
+//
+static RC BenchPools()
+{
+   RC rc;
+
+   cout << "pools: " << HOT_PAGES << " page file looked up between scans of"
+      << " a " << SCAN_PAGES << " page file, " << PF_BUFFER_SIZE + HOT_PAGES
+      << " buffer pages in all, LRU\n";
+   cout << setw(10) << "pools" << setw(14) << "lookup reads" << setw(12)
+      << "scan reads" << setw(12) << "ms" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SCAN_PAGES)) ||
+         (rc = CreateBenchFile(BENCHFILE2, HOT_PAGES)))
+      return (rc);
+
+   for (int bSplit = 0; bSplit < 2; bSplit++) {
+      PF_Manager pfm;
+      PF_FileHandle fhScan, fhHot;
+      int lookupReads = 0, scanReads = 0;
+
+      if (bSplit) {
+         if ((rc = pfm.SetPool(PF_POOL_INDEX, HOT_PAGES, PF_REPLACE_LRU)) ||
+               (rc = pfm.OpenFile(BENCHFILE2, fhHot, PF_OPEN_BUFFERED,
+                  PF_POOL_INDEX)))
+            return (rc);
+      }
+      else if ((rc = pfm.ResizeBuffer(PF_BUFFER_SIZE + HOT_PAGES)) ||
+            (rc = pfm.OpenFile(BENCHFILE2, fhHot)))
+         return (rc);
+      if ((rc = pfm.OpenFile(BENCHFILE, fhScan)))
+         return (rc);
+
+      ResetStats();
+      double start = Now();
+      for (int round = 0; round < ROUNDS; round++) {
+         int reads = GetStat(PF_READPAGE);
+         for (PageNum p = 0; p < HOT_PAGES; p++)
+            if ((rc = Lookup(fhHot, p)))
+               return (rc);
+         lookupReads += GetStat(PF_READPAGE) - reads;
+
+         reads = GetStat(PF_READPAGE);
+         if ((rc = Scan(fhScan)))
+            return (rc);
+         scanReads += GetStat(PF_READPAGE) - reads;
+      }
+      double elapsed = Now() - start;
+
+      cout << setw(10) << (bSplit ? "split" : "shared")
+         << setw(14) << lookupReads << setw(12) << scanReads << fixed
+         << setprecision(2) << setw(12) << elapsed * 1e3 << "\n";
+
+      if ((rc = pfm.CloseFile(fhHot)) ||
+            (rc = pfm.CloseFile(fhScan)))
+         return (rc);
+   }
+
+   unlink(BENCHFILE);
+   unlink(BENCHFILE2);
+   return (0);
+}
+
+//
+// BenchWorkMem
+//
+// Desc: Put WM_RECORDS records in an arena, spilling it whenever it is
+//       full, then read every spill file back and check the records
+//
+static RC BenchWorkMem()
+{
+   static const int budgets[] = { 16, 64, 192 };
+   RC rc;
+
+   cout << "workmem: " << WM_RECORDS << " records of " << WM_RECLEN
+      << " bytes, " << WM_TEMP_PAGES << " page temp pool\n";
+   cout << setw(10) << "blocks" << setw(10) << "spills" << setw(14)
+      << "pages written" << setw(12) << "fill ms" << setw(12) << "read ms"
+      << "\n";
+
+   for (unsigned b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+      PF_Manager pfm;
+      PF_Arena arena;
+      vector<PF_FileHandle *> runs;
+      vector<int> runRecords;
+      char *pRec;
+
+      if ((rc = pfm.SetPool(PF_POOL_TEMP, WM_TEMP_PAGES, PF_REPLACE_LRU)) ||
+            (rc = arena.Init(pfm, budgets[b])))
+         return (rc);
+
+      ResetStats();
+      double start = Now();
+      int numInArena = 0;
+      for (int i = 0; i < WM_RECORDS; i++) {
+         if ((rc = arena.Alloc(WM_RECLEN, pRec)) == PF_ARENAFULL) {
+            PF_FileHandle *pRun;
+            if ((rc = arena.Spill(pRun)))
+               return (rc);
+            runs.push_back(pRun);
+            runRecords.push_back(numInArena);
+            numInArena = 0;
+            rc = arena.Alloc(WM_RECLEN, pRec);
+         }
+         if (rc)
+            return (rc);
+         memcpy(pRec, &i, sizeof(int));
+         numInArena++;
+      }
+      double fillTime = Now() - start;
+      int numPages = GetStat(PF_WRITEPAGE);
+
+      // The records left in the arena are the last run
+      int next = 0;
+      start = Now();
+      for (unsigned r = 0; r < runs.size(); r++) {
+         PF_PageGuard pg;
+         PageNum pageNum;
+         char *pData;
+         int left = runRecords[r];
+
+         for (rc = runs[r]->GetFirstPage(pg, SEQUENTIAL_ONCE); rc == 0;
+               rc = runs[r]->GetNextPage(pageNum, pg, SEQUENTIAL_ONCE)) {
+            if ((rc = pg.GetData(pData)) ||
+                  (rc = pg.GetPageNum(pageNum)))
+               return (rc);
+            for (int k = 0; k + WM_RECLEN <= arena.BlockSize() && left > 0;
+                  k += WM_RECLEN, left--, next++)
+               if (memcmp(pData + k, &next, sizeof(int))) {
+                  cerr << "Record " << next << " spilled wrong\n";
+                  exit(1);
+               }
+         }
+         if (rc != PF_EOF)
+            return (rc);
+      }
+      double readTime = Now() - start;
+      if (next + numInArena != WM_RECORDS) {
+         cerr << "Records lost in the spill files\n";
+         exit(1);
+      }
+
+      cout << setw(10) << budgets[b] << setw(10) << runs.size()
+         << setw(14) << numPages << fixed << setprecision(2)
+         << setw(12) << fillTime * 1e3 << setw(12) << readTime * 1e3 << "\n";
+
+      if ((rc = arena.Release()))
+         return (rc);
+   }
+
+   return (0);
+}
+
+//
+// BenchWarm
+//
+// Desc: Read WARM_PAGES random pages of a file into a buffer that holds
+//       them and save the warm-up list on closing it.  Then, with a new
+//       manager each time and the file dropped from the OS cache, time
+//       looking the same pages up without and with a warm-up.
+//
+static RC BenchWarm()
+{
+   RC rc;
+
+   cout << "warm: " << WARM_PAGES << " hot pages of " << SEQ_PAGES
+      << ", " << WARM_PAGES << " page buffer\n";
+   cout << setw(10) << "start" << setw(12) << "ms" << setw(10) << "reads"
+      << setw(12) << "prefetched" << "\n";
+
+   if ((rc = CreateBenchFile(BENCHFILE, SEQ_PAGES)))
+      return (rc);
+
+   vector<PageNum> hot(SEQ_PAGES);
+   for (int i = 0; i < SEQ_PAGES; i++)
+      hot[i] = i;
+   srand(1);
+   for (int i = 0; i < WARM_PAGES; i++)
+      swap(hot[i], hot[i + rand() % (SEQ_PAGES - i)]);
+   hot.resize(WARM_PAGES);
+
+   {
+      PF_Manager pfm;
+      PF_FileHandle fh;
+
+      if ((rc = pfm.ResizeBuffer(WARM_PAGES)) ||
+            (rc = pfm.SetKeepClosed(1)) ||
+            (rc = pfm.OpenFile(BENCHFILE, fh)))
+         return (rc);
+      for (int i = 0; i < WARM_PAGES; i++)
+         if ((rc = Lookup(fh, hot[i])))
+            return (rc);
+      if ((rc = pfm.CloseFile(fh)) ||
+            (rc = pfm.SaveWarmList(WARMLIST)))
+         return (rc);
+   }
+
+   for (int bWarm = 0; bWarm < 2; bWarm++) {
+      PF_Manager pfm;
+      PF_FileHandle fh;
+
+      DropCache(BENCHFILE);
+      if ((rc = pfm.ResizeBuffer(WARM_PAGES)))
+         return (rc);
+      ResetStats();
+      double start = Now();
+      if (bWarm && ((rc = pfm.SetKeepClosed(1)) ||
+            (rc = pfm.WarmUp(WARMLIST))))
+         return (rc);
+      if ((rc = pfm.OpenFile(BENCHFILE, fh)))
+         return (rc);
+      for (int i = WARM_PAGES - 1; i >= 0; i--)
+         if ((rc = Lookup(fh, hot[i])))
+            return (rc);
+      double elapsed = Now() - start;
+
+      cout << setw(10) << (bWarm ? "warm" : "cold") << fixed
+         << setprecision(2) << setw(12) << elapsed * 1e3
+         << setw(10) << GetStat(PF_READPAGE)
+         << setw(12) << GetStat(PF_PREFETCHED) << "\n";
+
+      if ((rc = pfm.CloseFile(fh)))
+         return (rc);
+   }
+
+   unlink(WARMLIST);
+   unlink(BENCHFILE);
+   return (0);
+}
+
+//
+// Table of benchmarks
+//
+static struct {
+   const char *name;
+   RC (*run)();
+} benchmarks[] = {
+   { "replace", BenchReplace },
+   { "hash",    BenchHash },
+   { "flush",   BenchFlush },
+   { "scan",    BenchScan },
+   { "io",      BenchIO },
+   { "bgwriter", BenchBgWriter },
+   { "resize",  BenchResize },
+   { "arena",   BenchArena },
+   { "mt",      BenchMT },
+   { "mmap",    BenchMmap },
+   { "grow",    BenchGrow },
+   { "free",    BenchFree },
+   { "pools",   BenchPools },
+   { "workmem", BenchWorkMem },
+   { "warm",    BenchWarm },
+};
+
+int main(int argc, char *argv[])
+{
+   int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+   RC rc;
+
+   for (int b = 0; b < numBenchmarks; b++) {
+      bool bRun = (argc == 1);
+      for (int i = 1; i < argc; i++)
+         if (strcmp(argv[i], benchmarks[b].name) == 0)
+            bRun = true;
+      if (!bRun)
+         continue;
+
+      if ((rc = benchmarks[b].run())) {
+         PF_PrintError(rc);
+         return (1);
+      }
+      cout << "\n";
+   }
+
+   return (0);
+}
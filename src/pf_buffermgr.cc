@@ -16,8 +16,13 @@
 //
 
 #include <cstdio>
+#include <climits>
+#include <algorithm>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <iostream>
+#include <chrono>
 #include "pf_buffermgr.h"
 
 using namespace std;
@@ -29,6 +34,9 @@ using namespace std;
 
 // Global variable for the statistics manager
 StatisticsMgr *pStatisticsMgr;
+
+// Number of buffer managers sharing it
+static int numStatisticsUsers = 0;
 #endif
 
 #ifdef PF_LOG
@@ -84,53 +92,150 @@ void WriteLog(const char *psMessage)
 //       it checks if it is in the buffer.  If so, it pins the page (pages
 //       can be pinned multiple times).  If not, it reads it from the file
 //       and pins it.  If the buffer is full and a new page needs to be
-//       inserted, an unpinned page is replaced according to an LRU
+//       inserted, an unpinned page is replaced according to the
+//       replacement policy.
 // In:   numPages - the number of pages in the buffer
+//       policy - the page replacement policy
+//       ioEngine - the way pages are read and written
+//       pageBytes - size of the pages in the buffer, PF_PageHdr included
 //
-// Note: The constructor will initialize the global pStatisticsMgr.  We
+// Note: The first buffer manager constructed will initialize the global
+//       pStatisticsMgr, which lives until the last one is destroyed.  We
 //       make it global so that other components may use it and to allow
 //       easy access.
 //
 // Aut2003
 // numPages changed to _numPages for to eliminate CC warnings
 
-PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
+//
+// NewFrame
+//
+// Desc: Allocate a zeroed frame of size bytes outside of the arena, for
+//       the file header.  It is aligned on PF_FRAME_ALIGN so that it can
+//       take part in O_DIRECT transfers.  It is released with ::free.
+//
+static char *NewFrame(int size)
+{
+   void *pFrame;
+
+   if (posix_memalign(&pFrame, PF_FRAME_ALIGN, size)) {
+      cerr << "Not enough memory for buffer\n";
+      exit(1);
+   }
+   memset(pFrame, 0, size);
+   return ((char *)pFrame);
+}
+
+//
+// NewArena
+//
+// Desc: Map the memory for all the buffer frames at once.  Anonymous
+//       memory is zero and only backed as frames are first used, so this
+//       takes the same short time for any size.  Arenas of a huge page or
+//       more are taken from the huge page pool if the system has one
+//       reserved, or else aligned on a huge page boundary and offered to
+//       transparent huge pages, which cuts TLB misses on large buffers.
+// In:   size - bytes needed
+// Out:  size - bytes mapped, to be passed to FreeArena
+//       backing - kind of memory obtained
+// Ret:  the arena
+//
+static char *NewArena(size_t &size, const char *&backing)
+{
+   void *pArena = MAP_FAILED;
+
+   backing = "normal pages";
+   if (size < (size_t)PF_HUGE_PAGE_SIZE) {
+      pArena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (pArena == MAP_FAILED) {
+         cerr << "Not enough memory for buffer\n";
+         exit(1);
+      }
+      return ((char *)pArena);
+   }
+
+   size = (size + PF_HUGE_PAGE_SIZE - 1) & ~(PF_HUGE_PAGE_SIZE - 1);
+
+#ifdef MAP_HUGETLB
+   pArena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   if (pArena != MAP_FAILED) {
+      backing = "huge pages";
+      return ((char *)pArena);
+   }
+#endif
+
+   // Map one huge page too many and trim the ends so the arena is aligned
+   char *pMap = (char *)mmap(NULL, size + PF_HUGE_PAGE_SIZE,
+         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (pMap == MAP_FAILED) {
+      cerr << "Not enough memory for buffer\n";
+      exit(1);
+   }
+   char *pStart = (char *)(((unsigned long)pMap + PF_HUGE_PAGE_SIZE - 1) &
+         ~(PF_HUGE_PAGE_SIZE - 1));
+   if (pStart > pMap)
+      munmap(pMap, pStart - pMap);
+   munmap(pStart + size, pMap + PF_HUGE_PAGE_SIZE - pStart);
+
+#ifdef MADV_HUGEPAGE
+   if (madvise(pStart, size, MADV_HUGEPAGE) == 0)
+      backing = "transparent huge pages";
+#endif
+   return (pStart);
+}
+
+//
+// FreeArena
+//
+// Desc: Unmap an arena obtained from NewArena
+//
+static void FreeArena(char *pArena, size_t size)
+{
+   munmap(pArena, size);
+}
+
+PF_BufferMgr::PF_BufferMgr(int _numPages, PF_ReplacePolicy policy,
+      PF_IOEngineType ioEngine, int pageBytes)
 {
    // Initialize local variables
    this->numPages = _numPages;
-   pageSize = PF_PAGE_SIZE + sizeof(PF_PageHdr);
+   pageSize = pageBytes;
+   readAhead = PF_READAHEAD_PAGES;
+   nextBlockShard = 0;
+   replacePolicy = policy;
+   ioEngineType = ioEngine;
+   cleanTarget = 0;
+   maxWritesPerSec = 0;
+   bWriterStop = FALSE;
 
 #ifdef PF_STATS
    // Initialize the global variable for the statistics manager
-   pStatisticsMgr = new StatisticsMgr();
+   if (numStatisticsUsers++ == 0)
+      pStatisticsMgr = new StatisticsMgr();
 #endif
 
 #ifdef PF_LOG
    char psMessage[100];
    sprintf (psMessage, "Creating buffer manager. %d pages of size %d.\n",
-         numPages, PF_PAGE_SIZE+sizeof(PF_PageHdr));
+         numPages, pageSize);
    WriteLog(psMessage);
 #endif
 
-   // Allocate memory for buffer page description table
+   // Allocate memory for buffer page description table, and the arena
+   // holding the buffer pages
    bufTable = new PF_BufPageDesc[numPages];
+   arenaSize = (size_t)numPages * pageSize;
+   pArena = NewArena(arenaSize, arenaBacking);
 
-   // Initialize the buffer table and allocate memory for buffer pages.
-   // Initially, the free list contains all pages
-   for (int i = 0; i < numPages; i++) {
-      if ((bufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
-      }
-
-      memset ((void *)bufTable[i].pData, 0, pageSize);
+   // Split the buffer into shards, each with all its pages free
+   numShards = ShardCount(numPages, 0);
+   CreateShards();
 
-      bufTable[i].prev = i - 1;
-      bufTable[i].next = i + 1;
-   }
-   bufTable[0].prev = bufTable[numPages - 1].next = INVALID_SLOT;
-   free = 0;
-   first = last = INVALID_SLOT;
+   // Create the I/O engine, and a frame for file header transfers
+   pIOEngine = PF_IOEngine::Create(ioEngine);
+   pHdrFrame = NewFrame(PF_FILE_HDR_SIZE);
 
 #ifdef PF_LOG
    WriteLog("Succesfully created the buffer manager.\n");
@@ -144,15 +249,26 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
 //
 PF_BufferMgr::~PF_BufferMgr()
 {
+   // The background writer must be gone before its pages are
+   {
+      std::unique_lock<std::mutex> guard(writerLatch);
+      StopWriter(guard);
+   }
+
    // Free up buffer pages and tables
-   for (int i = 0; i < this->numPages; i++)
-      delete [] bufTable[i].pData;
+   delete [] pShards;
+   FreeArena(pArena, arenaSize);
 
    delete [] bufTable;
+   delete pIOEngine;
+   ::free(pHdrFrame);
 
 #ifdef PF_STATS
    // Destroy the global statistics manager
-   delete pStatisticsMgr;
+   if (--numStatisticsUsers == 0) {
+      delete pStatisticsMgr;
+      pStatisticsMgr = NULL;
+   }
 #endif
 
 #ifdef PF_LOG
@@ -160,6 +276,115 @@ PF_BufferMgr::~PF_BufferMgr()
 #endif
 }
 
+//
+// CreateShards
+//
+// Desc: Internal.  Split the numPages slots of the buffer into numShards
+//       shards of consecutive slots, all of them free
+//
+void PF_BufferMgr::CreateShards()
+{
+   pShards = new PF_BufferShard[numShards];
+
+   for (int s = 0, base = 0; s < numShards; s++) {
+      int size = numPages / numShards + (s < numPages % numShards);
+      pShards[s].Init(this, base, size, replacePolicy);
+      base += size;
+   }
+}
+
+//
+// ShardCount
+//
+// Desc: Internal.  Number of shards for a buffer of numPages pages: a
+//       power of two, at most PF_MAX_SHARDS and numPages.  If no number is
+//       asked for, there are up to four shards per core, as long as each
+//       gets PF_SHARD_MIN_PAGES slots; with fewer pages per shard, a shard
+//       pinned full would turn pages away while others have room.  A
+//       single core has nothing to gain from shards, and the replacement
+//       policy is only exact over the whole buffer with one.
+// In:   numPages - size of the buffer
+//       numShards - number of shards asked for, 0 to choose
+//
+int PF_BufferMgr::ShardCount(int numPages, int numShards)
+{
+   int minPages = 1;
+   int n = 1;
+
+   if (numShards == 0) {
+      numShards = 4 * std::thread::hardware_concurrency();
+      minPages = PF_SHARD_MIN_PAGES;
+      if (numShards <= 4)
+         return (1);
+   }
+
+   while (n * 2 <= min(numShards, PF_MAX_SHARDS) &&
+         numPages / (n * 2) >= minPages)
+      n *= 2;
+   return (n);
+}
+
+//
+// ShardIndex
+//
+// Desc: Internal.  Shard of a page among numShards.  The extents of
+//       PF_SHARD_EXTENT pages of a file go to the shards in turn, from a
+//       shard that depends on the file.  Neighbouring pages, which are
+//       read ahead and written back together, thus share a shard, while
+//       the pages of a file are spread evenly over all of them.
+// In:   fd, pageNum - the page
+//       numShards - power of two
+//
+int PF_BufferMgr::ShardIndex(int fd, PageNum pageNum, int numShards)
+{
+   if (numShards == 1)
+      return (0);
+
+   // Murmur3 finalizer of the fd, as in PF_HashTable
+   unsigned long long k = (unsigned int)fd;
+   k ^= k >> 33;
+   k *= 0xff51afd7ed558ccdULL;
+   k ^= k >> 33;
+   k *= 0xc4ceb9fe1a85ec53ULL;
+   k ^= k >> 33;
+   return ((int)(k + (unsigned int)pageNum / PF_SHARD_EXTENT) &
+         (numShards - 1));
+}
+
+//
+// ShardOfSlot
+//
+// Desc: Internal.  Shard owning a slot of the buffer
+// In:   slot - 0 <= slot < numPages
+//
+PF_BufferShard &PF_BufferMgr::ShardOfSlot(int slot) const
+{
+   int size = numPages / numShards;     // slots of the smaller shards
+   int numLarger = numPages % numShards;  // shards with one slot more
+
+   if (slot < numLarger * (size + 1))
+      return (pShards[slot / (size + 1)]);
+   return (pShards[numLarger + (slot - numLarger * (size + 1)) / size]);
+}
+
+//
+// LatchAll
+//
+// Desc: Internal.  Latch every shard, in ascending order, which is the
+//       order every thread that holds several latches takes them in.  The
+//       writes of the background writer in a shard are waited for before
+//       moving on to the next one.
+// Out:  guards - one lock per shard
+//
+void PF_BufferMgr::LatchAll(std::vector<std::unique_lock<std::mutex> > &guards)
+{
+   guards.reserve(numShards);
+   for (int s = 0; s < numShards; s++) {
+      guards.emplace_back(pShards[s].latch);
+      pShards[s].WaitWriter(guards.back());
+   }
+}
+
 //
 // GetPage
 //
@@ -167,92 +392,58 @@ PF_BufferMgr::~PF_BufferMgr()
 //       already in the buffer, (re)pin the page and return a pointer
 //       to it.  If the page is not in the buffer, read it from the file,
 //       pin it, and return a pointer to it.  If the buffer is full,
-//       replace an unpinned page.
+//       replace an unpinned page.  Only the shard of the page is latched.
 // In:   fd - OS file descriptor of the file to read
 //       pageNum - number of the page to read
 //       bMultiplePins - if FALSE, it is an error to ask for a page that is
 //                       already pinned in the buffer.
+//       hint - SEQUENTIAL_ONCE if a scan that reads each page once asks
+//              for it: the page does not push any other page out of the
+//              buffer but those of such scans
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - if not NULL, set *pSlot to the buffer slot of the page
 // Ret:  PF return code
 //
 RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
-      int bMultiplePins)
+      int bMultiplePins, int *pSlot, ClientHint hint)
 {
-   RC  rc;     // return code
-   int slot;   // buffer slot where page is located
-
-#ifdef PF_LOG
-   char psMessage[100];
-   sprintf (psMessage, "Looking for (%d,%d).\n", fd, pageNum);
-   WriteLog(psMessage);
-#endif
-
-
-#ifdef PF_STATS
-   pStatisticsMgr->Register(PF_GETPAGE, STAT_ADDONE);
-#endif
-
-   // Search for page in buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot)) &&
-         (rc != PF_HASHNOTFOUND))
-      return (rc);                // unexpected error
-
-   // If page not in buffer...
-   if (rc == PF_HASHNOTFOUND) {
-
-#ifdef PF_STATS
-   pStatisticsMgr->Register(PF_PAGENOTFOUND, STAT_ADDONE);
-#endif
-
-      // Allocate an empty page, this will also promote the newly allocated
-      // page to the MRU slot
-      if ((rc = InternalAlloc(slot)))
-         return (rc);
-
-      // read the page, insert it into the hash table,
-      // and initialize the page description entry
-      if ((rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
-            (rc = hashTable.Insert(fd, pageNum, slot)) ||
-            (rc = InitPageDesc(fd, pageNum, slot))) {
-
-         // Put the slot back on the free list before returning the error
-         Unlink(slot);
-         InsertFree(slot);
-         return (rc);
-      }
-#ifdef PF_LOG
-   WriteLog("Page not found in buffer. Loaded.\n");
-#endif
-   }
-   else {   // Page is in the buffer...
-
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_PAGEFOUND, STAT_ADDONE);
+   StatTimer timer(pStatisticsMgr, PF_LAT_GETPAGE);
 #endif
+   return (Shard(fd, pageNum).GetPage(fd, pageNum, ppBuffer, bMultiplePins,
+         pSlot, hint));
+}
 
-      // Error if we don't want to get a pinned page
-      if (!bMultiplePins && bufTable[slot].pinCount > 0)
-         return (PF_PAGEPINNED);
-
-      // Page is alredy in memory, just increment pin count
-      bufTable[slot].pinCount++;
-#ifdef PF_LOG
-      sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
-            bufTable[slot].pinCount);
-      WriteLog(psMessage);
-#endif
-
-      // Make this page the most recently used page
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
-   }
-
-   // Point ppBuffer to page
-   *ppBuffer = bufTable[slot].pData;
+//
+// PinResident
+//
+// Desc: Pin a page if it is in the buffer, without reading it otherwise.
+//       Used for files whose other pages are read through a mapping.
+// In:   fd - OS file descriptor of the file of the page
+//       pageNum - number of the page
+// Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - set *pSlot to the buffer slot of the page
+// Ret:  PF_PAGENOTINBUF if the page is not in the buffer, or another PF
+//       return code
+//
+RC PF_BufferMgr::PinResident(int fd, PageNum pageNum, char **ppBuffer,
+      int *pSlot)
+{
+   return (Shard(fd, pageNum).PinResident(fd, pageNum, ppBuffer, pSlot));
+}
 
-   // Return ok
-   return (0);
+//
+// DiscardPage
+//
+// Desc: Drop a page from the buffer without writing it back, because the
+//       file no longer uses it.  Nothing is done if it is not there.
+// In:   fd - OS file descriptor of the file of the page
+//       pageNum - number of the page
+// Ret:  PF_PAGEPINNED if the page is pinned, or another PF return code
+//
+RC PF_BufferMgr::DiscardPage(int fd, PageNum pageNum)
+{
+   return (Shard(fd, pageNum).DiscardPage(fd, pageNum));
 }
 
 //
@@ -262,49 +453,13 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 // In:   fd - OS file descriptor of the file associated with the new page
 //       pageNum - number of the new page
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - if not NULL, set *pSlot to the buffer slot of the page
 // Ret:  PF return code
 //
-RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
+RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer,
+      int *pSlot)
 {
-   RC  rc;     // return code
-   int slot;   // buffer slot where page is located
-
-#ifdef PF_LOG
-   char psMessage[100];
-   sprintf (psMessage, "Allocating a page for (%d,%d)....", fd, pageNum);
-   WriteLog(psMessage);
-#endif
-
-   // If page is already in buffer, return an error
-   if (!(rc = hashTable.Find(fd, pageNum, slot)))
-      return (PF_PAGEINBUF);
-   else if (rc != PF_HASHNOTFOUND)
-      return (rc);              // unexpected error
-
-   // Allocate an empty page
-   if ((rc = InternalAlloc(slot)))
-      return (rc);
-
-   // Insert the page into the hash table,
-   // and initialize the page description entry
-   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
-         (rc = InitPageDesc(fd, pageNum, slot))) {
-
-      // Put the slot back on the free list before returning the error
-      Unlink(slot);
-      InsertFree(slot);
-      return (rc);
-   }
-
-#ifdef PF_LOG
-   WriteLog("Succesfully allocated page.\n");
-#endif
-
-   // Point ppBuffer to page
-   *ppBuffer = bufTable[slot].pData;
-
-   // Return ok
-   return (0);
+   return (Shard(fd, pageNum).AllocatePage(fd, pageNum, ppBuffer, pSlot));
 }
 
 //
@@ -318,36 +473,24 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 //
 RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 {
-   RC  rc;       // return code
-   int slot;     // buffer slot where page is located
-
-#ifdef PF_LOG
-   char psMessage[100];
-   sprintf (psMessage, "Marking dirty (%d,%d).\n", fd, pageNum);
-   WriteLog(psMessage);
-#endif
-
-   // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
-      if ((rc == PF_HASHNOTFOUND))
-         return (PF_PAGENOTINBUF);
-      else
-         return (rc);              // unexpected error
-   }
-
-   if (bufTable[slot].pinCount == 0)
-      return (PF_PAGEUNPINNED);
-
-   // Mark this page dirty
-   bufTable[slot].bDirty = TRUE;
+   return (Shard(fd, pageNum).MarkDirty(fd, pageNum));
+}
 
-   // Make this page the most recently used page
-   if ((rc = Unlink(slot)) ||
-         (rc = LinkHead (slot)))
-      return (rc);
+//
+// MarkSlotDirty
+//
+// Desc: Mark the page held in a buffer slot dirty.  Used by page guards,
+//       which remember the slot of their page, to skip the hash lookup.
+// In:   slot - buffer slot of a pinned page
+// Ret:  PF return code
+//
+RC PF_BufferMgr::MarkSlotDirty(int slot)
+{
+   if (slot < 0 || slot >= numPages)
+      return (PF_PAGENOTINBUF);
 
-   // Return ok
-   return (0);
+   PF_BufferShard &shard = ShardOfSlot(slot);
+   return (shard.MarkSlotDirty(slot - shard.base));
 }
 
 //
@@ -360,36 +503,24 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 //
 RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 {
-   RC  rc;       // return code
-   int slot;     // buffer slot where page is located
-
-   // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
-      if ((rc == PF_HASHNOTFOUND))
-         return (PF_PAGENOTINBUF);
-      else
-         return (rc);              // unexpected error
-   }
-
-   if (bufTable[slot].pinCount == 0)
-      return (PF_PAGEUNPINNED);
-
-#ifdef PF_LOG
-   char psMessage[100];
-   sprintf (psMessage, "Unpinning (%d,%d). %d Pin count\n",
-         fd, pageNum, bufTable[slot].pinCount-1);
-   WriteLog(psMessage);
-#endif
+   return (Shard(fd, pageNum).UnpinPage(fd, pageNum));
+}
 
-   // If unpinning the last pin, make it the most recently used page
-   if (--(bufTable[slot].pinCount) == 0) {
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
-   }
+//
+// UnpinSlot
+//
+// Desc: Unpin the page held in a buffer slot, without looking it up.
+//       Unless it is the last pin of the page, no latch is taken.
+// In:   slot - buffer slot of a pinned page
+// Ret:  PF return code
+//
+RC PF_BufferMgr::UnpinSlot(int slot)
+{
+   if (slot < 0 || slot >= numPages)
+      return (PF_PAGENOTINBUF);
 
-   // Return ok
-   return (0);
+   PF_BufferShard &shard = ShardOfSlot(slot);
+   return (shard.UnpinSlot(slot - shard.base));
 }
 
 //
@@ -397,14 +528,20 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 //
 // Desc: Release all pages for this file and put them onto the free list
 //       Returns a warning if any of the file's pages are pinned.
-//       A linear search of the buffer is performed.
-//       A better method is not needed because # of buffers are small.
+//       Only the pages of this file are visited, through its own lists.
+//       Dirty pages are written in page order, one vectored write per
+//       run of contiguous pages, across all the shards.  Writes of the
+//       background writer in progress are waited for first.
 // In:   fd - file descriptor
+//       bKeep - TRUE to leave the pages resident once they are written
 // Ret:  PF_PAGEPINNED or other PF return code
-// TODO: 增加BufSz后改进出更好查找方案
-RC PF_BufferMgr::FlushPages(int fd)
+//
+RC PF_BufferMgr::FlushPages(int fd, int bKeep)
 {
    RC rc, rcWarn = 0;  // return codes
+   std::vector<std::unique_lock<std::mutex> > guards;
+
+   LatchAll(guards);
 
 #ifdef PF_LOG
    char psMessage[100];
@@ -413,46 +550,63 @@ RC PF_BufferMgr::FlushPages(int fd)
 #endif
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_FLUSHPAGES, STAT_ADDONE);
+   pStatisticsMgr->Add(PF_STAT_FLUSHPAGES);
 #endif
 
-   // Do a linear scan of the buffer to find pages belonging to the file
-   int slot = first;
-   while (slot != INVALID_SLOT) {
+   if (fd < 0)
+      return (0);
+
+   // Write the dirty pages that are not pinned
+   std::vector<int> dirty;
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+
+      // Nothing to do if no page of the file was ever read here
+      if (fd >= (int)shard.files.size())
+         continue;
+
+      // Forget the access pattern; the descriptor may be reused by
+      // another file
+      shard.files[fd].lastPage = -1;
+      shard.files[fd].seqRun = 0;
+
+      for (int slot = shard.files[fd].firstDirty; slot != INVALID_SLOT;
+            slot = shard.bufTable[slot].dirtyNext)
+         if (shard.bufTable[slot].pinCount == 0)
+            dirty.push_back(shard.base + slot);
+   }
+
+   if (!dirty.empty() && (rc = WriteDirty(fd, &dirty[0], dirty.size())))
+      return (rc);
+
+   // Remove the unpinned pages from the buffer
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
 
-      int next = bufTable[slot].next;
+      if (fd >= (int)shard.files.size())
+         continue;
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd) {
+      int slot = shard.files[fd].first;
+      while (slot != INVALID_SLOT) {
+
+         int next = shard.bufTable[slot].fileNext;
 
 #ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is in buffer manager.\n", bufTable[slot].pageNum);
+ sprintf (psMessage, "Page (%d) is in buffer manager.\n", shard.bufTable[slot].pageNum);
  WriteLog(psMessage);
 #endif
          // Ensure the page is not pinned
-         if (bufTable[slot].pinCount) {
+         if (shard.bufTable[slot].pinCount) {
             rcWarn = PF_PAGEPINNED;
          }
-         else {
-            // Write the page if dirty
-            if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-               if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-                  return (rc);
-               bufTable[slot].bDirty = FALSE;
-            }
-
-            // Remove page from the hash table and add the slot to the free list
-            if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
-                  (rc = Unlink(slot)) ||
-                  (rc = InsertFree(slot)))
+         else if (!bKeep) {
+            // Remove page from the hash table and add the slot to the
+            // free list
+            if ((rc = shard.Drop(slot)))
                return (rc);
          }
+         slot = next;
       }
-      slot = next;
    }
 
 #ifdef PF_LOG
@@ -468,6 +622,8 @@ RC PF_BufferMgr::FlushPages(int fd)
 //
 // Desc: If a page is dirty then force the page from the buffer pool
 //       onto disk.  The page will not be forced out of the buffer pool.
+//       A page the background writer is writing is on disk once its
+//       write is over, so that is waited for.
 // In:   The page number, a default value of ALL_PAGES will be used if
 //       the client doesn't provide a value.  This will force all pages.
 // Ret:  Standard PF errors
@@ -475,7 +631,8 @@ RC PF_BufferMgr::FlushPages(int fd)
 //
 RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
 {
-   RC rc;  // return codes
+   RC  rc;     // return code
+   int slot;   // buffer slot of the page
 
 #ifdef PF_LOG
    char psMessage[100];
@@ -483,38 +640,191 @@ RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
    WriteLog(psMessage);
 #endif
 
-   // Do a linear scan of the buffer to find the page for the file
-   int slot = first;
-   while (slot != INVALID_SLOT) {
+   if (fd < 0)
+      return (0);
 
-      int next = bufTable[slot].next;
+   // A single page is looked up directly in its shard.  I don't care if
+   // the page is pinned or not, just write it if it is dirty.
+   if (pageNum != ALL_PAGES) {
+      PF_BufferShard &shard = Shard(fd, pageNum);
+      std::unique_lock<std::mutex> guard(shard.latch);
+
+      shard.WaitWriter(guard);
+      if ((rc = shard.hashTable.Find(fd, pageNum, slot)))
+         return (rc == PF_HASHNOTFOUND ? 0 : rc);
+      if (!shard.bufTable[slot].bDirty)
+         return (0);
+      slot += shard.base;
+      return (WriteDirty(fd, &slot, 1));
+   }
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd &&
-            (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum)) {
+   // Otherwise write every dirty page of the file
+   std::vector<std::unique_lock<std::mutex> > guards;
+   std::vector<int> dirty;
 
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is in buffer pool.\n", bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-         // I don't care if the page is pinned or not, just write it if
-         // it is dirty.
-         if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
-sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
-WriteLog(psMessage);
-#endif
-            if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-               return (rc);
-            bufTable[slot].bDirty = FALSE;
-         }
+   LatchAll(guards);
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+
+      if (fd >= (int)shard.files.size())
+         continue;
+      for (slot = shard.files[fd].firstDirty; slot != INVALID_SLOT;
+            slot = shard.bufTable[slot].dirtyNext)
+         dirty.push_back(shard.base + slot);
+   }
+
+   if (dirty.empty())
+      return (0);
+   return (WriteDirty(fd, &dirty[0], dirty.size()));
+}
+
+//
+// SetReadAhead
+//
+// Desc: Set the number of pages read with one call when a file is being
+//       read sequentially.  The window actually used is also kept within
+//       a quarter of a shard so a scan cannot flush the whole pool.
+// In:   numPages - read-ahead window; 1 turns read-ahead off
+// Ret:  PF_TOOSMALL if numPages is less than 1
+//
+RC PF_BufferMgr::SetReadAhead(int numPages)
+{
+   if (numPages < 1)
+      return (PF_TOOSMALL);
+
+   readAhead = min(numPages, IOV_MAX);
+   return (0);
+}
+
+//
+// HintSequential
+//
+// Desc: Tell the buffer manager that a scan is about to ask for pageNum
+//       of fd.  From then on, as long as the file is asked for the same
+//       page or the one after it, every miss reads ahead.  Point lookups
+//       that merely happen to come in ascending order never do.
+// In:   fd - file descriptor
+//       pageNum - next page of the scan
+//
+void PF_BufferMgr::HintSequential(int fd, PageNum pageNum)
+{
+   if (fd < 0)
+      return;
+
+   Shard(fd, pageNum).HintSequential(fd, pageNum);
+}
+
+//
+// SetWriterTarget
+//
+// Desc: Set the fraction of the buffer that the background writer keeps
+//       clean.  The writer looks at that many frames from the replacement
+//       end of each shard (free frames count as clean ones) and writes the
+//       dirty unpinned pages among them, so that a victim rarely has to be
+//       written out by GetPage.  The thread is started on the first
+//       nonzero target and stopped when the target goes back to 0.
+// In:   cleanRatio - between 0 and 1
+// Ret:  PF_BADPARAM if cleanRatio is out of range
+//
+RC PF_BufferMgr::SetWriterTarget(double cleanRatio)
+{
+   if (!(cleanRatio >= 0 && cleanRatio <= 1))
+      return (PF_BADPARAM);
+
+   std::unique_lock<std::mutex> guard(writerLatch);
+
+   cleanTarget = cleanRatio;
+   if (cleanTarget == 0)
+      StopWriter(guard);
+   else if (!writer.joinable()) {
+      bWriterStop = FALSE;
+      writer = std::thread(&PF_BufferMgr::WriterMain, this);
+   }
+   return (0);
+}
+
+//
+// SetWriterRate
+//
+// Desc: Limit the number of pages written per second by the background
+//       writer
+// In:   maxWritesPerSec - 0 for no limit
+// Ret:  PF_BADPARAM if maxWritesPerSec is negative
+//
+RC PF_BufferMgr::SetWriterRate(int _maxWritesPerSec)
+{
+   if (_maxWritesPerSec < 0)
+      return (PF_BADPARAM);
+
+   std::lock_guard<std::mutex> guard(writerLatch);
+   maxWritesPerSec = _maxWritesPerSec;
+   return (0);
+}
+
+//
+// WriterMain
+//
+// Desc: Internal.  Body of the background writer thread.  Every
+//       PF_WRITER_TICK_MS it runs one round over the shards, writing as
+//       many pages as the rate limit has allowed since the last one; each
+//       round starts with the next shard, so that all of them get their
+//       turn when the limit is low.  The writer has its own I/O engine,
+//       since engines are not shared between threads.
+//
+void PF_BufferMgr::WriterMain()
+{
+   PF_IOEngine *pEngine = PF_IOEngine::Create(ioEngineType);
+   std::unique_lock<std::mutex> guard(writerLatch);
+   double credit = 0;   // pages the rate limit allows to write
+   int start = 0;       // shard the next round starts with
+
+   while (!bWriterStop) {
+      int budget = PF_WRITER_BATCH;
+      if (maxWritesPerSec > 0) {
+         credit = min(credit + maxWritesPerSec * PF_WRITER_TICK_MS / 1000.0,
+                      (double)PF_WRITER_BATCH);
+         budget = (int)credit;
+      }
+
+      if (budget > 0) {
+         double target = cleanTarget;
+         int numWritten = 0;
+
+         guard.unlock();
+         for (int i = 0; i < numShards && numWritten < budget; i++)
+            numWritten += pShards[(start + i) % numShards].WriterRound(
+                  target, budget - numWritten, pEngine);
+         guard.lock();
+
+         start = (start + 1) % numShards;
+         credit -= numWritten;
       }
-      slot = next;
+
+      writerCond.wait_for(guard,
+            std::chrono::milliseconds(PF_WRITER_TICK_MS));
    }
 
-   return 0;
+   delete pEngine;
 }
 
+//
+// StopWriter
+//
+// Desc: Internal.  End the background writer thread, if it runs, and wait
+//       for it.  writerLatch is released meanwhile.
+// In:   guard - holds writerLatch
+//
+void PF_BufferMgr::StopWriter(std::unique_lock<std::mutex> &guard)
+{
+   if (!writer.joinable())
+      return;
+
+   bWriterStop = TRUE;
+   writerCond.notify_all();
+   guard.unlock();
+   writer.join();
+   guard.lock();
+}
 
 //
 // PrintBuffer
@@ -527,24 +837,50 @@ WriteLog(psMessage);
 //
 RC PF_BufferMgr::PrintBuffer()
 {
+   std::vector<std::unique_lock<std::mutex> > guards;
+   int bEmpty = TRUE;
+
+   LatchAll(guards);
+
    cout << "Buffer contains " << numPages << " pages of size "
       << pageSize <<".\n";
-   cout << "Contents in order from most recently used to "
-      << "least recently used.\n";
-
-   int slot, next;
-   slot = first;
-   while (slot != INVALID_SLOT) {
-      next = bufTable[slot].next;
-      cout << slot << " :: \n";
-      cout << "  fd = " << bufTable[slot].fd << "\n";
-      cout << "  pageNum = " << bufTable[slot].pageNum << "\n";
-      cout << "  bDirty = " << bufTable[slot].bDirty << "\n";
-      cout << "  pinCount = " << bufTable[slot].pinCount << "\n";
-      slot = next;
-   }
-
-   if (first==INVALID_SLOT)
+   if (numShards > 1)
+      cout << "Buffer is split into " << numShards << " shards.\n";
+   cout << "Replacement policy is " << pShards[0].pReplacer->Name() << ".\n";
+   cout << "I/O engine is " << pIOEngine->Name() << ".\n";
+   cout << "Frames are in one arena of " << arenaBacking << ".\n";
+   if (cleanTarget > 0) {
+      cout << "Background writer keeps " << cleanTarget * 100
+         << "% of the buffer clean";
+      if (maxWritesPerSec > 0)
+         cout << ", at most " << maxWritesPerSec << " writes/s";
+      cout << ".\n";
+   }
+   cout << "Contents in order from the page the policy would keep longest "
+      << "to the next victim";
+   cout << (numShards > 1 ? ", shard by shard.\n" : ".\n");
+
+   // Ask the replacement policy for its order of the resident pages
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      int *order = new int[shard.numSlots];
+      int n = shard.pReplacer->Order(order);
+
+      for (int i = 0; i < n; i++) {
+         const PF_BufPageDesc &page = shard.bufTable[order[i]];
+         cout << shard.base + order[i] << " :: \n";
+         cout << "  fd = " << page.fd << "\n";
+         cout << "  pageNum = " << page.pageNum << "\n";
+         cout << "  bDirty = " << (int)page.bDirty << "\n";
+         cout << "  pinCount = " << page.pinCount.load() << "\n";
+      }
+      delete [] order;
+
+      if (shard.first != INVALID_SLOT)
+         bEmpty = FALSE;
+   }
+
+   if (bEmpty)
       cout << "Buffer is empty!\n";
    else
       cout << "All remaining slots are free.\n";
@@ -567,18 +903,21 @@ RC PF_BufferMgr::PrintBuffer()
 RC PF_BufferMgr::ClearBuffer()
 {
    RC rc;
+   std::vector<std::unique_lock<std::mutex> > guards;
 
-   int slot, next;
-   slot = first;
-   while (slot != INVALID_SLOT) {
-      next = bufTable[slot].next;
-      if (bufTable[slot].pinCount == 0)
-         if ((rc = hashTable.Delete(bufTable[slot].fd,
-               bufTable[slot].pageNum)) ||
-            (rc = Unlink(slot)) ||
-            (rc = InsertFree(slot)))
-         return (rc);
-      slot = next;
+   LatchAll(guards);
+
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      int slot, next;
+
+      slot = shard.first;
+      while (slot != INVALID_SLOT) {
+         next = shard.bufTable[slot].next;
+         if (shard.bufTable[slot].pinCount == 0 && (rc = shard.Drop(slot)))
+            return (rc);
+         slot = next;
+      }
    }
 
    return 0;
@@ -589,329 +928,578 @@ RC PF_BufferMgr::ClearBuffer()
 //
 // Desc: Resizes the buffer manager to the size passed in.
 //       This routine will be called via the system command.
+//       The resident pages move to the new buffer with their contents,
+//       dirty state and order in the replacement policy, so a resize is
+//       not a cold start: growing keeps every page, and shrinking drops
+//       only the pages the policy would have evicted first, writing them
+//       back if they are dirty.  Pages cannot move while clients point
+//       into them, so no page may be pinned.  The shards are replaced, so
+//       no other thread may use the buffer during the call; the
+//       background writer is stopped meanwhile.
 // In:   The new buffer size
+//       numShards - number of shards, 0 to choose from the size
 // Out:  Nothing
-// Ret:  0 for success or,
-//       Some other PF error (probably PF_NOBUF)
+// Ret:  0 for success, PF_TOOSMALL if iNewSize is less than 1,
+//       PF_BADPARAM if numShards is negative, PF_PAGEPINNED if some page
+//       is pinned, or another PF error
 //
-// Notes: This method attempts to copy all the old pages which I am
-// unable to kick out of the old buffer manager into the new buffer
-// manager.  This obviously cannot always be successfull!
-//
-RC PF_BufferMgr::ResizeBuffer(int iNewSize)
+RC PF_BufferMgr::ResizeBuffer(int iNewSize, int numShards)
 {
-   int i;
    RC rc;
 
-   // First try and clear out the old buffer!
-   ClearBuffer();
+   if (iNewSize < 1)
+      return (PF_TOOSMALL);
+   if (numShards < 0)
+      return (PF_BADPARAM);
 
-   // Allocate memory for a new buffer table
-   PF_BufPageDesc *pNewBufTable = new PF_BufPageDesc[iNewSize];
+   std::unique_lock<std::mutex> guard(writerLatch);
+   int bWriterOn = writer.joinable();
 
-   // Initialize the new buffer table and allocate memory for buffer
-   // pages.  Initially, the free list contains all pages
-   for (i = 0; i < iNewSize; i++) {
-      if ((pNewBufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
-      }
+   StopWriter(guard);
+   rc = MovePages(iNewSize, ShardCount(iNewSize, numShards));
+   if (bWriterOn) {
+      bWriterStop = FALSE;
+      writer = std::thread(&PF_BufferMgr::WriterMain, this);
+   }
 
-      memset ((void *)pNewBufTable[i].pData, 0, pageSize);
+   return (rc);
+}
 
-      pNewBufTable[i].prev = i - 1;
-      pNewBufTable[i].next = i + 1;
-   }
-   pNewBufTable[0].prev = pNewBufTable[iNewSize - 1].next = INVALID_SLOT;
+//
+// SetPolicy
+//
+// Desc: Switch to another page replacement policy.  The shards are
+//       rebuilt as by ResizeBuffer, at the same size, and the resident
+//       pages handed to the new policy in the order the old one kept
+//       them, so the same pages would be evicted first.  The same
+//       restrictions apply: no page may be pinned and no other thread
+//       may use the buffer during the call.
+// In:   policy - the new policy
+// Ret:  0 for success, PF_PAGEPINNED if some page is pinned, or another
+//       PF error; the old policy stays on failure
+//
+RC PF_BufferMgr::SetPolicy(PF_ReplacePolicy policy)
+{
+   RC rc;
 
-   // Now we must remember the old first and last slots and (of course)
-   // the buffer table itself.  Then we use insert methods to insert
-   // each of the entries into the new buffertable
-   int oldFirst = first;
-   PF_BufPageDesc *pOldBufTable = bufTable;
+   if (policy == replacePolicy)
+      return (0);
 
-   // Setup the new number of pages,  first, last and free
-   numPages = iNewSize;
-   first = last = INVALID_SLOT;
-   free = 0;
+   std::unique_lock<std::mutex> guard(writerLatch);
+   int bWriterOn = writer.joinable();
+   PF_ReplacePolicy oldPolicy = replacePolicy;
+
+   StopWriter(guard);
+   replacePolicy = policy;
+   if ((rc = MovePages(numPages, numShards)))
+      replacePolicy = oldPolicy;
+   if (bWriterOn) {
+      bWriterStop = FALSE;
+      writer = std::thread(&PF_BufferMgr::WriterMain, this);
+   }
 
-   // Setup the new buffer table
-   bufTable = pNewBufTable;
+   return (rc);
+}
 
-   // We must first remove from the hashtable any possible entries
-   int slot, next, newSlot;
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
-      next = pOldBufTable[slot].next;
+//
+// MovePages
+//
+// Desc: Internal.  Body of ResizeBuffer, with the background writer
+//       stopped.  The pages of the old shards are ranked by their place
+//       in their shard's replacement order; going from the hottest rank
+//       down, each page is kept if the new shard it hashes to has room.
+// In:   iNewSize - the new buffer size
+//       newNumShards - its number of shards
+// Ret:  PF return code
+//
+RC PF_BufferMgr::MovePages(int iNewSize, int newNumShards)
+{
+   RC rc;
+   std::vector<std::unique_lock<std::mutex> > guards;
+
+   LatchAll(guards);
+
+   // The resident file pages of every shard, with their relative rank in
+   // it, hottest first.  Disposed memory blocks are not worth keeping.
+   std::vector<std::pair<double, int> > ranked;
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      std::vector<int> order(shard.numSlots);
+      int numResident = shard.pReplacer->Order(&order[0]);
+
+      for (int i = 0; i < numResident; i++) {
+         const PF_BufPageDesc &page = shard.bufTable[order[i]];
+         if (page.pinCount > 0)
+            return (PF_PAGEPINNED);
+         if (page.fd >= 0)
+            ranked.push_back(std::make_pair((double)i / numResident,
+                  shard.base + order[i]));
+      }
+   }
+   std::sort(ranked.begin(), ranked.end());
+
+   // The hottest pages that fit in their new shard are kept
+   std::vector<std::vector<int> > keep(newNumShards);
+   std::vector<int> dirty;
+   for (unsigned i = 0; i < ranked.size(); i++) {
+      int slot = ranked[i].second;
+      int s = ShardIndex(bufTable[slot].fd, bufTable[slot].pageNum,
+            newNumShards);
+      int size = iNewSize / newNumShards + (s < iNewSize % newNumShards);
+
+      if ((int)keep[s].size() < size)
+         keep[s].push_back(slot);
+      else {
+         if (bufTable[slot].bDirty)
+            dirty.push_back(slot);
+#ifdef PF_STATS
+         if (bufTable[slot].bPrefetched)
+            pStatisticsMgr->Add(PF_STAT_PREFETCHWASTED);
+#endif
+      }
+   }
 
-      // Must remove the entry from the hashtable from the
-      if ((rc=hashTable.Delete(pOldBufTable[slot].fd, pOldBufTable[slot].pageNum)))
+   // Write back the dirty pages that do not fit, file by file
+   const PF_BufPageDesc *table = bufTable;
+   std::sort(dirty.begin(), dirty.end(), [table](int a, int b) {
+      return (table[a].fd < table[b].fd);
+   });
+   for (unsigned i = 0, j; i < dirty.size(); i = j) {
+      int fd = bufTable[dirty[i]].fd;
+      for (j = i + 1; j < dirty.size() && bufTable[dirty[j]].fd == fd; j++)
+         ;
+      if ((rc = WriteDirty(fd, &dirty[i], j - i)))
          return (rc);
-      slot = next;
    }
 
-   // Now we traverse through the old buffer table and copy any old
-   // entries into the new one
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
+   // Scans in progress carry on in the shard of their next page
+   std::vector<std::pair<int, PF_FileFrames> > scans;
+   for (int s = 0; s < numShards; s++)
+      for (unsigned fd = 0; fd < pShards[s].files.size(); fd++)
+         if (pShards[s].files[fd].seqRun > 0)
+            scans.push_back(std::make_pair((int)fd, pShards[s].files[fd]));
 
-      next = pOldBufTable[slot].next;
-      // Allocate a new slot for the old page
-      if ((rc = InternalAlloc(newSlot)))
-         return (rc);
+   // Switch to a new buffer table, frames and shards
+   PF_BufPageDesc *pOldBufTable = bufTable;
+   char *pOldArena = pArena;
+   size_t oldArenaSize = arenaSize;
+   PF_BufferShard *pOldShards = pShards;
 
-      // Insert the page into the hash table,
-      // and initialize the page description entry
-      if ((rc = hashTable.Insert(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)) ||
-            (rc = InitPageDesc(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)))
-         return (rc);
+   bufTable = new PF_BufPageDesc[iNewSize];
+   arenaSize = (size_t)iNewSize * pageSize;
+   pArena = NewArena(arenaSize, arenaBacking);
+   numPages = iNewSize;
+   numShards = newNumShards;
+   CreateShards();
+
+   // The kth hottest page of a shard moves to its slot k.  They are handed
+   // to the policy coldest first, so that it ends up with the same order.
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      int numKeep = keep[s].size();
+
+      shard.free = INVALID_SLOT;
+      for (int slot = numKeep - 1; slot >= 0; slot--) {
+         const PF_BufPageDesc &old = pOldBufTable[keep[s][slot]];
+
+         memcpy(shard.Frame(slot), pOldArena + (size_t)keep[s][slot] * pageSize,
+               pageSize);
+         if ((rc = shard.hashTable.Insert(old.fd, old.pageNum, slot)) ||
+               (rc = shard.InitPageDesc(old.fd, old.pageNum, slot)) ||
+               (rc = shard.LinkHead(slot)))
+            return (rc);
+
+         shard.bufTable[slot].pinCount = 0;
+         shard.bufTable[slot].bPrefetched = old.bPrefetched;
+         shard.LinkFile(slot);
+         if (old.bDirty)
+            shard.SetDirty(slot);
+         shard.pReplacer->Insert(slot, old.fd, old.pageNum);
+         shard.pReplacer->Touch(slot);
+      }
 
-      // Put the slot back on the free list before returning the error
-      Unlink(newSlot);
-      InsertFree(newSlot);
+      // The other slots are free
+      for (int slot = shard.numSlots - 1; slot >= numKeep; slot--)
+         shard.InsertFree(slot);
+   }
 
-      slot = next;
+   for (unsigned i = 0; i < scans.size(); i++) {
+      const PF_FileFrames &old = scans[i].second;
+      PF_FileFrames &file =
+         Shard(scans[i].first, old.lastPage + 1).File(scans[i].first);
+      file.lastPage = old.lastPage;
+      file.seqRun = old.seqRun;
    }
 
-   // Finally, delete the old buffer table
+   guards.clear();
+   delete [] pOldShards;
    delete [] pOldBufTable;
+   FreeArena(pOldArena, oldArenaSize);
 
    return 0;
 }
 
-
 //
-// InsertFree
+// PrefetchPages
 //
-// Desc: Internal.  Insert a slot at the head of the free list
-// In:   slot - slot number to insert
+// Desc: Read a set of pages of a file into the buffer without pinning
+//       them.  Pages already resident are skipped.  The others are sorted
+//       and every run of contiguous pages becomes one request, whatever
+//       shards the pages fall in; all the requests go to the I/O engine
+//       together, so an asynchronous engine has them in flight at the
+//       same time.  Pages whose shard runs out of unpinned slots are not
+//       read, nor, with bFreeOnly, those whose shard runs out of free
+//       slots.
+// In:   fd - OS file descriptor
+//       pageNums - pages to read, in any order, duplicates allowed
+//       numPages - number of entries in pageNums
+//       bFreeOnly - TRUE to use free slots only, evicting nothing
 // Ret:  PF return code
 //
-RC PF_BufferMgr::InsertFree(int slot)
+RC PF_BufferMgr::PrefetchPages(int fd, const PageNum *pageNums, int numPages,
+      int bFreeOnly)
 {
-   bufTable[slot].next = free;
-   free = slot;
+   RC rc = 0, rcIO = 0;
+   int slot;
 
-   // Return ok
-   return (0);
-}
+   // The pages, in file order
+   std::vector<PageNum> pages(pageNums, pageNums + numPages);
+   sort(pages.begin(), pages.end());
+   pages.erase(unique(pages.begin(), pages.end()), pages.end());
+
+   // Latch their shards, in ascending order
+   std::vector<int> shards;
+   std::vector<std::unique_lock<std::mutex> > guards;
+   for (unsigned i = 0; i < pages.size(); i++)
+      shards.push_back(ShardIndex(fd, pages[i], numShards));
+   sort(shards.begin(), shards.end());
+   shards.erase(unique(shards.begin(), shards.end()), shards.end());
+   for (unsigned i = 0; i < shards.size(); i++)
+      guards.emplace_back(pShards[shards[i]].latch);
+
+   // Leave out the pages that are resident
+   int n = 0;
+   for (unsigned i = 0; i < pages.size(); i++) {
+      rc = Shard(fd, pages[i]).hashTable.Find(fd, pages[i], slot);
+      if (rc != PF_HASHNOTFOUND) {
+         if (rc)
+            return (rc);
+         continue;
+      }
+      pages[n++] = pages[i];
+   }
 
-//
-// LinkHead
-//
-// Desc: Internal.  Insert a slot at the head of the used list, making
-//       it the most-recently used slot.
-// In:   slot - slot number to insert
-// Ret:  PF return code
-//
-RC PF_BufferMgr::LinkHead(int slot)
-{
-   // Set next and prev pointers of slot entry
-   bufTable[slot].next = first;
-   bufTable[slot].prev = INVALID_SLOT;
+   // Find a slot for each of them, as far as the buffer allows
+   std::vector<int> slots;
+   slots.reserve(n);
+   for (int i = 0; i < n; i++) {
+      PF_BufferShard &shard = Shard(fd, pages[i]);
+      if ((bFreeOnly && shard.free == INVALID_SLOT) ||
+            shard.InternalAlloc(slot))
+         continue;
+      pages[slots.size()] = pages[i];
+      slots.push_back(shard.base + slot);
+   }
+   n = slots.size();
+   if (n == 0)
+      return (0);
 
-   // If list isn't empty, point old first back to slot
-   if (first != INVALID_SLOT)
-      bufTable[first].prev = slot;
+   // One request per run of contiguous pages
+   std::vector<struct iovec> iov(n);
+   std::vector<PF_IORequest> reqs;
+   for (int i = 0; i < n; i++) {
+      iov[i].iov_base = Frame(slots[i]);
+      iov[i].iov_len = pageSize;
+      if (i > 0 && pages[i] == pages[i - 1] + 1 &&
+            reqs.back().iovcnt < IOV_MAX)
+         reqs.back().iovcnt++;
+      else {
+         PF_IORequest req = { fd,
+                              pages[i] * (long)pageSize + PF_FILE_HDR_SIZE,
+                              &iov[i], 1, FALSE, 0 };
+         reqs.push_back(req);
+      }
+   }
 
-   first = slot;
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Prefetching %d pages of (%d) in %d requests.\n",
+         n, fd, (int)reqs.size());
+   WriteLog(psMessage);
+#endif
 
-   // if list was empty, set last to slot
-   if (last == INVALID_SLOT)
-      last = first;
+   {
+      std::lock_guard<std::mutex> ioGuard(ioLatch);
+#ifdef PF_STATS
+      StatTimer timer(pStatisticsMgr, PF_LAT_READ);
+#endif
+      rc = pIOEngine->Run(&reqs[0], reqs.size());
+   }
+   if (rc) {
+      for (int i = 0; i < n; i++) {
+         PF_BufferShard &shard = ShardOfSlot(slots[i]);
+         shard.Unlink(slots[i] - shard.base);
+         shard.InsertFree(slots[i] - shard.base);
+      }
+      return (rc);
+   }
 
-   // Return ok
-   return (0);
+   // Keep the pages that were read and give back the other slots
+   int numRead = 0;
+   for (unsigned r = 0, i = 0; r < reqs.size(); r++) {
+      int numInReq = (reqs[r].result < 0) ? 0 : reqs[r].result / pageSize;
+      if (reqs[r].result < 0)
+         rcIO = PF_UNIX;
+
+      for (int k = 0; k < reqs[r].iovcnt; k++, i++) {
+         PF_BufferShard &shard = ShardOfSlot(slots[i]);
+         slot = slots[i] - shard.base;
+         if (k < numInReq &&
+               !(rc = shard.InsertPage(slot, fd, pages[i], TRUE)))
+            numRead++;
+         else {
+            shard.Unlink(slot);
+            shard.InsertFree(slot);
+            if (rc)
+               rcIO = rc;
+         }
+      }
+   }
+
+#ifdef PF_STATS
+   int numReqs = reqs.size();
+   pStatisticsMgr->Add(PF_STAT_READPAGE, numRead);
+   pStatisticsMgr->Add(PF_STAT_READV, numReqs);
+   pStatisticsMgr->Add(PF_STAT_PREFETCHED, numRead);
+#endif
+
+   return (rcIO);
 }
 
 //
-// Unlink
+// NumFree
 //
-// Desc: Internal.  Unlink the slot from the used list.  Assume that
-//       slot is valid.  Set prev and next pointers to INVALID_SLOT.
-//       The caller is responsible to either place the unlinked page into
-//       the free list or the used list.
-// In:   slot - slot number to unlink
-// Ret:  PF return code
+// Desc: Count the free frames of the buffer, which pages can be read into
+//       without evicting any
+// Ret:  # of free frames
 //
-RC PF_BufferMgr::Unlink(int slot)
+int PF_BufferMgr::NumFree()
 {
-   // If slot is at head of list, set first to next element
-   if (first == slot)
-      first = bufTable[slot].next;
-
-   // If slot is at end of list, set last to previous element
-   if (last == slot)
-      last = bufTable[slot].prev;
-
-   // If slot not at end of list, point next back to previous
-   if (bufTable[slot].next != INVALID_SLOT)
-      bufTable[bufTable[slot].next].prev = bufTable[slot].prev;
-
-   // If slot not at head of list, point prev forward to next
-   if (bufTable[slot].prev != INVALID_SLOT)
-      bufTable[bufTable[slot].prev].next = bufTable[slot].next;
-
-   // Set next and prev pointers of slot entry
-   bufTable[slot].prev = bufTable[slot].next = INVALID_SLOT;
-
-   // Return ok
-   return (0);
+   int numFree = 0;
+
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      std::lock_guard<std::mutex> guard(shard.latch);
+      for (int slot = shard.free; slot != INVALID_SLOT;
+            slot = shard.bufTable[slot].next)
+         numFree++;
+   }
+   return (numFree);
 }
 
 //
-// InternalAlloc
+// ResidentPages
 //
-// Desc: Internal.  Allocate a buffer slot.  The slot is inserted at the
-//       head of the used list.  Here's how it chooses which slot to use:
-//       If there is something on the free list, then use it.
-//       Otherwise, choose a victim to replace.  If a victim cannot be
-//       chosen (because all the pages are pinned), then return an error.
-// Out:  slot - set to newly-allocated slot
-// Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
+// Desc: List the resident pages of a file, hottest first.  Each shard's
+//       policy orders its own pages; the shards are merged by the
+//       relative rank of the pages in them, as ResizeBuffer does.
+// In:   fd - OS file descriptor
+// Out:  pageNums - the pages
 //
-RC PF_BufferMgr::InternalAlloc(int &slot)
+void PF_BufferMgr::ResidentPages(int fd, std::vector<PageNum> &pageNums)
 {
-   RC  rc;       // return code
-
-   // If the free list is not empty, choose a slot from the free list
-   if (free != INVALID_SLOT) {
-      slot = free;
-      free = bufTable[slot].next;
+   std::vector<std::unique_lock<std::mutex> > guards;
+   std::vector<std::pair<double, PageNum> > ranked;
+
+   LatchAll(guards);
+
+   for (int s = 0; s < numShards; s++) {
+      PF_BufferShard &shard = pShards[s];
+      if (fd >= (int)shard.files.size() ||
+            shard.files[fd].first == INVALID_SLOT)
+         continue;
+
+      std::vector<int> order(shard.numSlots);
+      int numResident = shard.pReplacer->Order(&order[0]);
+      for (int i = 0; i < numResident; i++)
+         if (shard.bufTable[order[i]].fd == fd)
+            ranked.push_back(std::make_pair((double)i / numResident,
+                  shard.bufTable[order[i]].pageNum));
    }
-   else {
-
-      // Choose the least-recently used page that is unpinned
-      for (slot = last; slot != INVALID_SLOT; slot = bufTable[slot].prev) {
-         if (bufTable[slot].pinCount == 0)
-            break;
-      }
+   std::sort(ranked.begin(), ranked.end());
 
-      // Return error if all buffers were pinned
-      if (slot == INVALID_SLOT)
-         return (PF_NOBUF);
+   pageNums.clear();
+   for (unsigned i = 0; i < ranked.size(); i++)
+      pageNums.push_back(ranked[i].second);
+}
 
-      // Write out the page if it is dirty
-      if (bufTable[slot].bDirty) {
-         if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
-               bufTable[slot].pData)))
-            return (rc);
+//
+// IOResult
+//
+// Desc: Internal.  Turn the result of a completed I/O request into a PF
+//       return code.
+// In:   req - the request
+//       rcIncomplete - code to return if fewer bytes were transferred
+//                      than asked for
+// Ret:  0, PF_UNIX or rcIncomplete
+//
+RC PF_BufferMgr::IOResult(const PF_IORequest &req, RC rcIncomplete)
+{
+   ssize_t length = 0;
+   for (int i = 0; i < req.iovcnt; i++)
+      length += req.iov[i].iov_len;
 
-         bufTable[slot].bDirty = FALSE;
-      }
+   if (req.result < 0)
+      return (PF_UNIX);
+   if (req.result != length)
+      return (rcIncomplete);
+   return (0);
+}
 
-      // Remove page from the hash table and slot from the used buffer list
-      if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
-            (rc = Unlink(slot)))
-         return (rc);
-   }
+//
+// ReadFileHdr
+//
+// Desc: Read the header of a file.  The whole header page is transferred
+//       through an aligned frame, so this works with any I/O engine.
+// In:   fd - OS file descriptor
+//       length - number of bytes of the header to return
+// Out:  pHdr - header contents
+// Ret:  PF_HDRREAD, PF_UNIX or 0
+//
+RC PF_BufferMgr::ReadFileHdr(int fd, char *pHdr, int length)
+{
+   RC rc;
+   std::lock_guard<std::mutex> guard(ioLatch);
+   struct iovec iov = { pHdrFrame, (size_t)PF_FILE_HDR_SIZE };
+   PF_IORequest req = { fd, 0, &iov, 1, FALSE, 0 };
 
-   // Link slot at the head of the used list
-   if ((rc = LinkHead(slot)))
+   if ((rc = pIOEngine->Run(&req, 1)))
       return (rc);
+   if (req.result < 0)
+      return (PF_UNIX);
+   if (req.result < length)
+      return (PF_HDRREAD);
 
-   // Return ok
+   memcpy(pHdr, pHdrFrame, length);
    return (0);
 }
 
 //
-// ReadPage
-//
-// Desc: Read a page from disk
+// WriteFileHdr
 //
+// Desc: Write the header of a file, padded with zeroes to a full page
 // In:   fd - OS file descriptor
-//       pageNum - number of page to read
-//       dest - pointer to buffer in which to read page
-// Out:  dest - buffer contains page contents
-// Ret:  PF return code
+//       pHdr - header contents
+//       length - size of the header
+// Ret:  PF_HDRWRITE, PF_UNIX or 0
 //
-RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
+RC PF_BufferMgr::WriteFileHdr(int fd, const char *pHdr, int length)
 {
+   RC rc;
+   std::lock_guard<std::mutex> guard(ioLatch);
+   struct iovec iov = { pHdrFrame, (size_t)PF_FILE_HDR_SIZE };
+   PF_IORequest req = { fd, 0, &iov, 1, TRUE, 0 };
 
-#ifdef PF_LOG
-   char psMessage[100];
-   sprintf (psMessage, "Reading (%d,%d).\n", fd, pageNum);
-   WriteLog(psMessage);
-#endif
-
-#ifdef PF_STATS
-   pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
-#endif
+   memset(pHdrFrame, 0, PF_FILE_HDR_SIZE);
+   memcpy(pHdrFrame, pHdr, length);
 
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
-      return (PF_UNIX);
-
-   // Read the data
-   int numBytes = read(fd, dest, pageSize);
-   if (numBytes < 0)
+   if ((rc = pIOEngine->Run(&req, 1)))
+      return (rc);
+   if (req.result < 0)
       return (PF_UNIX);
-   else if (numBytes != pageSize)
-      return (PF_INCOMPLETEREAD);
-   else
-      return (0);
+   if (req.result != PF_FILE_HDR_SIZE)
+      return (PF_HDRWRITE);
+   return (0);
 }
 
 //
-// WritePage
+// OpenFlags
 //
-// Desc: Write a page to disk
+// Desc: Flags that files must be opened with for the I/O engine in use
 //
-// In:   fd - OS file descriptor
-//       pageNum - number of page to write
-//       dest - pointer to buffer containing page contents
+int PF_BufferMgr::OpenFlags() const
+{
+   return (pIOEngine->OpenFlags());
+}
+
+//
+// WriteDirty
+//
+// Desc: Internal.  Write dirty pages of a file back in page order.  Each
+//       run of contiguous page numbers is one vectored write request
+//       (split at IOV_MAX pages), and all of them are passed to the I/O
+//       engine together.  The pages written are marked clean.  The pages
+//       may be in several shards, all of which must be latched.
+// In:   fd - file descriptor of the pages
+//       slots - slots of the dirty pages; reordered by this call
+//       numSlots - number of slots
 // Ret:  PF return code
 //
-RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
+RC PF_BufferMgr::WriteDirty(int fd, int *slots, int numSlots)
 {
+   RC rc, rcWrite = 0;
+   std::vector<struct iovec> iov(numSlots);
+   std::vector<PF_IORequest> reqs;
+   const PF_BufPageDesc *table = bufTable;
+
+   std::sort(slots, slots + numSlots, [table](int a, int b) {
+      return (table[a].pageNum < table[b].pageNum);
+   });
+
+   // Gather the runs of contiguous pages, one request each
+   for (int i = 0; i < numSlots; i++) {
+      iov[i].iov_base = Frame(slots[i]);
+      iov[i].iov_len = pageSize;
+      if (i > 0 &&
+            bufTable[slots[i]].pageNum == bufTable[slots[i - 1]].pageNum + 1 &&
+            reqs.back().iovcnt < IOV_MAX)
+         reqs.back().iovcnt++;
+      else {
+         PF_IORequest req = { fd,
+               bufTable[slots[i]].pageNum * (long)pageSize + PF_FILE_HDR_SIZE,
+               &iov[i], 1, TRUE, 0 };
+         reqs.push_back(req);
+      }
+   }
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Writing (%d,%d).\n", fd, pageNum);
+   sprintf (psMessage, "Writing %d pages of (%d) in %d requests.\n",
+         numSlots, fd, (int)reqs.size());
    WriteLog(psMessage);
 #endif
 
 #ifdef PF_STATS
-   pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
+   int numReqs = reqs.size();
+   pStatisticsMgr->Add(PF_STAT_WRITEPAGE, numSlots);
+   pStatisticsMgr->Add(PF_STAT_WRITEV, numReqs);
 #endif
 
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
-      return (PF_UNIX);
-
-   // Read the data
-   int numBytes = write(fd, source, pageSize);
-   if (numBytes < 0)
-      return (PF_UNIX);
-   else if (numBytes != pageSize)
-      return (PF_INCOMPLETEWRITE);
-   else
-      return (0);
-}
+   // All the runs are handed to the I/O engine at once
+   {
+      std::lock_guard<std::mutex> ioGuard(ioLatch);
+#ifdef PF_STATS
+      StatTimer timer(pStatisticsMgr, PF_LAT_WRITE);
+#endif
+      if ((rc = pIOEngine->Run(&reqs[0], reqs.size())))
+         return (rc);
+   }
 
-//
-// InitPageDesc
-//
-// Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
-//       for a newly pinned page
-// In:   fd - file descriptor
-//       pageNum - page number
-// Ret:  PF return code
-//
-RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot)
-{
-   // set the slot to refer to a newly-pinned page
-   bufTable[slot].fd       = fd;
-   bufTable[slot].pageNum  = pageNum;
-   bufTable[slot].bDirty   = FALSE;
-   bufTable[slot].pinCount = 1;
+   // Pages of the runs that made it to the file are clean
+   for (unsigned r = 0, i = 0; r < reqs.size(); r++) {
+      if ((rc = IOResult(reqs[r], PF_INCOMPLETEWRITE))) {
+         if (!rcWrite)
+            rcWrite = rc;
+         i += reqs[r].iovcnt;
+         continue;
+      }
+      for (int k = 0; k < reqs[r].iovcnt; k++, i++) {
+         PF_BufferShard &shard = ShardOfSlot(slots[i]);
+         shard.ClearDirty(slots[i] - shard.base);
+      }
+   }
 
-   // Return ok
-   return (0);
+   return (rcWrite);
 }
 
 //------------------------------------------------------------------------------
@@ -939,42 +1527,39 @@ RC PF_BufferMgr::GetBlockSize(int &length) const
 //
 // Allocates a page in the buffer pool that is not associated with a
 // particular file and returns the pointer to the data area back to the
-// user.
+// user.  Blocks are spread over the shards in turn; a shard that is
+// pinned full passes the block on to the next one.
 //
 RC PF_BufferMgr::AllocateBlock(char *&buffer)
 {
    RC rc = OK_RC;
+   unsigned start = nextBlockShard++;
 
-   // Get an empty slot from the buffer pool
-   int slot;
-   if ((rc = InternalAlloc(slot)) != OK_RC)
-      return rc;
-
-   // Create artificial page number (just needs to be unique for hash table)
-   PageNum pageNum = bufTable[slot].pData - (char*)0;
+   for (int i = 0; i < numShards; i++)
+      if ((rc = pShards[(start + i) % numShards].AllocateBlock(buffer))
+            != PF_NOBUF)
+         break;
 
-   // Insert the page into the hash table, and initialize the page description entry
-   if ((rc = hashTable.Insert(MEMORY_FD, pageNum, slot) != OK_RC) ||
-         (rc = InitPageDesc(MEMORY_FD, pageNum, slot)) != OK_RC) {
-      // Put the slot back on the free list before returning the error
-      Unlink(slot);
-      InsertFree(slot);
-      return rc;
-   }
-
-   // Return pointer to buffer
-   buffer = bufTable[slot].pData;
-
-   // Return success code
-   return OK_RC;
+   return rc;
 }
 
 //
 // DisposeBlock
 //
-// Free the block of memory from the buffer pool.
+// Free the block of memory from the buffer pool.  Its slot follows from
+// its place in the arena.
 //
 RC PF_BufferMgr::DisposeBlock(char* buffer)
 {
-   return UnpinPage(MEMORY_FD, buffer - (char*)0);
+   long offset = buffer - pArena;
+
+   if (offset < 0 || offset >= (long)numPages * pageSize ||
+         offset % pageSize != 0)
+      return (PF_PAGENOTINBUF);
+
+   int slot = offset / pageSize;
+   if (bufTable[slot].fd != MEMORY_FD)
+      return (PF_PAGENOTINBUF);
+
+   return UnpinSlot(slot);
 }
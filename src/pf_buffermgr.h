@@ -15,8 +15,15 @@
 #ifndef PF_BUFFERMGR_H
 #define PF_BUFFERMGR_H
 
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "pf_internal.h"
 #include "pf_hashtable.h"
+#include "pf_replacer.h"
+#include "pf_ioengine.h"
 
 //
 // Defines
@@ -31,47 +38,247 @@
 //
 // PF_BufPageDesc - struct containing data about a page in the buffer
 //
+// The descriptors form a dense array apart from the page contents: the
+// frame of slot i is at a fixed offset of the frame arena.  The fields a
+// victim search looks at come first.
+//
+// The pin count is atomic so that a client can drop a pin that is not
+// the last one without taking the latch of the page's shard.  All other
+// fields, and any change of the pin count to or from 0, are only touched
+// with the latch held.  The background writer pins the pages it writes
+// with a pin worth PF_WRITER_PIN, so the pins of clients are the pin
+// count modulo PF_WRITER_PIN.
+//
 struct PF_BufPageDesc {
-    char       *pData;      // page contents
-    int        next;        // next in the linked list of buffer pages
-    int        prev;        // prev in the linked list of buffer pages
-    int        bDirty;      // TRUE if page is dirty
-    short int  pinCount;    // pin count
     PageNum    pageNum;     // page number for this page
     int        fd;          // OS file descriptor of this page
+    std::atomic<int> pinCount; // pin count
+    char       bDirty;      // TRUE if page is dirty
+    char       bPrefetched; // TRUE if read ahead and not requested yet
+    char       bScanOnce;   // TRUE if only SEQUENTIAL_ONCE scans have
+                            // asked for the page: it stays at the cold end
+    int        next;        // next in the used or free list of buffer pages
+    int        prev;        // prev in the used list of buffer pages
+    int        fileNext;    // next/prev page of the same file
+    int        filePrev;
+    int        dirtyNext;   // next/prev dirty page of the same file
+    int        dirtyPrev;
+
+    // # of pins held by clients, leaving out the background writer's
+    int ClientPins() const { return (pinCount.load() % PF_WRITER_PIN); }
+};
+
+//
+// PF_FileFrames - the buffer pages of one open file
+//
+// Each file keeps its resident pages and its dirty pages on two lists
+// threaded through the buffer table, so that flushing or forcing a file
+// only looks at that file's pages.  The last page requested and the
+// length of the current scan of the file drive read-ahead.
+//
+struct PF_FileFrames {
+    int        first;       // head of the list of resident pages
+    int        firstDirty;  // head of the list of dirty pages
+    int        numDirty;    // # of dirty pages
+    PageNum    lastPage;    // page of the last GetPage
+    int        seqRun;      // # of pages scanned up to lastPage, 0 if
+                            // the file is not being scanned
+};
+
+class PF_BufferMgr;
+
+//
+// PF_BufferShard - one partition of the page buffer
+//
+// A shard owns a contiguous range of the buffer slots and everything
+// needed to manage them: its latch, hash table, free and used lists,
+// replacement policy, per-file page lists and I/O engine.  Inside a shard
+// slots are numbered from the start of its range; bufTable and pArena
+// point at the shard's first descriptor and frame.
+//
+class PF_BufferShard {
+    friend class PF_BufferMgr;
+
+    PF_BufferShard   ();
+    ~PF_BufferShard  ();
+
+    // Take slots base..base+numSlots-1 of the buffer of pMgr
+    void Init        (PF_BufferMgr *pMgr, int base, int numSlots,
+                      PF_ReplacePolicy policy);
+
+    // Page operations of PF_BufferMgr, for a page of this shard.  They
+    // take the latch themselves; slots are local to the shard.
+    RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
+                      int bMultiplePins, int *pSlot, ClientHint hint);
+    RC  PinResident  (int fd, PageNum pageNum, char **ppBuffer, int *pSlot);
+    RC  DiscardPage  (int fd, PageNum pageNum);
+    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer, int *pSlot);
+    RC  MarkDirty    (int fd, PageNum pageNum);
+    RC  UnpinPage    (int fd, PageNum pageNum);
+    RC  MarkSlotDirty(int slot);
+    RC  UnpinSlot    (int slot);
+    void HintSequential(int fd, PageNum pageNum);
+    RC  AllocateBlock(char *&buffer);
+
+    // The rest is called with the latch held
+    RC  SetSlotDirty (int slot);                 // MarkSlotDirty, latched
+    RC  UnpinLatched (int slot);                 // UnpinSlot, latched
+    RC  InsertFree   (int slot);                 // Insert slot at head of free
+    RC  LinkHead     (int slot);                 // Insert slot at head of used
+    RC  Unlink       (int slot);                 // Unlink slot
+    RC  InternalAlloc(int &slot);                // Get a slot to use
+    RC  Drop         (int slot);                 // Free the slot of a page
+
+    // Read or write a page
+    RC  ReadPage     (int fd, PageNum pageNum, char *dest);
+    RC  WritePage    (int fd, PageNum pageNum, char *source);
+
+    // Read pageNum into a new pinned slot, together with up to
+    // numPages - 1 following pages of the shard that are not resident yet
+    RC  ReadRun      (int fd, PageNum pageNum, int numPages, int &slot,
+                      int bScanOnce = FALSE);
+
+    // Make a page just read into slot resident
+    RC  InsertPage   (int slot, int fd, PageNum pageNum, int bPrefetched,
+                      int bScanOnce = FALSE);
+
+    // The page lists and access pattern of fd
+    PF_FileFrames &File(int fd);
+
+    // Buffer frame of a slot
+    char *Frame      (int slot) const
+                     { return pArena + (size_t)slot * pageSize; }
+
+    // Init the page desc entry
+    RC  InitPageDesc (int fd, PageNum pageNum, int slot);
+
+    // Per-file page lists
+    void LinkFile    (int slot);                 // Add page to its file
+    void UnlinkFile  (int slot);                 // Remove page from its file
+    void SetDirty    (int slot);                 // Mark page dirty
+    void ClearDirty  (int slot);                 // Page is clean again
+
+    // Background writer: one pass over the shard (takes the latch), and
+    // waiting for the writes of such a pass to be over
+    int  WriterRound (double cleanTarget, int budget, PF_IOEngine *pEngine);
+    void WaitWriter  (std::unique_lock<std::mutex> &guard);
+
+    PF_BufferMgr   *pMgr;                         // buffer of the shard
+    PF_BufPageDesc *bufTable;                     // first slot of the shard
+    char           *pArena;                       // frame of that slot
+    int            base;                          // its slot in the buffer
+    int            numSlots;                      // # of slots in the shard
+    int            pageSize;                      // Size of pages in the buffer
+    PF_HashTable   hashTable;                     // Hash table object
+    PF_Replacer    *pReplacer;                    // page replacement policy
+    PF_IOEngine    *pIOEngine;                    // reads and writes pages
+    std::vector<PF_FileFrames> files;             // pages of each fd
+    int            first;                         // head of used list
+    int            last;                          // tail of used list
+    int            free;                          // head of free list
+
+    // latch guards everything above but the atomic part of the pin
+    // counts.  The background writer drops it while its pages are being
+    // written; writerDone tells those waiting that the writes are over.
+    std::mutex     latch;
+    std::condition_variable writerDone;
+    int            bWriterBusy;                   // TRUE during its writes
 };
 
 //
 // PF_BufferMgr - manage the page buffer
 //
+// The buffer is split into shards by the page key (fd, page number), so
+// that threads asking for different pages rarely wait for one another.
+// Pages go to shards by extents of PF_SHARD_EXTENT pages so that a
+// read-ahead window or a run of pages to write usually stays in one
+// shard.  A small buffer has a single shard and behaves just like an
+// unpartitioned one.
+//
+// Operations on one page go to its shard only.  Operations on a whole
+// file or the whole buffer latch every shard in ascending order.
+//
 class PF_BufferMgr {
+    friend class PF_BufferShard;
 public:
 
-    PF_BufferMgr     (int numPages);             // Constructor - allocate
-                                                  // numPages buffer pages
+    PF_BufferMgr     (int numPages,              // Constructor - allocate
+                      PF_ReplacePolicy policy     // numPages buffer pages
+                        = PF_REPLACE_LRU,         // of pageBytes bytes
+                      PF_IOEngineType ioEngine
+                        = PF_IO_SYNC,
+                      int pageBytes = PF_MIN_PAGE_BYTES);
     ~PF_BufferMgr    ();                         // Destructor
 
     // Read pageNum into buffer, point *ppBuffer to location
+    // (and set *pSlot to the slot holding it, if pSlot is not NULL).
+    // With SEQUENTIAL_ONCE a page that is read goes at the cold end of
+    // the replacement order, and a page that is found is left where it is.
     RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
-                      int bMultiplePins = TRUE);
+                      int bMultiplePins = TRUE, int *pSlot = NULL,
+                      ClientHint hint = NO_HINT);
+    // Pin pageNum only if it is already in the buffer; PF_PAGENOTINBUF
+    // otherwise
+    RC  PinResident  (int fd, PageNum pageNum, char **ppBuffer, int *pSlot);
+    // Drop pageNum from the buffer, if it is there, without writing it;
+    // PF_PAGEPINNED if it is pinned
+    RC  DiscardPage  (int fd, PageNum pageNum);
     // Allocate a new page in the buffer, point *ppBuffer to its location
-    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer);
+    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer,
+                      int *pSlot = NULL);
 
     RC  MarkDirty    (int fd, PageNum pageNum);  // Mark page dirty
     RC  UnpinPage    (int fd, PageNum pageNum);  // Unpin page from the buffer
-    RC  FlushPages   (int fd);                   // Flush pages for file
+
+    // Same as above for a page whose buffer slot is known
+    RC  MarkSlotDirty(int slot);
+    RC  UnpinSlot    (int slot);
+    // Flush pages for file: write the dirty ones and drop them all from
+    // the buffer, or keep them resident if bKeep is TRUE
+    RC  FlushPages   (int fd, int bKeep = FALSE);
 
     // Force a page to the disk, but do not remove from the buffer pool
     RC ForcePages    (int fd, PageNum pageNum);
 
+    // Set the number of pages read at once by a sequential scan
+    RC  SetReadAhead (int numPages);
+    // Tell the buffer that pageNum of fd is the next page of a scan
+    void HintSequential(int fd, PageNum pageNum);
+
+    // Background writer: keep a fraction cleanRatio of the frames at the
+    // replacement end of the buffer clean (0 stops the writer), writing
+    // at most maxWritesPerSec pages a second (0 means no limit)
+    RC  SetWriterTarget(double cleanRatio);
+    RC  SetWriterRate(int maxWritesPerSec);
+
+    // Read pages of fd into the buffer, unpinned, all at once.  With
+    // bFreeOnly only free frames are used; no page is evicted.
+    RC  PrefetchPages(int fd, const PageNum *pageNums, int numPages,
+                      int bFreeOnly = FALSE);
+
+    // Number of free frames
+    int NumFree      ();
+    // The resident pages of fd, hottest first
+    void ResidentPages(int fd, std::vector<PageNum> &pageNums);
+
+    // File header transfers and open(2) flags for the I/O engine in use
+    RC  ReadFileHdr  (int fd, char *pHdr, int length);
+    RC  WriteFileHdr (int fd, const char *pHdr, int length);
+    int OpenFlags    () const;
+
 
     // Remove all entries from the Buffer Manager.
     RC  ClearBuffer  ();
     // Display all entries in the buffer
     RC PrintBuffer   ();
 
-    // Attempts to resize the buffer to the new size
-    RC ResizeBuffer  (int iNewSize);
+    // Resize the buffer, moving the hottest resident pages to the new one,
+    // and split it into numShards shards (0 to choose automatically).  No
+    // other thread may use the buffer meanwhile.
+    RC ResizeBuffer  (int iNewSize, int numShards = 0);
+    // Switch to another replacement policy, keeping the resident pages
+    // in the same order.  The same restrictions apply.
+    RC SetPolicy     (PF_ReplacePolicy policy);
 
     // Three Methods for manipulating raw memory buffers.  These memory
     // locations are handled by the buffer manager, but are not
@@ -87,27 +294,63 @@ public:
     RC DisposeBlock  (char *buffer);
 
 private:
-    RC  InsertFree   (int slot);                 // Insert slot at head of free
-    RC  LinkHead     (int slot);                 // Insert slot at head of used
-    RC  Unlink       (int slot);                 // Unlink slot
-    RC  InternalAlloc(int &slot);                // Get a slot to use
+    // Split the slots into numShards shards, and the number of shards to
+    // use for a size, given the number asked for (0 if none)
+    void CreateShards();
+    static int ShardCount(int numPages, int numShards);
 
-    // Read a page
-    RC  ReadPage     (int fd, PageNum pageNum, char *dest);
+    // ResizeBuffer, once the background writer is stopped
+    RC  MovePages    (int iNewSize, int newNumShards);
 
-    // Write a page
-    RC  WritePage    (int fd, PageNum pageNum, char *source);
+    // Shard of a page, and shard of a slot of the buffer
+    PF_BufferShard &Shard(int fd, PageNum pageNum) const
+                     { return pShards[ShardIndex(fd, pageNum, numShards)]; }
+    PF_BufferShard &ShardOfSlot(int slot) const;
+    static int ShardIndex(int fd, PageNum pageNum, int numShards);
 
-    // Init the page desc entry
-    RC  InitPageDesc (int fd, PageNum pageNum, int slot);
+    // Latch every shard, in ascending order, once its writes are over
+    void LatchAll    (std::vector<std::unique_lock<std::mutex> > &guards);
 
+    // PF return code for a completed I/O request
+    static RC IOResult(const PF_IORequest &req, RC rcIncomplete);
+
+    // Buffer frame of a slot
+    char *Frame      (int slot) const
+                     { return pArena + (size_t)slot * pageSize; }
+
+    // Write the dirty pages in slots[0..numSlots-1], all belonging to fd,
+    // in page order with one vectored write per run of contiguous pages.
+    // The shards of the pages must be latched.
+    RC  WriteDirty   (int fd, int *slots, int numSlots);
+
+    // Background writer
+    void WriterMain  ();                         // body of the thread
+    void StopWriter  (std::unique_lock<std::mutex> &guard);
+
+    PF_BufferShard *pShards;                      // the shards
+    int            numShards;                     // # of shards, power of 2
     PF_BufPageDesc *bufTable;                     // info on buffer pages
-    PF_HashTable   hashTable;                     // Hash table object
+    char           *pArena;                       // all the buffer frames
+    size_t         arenaSize;                     // bytes mapped for them
+    const char     *arenaBacking;                 // kind of memory used
+    PF_IOEngine    *pIOEngine;                    // for whole file transfers
+    char           *pHdrFrame;                    // aligned file header page
+    std::mutex     ioLatch;                       // guards the two above
     int            numPages;                      // # of pages in the buffer
     int            pageSize;                      // Size of pages in the buffer
-    int            first;                         // MRU page slot
-    int            last;                          // LRU page slot
-    int            free;                          // head of free list
+    std::atomic<int> readAhead;                   // read-ahead window
+    std::atomic<unsigned> nextBlockShard;         // shard of the next block
+    PF_ReplacePolicy replacePolicy;               // policy of every shard
+    PF_IOEngineType ioEngineType;                 // engine of every shard
+
+    // The background writer thread.  writerLatch guards its settings;
+    // writerCond tells it to wake up or stop.
+    std::mutex     writerLatch;
+    std::condition_variable writerCond;
+    std::thread    writer;                        // background writer
+    double         cleanTarget;                   // fraction kept clean
+    int            maxWritesPerSec;               // writer rate, 0 = any
+    int            bWriterStop;                   // TRUE to end the thread
 };
 
 #endif
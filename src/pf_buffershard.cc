@@ -0,0 +1,1210 @@
+//
+// File:        pf_buffershard.cc
+// Description: PF_BufferShard class implementation
+//
+// A shard is the buffer manager of a slice of the buffer.  Apart from
+// the latch, and from slots being counted from the start of the shard,
+// everything here is what PF_BufferMgr used to do for the whole buffer.
+//
+
+#include <cstdio>
+#include <climits>
+#include <algorithm>
+#include <sys/uio.h>
+#include <iostream>
+#include "pf_buffermgr.h"
+
+using namespace std;
+
+#ifdef PF_STATS
+#include "statistics.h"   // For StatisticsMgr interface
+
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+#ifdef PF_LOG
+void WriteLog(const char *psMessage);
+#endif
+
+#define MEMORY_FD -1
+
+//
+// PF_BufferShard
+//
+// Desc: Constructor - the shard is set up by Init
+//
+PF_BufferShard::PF_BufferShard()
+   : hashTable(PF_HASH_TBL_SIZE)
+{
+   pMgr = NULL;
+   bufTable = NULL;
+   pArena = NULL;
+   base = numSlots = pageSize = 0;
+   pReplacer = NULL;
+   pIOEngine = NULL;
+   first = last = free = INVALID_SLOT;
+   bWriterBusy = FALSE;
+}
+
+//
+// ~PF_BufferShard
+//
+// Desc: Destructor - the table and frames belong to the buffer manager
+//
+PF_BufferShard::~PF_BufferShard()
+{
+   delete pReplacer;
+   delete pIOEngine;
+}
+
+//
+// Init
+//
+// Desc: Take a range of the slots of the buffer, all of them free
+// In:   _pMgr - buffer manager, whose table and arena are allocated
+//       _base - first slot of the range
+//       _numSlots - # of slots in the range
+//       policy - page replacement policy
+//
+void PF_BufferShard::Init(PF_BufferMgr *_pMgr, int _base, int _numSlots,
+      PF_ReplacePolicy policy)
+{
+   pMgr = _pMgr;
+   base = _base;
+   numSlots = _numSlots;
+   pageSize = pMgr->pageSize;
+   bufTable = pMgr->bufTable + base;
+   pArena = pMgr->Frame(base);
+
+   // Initially, the free list contains all pages
+   for (int i = 0; i < numSlots; i++) {
+      bufTable[i].prev = i - 1;
+      bufTable[i].next = i + 1;
+      bufTable[i].pinCount = 0;
+      bufTable[i].bDirty = bufTable[i].bPrefetched = FALSE;
+      bufTable[i].bScanOnce = FALSE;
+   }
+   bufTable[0].prev = bufTable[numSlots - 1].next = INVALID_SLOT;
+   free = 0;
+   first = last = INVALID_SLOT;
+
+   hashTable.Resize(numSlots);
+   pReplacer = PF_Replacer::Create(policy);
+   pReplacer->Resize(numSlots);
+   pIOEngine = PF_IOEngine::Create(pMgr->ioEngineType);
+}
+
+//
+// GetPage
+//
+// Desc: Get a pointer to a page pinned in the buffer, reading it if it
+//       is not resident.  See PF_BufferMgr::GetPage.
+// In:   fd - OS file descriptor of the file to read
+//       pageNum - number of the page to read
+//       bMultiplePins - if FALSE, it is an error to ask for a page that is
+//                       already pinned in the buffer.
+//       hint - SEQUENTIAL_ONCE to read the page in at the cold end, and
+//              leave it where it is if it is resident
+// Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - if not NULL, set *pSlot to the slot of the page in the
+//               whole buffer
+// Ret:  PF return code
+//
+RC PF_BufferShard::GetPage(int fd, PageNum pageNum, char **ppBuffer,
+      int bMultiplePins, int *pSlot, ClientHint hint)
+{
+   RC  rc;     // return code
+   int slot;   // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Looking for (%d,%d).\n", fd, pageNum);
+   WriteLog(psMessage);
+#endif
+
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_GETPAGE);
+#endif
+
+   // Follow the scan of the file, if there is one.  Asking for the page
+   // after the last one continues it; asking for the same page again (one
+   // pin per record, say) leaves it as it is; anything else ends it.
+   int seqRun = 0;
+   if (fd >= 0) {
+      PF_FileFrames &file = File(fd);
+      if (pageNum == file.lastPage + 1 && file.seqRun > 0)
+         file.seqRun++;
+      else if (pageNum != file.lastPage)
+         file.seqRun = 0;
+      file.lastPage = pageNum;
+      seqRun = file.seqRun;
+   }
+
+   // Search for page in buffer
+   if ((rc = hashTable.Find(fd, pageNum, slot)) &&
+         (rc != PF_HASHNOTFOUND))
+      return (rc);                // unexpected error
+
+   // If page not in buffer...
+   if (rc == PF_HASHNOTFOUND) {
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_PAGENOTFOUND);
+#endif
+
+      // Read the page into a new slot.  During a scan the pages after
+      // it are read along with it.
+      int window = 1;
+      if (seqRun > 0)
+         window = min(pMgr->readAhead.load(), max(1, numSlots / 4));
+
+      if ((rc = ReadRun(fd, pageNum, window, slot,
+                        hint == SEQUENTIAL_ONCE)))
+         return (rc);
+#ifdef PF_LOG
+   WriteLog("Page not found in buffer. Loaded.\n");
+#endif
+   }
+   else {   // Page is in the buffer...
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_PAGEFOUND);
+#endif
+
+      // Error if we don't want to get a pinned page (a pin of the
+      // background writer does not count)
+      if (!bMultiplePins && bufTable[slot].ClientPins() > 0)
+         return (PF_PAGEPINNED);
+
+      // A page read ahead has paid off
+      if (bufTable[slot].bPrefetched) {
+         bufTable[slot].bPrefetched = FALSE;
+#ifdef PF_STATS
+         pStatisticsMgr->Add(PF_STAT_PREFETCHHITS);
+#endif
+      }
+
+      // Page is alredy in memory, just increment pin count
+      bufTable[slot].pinCount++;
+#ifdef PF_LOG
+      sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
+            bufTable[slot].pinCount.load());
+      WriteLog(psMessage);
+#endif
+
+      // Tell the replacement policy about the reference.  A one-shot
+      // scan leaves the page where it is; anyone else makes a page that
+      // such scans read an ordinary one.
+      if (hint != SEQUENTIAL_ONCE) {
+         bufTable[slot].bScanOnce = FALSE;
+         pReplacer->Access(slot);
+      }
+   }
+
+   // Point ppBuffer to page
+   *ppBuffer = Frame(slot);
+   if (pSlot != NULL)
+      *pSlot = base + slot;
+
+   // Return ok
+   return (0);
+}
+
+//
+// PinResident
+//
+// Desc: Pin a page of the shard if it is in the buffer.  Nothing is read
+//       and the scan state of the file is left alone.
+// In:   fd - OS file descriptor of the file of the page
+//       pageNum - number of the page
+// Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - set *pSlot to the slot of the page in the whole buffer
+// Ret:  PF_PAGENOTINBUF if the page is not in the buffer, or another PF
+//       return code
+//
+RC PF_BufferShard::PinResident(int fd, PageNum pageNum, char **ppBuffer,
+      int *pSlot)
+{
+   RC  rc;     // return code
+   int slot;   // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+   if ((rc = hashTable.Find(fd, pageNum, slot)))
+      return (rc == PF_HASHNOTFOUND ? PF_PAGENOTINBUF : rc);
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_GETPAGE);
+   pStatisticsMgr->Add(PF_STAT_PAGEFOUND);
+#endif
+
+   if (bufTable[slot].bPrefetched) {
+      bufTable[slot].bPrefetched = FALSE;
+#ifdef PF_STATS
+      pStatisticsMgr->Add(PF_STAT_PREFETCHHITS);
+#endif
+   }
+
+   bufTable[slot].pinCount++;
+   pReplacer->Access(slot);
+
+   *ppBuffer = Frame(slot);
+   *pSlot = base + slot;
+   return (0);
+}
+
+//
+// DiscardPage
+//
+// Desc: Drop a page of the shard from the buffer without writing it,
+//       because the file no longer uses it.  A page the background
+//       writer is writing out is left in the buffer.
+// In:   fd - OS file descriptor of the file of the page
+//       pageNum - number of the page
+// Ret:  PF_PAGEPINNED if a client has the page pinned, or another PF
+//       return code
+//
+RC PF_BufferShard::DiscardPage(int fd, PageNum pageNum)
+{
+   RC  rc;     // return code
+   int slot;   // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+   if ((rc = hashTable.Find(fd, pageNum, slot)))
+      return (rc == PF_HASHNOTFOUND ? 0 : rc);
+
+   if (bufTable[slot].ClientPins() > 0)
+      return (PF_PAGEPINNED);
+   if (bufTable[slot].pinCount > 0)
+      return (0);
+
+   ClearDirty(slot);
+   return (Drop(slot));
+}
+
+//
+// AllocatePage
+//
+// Desc: Allocate a new page in the buffer and return a pointer to it.
+// In:   fd - OS file descriptor of the file associated with the new page
+//       pageNum - number of the new page
+// Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
+//       pSlot - if not NULL, set *pSlot to the slot of the page in the
+//               whole buffer
+// Ret:  PF return code
+//
+RC PF_BufferShard::AllocatePage(int fd, PageNum pageNum, char **ppBuffer,
+      int *pSlot)
+{
+   RC  rc;     // return code
+   int slot;   // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Allocating a page for (%d,%d)....", fd, pageNum);
+   WriteLog(psMessage);
+#endif
+
+   // If page is already in buffer, return an error
+   if (!(rc = hashTable.Find(fd, pageNum, slot)))
+      return (PF_PAGEINBUF);
+   else if (rc != PF_HASHNOTFOUND)
+      return (rc);              // unexpected error
+
+   // Allocate an empty page
+   if ((rc = InternalAlloc(slot)))
+      return (rc);
+
+   // Insert the page into the hash table,
+   // and initialize the page description entry
+   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
+         (rc = InitPageDesc(fd, pageNum, slot))) {
+
+      // Put the slot back on the free list before returning the error
+      Unlink(slot);
+      InsertFree(slot);
+      return (rc);
+   }
+
+   // Let the replacement policy track the new page
+   LinkFile(slot);
+   pReplacer->Insert(slot, fd, pageNum);
+
+#ifdef PF_LOG
+   WriteLog("Succesfully allocated page.\n");
+#endif
+
+   // Point ppBuffer to page
+   *ppBuffer = Frame(slot);
+   if (pSlot != NULL)
+      *pSlot = base + slot;
+
+   // Return ok
+   return (0);
+}
+
+//
+// MarkDirty
+//
+// Desc: Mark a page of the shard dirty
+// In:   fd - OS file descriptor of the file associated with the page
+//       pageNum - number of the page to mark dirty
+// Ret:  PF return code
+//
+RC PF_BufferShard::MarkDirty(int fd, PageNum pageNum)
+{
+   RC  rc;       // return code
+   int slot;     // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Marking dirty (%d,%d).\n", fd, pageNum);
+   WriteLog(psMessage);
+#endif
+
+   // The page must be found and pinned in the buffer
+   if ((rc = hashTable.Find(fd, pageNum, slot))){
+      if ((rc == PF_HASHNOTFOUND))
+         return (PF_PAGENOTINBUF);
+      else
+         return (rc);              // unexpected error
+   }
+
+   return (SetSlotDirty(slot));
+}
+
+//
+// UnpinPage
+//
+// Desc: Unpin a page of the shard
+// In:   fd - OS file descriptor of the file associated with the page
+//       pageNum - number of the page to unpin
+// Ret:  PF return code
+//
+RC PF_BufferShard::UnpinPage(int fd, PageNum pageNum)
+{
+   RC  rc;       // return code
+   int slot;     // buffer slot where page is located
+   std::lock_guard<std::mutex> guard(latch);
+
+   // The page must be found and pinned in the buffer
+   if ((rc = hashTable.Find(fd, pageNum, slot))){
+      if ((rc == PF_HASHNOTFOUND))
+         return (PF_PAGENOTINBUF);
+      else
+         return (rc);              // unexpected error
+   }
+
+   return (UnpinLatched(slot));
+}
+
+//
+// MarkSlotDirty
+//
+// Desc: Mark the page held in a slot of the shard dirty
+// In:   slot - slot of a pinned page
+// Ret:  PF return code
+//
+RC PF_BufferShard::MarkSlotDirty(int slot)
+{
+   std::lock_guard<std::mutex> guard(latch);
+
+   return (SetSlotDirty(slot));
+}
+
+//
+// UnpinSlot
+//
+// Desc: Unpin the page held in a slot of the shard.  A pin that is not
+//       the last one of the page is dropped with a compare-and-swap,
+//       without the latch: clients of a hot page do not wait for one
+//       another on the way out.  The last pin goes through the latch,
+//       since the page becomes a candidate for eviction.
+// In:   slot - slot of a pinned page
+// Ret:  PF return code
+//
+RC PF_BufferShard::UnpinSlot(int slot)
+{
+   std::atomic<int> &pinCount = bufTable[slot].pinCount;
+   int pins = pinCount.load(std::memory_order_relaxed);
+
+   while (pins % PF_WRITER_PIN > 1)
+      if (pinCount.compare_exchange_weak(pins, pins - 1,
+            std::memory_order_release, std::memory_order_relaxed))
+         return (0);
+
+   std::lock_guard<std::mutex> guard(latch);
+   return (UnpinLatched(slot));
+}
+
+//
+// SetSlotDirty
+//
+// Desc: Internal.  Mark the page held in a slot dirty, with the latch held
+// In:   slot - slot of a pinned page
+// Ret:  PF_PAGEUNPINNED if no client pins the page, 0 otherwise
+//
+RC PF_BufferShard::SetSlotDirty(int slot)
+{
+   if (bufTable[slot].ClientPins() == 0)
+      return (PF_PAGEUNPINNED);
+
+   // Mark this page dirty
+   SetDirty(slot);
+
+   // Tell the replacement policy the page was touched, unless it is to
+   // stay at the cold end
+   if (!bufTable[slot].bScanOnce)
+      pReplacer->Touch(slot);
+
+   // Return ok
+   return (0);
+}
+
+//
+// UnpinLatched
+//
+// Desc: Internal.  Unpin the page held in a slot, with the latch held
+// In:   slot - slot of a pinned page
+// Ret:  PF_PAGEUNPINNED if no client pins the page, 0 otherwise
+//
+RC PF_BufferShard::UnpinLatched(int slot)
+{
+   if (bufTable[slot].ClientPins() == 0)
+      return (PF_PAGEUNPINNED);
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Unpinning (%d,%d). %d Pin count\n",
+         bufTable[slot].fd, bufTable[slot].pageNum,
+         bufTable[slot].pinCount.load()-1);
+   WriteLog(psMessage);
+#endif
+
+   // If unpinning the last pin, tell the replacement policy
+   if (--(bufTable[slot].pinCount) == 0 && !bufTable[slot].bScanOnce)
+      pReplacer->Touch(slot);
+
+   // Return ok
+   return (0);
+}
+
+//
+// HintSequential
+//
+// Desc: Record that a scan is about to ask for pageNum of fd.  See
+//       PF_BufferMgr::HintSequential.
+// In:   fd - file descriptor
+//       pageNum - next page of the scan
+//
+void PF_BufferShard::HintSequential(int fd, PageNum pageNum)
+{
+   std::lock_guard<std::mutex> guard(latch);
+   PF_FileFrames &file = File(fd);
+
+   if (file.lastPage != pageNum - 1)
+      file.seqRun = 0;
+   file.lastPage = pageNum - 1;
+   file.seqRun = max(file.seqRun, 1);
+}
+
+//
+// AllocateBlock
+//
+// Desc: Allocate a memory block in a slot of the shard.  Its page number
+//       is its slot in the whole buffer, which makes it unique.
+// Out:  buffer - the block
+// Ret:  PF return code
+//
+RC PF_BufferShard::AllocateBlock(char *&buffer)
+{
+   RC rc = OK_RC;
+   std::lock_guard<std::mutex> guard(latch);
+
+   // Get an empty slot from the buffer pool
+   int slot;
+   if ((rc = InternalAlloc(slot)) != OK_RC)
+      return rc;
+
+   // Create artificial page number (just needs to be unique for hash table)
+   PageNum pageNum = base + slot;
+
+   // Insert the page into the hash table, and initialize the page description entry
+   if ((rc = hashTable.Insert(MEMORY_FD, pageNum, slot) != OK_RC) ||
+         (rc = InitPageDesc(MEMORY_FD, pageNum, slot)) != OK_RC) {
+      // Put the slot back on the free list before returning the error
+      Unlink(slot);
+      InsertFree(slot);
+      return rc;
+   }
+
+   // Blocks are replaceable once disposed of, like any other page
+   pReplacer->Insert(slot, MEMORY_FD, pageNum);
+
+   // Return pointer to buffer
+   buffer = Frame(slot);
+
+   // Return success code
+   return OK_RC;
+}
+
+//
+// InsertFree
+//
+// Desc: Internal.  Insert a slot at the head of the free list
+// In:   slot - slot number to insert
+// Ret:  PF return code
+//
+RC PF_BufferShard::InsertFree(int slot)
+{
+   bufTable[slot].next = free;
+   free = slot;
+
+   // Return ok
+   return (0);
+}
+
+//
+// LinkHead
+//
+// Desc: Internal.  Insert a slot at the head of the used list.  The used
+//       list holds every slot with a page in it; recency is kept by the
+//       replacement policy.
+// In:   slot - slot number to insert
+// Ret:  PF return code
+//
+RC PF_BufferShard::LinkHead(int slot)
+{
+   // Set next and prev pointers of slot entry
+   bufTable[slot].next = first;
+   bufTable[slot].prev = INVALID_SLOT;
+
+   // If list isn't empty, point old first back to slot
+   if (first != INVALID_SLOT)
+      bufTable[first].prev = slot;
+
+   first = slot;
+
+   // if list was empty, set last to slot
+   if (last == INVALID_SLOT)
+      last = first;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Unlink
+//
+// Desc: Internal.  Unlink the slot from the used list.  Assume that
+//       slot is valid.  Set prev and next pointers to INVALID_SLOT.
+//       The caller is responsible to either place the unlinked page into
+//       the free list or the used list.
+// In:   slot - slot number to unlink
+// Ret:  PF return code
+//
+RC PF_BufferShard::Unlink(int slot)
+{
+   // If slot is at head of list, set first to next element
+   if (first == slot)
+      first = bufTable[slot].next;
+
+   // If slot is at end of list, set last to previous element
+   if (last == slot)
+      last = bufTable[slot].prev;
+
+   // If slot not at end of list, point next back to previous
+   if (bufTable[slot].next != INVALID_SLOT)
+      bufTable[bufTable[slot].next].prev = bufTable[slot].prev;
+
+   // If slot not at head of list, point prev forward to next
+   if (bufTable[slot].prev != INVALID_SLOT)
+      bufTable[bufTable[slot].prev].next = bufTable[slot].next;
+
+   // Set next and prev pointers of slot entry
+   bufTable[slot].prev = bufTable[slot].next = INVALID_SLOT;
+
+   // Return ok
+   return (0);
+}
+
+//
+// InternalAlloc
+//
+// Desc: Internal.  Allocate a buffer slot.  The slot is inserted at the
+//       head of the used list.  Here's how it chooses which slot to use:
+//       If there is something on the free list, then use it.
+//       Otherwise, ask the replacement policy for a victim to replace.
+//       If a victim cannot be chosen (because all the pages are pinned),
+//       then return an error.
+// Out:  slot - set to newly-allocated slot
+// Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
+//
+RC PF_BufferShard::InternalAlloc(int &slot)
+{
+   RC  rc;       // return code
+
+   // If the free list is not empty, choose a slot from the free list
+   if (free != INVALID_SLOT) {
+      slot = free;
+      free = bufTable[slot].next;
+   }
+   else {
+
+      int probes;   // # of slots the policy looked at
+
+      // Choose an unpinned page according to the replacement policy,
+      // return error if all buffers were pinned
+      rc = pReplacer->Victim(bufTable, slot, probes);
+
+#ifdef PF_STATS
+      pStatisticsMgr->Add(PF_STAT_VICTIMPROBES, probes);
+#endif
+
+      if (rc)
+         return (rc);
+
+#ifdef PF_STATS
+      pStatisticsMgr->Add(PF_STAT_VICTIMS);
+#endif
+
+      // Write out the page if it is dirty
+      if (bufTable[slot].bDirty) {
+#ifdef PF_STATS
+         pStatisticsMgr->Add(PF_STAT_DIRTYVICTIMS);
+#endif
+         if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
+               Frame(slot))))
+            return (rc);
+
+         ClearDirty(slot);
+      }
+
+      // Remove page from the hash table and slot from the used buffer list
+      UnlinkFile(slot);
+      if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
+            (rc = Unlink(slot)))
+         return (rc);
+   }
+
+   // Link slot at the head of the used list
+   if ((rc = LinkHead(slot)))
+      return (rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// Drop
+//
+// Desc: Internal.  Remove an unpinned page from the buffer and put its
+//       slot on the free list.  A dirty page is not written.
+// In:   slot - slot of the page
+// Ret:  PF return code
+//
+RC PF_BufferShard::Drop(int slot)
+{
+   RC rc;
+
+   UnlinkFile(slot);
+   pReplacer->Remove(slot);
+   if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
+         (rc = Unlink(slot)) ||
+         (rc = InsertFree(slot)))
+      return (rc);
+   return (0);
+}
+
+//
+// ReadPage
+//
+// Desc: Read a page from disk
+//
+// In:   fd - OS file descriptor
+//       pageNum - number of page to read
+//       dest - pointer to buffer in which to read page
+// Out:  dest - buffer contains page contents
+// Ret:  PF return code
+//
+RC PF_BufferShard::ReadPage(int fd, PageNum pageNum, char *dest)
+{
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Reading (%d,%d).\n", fd, pageNum);
+   WriteLog(psMessage);
+#endif
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_READPAGE);
+#endif
+
+   // Read the data (cast to long for PC's)
+   RC rc;
+   struct iovec iov = { dest, (size_t)pageSize };
+   PF_IORequest req = { fd, pageNum * (long)pageSize + PF_FILE_HDR_SIZE,
+                        &iov, 1, FALSE, 0 };
+#ifdef PF_STATS
+   StatTimer timer(pStatisticsMgr, PF_LAT_READ);
+#endif
+   if ((rc = pIOEngine->Run(&req, 1)))
+      return (rc);
+   return (PF_BufferMgr::IOResult(req, PF_INCOMPLETEREAD));
+}
+
+//
+// WritePage
+//
+// Desc: Write a page to disk
+//
+// In:   fd - OS file descriptor
+//       pageNum - number of page to write
+//       dest - pointer to buffer containing page contents
+// Ret:  PF return code
+//
+RC PF_BufferShard::WritePage(int fd, PageNum pageNum, char *source)
+{
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Writing (%d,%d).\n", fd, pageNum);
+   WriteLog(psMessage);
+#endif
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_WRITEPAGE);
+#endif
+
+   // Write the data (cast to long for PC's)
+   RC rc;
+   struct iovec iov = { source, (size_t)pageSize };
+   PF_IORequest req = { fd, pageNum * (long)pageSize + PF_FILE_HDR_SIZE,
+                        &iov, 1, TRUE, 0 };
+#ifdef PF_STATS
+   StatTimer timer(pStatisticsMgr, PF_LAT_WRITE);
+#endif
+   if ((rc = pIOEngine->Run(&req, 1)))
+      return (rc);
+   return (PF_BufferMgr::IOResult(req, PF_INCOMPLETEWRITE));
+}
+
+//
+// ReadRun
+//
+// Desc: Internal.  Read pageNum into a new slot, which is returned pinned
+//       and linked like any other page read.  Up to numPages - 1 of the
+//       following pages are read ahead in the same request, as long as
+//       they belong to this shard, are not resident already and slots can
+//       be found for them.  Those pages are left unpinned and marked as
+//       prefetched; pages past the end of the file are simply not read.
+// In:   fd - OS file descriptor
+//       pageNum - number of the page asked for
+//       numPages - read window, including pageNum
+//       bScanOnce - TRUE if a SEQUENTIAL_ONCE scan asked for the page
+// Out:  slot - slot holding pageNum
+// Ret:  PF return code
+//
+RC PF_BufferShard::ReadRun(int fd, PageNum pageNum, int numPages, int &slot,
+      int bScanOnce)
+{
+   RC  rc;                    // return code
+   int slots[IOV_MAX];        // slots of the pages of the run
+   struct iovec iov[IOV_MAX];
+   int n, numRead;
+
+   // The run ends at the first page that is already in the buffer
+   numPages = min(numPages, IOV_MAX);
+   for (n = 1; n < numPages; n++) {
+      int found;
+      if (&pMgr->Shard(fd, pageNum + n) != this)
+         break;
+      if ((rc = hashTable.Find(fd, pageNum + n, found)) != PF_HASHNOTFOUND)
+         break;
+   }
+   numPages = n;
+
+   // Find a slot for every page of the run.  Only the first one is
+   // required; read-ahead stops short if the buffer is pinned full.
+   if ((rc = InternalAlloc(slots[0])))
+      return (rc);
+   for (n = 1; n < numPages; n++)
+      if (InternalAlloc(slots[n]))
+         break;
+
+   if (n == 1) {
+      rc = ReadPage(fd, pageNum, Frame(slots[0]));
+      numRead = rc ? 0 : 1;
+   }
+   else {
+      for (int i = 0; i < n; i++) {
+         iov[i].iov_base = Frame(slots[i]);
+         iov[i].iov_len = pageSize;
+      }
+
+#ifdef PF_LOG
+      char psMessage[100];
+      sprintf (psMessage, "Reading (%d,%d) and %d following pages.\n",
+            fd, pageNum, n - 1);
+      WriteLog(psMessage);
+#endif
+
+      PF_IORequest req = { fd, pageNum * (long)pageSize + PF_FILE_HDR_SIZE,
+                           iov, n, FALSE, 0 };
+      {
+#ifdef PF_STATS
+         StatTimer timer(pStatisticsMgr, PF_LAT_READ);
+#endif
+         if ((rc = pIOEngine->Run(&req, 1)))
+            req.result = -1;
+      }
+      numRead = (req.result < 0) ? 0 : (int)(req.result / pageSize);
+      rc = (req.result < 0) ? PF_UNIX : (numRead ? 0 : PF_INCOMPLETEREAD);
+
+#ifdef PF_STATS
+      pStatisticsMgr->Add(PF_STAT_READPAGE, numRead);
+      pStatisticsMgr->Add(PF_STAT_READV);
+#endif
+   }
+
+   // Insert the pages read into the hash table; the ones read ahead
+   // are not pinned by anyone
+   int i;
+   for (i = 0; i < numRead; i++)
+      if ((rc = InsertPage(slots[i], fd, pageNum + i, i > 0, bScanOnce)))
+         break;
+
+   // Put the slots of the pages that were not read back on the free list
+   for (int j = i; j < n; j++) {
+      Unlink(slots[j]);
+      InsertFree(slots[j]);
+   }
+
+   // It is only an error if the page asked for could not be read
+   if (i == 0)
+      return (rc);
+
+#ifdef PF_STATS
+   int numPrefetched = i - 1;
+   if (numPrefetched > 0)
+      pStatisticsMgr->Add(PF_STAT_PREFETCHED, numPrefetched);
+#endif
+
+   slot = slots[0];
+   return (0);
+}
+
+//
+// InsertPage
+//
+// Desc: Internal.  Make a page that has just been read into slot known to
+//       the hash table, its file and the replacement policy.
+// In:   slot - slot holding the page, taken by InternalAlloc
+//       fd, pageNum - the page
+//       bPrefetched - FALSE if the page is pinned for the caller, TRUE if
+//                     it is read ahead and left unpinned
+//       bScanOnce - TRUE if the page is read for a SEQUENTIAL_ONCE scan:
+//                   it goes at the cold end and stays there
+// Ret:  PF return code
+//
+RC PF_BufferShard::InsertPage(int slot, int fd, PageNum pageNum,
+      int bPrefetched, int bScanOnce)
+{
+   RC rc;
+
+   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
+         (rc = InitPageDesc(fd, pageNum, slot)))
+      return (rc);
+
+   // Let the replacement policy track the new page
+   LinkFile(slot);
+   bufTable[slot].bScanOnce = bScanOnce;
+   if (bScanOnce)
+      pReplacer->InsertCold(slot, fd, pageNum);
+   else
+      pReplacer->Insert(slot, fd, pageNum);
+
+   if (bPrefetched) {
+      bufTable[slot].pinCount = 0;
+      bufTable[slot].bPrefetched = TRUE;
+      if (!bScanOnce)
+         pReplacer->Touch(slot);
+   }
+
+   return (0);
+}
+
+//
+// InitPageDesc
+//
+// Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
+//       for a newly pinned page
+// In:   fd - file descriptor
+//       pageNum - page number
+// Ret:  PF return code
+//
+RC PF_BufferShard::InitPageDesc(int fd, PageNum pageNum, int slot)
+{
+   // set the slot to refer to a newly-pinned page
+   bufTable[slot].fd       = fd;
+   bufTable[slot].pageNum  = pageNum;
+   bufTable[slot].bDirty   = FALSE;
+   bufTable[slot].pinCount = 1;
+   bufTable[slot].bPrefetched = FALSE;
+   bufTable[slot].bScanOnce = FALSE;
+
+   // Return ok
+   return (0);
+}
+
+//
+// File
+//
+// Desc: Internal.  Return the page lists and access pattern of a file,
+//       creating an empty entry the first time the file is seen.
+// In:   fd - file descriptor, not MEMORY_FD
+//
+PF_FileFrames &PF_BufferShard::File(int fd)
+{
+   if (fd >= (int)files.size()) {
+      PF_FileFrames empty = { INVALID_SLOT, INVALID_SLOT, 0, -1, 0 };
+      files.resize(fd + 1, empty);
+   }
+   return (files[fd]);
+}
+
+//
+// LinkFile
+//
+// Desc: Internal.  Put a newly read or allocated page at the head of the
+//       resident list of its file.  Memory blocks are not tracked.
+// In:   slot - slot of the page, already initialized by InitPageDesc
+//
+void PF_BufferShard::LinkFile(int slot)
+{
+   int fd = bufTable[slot].fd;
+
+   bufTable[slot].fileNext = bufTable[slot].filePrev = INVALID_SLOT;
+   bufTable[slot].dirtyNext = bufTable[slot].dirtyPrev = INVALID_SLOT;
+   if (fd < 0)
+      return;
+
+   PF_FileFrames &file = File(fd);
+   bufTable[slot].fileNext = file.first;
+   if (file.first != INVALID_SLOT)
+      bufTable[file.first].filePrev = slot;
+   file.first = slot;
+}
+
+//
+// UnlinkFile
+//
+// Desc: Internal.  Take a page that leaves the buffer off the lists of
+//       its file.  A dirty page is forgotten; write it out first.  A page
+//       read ahead that nobody asked for counts as a wasted prefetch.
+// In:   slot - slot of the page
+//
+void PF_BufferShard::UnlinkFile(int slot)
+{
+   int fd = bufTable[slot].fd;
+
+   if (bufTable[slot].bPrefetched) {
+      bufTable[slot].bPrefetched = FALSE;
+#ifdef PF_STATS
+      pStatisticsMgr->Add(PF_STAT_PREFETCHWASTED);
+#endif
+   }
+
+   if (fd < 0 || fd >= (int)files.size())
+      return;
+
+   ClearDirty(slot);
+
+   int next = bufTable[slot].fileNext;
+   int prev = bufTable[slot].filePrev;
+   if (prev != INVALID_SLOT)
+      bufTable[prev].fileNext = next;
+   else if (files[fd].first == slot)
+      files[fd].first = next;
+   if (next != INVALID_SLOT)
+      bufTable[next].filePrev = prev;
+
+   bufTable[slot].fileNext = bufTable[slot].filePrev = INVALID_SLOT;
+}
+
+//
+// SetDirty
+//
+// Desc: Internal.  Mark a page dirty and put it on its file's dirty list
+// In:   slot - slot of the page
+//
+void PF_BufferShard::SetDirty(int slot)
+{
+   int fd = bufTable[slot].fd;
+
+   if (bufTable[slot].bDirty)
+      return;
+   bufTable[slot].bDirty = TRUE;
+
+   if (fd < 0 || fd >= (int)files.size())
+      return;
+
+   bufTable[slot].dirtyPrev = INVALID_SLOT;
+   bufTable[slot].dirtyNext = files[fd].firstDirty;
+   if (files[fd].firstDirty != INVALID_SLOT)
+      bufTable[files[fd].firstDirty].dirtyPrev = slot;
+   files[fd].firstDirty = slot;
+   files[fd].numDirty++;
+}
+
+//
+// ClearDirty
+//
+// Desc: Internal.  Mark a page clean and take it off its file's dirty list
+// In:   slot - slot of the page
+//
+void PF_BufferShard::ClearDirty(int slot)
+{
+   int fd = bufTable[slot].fd;
+
+   if (!bufTable[slot].bDirty)
+      return;
+   bufTable[slot].bDirty = FALSE;
+
+   if (fd < 0 || fd >= (int)files.size())
+      return;
+
+   int next = bufTable[slot].dirtyNext;
+   int prev = bufTable[slot].dirtyPrev;
+   if (prev != INVALID_SLOT)
+      bufTable[prev].dirtyNext = next;
+   else
+      files[fd].firstDirty = next;
+   if (next != INVALID_SLOT)
+      bufTable[next].dirtyPrev = prev;
+
+   bufTable[slot].dirtyNext = bufTable[slot].dirtyPrev = INVALID_SLOT;
+   files[fd].numDirty--;
+}
+
+//
+// WriterRound
+//
+// Desc: Internal.  One round of the background writer over this shard.
+//       The unpinned frames nearest to eviction are visited, up to the
+//       clean target, and their dirty pages are written with one request
+//       per run of contiguous pages.  The pages are marked clean and
+//       pinned by the writer before the latch is dropped for the writes,
+//       so they can be neither evicted nor flushed meanwhile; a page
+//       dirtied again during its write simply stays dirty.
+// In:   cleanTarget - fraction of the shard to keep clean
+//       budget - most pages to write
+//       pEngine - the writer's I/O engine
+// Ret:  number of pages written
+//
+int PF_BufferShard::WriterRound(double cleanTarget, int budget,
+      PF_IOEngine *pEngine)
+{
+   std::unique_lock<std::mutex> guard(latch);
+   std::vector<int> order(numSlots);
+   std::vector<int> slots;
+   int numResident = pReplacer->Order(&order[0]);
+
+   // Frames to keep clean besides the free ones, from the victim end
+   int window = (int)(cleanTarget * numSlots + 0.5) - (numSlots - numResident);
+   for (int i = numResident - 1;
+         i >= 0 && window > 0 && (int)slots.size() < budget; i--) {
+      int slot = order[i];
+      if (bufTable[slot].pinCount > 0)
+         continue;
+      window--;
+      if (bufTable[slot].bDirty && bufTable[slot].fd >= 0)
+         slots.push_back(slot);
+   }
+   if (slots.empty())
+      return (0);
+
+   for (unsigned i = 0; i < slots.size(); i++) {
+      ClearDirty(slots[i]);
+      bufTable[slots[i]].pinCount += PF_WRITER_PIN;
+   }
+
+   // Requests for the runs of contiguous pages of each file
+   const PF_BufPageDesc *table = bufTable;
+   std::sort(slots.begin(), slots.end(), [table](int a, int b) {
+      if (table[a].fd != table[b].fd)
+         return (table[a].fd < table[b].fd);
+      return (table[a].pageNum < table[b].pageNum);
+   });
+
+   std::vector<struct iovec> iov(slots.size());
+   std::vector<PF_IORequest> reqs;
+   for (unsigned i = 0; i < slots.size(); i++) {
+      const PF_BufPageDesc &page = bufTable[slots[i]];
+      iov[i].iov_base = Frame(slots[i]);
+      iov[i].iov_len = pageSize;
+      if (i > 0 && page.fd == bufTable[slots[i - 1]].fd &&
+            page.pageNum == bufTable[slots[i - 1]].pageNum + 1 &&
+            reqs.back().iovcnt < IOV_MAX)
+         reqs.back().iovcnt++;
+      else {
+         PF_IORequest req = { page.fd,
+               page.pageNum * (long)pageSize + PF_FILE_HDR_SIZE,
+               &iov[i], 1, TRUE, 0 };
+         reqs.push_back(req);
+      }
+   }
+
+   bWriterBusy = TRUE;
+   guard.unlock();
+   RC rc;
+   {
+#ifdef PF_STATS
+      StatTimer timer(pStatisticsMgr, PF_LAT_WRITE);
+#endif
+      rc = pEngine->Run(&reqs[0], reqs.size());
+   }
+   guard.lock();
+
+   // Release the pages; those whose write failed are dirty again
+   int numWritten = 0;
+   for (unsigned r = 0, i = 0; r < reqs.size(); r++) {
+      int bOk = !rc &&
+         !PF_BufferMgr::IOResult(reqs[r], PF_INCOMPLETEWRITE);
+      for (int k = 0; k < reqs[r].iovcnt; k++, i++) {
+         bufTable[slots[i]].pinCount -= PF_WRITER_PIN;
+         if (bOk)
+            numWritten++;
+         else
+            SetDirty(slots[i]);
+      }
+   }
+
+#ifdef PF_STATS
+   int numReqs = reqs.size();
+   pStatisticsMgr->Add(PF_STAT_BGWRITES, numWritten);
+   pStatisticsMgr->Add(PF_STAT_BGWRITEV, numReqs);
+#endif
+
+   bWriterBusy = FALSE;
+   writerDone.notify_all();
+   return (numWritten);
+}
+
+//
+// WaitWriter
+//
+// Desc: Internal.  Wait until the background writer has no write in
+//       progress in this shard, hence no pin on any of its pages.  Methods
+//       that drop pages call this first; as they keep the latch, no new
+//       round starts until they are done.
+// In:   guard - holds the latch
+//
+void PF_BufferShard::WaitWriter(std::unique_lock<std::mutex> &guard)
+{
+   while (bWriterBusy)
+      writerDone.wait(guard);
+}
@@ -25,7 +25,10 @@ static char *PF_WarnMsg[] = {
   (char*)"page already unpinned",
   (char*)"end of file",
   (char*)"attempting to resize the buffer too small",
-  (char*)"invalid filename"
+  (char*)"invalid buffer tuning parameter",
+  (char*)"page is mapped read-only",
+  (char*)"invalid page size",
+  (char*)"work memory budget used up"
 };
 
 static char *PF_ErrorMsg[] = {
@@ -5,10 +5,22 @@
 //              Dallan Quass (quass@cs.stanford.edu)
 //
 
+#include <cerrno>
+#include <algorithm>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_filemap.h"
+#include "pf_pagemap.h"
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
 
 //
 // PF_FileHandle
@@ -28,6 +40,9 @@ PF_FileHandle::PF_FileHandle()
    // Initialize local variables
    bFileOpen = FALSE;
    pBufferMgr = NULL;
+   pFileMap = NULL;
+   pPageMap = NULL;
+   extentPages = PF_EXTENT_PAGES;
 }
 
 //
@@ -52,10 +67,13 @@ PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
 {
    // Just copy the data members since there is no memory allocation involved
    this->pBufferMgr  = fileHandle.pBufferMgr;
+   this->pFileMap    = fileHandle.pFileMap;
+   this->pPageMap    = fileHandle.pPageMap;
    this->hdr         = fileHandle.hdr;
    this->bFileOpen   = fileHandle.bFileOpen;
    this->bHdrChanged = fileHandle.bHdrChanged;
    this->unixfd      = fileHandle.unixfd;
+   this->extentPages = fileHandle.extentPages;
 }
 
 //
@@ -74,10 +92,13 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
 
       // Just copy the members since there is no memory allocation involved
       this->pBufferMgr  = fileHandle.pBufferMgr;
+      this->pFileMap    = fileHandle.pFileMap;
+      this->pPageMap    = fileHandle.pPageMap;
       this->hdr         = fileHandle.hdr;
       this->bFileOpen   = fileHandle.bFileOpen;
       this->bHdrChanged = fileHandle.bHdrChanged;
       this->unixfd      = fileHandle.unixfd;
+      this->extentPages = fileHandle.extentPages;
    }
 
    // Return a reference to this
@@ -93,9 +114,10 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle,
+      ClientHint hint) const
 {
-   return (GetNextPage((PageNum)-1, pageHandle));
+   return (GetNextPage((PageNum)-1, pageHandle, hint));
 }
 
 //
@@ -107,9 +129,10 @@ RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle) const
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle,
+      ClientHint hint) const
 {
-   return (GetPrevPage((PageNum)hdr.numPages, pageHandle));
+   return (GetPrevPage((PageNum)hdr.numPages, pageHandle, hint));
 }
 
 //
@@ -123,32 +146,22 @@ RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle) const
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF_EOF, or another PF return code
 //
-RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle,
+      ClientHint hint) const
 {
-   int rc;               // return code
-
-   // File must be open
-   if (!bFileOpen)
-      return (PF_CLOSEDFILE);
-
-   // Validate page number (note that -1 is acceptable here)
-   if (current != -1 &&  !IsValidPageNum(current))
-      return (PF_INVALIDPAGE);
-
-   // Scan the file until a valid used page is found
-   for (current++; current < hdr.numPages; current++) {
+   int  rc;               // return code
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
 
-      // If this is a valid (used) page, we're done
-      if (!(rc = GetThisPage(current, pageHandle)))
-         return (0);
+   if ((rc = PinNextUsedPage(current, 1, pPageBuf, slot, hint)))
+      return (rc);
 
-      // If unexpected error, return it
-      if (rc != PF_INVALIDPAGE)
-         return (rc);
-   }
+   // Set the pageHandle local variables
+   pageHandle.pageNum = current;
+   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
 
-   // No valid (used) page found
-   return (PF_EOF);
+   // Return ok
+   return (0);
 }
 
 //
@@ -162,32 +175,22 @@ RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF_EOF, or another PF return code
 //
-RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle,
+      ClientHint hint) const
 {
-   int rc;               // return code
-
-   // File must be open
-   if (!bFileOpen)
-      return (PF_CLOSEDFILE);
-
-   // Validate page number (note that hdr.numPages is acceptable here)
-   if (current != hdr.numPages &&  !IsValidPageNum(current))
-      return (PF_INVALIDPAGE);
-
-   // Scan the file until a valid used page is found
-   for (current--; current >= 0; current--) {
+   int  rc;               // return code
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
 
-      // If this is a valid (used) page, we're done
-      if (!(rc = GetThisPage(current, pageHandle)))
-         return (0);
+   if ((rc = PinNextUsedPage(current, -1, pPageBuf, slot, hint)))
+      return (rc);
 
-      // If unexpected error, return it
-      if (rc != PF_INVALIDPAGE)
-         return (rc);
-   }
+   // Set the pageHandle local variables
+   pageHandle.pageNum = current;
+   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
 
-   // No valid (used) page found
-   return (PF_EOF);
+   // Return ok
+   return (0);
 }
 
 //
@@ -201,39 +204,22 @@ RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle,
+      ClientHint hint) const
 {
    int  rc;               // return code
    char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
 
-   // File must be open
-   if (!bFileOpen)
-      return (PF_CLOSEDFILE);
-
-   // Validate page number
-   if (!IsValidPageNum(pageNum))
-      return (PF_INVALIDPAGE);
-
-   // Get this page from the buffer manager
-   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf)))
+   if ((rc = PinUsedPage(pageNum, pPageBuf, slot, hint)))
       return (rc);
 
-   // If the page is valid, then set pageHandle to this page and return ok
-   if (((PF_PageHdr*)pPageBuf)->nextFree == PF_PAGE_USED) {
-
-      // Set the pageHandle local variables
-      pageHandle.pageNum = pageNum;
-      pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
-
-      // Return ok
-      return (0);
-   }
-
-   // If the page is *not* a valid one, then unpin the page
-   if ((rc = UnpinPage(pageNum)))
-      return (rc);
+   // Set the pageHandle local variables
+   pageHandle.pageNum = pageNum;
+   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
 
-   return (PF_INVALIDPAGE);
+   // Return ok
+   return (0);
 }
 
 //
@@ -251,58 +237,310 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
    int     rc;               // return code
    int     pageNum;          // new-page number
    char    *pPageBuf;        // address of page in buffer pool
+   int     slot;             // buffer slot of the page
 
+   if ((rc = PinNewPage(pageNum, pPageBuf, slot)))
+      return (rc);
+
+   // Set the pageHandle local variables
+   pageHandle.pageNum = pageNum;
+   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
+
+   // Return ok
+   return (0);
+}
+
+//
+// GetPageSize
+//
+// Desc: Size of the data part of the pages of the file, chosen when the
+//       file was created.  The file handle must refer to an open file.
+// Out:  pageSize - bytes of data per page
+// Ret:  PF return code
+//
+RC PF_FileHandle::GetPageSize(int &pageSize) const
+{
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // If the free list isn't empty...
-   if (hdr.firstFree != PF_PAGE_LIST_END) {
-      pageNum = hdr.firstFree;
+   pageSize = hdr.pageBytes - sizeof(PF_PageHdr);
+   return (0);
+}
 
-      // Get the first free page into the buffer
-      if ((rc = pBufferMgr->GetPage(unixfd,
-            pageNum,
-            &pPageBuf)))
-         return (rc);
+//
+// GetFirstPage, GetLastPage, GetNextPage, GetPrevPage, GetThisPage,
+// AllocatePage
+//
+// Desc: Same as above, but the page is handed to a page guard, which
+//       first unpins the page it was holding, if any.
+// Out:  pageGuard - holds the pin on the page
+// Ret:  PF return code
+//
+RC PF_FileHandle::GetFirstPage(PF_PageGuard &pageGuard,
+      ClientHint hint) const
+{
+   return (GetNextPage((PageNum)-1, pageGuard, hint));
+}
 
-      // Set the first free page to the next page on the free list
-      hdr.firstFree = ((PF_PageHdr*)pPageBuf)->nextFree;
-   }
-   else {
+RC PF_FileHandle::GetLastPage(PF_PageGuard &pageGuard, ClientHint hint) const
+{
+   return (GetPrevPage((PageNum)hdr.numPages, pageGuard, hint));
+}
 
-      // The free list is empty...
-      pageNum = hdr.numPages;
+RC PF_FileHandle::GetNextPage(PageNum current, PF_PageGuard &pageGuard,
+      ClientHint hint) const
+{
+   int  rc;               // return code
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   if ((rc = pageGuard.UnpinPage()) && rc != PF_PAGEUNPINNED)
+      return (rc);
+
+   if ((rc = PinNextUsedPage(current, 1, pPageBuf, slot, hint)))
+      return (rc);
+
+   pageGuard.Attach(pBufferMgr, pFileMap, slot, current,
+         pPageBuf + sizeof(PF_PageHdr));
+   return (0);
+}
+
+RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageGuard &pageGuard,
+      ClientHint hint) const
+{
+   int  rc;               // return code
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   if ((rc = pageGuard.UnpinPage()) && rc != PF_PAGEUNPINNED)
+      return (rc);
+
+   if ((rc = PinNextUsedPage(current, -1, pPageBuf, slot, hint)))
+      return (rc);
+
+   pageGuard.Attach(pBufferMgr, pFileMap, slot, current,
+         pPageBuf + sizeof(PF_PageHdr));
+   return (0);
+}
+
+RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageGuard &pageGuard,
+      ClientHint hint) const
+{
+   int  rc;               // return code
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   if ((rc = pageGuard.UnpinPage()) && rc != PF_PAGEUNPINNED)
+      return (rc);
+
+   if ((rc = PinUsedPage(pageNum, pPageBuf, slot, hint)))
+      return (rc);
+
+   pageGuard.Attach(pBufferMgr, pFileMap, slot, pageNum,
+         pPageBuf + sizeof(PF_PageHdr));
+   return (0);
+}
+
+RC PF_FileHandle::AllocatePage(PF_PageGuard &pageGuard)
+{
+   int  rc;               // return code
+   int  pageNum;          // new-page number
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   if ((rc = pageGuard.UnpinPage()) && rc != PF_PAGEUNPINNED)
+      return (rc);
+
+   if ((rc = PinNewPage(pageNum, pPageBuf, slot)))
+      return (rc);
+
+   pageGuard.Attach(pBufferMgr, pFileMap, slot, pageNum,
+         pPageBuf + sizeof(PF_PageHdr));
+   return (0);
+}
+
+//
+// PinUsedPage
+//
+// Desc: Internal.  Pin a specific page of the file if it is in use.
+// In:   pageNum - the number of the page to get
+//       hint - passed on to the buffer manager
+// Out:  pPageBuf - address of the page (including PF_PageHdr) in the buffer
+//       or in the mapping of the file
+//       slot - buffer slot of the page, INVALID_SLOT if it is mapped
+// Ret:  PF_INVALIDPAGE if the page is free, or another PF return code
+//
+RC PF_FileHandle::PinUsedPage(PageNum pageNum, char *&pPageBuf,
+      int &slot, ClientHint hint) const
+{
+   int  rc;               // return code
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number; a free page is not even read
+   if (!IsValidPageNum(pageNum) || !pPageMap->IsUsed(pageNum))
+      return (PF_INVALIDPAGE);
+
+   // Get this page from the mapping of the file, if it has one, or else
+   // from the buffer manager
+   rc = PF_PAGENOTINBUF;
+   if (pFileMap != NULL)
+      rc = PinMappedPage(pageNum, pPageBuf, slot);
+   if (rc == PF_PAGENOTINBUF)
+      rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, &slot,
+            hint);
+   return (rc);
+}
+
+//
+// PinMappedPage
+//
+// Desc: Internal.  Pin a page of a mapped file without copying it into
+//       the buffer.  A page that the buffer holds is pinned there, since
+//       it may have changes the file does not have yet; any other page is
+//       pinned in the mapping.  A page with mapped pins keeps getting
+//       them, so the pins of a page are all of one kind.
+// In:   pageNum - the number of the page to get
+// Out:  pPageBuf - address of the page (including PF_PageHdr)
+//       slot - buffer slot of the page, INVALID_SLOT if it is mapped
+// Ret:  PF_PAGENOTINBUF if the page is past the end of the mapping, or
+//       another PF return code
+//
+RC PF_FileHandle::PinMappedPage(PageNum pageNum, char *&pPageBuf,
+      int &slot) const
+{
+   int  rc;               // return code
+
+   if (!pFileMap->Covers(pageNum))
+      return (PF_PAGENOTINBUF);
+
+   if (!pFileMap->IsPinned(pageNum) &&
+         (rc = pBufferMgr->PinResident(unixfd, pageNum, &pPageBuf, &slot))
+         != PF_PAGENOTINBUF)
+      return (rc);
+
+   pFileMap->Pin(pageNum);
+   pPageBuf = pFileMap->Page(pageNum);
+   slot = INVALID_SLOT;
+   return (0);
+}
+
+//
+// IsMappedPin
+//
+// Desc: Internal.  Return TRUE if pageNum is pinned in the mapping of the
+//       file, FALSE otherwise
+// In:   pageNum - page number to test
+// Ret:  TRUE or FALSE
+//
+int PF_FileHandle::IsMappedPin(PageNum pageNum) const
+{
+   return (pFileMap != NULL &&
+         pFileMap->Covers(pageNum) &&
+         pFileMap->IsPinned(pageNum));
+}
+
+//
+// PinNextUsedPage
+//
+// Desc: Internal.  Pin the next (step 1) or prev (step -1) valid page
+//       from current.  current can refer to a page that has been
+//       disposed; it can also be -1 when going forward and hdr.numPages
+//       when going backward.
+// In:   current - page number to start from
+//       step - 1 or -1
+//       hint - passed on to the buffer manager
+// Out:  current - number of the page found
+//       pPageBuf - address of the page (including PF_PageHdr) in the buffer
+//       slot - buffer slot of the page
+// Ret:  PF_EOF, or another PF return code
+//
+RC PF_FileHandle::PinNextUsedPage(PageNum &current, int step,
+      char *&pPageBuf, int &slot, ClientHint hint) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number (note that the position before the first page
+   // in the direction of the scan is acceptable here, and so are free
+   // and directory pages)
+   if (current != (step > 0 ? -1 : hdr.numPages) &&
+         (current < 0 || current >= hdr.numPages))
+      return (PF_INVALIDPAGE);
+
+   // Going forward from a page of the file is a scan; let the buffer
+   // manager read ahead from the next page on
+   if (step > 0 && current >= 0)
+      pBufferMgr->HintSequential(unixfd, current + 1);
+
+   // Find the next used page in the page map, skipping free pages
+   // without reading them
+   current = pPageMap->NextUsed(current, step, hdr.numPages);
+   if (current < 0 || current >= hdr.numPages)
+      return (PF_EOF);
+
+   return (PinUsedPage(current, pPageBuf, slot, hint));
+}
 
-      // Allocate a new page in the file
-      if ((rc = pBufferMgr->AllocatePage(unixfd,
-            pageNum,
-            &pPageBuf)))
+//
+// PinNewPage
+//
+// Desc: Internal.  Allocate a new page in the file (may get a page which
+//       was previously disposed) and pin it.  The page data is zeroed.
+// Out:  pageNum - number of the new page
+//       pPageBuf - address of the page (including PF_PageHdr) in the buffer
+//       slot - buffer slot of the page
+// Ret:  PF return code
+//
+RC PF_FileHandle::PinNewPage(PageNum &pageNum, char *&pPageBuf, int &slot)
+{
+   int     rc;               // return code
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Take the lowest free page.  If there is none, the file grows by a
+   // page: the next one the file has on disk, after another extent is
+   // allocated if there is none left.
+   pageNum = pPageMap->FindFree(hdr.numPages);
+   if (pageNum == hdr.numPages) {
+      if ((rc = CoverPages(1)) ||
+            (hdr.numReserved == 0 && (rc = ReserveExtent())))
          return (rc);
+      pageNum = hdr.numPages;
+   }
+
+   // Get a buffer frame for the page.  What a free page holds is of no
+   // use, so it is not read, unless the buffer still has it.
+   if ((rc = pBufferMgr->AllocatePage(unixfd, pageNum, &pPageBuf, &slot))
+         == PF_PAGEINBUF)
+      rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, &slot);
+   if (rc)
+      return (rc);
 
-      // Increment the number of pages for this file
+   // Increment the number of pages for this file if it grew
+   if (pageNum == hdr.numPages) {
       hdr.numPages++;
+      if (hdr.numReserved > 0)
+         hdr.numReserved--;
+      bHdrChanged = TRUE;
    }
-
-   // Mark the header as changed
-   bHdrChanged = TRUE;
+   pPageMap->SetUsed(pageNum, TRUE);
 
    // Mark this page as used
    ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
 
    // Zero out the page data
-   memset(pPageBuf + sizeof(PF_PageHdr), 0, PF_PAGE_SIZE);
+   memset(pPageBuf + sizeof(PF_PageHdr), 0,
+         hdr.pageBytes - sizeof(PF_PageHdr));
 
    // Mark the page dirty because we changed the next pointer
-   if ((rc = MarkDirty(pageNum)))
-      return (rc);
-
-   // Set the pageHandle local variables
-   pageHandle.pageNum = pageNum;
-   pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
-
-   // Return ok
-   return (0);
+   return (pBufferMgr->MarkSlotDirty(slot));
 }
 
 //
@@ -311,14 +549,14 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
 // Desc: Dispose of a page
 //       The file handle must refer to an open file
 //       PF_PageHandle objects referring to this page should not be used
-//       after making this call.
+//       after making this call.  The page is only marked free in the
+//       page map; it is neither read nor written.
 // In:   pageNum - number of page to dispose
 // Ret:  PF return code
 //
 RC PF_FileHandle::DisposePage(PageNum pageNum)
 {
    int     rc;               // return code
-   char    *pPageBuf;        // address of page in buffer pool
 
    // File must be open
    if (!bFileOpen)
@@ -328,36 +566,20 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
-   // Get the page (but don't re-pin it if it's already pinned)
-   if ((rc = pBufferMgr->GetPage(unixfd,
-         pageNum,
-         &pPageBuf,
-         FALSE)))
-      return (rc);
-
-   // Page must be valid (used)，否则是在释放一个已经释放的page
-   if (((PF_PageHdr *)pPageBuf)->nextFree != PF_PAGE_USED) {
-
-      // Unpin the page
-      if ((rc = UnpinPage(pageNum)))
-         return (rc);
+   // A page read through the mapping of the file is pinned, too
+   if (IsMappedPin(pageNum))
+      return (PF_PAGEPINNED);
 
-      // Return page already free
+   // Page must be used，否则是在释放一个已经释放的page
+   if (!pPageMap->IsUsed(pageNum))
       return (PF_PAGEFREE);
-   }
 
-   // Put this page onto the free list
-   ((PF_PageHdr *)pPageBuf)->nextFree = hdr.firstFree;
-   hdr.firstFree = pageNum;
-   bHdrChanged = TRUE;
-
-   // Mark the page dirty because we changed the next pointer
-   if ((rc = MarkDirty(pageNum)))
+   // Drop the page from the buffer unwritten; it must not be pinned
+   if ((rc = pBufferMgr->DiscardPage(unixfd, pageNum)))
       return (rc);
 
-   // Unpin the page
-   if ((rc = UnpinPage(pageNum)))
-      return (rc);
+   // Mark the page free in the page map
+   pPageMap->SetUsed(pageNum, FALSE);
 
    // Return ok
    return (0);
@@ -371,7 +593,8 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
 //       the page buffer
 //       The file handle must refer to an open file
 // In:   pageNum - number of page to mark dirty
-// Ret:  PF return code
+// Ret:  PF_MAPPEDPAGE if the page is pinned in the mapping of the file,
+//       or another PF return code
 //
 RC PF_FileHandle::MarkDirty(PageNum pageNum) const
 {
@@ -383,6 +606,10 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   // A page pinned in the mapping of the file cannot be changed
+   if (IsMappedPin(pageNum))
+      return (PF_MAPPEDPAGE);
+
    // Tell the buffer manager to mark the page dirty
    return (pBufferMgr->MarkDirty(unixfd, pageNum));
 }
@@ -408,10 +635,52 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   // The page may be pinned in the mapping of the file
+   if (IsMappedPin(pageNum))
+      return (pFileMap->Unpin(pageNum));
+
    // Tell the buffer manager to unpin the page
    return (pBufferMgr->UnpinPage(unixfd, pageNum));
 }
 
+//
+// ReserveExtent
+//
+// Desc: Internal.  Allocate pages after the last page of the file on
+//       disk, so that the file grows in large contiguous pieces with one
+//       metadata update each instead of a page at a time as pages get
+//       written.  An extent is extentPages pages, or half the pages the
+//       file has if that is more, up to PF_MAX_EXTENT_BYTES; growing
+//       extents keep a large file in few pieces even when other files
+//       grow at the same time.  The pages are counted in hdr.numReserved
+//       until AllocatePage hands them out.  On a file system that cannot
+//       preallocate, nothing is reserved and the file grows as pages are
+//       written.
+// Ret:  PF_UNIX if the space cannot be allocated, 0 otherwise
+//
+RC PF_FileHandle::ReserveExtent()
+{
+   if (extentPages <= 1)
+      return (0);
+
+   int numPages = std::max(extentPages,
+         std::min(hdr.numPages / 2, PF_MAX_EXTENT_BYTES / hdr.pageBytes));
+   off_t offset = PF_FILE_HDR_SIZE + (off_t)hdr.numPages * hdr.pageBytes;
+   if (fallocate(unixfd, 0, offset, (off_t)numPages * hdr.pageBytes) < 0) {
+      if (errno == EOPNOTSUPP || errno == ENOSYS)
+         return (0);
+      return (PF_UNIX);
+   }
+
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_EXTENTS);
+#endif
+
+   hdr.numReserved = numPages;
+   bHdrChanged = TRUE;
+   return (0);
+}
+
 //
 // FlushPages
 //
@@ -422,31 +691,15 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
 //
 RC PF_FileHandle::FlushPages() const
 {
+   RC rc;
+
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
    // If the file header has changed, write it back to the file
-   if (bHdrChanged) {
-
-      // First seek to the appropriate place
-      if (lseek(unixfd, 0, L_SET) < 0)
-         return (PF_UNIX);
-
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
-
-      // This function is declared const, but we need to change the
-      // bHdrChanged variable.  Cast away the constness
-      PF_FileHandle *dummy = (PF_FileHandle *)this;
-      dummy->bHdrChanged = FALSE;
-   }
+   if ((rc = WriteHdr()))
+      return (rc);
 
    // Tell Buffer Manager to flush pages
    return (pBufferMgr->FlushPages(unixfd));
@@ -464,42 +717,222 @@ RC PF_FileHandle::FlushPages() const
 //
 RC PF_FileHandle::ForcePages(PageNum pageNum) const
 {
+   RC rc;
+
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
    // If the file header has changed, write it back to the file
-   if (bHdrChanged) {
-
-      // First seek to the appropriate place
-      if (lseek(unixfd, 0, L_SET) < 0)
-         return (PF_UNIX);
-
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
-
-      // This function is declared const, but we need to change the
-      // bHdrChanged variable.  Cast away the constness
-      PF_FileHandle *dummy = (PF_FileHandle *)this;
-      dummy->bHdrChanged = FALSE;
-   }
+   if ((rc = WriteHdr()))
+      return (rc);
 
    // Tell Buffer Manager to Force the page
    return (pBufferMgr->ForcePages(unixfd, pageNum));
 }
 
+//
+// PrefetchPages
+//
+// Desc: Read pages of the file into the buffer pool without pinning them.
+//       All the reads are issued together, so with an asynchronous I/O
+//       engine they are in flight at the same time.  Useful before
+//       fetching a batch of records whose RIDs are known.
+// In:   pageNums - pages to read, in any order; invalid and free ones
+//       are skipped
+//       numPages - number of entries in pageNums
+// Ret:  PF return code
+//
+RC PF_FileHandle::PrefetchPages(const PageNum *pageNums, int numPages) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   PageNum *valid = new PageNum[numPages];
+   int numValid = 0;
+   for (int i = 0; i < numPages; i++)
+      if (IsValidPageNum(pageNums[i]) && pPageMap->IsUsed(pageNums[i]))
+         valid[numValid++] = pageNums[i];
+
+   RC rc = pBufferMgr->PrefetchPages(unixfd, valid, numValid);
+   delete [] valid;
+   return (rc);
+}
+
+//
+// WriteHdr
+//
+// Desc: Internal.  Write the file header back if it or the page map bits
+//       it holds have changed.  The changed directory pages of the page
+//       map are put into the buffer, to be written with the other pages.
+// Ret:  PF return code
+//
+RC PF_FileHandle::WriteHdr() const
+{
+   RC rc;
+
+   if ((rc = WriteDirPages()))
+      return (rc);
+
+   if (!bHdrChanged && !pPageMap->IsDirty(0))
+      return (0);
+
+   // This function is declared const, but we need to change the
+   // bHdrChanged variable.  Cast away the constness
+   PF_FileHandle *dummy = (PF_FileHandle *)this;
+   dummy->hdr.firstDir = (pPageMap->NumDirs() > 0) ? pPageMap->Dir(0) :
+         PF_PAGE_LIST_END;
+
+   char hdrBuf[PF_FILE_HDR_SIZE];
+   memset(hdrBuf, 0, PF_FILE_HDR_SIZE);
+   memcpy(hdrBuf, &hdr, sizeof(PF_FileHdr));
+   pPageMap->Store(0, hdrBuf + PF_HDR_MAP_OFFSET);
+
+   if ((rc = pBufferMgr->WriteFileHdr(unixfd, hdrBuf, PF_FILE_HDR_SIZE)))
+      return (rc);
+
+   dummy->bHdrChanged = FALSE;
+   pPageMap->SetClean(0);
+   return (0);
+}
+
+//
+// WriteDirPages
+//
+// Desc: Internal.  Copy the page map bits of the directory pages that
+//       changed into their pages in the buffer, and mark those dirty.
+//       A directory page is rewritten whole, so it is not read first.
+// Ret:  PF return code
+//
+RC PF_FileHandle::WriteDirPages() const
+{
+   RC   rc;
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   for (int i = 0; i < pPageMap->NumDirs(); i++) {
+      if (!pPageMap->IsDirty(i + 1))
+         continue;
+
+      PageNum pageNum = pPageMap->Dir(i);
+      if ((rc = pBufferMgr->AllocatePage(unixfd, pageNum, &pPageBuf, &slot))
+            == PF_PAGEINBUF)
+         rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, &slot);
+      if (rc)
+         return (rc);
+
+      memset(pPageBuf, 0, hdr.pageBytes);
+      ((PF_PageHdr *)pPageBuf)->nextFree = (i + 1 < pPageMap->NumDirs()) ?
+            pPageMap->Dir(i + 1) : PF_PAGE_LIST_END;
+      pPageMap->Store(i + 1, pPageBuf + sizeof(PF_PageHdr));
+
+      if ((rc = pBufferMgr->MarkSlotDirty(slot)) ||
+            (rc = pBufferMgr->UnpinSlot(slot)))
+         return (rc);
+      pPageMap->SetClean(i + 1);
+   }
+
+   return (0);
+}
+
+//
+// ReadPageMap
+//
+// Desc: Internal.  Fill the page map of a file that was just opened from
+//       the header page and the directory pages.  A file made before
+//       there was a page map has its free list walked instead, once; the
+//       page map replaces it when the header is next written.
+// In:   hdrBuf - the file header page
+// Ret:  PF return code
+//
+RC PF_FileHandle::ReadPageMap(const char *hdrBuf)
+{
+   RC   rc;
+   char *pPageBuf;        // address of page in buffer pool
+   int  slot;             // buffer slot of the page
+
+   if (hdr.bPageMap) {
+      pPageMap->Load(0, hdrBuf + PF_HDR_MAP_OFFSET);
+
+      for (PageNum pageNum = hdr.firstDir; pageNum != PF_PAGE_LIST_END;) {
+         if (pageNum < 0 || pageNum >= hdr.numPages)
+            return (PF_INVALIDPAGE);
+         if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE,
+               &slot)))
+            return (rc);
+
+         pPageMap->AddDir(pageNum);
+         pPageMap->Load(pPageMap->NumDirs(), pPageBuf + sizeof(PF_PageHdr));
+         pageNum = ((PF_PageHdr *)pPageBuf)->nextFree;
+
+         if ((rc = pBufferMgr->UnpinSlot(slot)))
+            return (rc);
+      }
+
+      for (int group = 0; group <= pPageMap->NumDirs(); group++)
+         pPageMap->SetClean(group);
+      return (0);
+   }
+
+   // Every page is used, except for those on the free list
+   for (PageNum pageNum = 0; pageNum < hdr.numPages; pageNum++)
+      pPageMap->SetUsed(pageNum, TRUE);
+   for (PageNum pageNum = hdr.firstFree; pageNum != PF_PAGE_LIST_END;) {
+      if (pageNum < 0 || pageNum >= hdr.numPages)
+         return (PF_INVALIDPAGE);
+      if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE,
+            &slot)))
+         return (rc);
+
+      pPageMap->SetUsed(pageNum, FALSE);
+      pageNum = ((PF_PageHdr *)pPageBuf)->nextFree;
+
+      if ((rc = pBufferMgr->UnpinSlot(slot)))
+         return (rc);
+   }
+
+   hdr.firstFree = PF_PAGE_LIST_END;
+   hdr.bPageMap = TRUE;
+   bHdrChanged = TRUE;
+   return (CoverPages(0));
+}
+
+//
+// CoverPages
+//
+// Desc: Internal.  Add directory pages to the page map until it holds
+//       the bits of the pages of the file and of numNew pages more.  A
+//       directory page is taken like any new page, a free one first.
+// In:   numNew - # of pages the file is about to grow by
+// Ret:  PF return code
+//
+RC PF_FileHandle::CoverPages(int numNew)
+{
+   RC rc;
+
+   while (pPageMap->NumDirs() < pPageMap->DirsNeeded(hdr.numPages + numNew)) {
+      PageNum pageNum = pPageMap->FindFree(hdr.numPages);
+      if (pageNum == hdr.numPages) {
+         if (hdr.numReserved == 0 && (rc = ReserveExtent()))
+            return (rc);
+         hdr.numPages++;
+         if (hdr.numReserved > 0)
+            hdr.numReserved--;
+      }
+      pPageMap->AddDir(pageNum);
+      bHdrChanged = TRUE;
+   }
+
+   return (0);
+}
 
 //
 // IsValidPageNum
 //
 // Desc: Internal.  Return TRUE if pageNum is a valid page number
-//       in the file, FALSE otherwise
+//       in the file, FALSE otherwise.  Directory pages of the page map
+//       are not.
 // In:   pageNum - page number to test
 // Ret:  TRUE or FALSE
 //
@@ -507,6 +940,7 @@ int PF_FileHandle::IsValidPageNum(PageNum pageNum) const
 {
    return (bFileOpen &&
          pageNum >= 0 &&
-         pageNum < hdr.numPages);
+         pageNum < hdr.numPages &&
+         !pPageMap->IsDir(pageNum));
 }
 
@@ -0,0 +1,134 @@
+//
+// File:        pf_filemap.cc
+// Description: PF_FileMap class implementation
+//
+
+#include <sys/mman.h>
+#include "pf_filemap.h"
+
+#ifdef PF_STATS
+#include "statistics.h"
+
+// This is defined within pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
+//
+// PF_FileMap
+//
+// Desc: Constructor.  Nothing is mapped until Map() is called.
+//
+PF_FileMap::PF_FileMap()
+{
+   pBase = NULL;
+   length = 0;
+   numPages = 0;
+   pageSize = 0;
+   pins = NULL;
+}
+
+//
+// ~PF_FileMap
+//
+// Desc: Destructor.  Removes the mapping, pinned pages or not.
+//
+PF_FileMap::~PF_FileMap()
+{
+   if (pBase != NULL)
+      munmap(pBase, length);
+   delete [] pins;
+}
+
+//
+// Map
+//
+// Desc: Map the file header and the first numPages pages of the file
+//       read-only.  The mapping is shared, so it sees every page the
+//       buffer manager writes back to the file.
+// In:   fd - OS file descriptor of the file
+//       numPages - # of pages to map
+//       pageSize - size of a page, including its PF_PageHdr
+// Ret:  PF_UNIX if the file cannot be mapped, or another PF return code
+//
+RC PF_FileMap::Map(int fd, int _numPages, int _pageSize)
+{
+   RC rc;
+
+   if ((rc = Unmap()))
+      return (rc);
+
+   // An empty file has nothing to map
+   if (_numPages == 0)
+      return (0);
+
+   length = PF_FILE_HDR_SIZE + (long)_numPages * _pageSize;
+   void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+   if (p == MAP_FAILED) {
+      length = 0;
+      return (PF_UNIX);
+   }
+
+   pBase = (char *)p;
+   numPages = _numPages;
+   pageSize = _pageSize;
+   pins = new std::atomic<int>[numPages];
+   for (int i = 0; i < numPages; i++)
+      pins[i] = 0;
+   return (0);
+}
+
+//
+// Unmap
+//
+// Desc: Remove the mapping.  Nothing is done if a page is still pinned.
+// Ret:  PF_PAGEPINNED if a page is pinned, 0 otherwise
+//
+RC PF_FileMap::Unmap()
+{
+   for (int i = 0; i < numPages; i++)
+      if (IsPinned(i))
+         return (PF_PAGEPINNED);
+
+   if (pBase != NULL && munmap(pBase, length) < 0)
+      return (PF_UNIX);
+
+   delete [] pins;
+   pBase = NULL;
+   length = 0;
+   numPages = 0;
+   pins = NULL;
+   return (0);
+}
+
+//
+// Pin
+//
+// Desc: Count a pin on a page of the mapping
+// In:   pageNum - page pinned; must be inside the mapping
+//
+void PF_FileMap::Pin(PageNum pageNum)
+{
+#ifdef PF_STATS
+   pStatisticsMgr->Add(PF_STAT_MAPPEDPINS);
+#endif
+
+   pins[pageNum]++;
+}
+
+//
+// Unpin
+//
+// Desc: Drop a pin on a page of the mapping
+// In:   pageNum - page to unpin; must be inside the mapping
+// Ret:  PF_PAGEUNPINNED if the page is not pinned, 0 otherwise
+//
+RC PF_FileMap::Unpin(PageNum pageNum)
+{
+   int count = pins[pageNum].load();
+   do {
+      if (count == 0)
+         return (PF_PAGEUNPINNED);
+   } while (!pins[pageNum].compare_exchange_weak(count, count - 1));
+
+   return (0);
+}
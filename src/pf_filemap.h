@@ -0,0 +1,51 @@
+//
+// File:        pf_filemap.h
+// Description: Read-only memory mapping of a PF file
+//
+// A file opened with PF_OPEN_MMAP is mapped in full when it is opened.
+// Its pages are then read straight from the OS page cache through the
+// mapping instead of being copied into buffer frames.  The mapping only
+// counts the pins on each page, so that a page cannot be disposed of, or
+// the file closed, while a client still points into it.  The mapping
+// covers the pages the file had when it was opened; pages allocated
+// later live in the buffer pool only.
+//
+
+#ifndef PF_FILEMAP_H
+#define PF_FILEMAP_H
+
+#include <atomic>
+#include "pf_internal.h"
+
+class PF_FileMap {
+public:
+    PF_FileMap  ();
+    ~PF_FileMap ();                              // Unmaps the file
+
+    // Map the first numPages pages of the file
+    RC   Map      (int fd, int numPages, int pageSize);
+    // Remove the mapping; PF_PAGEPINNED if a page is still pinned
+    RC   Unmap    ();
+
+    // TRUE if pageNum is inside the mapping
+    int  Covers   (PageNum pageNum) const
+        { return (pageNum >= 0 && pageNum < numPages); }
+
+    // Address of the page (including its PF_PageHdr) in the mapping
+    char *Page    (PageNum pageNum) const
+        { return (pBase + PF_FILE_HDR_SIZE + (long)pageNum * pageSize); }
+
+    void Pin      (PageNum pageNum);             // Count a pin
+    RC   Unpin    (PageNum pageNum);             // Drop a pin
+    int  IsPinned (PageNum pageNum) const        // TRUE if pinned
+        { return (pins[pageNum].load() > 0); }
+
+private:
+    char             *pBase;                     // start of the mapping
+    long             length;                     // bytes mapped
+    int              numPages;                   // pages mapped
+    int              pageSize;                   // bytes per page
+    std::atomic<int> *pins;                      // pin count of each page
+};
+
+#endif
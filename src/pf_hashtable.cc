@@ -8,24 +8,40 @@
 #include "pf_internal.h"
 #include "pf_hashtable.h"
 
+#define EMPTY_ENTRY  (-1)
+
+//
+// Capacity
+//
+// Desc: Smallest power of two that keeps n entries at most half full
+//
+static unsigned int Capacity(int n)
+{
+  unsigned int capacity = 16;
+  while (capacity < 2 * (unsigned int)n)
+    capacity <<= 1;
+  return (capacity);
+}
+
 //
 // PF_HashTable
 //
 // Desc: Constructor for PF_HashTable object, which allows search, insert,
 //       and delete of hash table entries.
-// In:   numBuckets - number of hash table buckets
+// In:   _numEntries - number of entries the table should hold without
+//                     growing (normally the number of buffer pages)
 //
-PF_HashTable::PF_HashTable(int _numBuckets)
+PF_HashTable::PF_HashTable(int _numEntries)
 {
-  // Initialize numBuckets local variable from parameter
-  this->numBuckets = _numBuckets;
+  unsigned int capacity = Capacity(_numEntries);
 
-  // Allocate memory for hash table
-  hashTable = new PF_HashEntry* [numBuckets];
+  numEntries = 0;
+  mask = capacity - 1;
 
-  // Initialize all buckets to empty
-  for (int i = 0; i < numBuckets; i++)
-    hashTable[i] = NULL;
+  // Allocate memory for hash table and mark all entries empty
+  hashTable = new PF_HashEntry[capacity];
+  for (unsigned int i = 0; i < capacity; i++)
+    hashTable[i].slot = EMPTY_ENTRY;
 }
 
 //
@@ -35,22 +51,27 @@ PF_HashTable::PF_HashTable(int _numBuckets)
 //
 PF_HashTable::~PF_HashTable()
 {
-  // Clear out all buckets
-  for (int i = 0; i < numBuckets; i++) {
-
-    // Delete all entries in the bucket
-    PF_HashEntry *entry = hashTable[i];
-    while (entry != NULL) {
-      PF_HashEntry *next = entry->next;
-      delete entry;
-      entry = next;
-    }
-  }
-
-  // Finally delete the hash table
   delete[] hashTable;
 }
 
+//
+// Probe
+//
+// Desc: Internal.  Walk the probe sequence of (fd, pageNum).
+// Ret:  index of the entry holding the key, or of the first empty entry
+//       if the key is not in the table
+//
+int PF_HashTable::Probe(int fd, PageNum pageNum) const
+{
+  unsigned int i = Hash(fd, pageNum);
+
+  while (hashTable[i].slot != EMPTY_ENTRY &&
+         (hashTable[i].fd != fd || hashTable[i].pageNum != pageNum))
+    i = (i + 1) & mask;
+
+  return (i);
+}
+
 //
 // Find
 //
@@ -62,32 +83,22 @@ PF_HashTable::~PF_HashTable()
 //
 RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  if (bucket<0)
-     return (PF_HASHNOTFOUND);
-
-  // Go through the linked list of this bucket
-  for (PF_HashEntry *entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum) {
-
-      // Found it
-      slot = entry->slot;
-      return (0);
-    }
-  }
+  int i = Probe(fd, pageNum);
 
   // Didn't find it
-  return (PF_HASHNOTFOUND);
+  if (hashTable[i].slot == EMPTY_ENTRY)
+    return (PF_HASHNOTFOUND);
+
+  // Found it
+  slot = hashTable[i].slot;
+  return (0);
 }
 
 //
 // Insert
 //
-// Desc: Insert a hash table entry
+// Desc: Insert a hash table entry.  The table only grows (and allocates)
+//       if it holds more entries than it was sized for.
 // In:   fd - file descriptor
 //       pagenum - page number
 //       slot - slot associated with fd and pageNum
@@ -95,31 +106,23 @@ RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 //
 RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  // Check entry doesn't already exist in the bucket
-  PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum)
-      return (PF_HASHPAGEEXIST);
-  }
+  RC rc;
 
-  // Allocate memory for new hash entry
-  if ((entry = new PF_HashEntry) == NULL)
-    return (PF_NOMEM);
+  // Keep the table at most half full
+  if (2 * (unsigned int)(numEntries + 1) > mask + 1 &&
+      (rc = Resize(numEntries + 1)))
+    return (rc);
+
+  // Check entry doesn't already exist
+  int i = Probe(fd, pageNum);
+  if (hashTable[i].slot != EMPTY_ENTRY)
+    return (PF_HASHPAGEEXIST);
 
-  // Insert entry at head of list for this bucket
-  entry->fd = fd;
-  entry->pageNum = pageNum;
-  entry->slot = slot;
-  entry->next = hashTable[bucket];
-  entry->prev = NULL;
-  if (hashTable[bucket] != NULL)
-    hashTable[bucket]->prev = entry;
-  hashTable[bucket] = entry;
+  // Fill the empty entry that ended the probe sequence
+  hashTable[i].fd = fd;
+  hashTable[i].pageNum = pageNum;
+  hashTable[i].slot = slot;
+  numEntries++;
 
   // Return ok
   return (0);
@@ -128,40 +131,80 @@ RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 //
 // Delete
 //
-// Desc: Delete a hash table entry
+// Desc: Delete a hash table entry.  Entries further along the same probe
+//       run are shifted back into the hole so that lookups can keep
+//       stopping at the first empty entry.
 // In:   fd - file descriptor
 //       pagenum - page number
 // Ret:  PF return code
 //
 RC PF_HashTable::Delete(int fd, PageNum pageNum)
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  // Find the entry is in this bucket
-  PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum)
-      break;
-  }
+  unsigned int hole = Probe(fd, pageNum);
 
   // Did we find hash entry?
-  if (entry == NULL)
+  if (hashTable[hole].slot == EMPTY_ENTRY)
     return (PF_HASHNOTFOUND);
 
-  // Remove this entry
-  if (entry == hashTable[bucket])
-    hashTable[bucket] = entry->next;
-  if (entry->prev != NULL)
-    entry->prev->next = entry->next;
-  if (entry->next != NULL)
-    entry->next->prev = entry->prev;
-  delete entry;
+  // Move back every following entry whose home position does not lie
+  // (cyclically) between the hole and its current position
+  for (unsigned int i = (hole + 1) & mask;
+       hashTable[i].slot != EMPTY_ENTRY;
+       i = (i + 1) & mask) {
+    unsigned int home = Hash(hashTable[i].fd, hashTable[i].pageNum);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      hashTable[hole] = hashTable[i];
+      hole = i;
+    }
+  }
+  hashTable[hole].slot = EMPTY_ENTRY;
+  numEntries--;
 
-  // Return ook
+  // Return ok
   return (0);
 }
 
+//
+// Resize
+//
+// Desc: Size the table for _numEntries entries (at least the number of
+//       entries it currently holds) and rehash the existing entries.
+//       Called by the buffer manager whenever the buffer is resized.
+// In:   _numEntries - number of entries to hold without growing
+// Ret:  PF return code
+//
+RC PF_HashTable::Resize(int _numEntries)
+{
+  if (_numEntries < numEntries)
+    _numEntries = numEntries;
+
+  unsigned int capacity = Capacity(_numEntries);
+  if (capacity == mask + 1)
+    return (0);
+
+  PF_HashEntry *pOldTable = hashTable;
+  unsigned int oldCapacity = mask + 1;
+
+  if ((hashTable = new PF_HashEntry[capacity]) == NULL) {
+    hashTable = pOldTable;
+    return (PF_NOMEM);
+  }
+  mask = capacity - 1;
+  for (unsigned int i = 0; i < capacity; i++)
+    hashTable[i].slot = EMPTY_ENTRY;
+
+  // Reinsert the old entries (no duplicates, so no need to compare keys)
+  for (unsigned int j = 0; j < oldCapacity; j++) {
+    if (pOldTable[j].slot == EMPTY_ENTRY)
+      continue;
+    unsigned int i = Hash(pOldTable[j].fd, pOldTable[j].pageNum);
+    while (hashTable[i].slot != EMPTY_ENTRY)
+      i = (i + 1) & mask;
+    hashTable[i] = pOldTable[j];
+  }
+
+  delete[] pOldTable;
 
+  // Return ok
+  return (0);
+}
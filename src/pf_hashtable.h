@@ -4,6 +4,12 @@
 // Authors:     Hugo Rivero (rivero@cs.stanford.edu)
 //              Dallan Quass (quass@cs.stanford.edu)
 //
+// The table maps (fd, pageNum) to a buffer slot.  It uses open addressing
+// with linear probing over a flat array whose size is a power of two kept
+// at least twice the number of entries, so a lookup normally touches a
+// single cache line and inserts do not allocate.  Deletion shifts the
+// following entries back instead of leaving tombstones.
+//
 
 #ifndef PF_HASHTABLE_H
 #define PF_HASHTABLE_H
@@ -11,14 +17,12 @@
 #include "pf_internal.h"
 
 //
-// HashEntry - Hash table bucket entries
+// HashEntry - Hash table entries
 //
 struct PF_HashEntry {
-    PF_HashEntry *next;   // next hash table element or NULL
-    PF_HashEntry *prev;   // prev hash table element or NULL
     int          fd;      // file descriptor
     PageNum      pageNum; // page number
-    int          slot;    // slot of this page in the buffer
+    int          slot;    // slot of this page in the buffer, -1 if empty
 };
 
 //
@@ -26,7 +30,7 @@ struct PF_HashEntry {
 //
 class PF_HashTable {
 public:
-    PF_HashTable (int numBuckets);           // Constructor
+    PF_HashTable (int numEntries);           // Constructor
     ~PF_HashTable();                         // Destructor
     RC  Find     (int fd, PageNum pageNum, int &slot);
                                              // Set slot to the hash table
@@ -35,11 +39,29 @@ public:
                                              // Insert a hash table entry
     RC  Delete   (int fd, PageNum pageNum);  // Delete a hash table entry
 
+    // Size the table for numEntries entries, rehashing the current ones
+    RC  Resize   (int numEntries);
+
 private:
-    int Hash     (int fd, PageNum pageNum) const
-      { return ((fd + pageNum) % numBuckets); }   // Hash function
-    int numBuckets;                               // Number of hash table buckets
-    PF_HashEntry **hashTable;                     // Hash table
+    unsigned int Hash(int fd, PageNum pageNum) const
+    {
+        // Murmur3 finalizer over the 64-bit key: consecutive page numbers
+        // and small fds spread over the whole table
+        unsigned long long k = ((unsigned long long)(unsigned int)fd << 32) |
+                               (unsigned int)pageNum;
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return ((unsigned int)k & mask);
+    }
+    int Probe    (int fd, PageNum pageNum) const;  // position of the key or
+                                                   // of the empty entry that
+                                                   // ends its probe sequence
+    int numEntries;                               // # of entries in use
+    unsigned int mask;                            // capacity - 1
+    PF_HashEntry *hashTable;                      // Hash table
 };
 
 #endif
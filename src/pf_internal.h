@@ -17,7 +17,24 @@
 // Constants and defines
 //
 const int PF_BUFFER_SIZE = 40;     // Number of pages in the buffer
-const int PF_HASH_TBL_SIZE = 20;   // Size of hash table
+const int PF_CATALOG_POOL_PAGES = 16; // Default pages of the catalog pool
+const int PF_INDEX_POOL_PAGES = 40;   // Default pages of the index pool
+const int PF_TEMP_POOL_PAGES = 16;    // Default pages of the temp pool
+const int PF_HASH_TBL_SIZE = 20;   // Default # of hash table entries
+const int PF_CLOCK_MAX_USAGE = 5;  // Usage count cap of the CLOCK policy
+const int PF_READAHEAD_PAGES = 8;  // Default read-ahead window in pages
+const int PF_FRAME_ALIGN = 4096;   // Alignment of buffer frames
+const long PF_HUGE_PAGE_SIZE = 2 << 20; // Huge page size for the arena
+const int PF_WRITER_TICK_MS = 10;  // Background writer wakes up this often
+const int PF_WRITER_BATCH = 64;    // Most pages written per writer round
+const int PF_WRITER_PIN = 1 << 16; // Pin count of the background writer
+const int PF_SHARD_EXTENT = 8;     // Pages kept in a buffer shard together
+const int PF_SHARD_MIN_PAGES = 256;// Fewest pages per buffer shard
+const int PF_MAX_SHARDS = 64;      // Most buffer shards
+const int PF_CLASS_MIN_PAGES = 16; // Fewest pages in the buffer of a
+                                   // page size above PF_MIN_PAGE_BYTES
+const int PF_EXTENT_PAGES = 64;    // Default # of pages a file grows by
+const int PF_MAX_EXTENT_BYTES = 64 << 20; // Largest extent a file grows by
 
 #define CREATION_MASK      0600    // r/w privileges to owner only
 #define PF_PAGE_LIST_END  -1       // end of list of free pages
@@ -38,9 +55,17 @@ struct PF_PageHdr {
                         //  - the number of the next free page
                         //  - PF_PAGE_LIST_END if this is last free page
                         //  - PF_PAGE_USED if the page is not free
+                        // Free pages are only linked in files made before
+                        // the page map; in a directory page of the page
+                        // map it is the next directory page instead.
 };
 
 // Justify the file header to the length of one page
 const int PF_FILE_HDR_SIZE = PF_PAGE_SIZE + sizeof(PF_PageHdr);
 
+// The header page holds PF_FileHdr in its first PF_HDR_MAP_OFFSET bytes and
+// the page map bits of the first PF_HDR_MAP_PAGES pages in the rest
+const int PF_HDR_MAP_OFFSET = 64;
+const int PF_HDR_MAP_PAGES = (PF_FILE_HDR_SIZE - PF_HDR_MAP_OFFSET) * 8;
+
 #endif
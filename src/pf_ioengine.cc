@@ -0,0 +1,248 @@
+//
+// File:        pf_ioengine.cc
+// Description: I/O engines for PF_BufferMgr
+//
+
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "pf_ioengine.h"
+
+// io_uring is used through its system calls, so only the kernel header
+// is needed
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define PF_HAVE_URING
+#endif
+#endif
+
+using namespace std;
+
+const unsigned PF_URING_DEPTH = 64;   // requests in flight at most
+
+//
+// Create
+//
+// Desc: Factory for the engine of a given type
+// In:   type - I/O engine type
+// Ret:  new engine (to be deleted by the caller)
+//
+PF_IOEngine *PF_IOEngine::Create(PF_IOEngineType type)
+{
+   switch (type) {
+      case PF_IO_SYNC:
+         break;
+      case PF_IO_DIRECT:
+         return new PF_DirectIOEngine();
+      case PF_IO_URING: {
+         PF_UringIOEngine *pEngine = new PF_UringIOEngine();
+         if (pEngine->Init(PF_URING_DEPTH))
+            return pEngine;
+         delete pEngine;
+         break;
+      }
+   }
+   return new PF_SyncIOEngine();
+}
+
+//------------------------------------------------------------------------------
+// PF_SyncIOEngine
+//------------------------------------------------------------------------------
+
+RC PF_SyncIOEngine::Run(PF_IORequest *reqs, int numReqs)
+{
+   for (int i = 0; i < numReqs; i++) {
+      PF_IORequest &req = reqs[i];
+      do {
+         if (req.bWrite)
+            req.result = pwritev(req.fd, req.iov, req.iovcnt, req.offset);
+         else
+            req.result = preadv(req.fd, req.iov, req.iovcnt, req.offset);
+      } while (req.result < 0 && errno == EINTR);
+
+      if (req.result < 0)
+         req.result = -errno;
+   }
+   return (0);
+}
+
+//------------------------------------------------------------------------------
+// PF_DirectIOEngine
+//------------------------------------------------------------------------------
+
+int PF_DirectIOEngine::OpenFlags() const
+{
+#ifdef O_DIRECT
+   return (O_DIRECT);
+#else
+   return (0);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// PF_UringIOEngine
+//------------------------------------------------------------------------------
+
+PF_UringIOEngine::PF_UringIOEngine()
+{
+   ringFd = -1;
+   numEntries = 0;
+   sqRing = cqRing = NULL;
+   sqes = NULL;
+   sqRingSize = cqRingSize = sqesSize = 0;
+}
+
+PF_UringIOEngine::~PF_UringIOEngine()
+{
+   if (sqes != NULL)
+      munmap(sqes, sqesSize);
+   if (cqRing != NULL && cqRing != sqRing)
+      munmap(cqRing, cqRingSize);
+   if (sqRing != NULL)
+      munmap(sqRing, sqRingSize);
+   if (ringFd >= 0)
+      close(ringFd);
+}
+
+//
+// Init
+//
+// Desc: Set up the ring and map its queues
+// In:   depth - number of submission queue entries asked for
+// Ret:  TRUE on success, FALSE if io_uring cannot be used
+//
+int PF_UringIOEngine::Init(unsigned depth)
+{
+#ifdef PF_HAVE_URING
+   struct io_uring_params p;
+
+   memset(&p, 0, sizeof(p));
+   if ((ringFd = syscall(__NR_io_uring_setup, depth, &p)) < 0)
+      return (FALSE);
+   numEntries = p.sq_entries;
+
+   sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if (p.features & IORING_FEAT_SINGLE_MMAP)
+      sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+
+   void *pMap = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+   if (pMap == MAP_FAILED)
+      return (FALSE);
+   sqRing = pMap;
+
+   if (p.features & IORING_FEAT_SINGLE_MMAP)
+      cqRing = sqRing;
+   else {
+      pMap = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+      if (pMap == MAP_FAILED)
+         return (FALSE);
+      cqRing = pMap;
+   }
+
+   sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+   pMap = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+   if (pMap == MAP_FAILED)
+      return (FALSE);
+   sqes = (struct io_uring_sqe *)pMap;
+
+   char *sq = (char *)sqRing;
+   sqHead  = (unsigned *)(sq + p.sq_off.head);
+   sqTail  = (unsigned *)(sq + p.sq_off.tail);
+   sqMask  = (unsigned *)(sq + p.sq_off.ring_mask);
+   sqArray = (unsigned *)(sq + p.sq_off.array);
+
+   char *cq = (char *)cqRing;
+   cqHead  = (unsigned *)(cq + p.cq_off.head);
+   cqTail  = (unsigned *)(cq + p.cq_off.tail);
+   cqMask  = (unsigned *)(cq + p.cq_off.ring_mask);
+   cqes    = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+   return (TRUE);
+#else
+   (void)depth;
+   return (FALSE);
+#endif
+}
+
+//
+// Run
+//
+// Desc: Queue as many requests as the ring holds, submit them and wait
+//       for at least one completion with a single io_uring_enter, reap
+//       every completion available, and repeat until all are done.
+// In:   reqs - requests to carry out
+//       numReqs - number of requests
+// Ret:  PF_UNIX if io_uring_enter fails, 0 otherwise
+//
+RC PF_UringIOEngine::Run(PF_IORequest *reqs, int numReqs)
+{
+#ifdef PF_HAVE_URING
+   int      queued = 0;       // requests put on the submission ring
+   int      done = 0;         // requests completed
+   unsigned inFlight = 0;     // requests queued but not completed
+   unsigned unsubmitted = 0;  // requests queued but not yet submitted
+
+   while (done < numReqs) {
+
+      // Fill the submission ring
+      unsigned tail = *sqTail;
+      unsigned toSubmit = 0;
+      while (queued < numReqs && inFlight < numEntries) {
+         PF_IORequest &req = reqs[queued];
+         unsigned index = tail & *sqMask;
+         struct io_uring_sqe *sqe = &sqes[index];
+
+         memset(sqe, 0, sizeof(*sqe));
+         sqe->opcode = req.bWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+         sqe->fd = req.fd;
+         sqe->addr = (unsigned long)req.iov;
+         sqe->len = req.iovcnt;
+         sqe->off = req.offset;
+         sqe->user_data = queued;
+         sqArray[index] = index;
+
+         tail++;
+         queued++;
+         inFlight++;
+         toSubmit++;
+      }
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+      unsubmitted += toSubmit;
+
+      // Submit and wait for a completion
+      int ret;
+      do {
+         ret = syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1,
+               IORING_ENTER_GETEVENTS, NULL, 0);
+      } while (ret < 0 && errno == EINTR);
+      if (ret < 0)
+         return (PF_UNIX);
+      unsubmitted -= ret;
+
+      // Reap the completions
+      unsigned head = *cqHead;
+      while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+         struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+         reqs[cqe->user_data].result = cqe->res;
+         head++;
+         done++;
+         inFlight--;
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+   }
+
+   return (0);
+#else
+   (void)reqs;
+   (void)numReqs;
+   return (PF_UNIX);
+#endif
+}
@@ -0,0 +1,111 @@
+//
+// File:        pf_ioengine.h
+// Description: I/O engines for PF_BufferMgr
+//
+// The buffer manager does not call read(2) and write(2) itself; it hands
+// PF_IORequest objects to a PF_IOEngine.  A request is one positioned,
+// possibly vectored, read or write.  Run() takes any number of requests
+// and returns once all of them are complete, so an engine that can keep
+// several I/Os in flight (io_uring) overlaps them, while the synchronous
+// engines simply issue them one after the other.
+//
+
+#ifndef PF_IOENGINE_H
+#define PF_IOENGINE_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "pf_internal.h"
+
+//
+// PF_IORequest - one read or write of contiguous bytes of a file
+//
+struct PF_IORequest {
+    int          fd;      // file descriptor
+    long         offset;  // file offset of the first byte
+    struct iovec *iov;    // memory to read into or write from
+    int          iovcnt;  // # of entries in iov
+    int          bWrite;  // TRUE for a write, FALSE for a read
+    ssize_t      result;  // set by Run(): bytes transferred, or -errno
+};
+
+//
+// PF_IOEngine - interface for the way pages are moved to and from files
+//
+class PF_IOEngine {
+public:
+    virtual ~PF_IOEngine () {}
+
+    // Flags the engine needs when a PF file is opened
+    virtual int  OpenFlags () const { return (0); }
+
+    // Carry out reqs[0..numReqs-1] and wait until all are done.  Failed
+    // requests report -errno in their result; PF_UNIX is only returned
+    // if the engine itself fails.
+    virtual RC   Run       (PF_IORequest *reqs, int numReqs) = 0;
+
+    virtual const char *Name() const = 0;
+
+    // Create the engine of the given type.  If the system cannot provide
+    // it, the synchronous engine is returned instead.
+    static PF_IOEngine *Create(PF_IOEngineType type);
+};
+
+//
+// PF_SyncIOEngine - blocking preadv/pwritev, one request at a time
+//
+class PF_SyncIOEngine : public PF_IOEngine {
+public:
+    RC   Run       (PF_IORequest *reqs, int numReqs);
+    const char *Name() const { return "pread/pwrite"; }
+};
+
+//
+// PF_DirectIOEngine - like the synchronous engine, on files opened with
+// O_DIRECT so that pages bypass the OS page cache.  The buffer frames are
+// page aligned, and pages and the file header are whole multiples of the
+// block size, which is what O_DIRECT asks for.
+//
+class PF_DirectIOEngine : public PF_SyncIOEngine {
+public:
+    int  OpenFlags () const;
+    const char *Name() const { return "O_DIRECT"; }
+};
+
+//
+// PF_UringIOEngine - io_uring with batched submission
+//
+// All the requests passed to Run() are queued on the submission ring (as
+// many as fit) and submitted with one io_uring_enter call, which then
+// waits for completions; further requests are queued as slots free up.
+//
+class PF_UringIOEngine : public PF_IOEngine {
+public:
+    PF_UringIOEngine ();
+    ~PF_UringIOEngine();
+
+    // Set up a ring of the given depth; return FALSE if io_uring is not
+    // available
+    int  Init      (unsigned depth);
+
+    RC   Run       (PF_IORequest *reqs, int numReqs);
+    const char *Name() const { return "io_uring"; }
+
+private:
+    int      ringFd;                              // io_uring descriptor
+    unsigned numEntries;                          // submission ring size
+
+    // Submission ring
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    struct io_uring_sqe *sqes;
+
+    // Completion ring
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    // Mappings of the rings
+    void     *sqRing, *cqRing;
+    size_t   sqRingSize, cqRingSize, sqesSize;
+};
+
+#endif
@@ -6,38 +6,311 @@
 //
 
 #include <cstdio>
+#include <iostream>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_filemap.h"
+#include "pf_pagemap.h"
+
+//
+// PF_FileTable - the files opened through a PF_Manager
+//
+// Files are told apart by device and inode, since names do not identify
+// them.  Each entry counts the handles open on its file.  Once the last
+// of them is closed the entry may keep the descriptor open and the pages
+// resident (see SetKeepClosed); the descriptor stays taken, so no other
+// file can be mistaken for it.  The latch serializes opening and closing
+// files, the bookkeeping of the warm-up and the calls that change the
+// buffer pools.  The warm-up reads pages without it; meanwhile the file
+// it reads is marked, and opening, closing or destroying that file waits,
+// as does resizing a buffer pool, which moves the pages of every file.
+//
+struct PF_FileEntry {
+   dev_t        dev;
+   ino_t        ino;
+   int          numOpen;       // handles open on the file
+   int          keptFd;        // descriptor kept since the last close, or -1
+   int          openFd;        // descriptor of the first handle open, or -1
+   PF_PoolId    pool;          // pool holding the pages of the file,
+   PF_BufferMgr *pBufferMgr;   //   and its buffer for their size
+   long         lastClose;     // when it was kept; oldest are let go first
+   std::string  fileName;      // name it was last opened by
+};
+
+struct PF_FileTable {
+   PF_FileTable() : maxKept(0), closeClock(0), bStopWarm(FALSE),
+                    bWarming(FALSE) {}
+
+   int  Find   (dev_t dev, ino_t ino) const;   // entry of a file, or -1
+   RC   LetGo  (int e);                         // stop keeping a file
+   RC   Trim   ();                              // keep at most maxKept
+   // wait while the warm-up reads a file, or any file
+   void WaitWarm(std::unique_lock<std::mutex> &guard, dev_t dev, ino_t ino);
+   void WaitWarm(std::unique_lock<std::mutex> &guard);
+
+   std::mutex   latch;
+   std::vector<PF_FileEntry> files;
+   int          maxKept;       // most files kept after their last close
+   long         closeClock;    // counts the files kept
+   std::thread  warmer;        // the warm-up, while it runs
+   std::atomic<int> bStopWarm; // TRUE to end the warm-up early
+   int          bWarming;      // TRUE while the warm-up reads the file
+   dev_t        warmDev;       //   of this device
+   ino_t        warmIno;       //   and inode, without the latch
+   std::condition_variable warmed;   // signalled when it is done
+};
+
+//
+// Find
+//
+// Desc: Entry of a file
+// In:   dev, ino - identity of the file
+// Ret:  index in files, -1 if the file is neither open nor kept
+//
+int PF_FileTable::Find(dev_t dev, ino_t ino) const
+{
+   for (unsigned e = 0; e < files.size(); e++)
+      if (files[e].dev == dev && files[e].ino == ino)
+         return (e);
+   return (-1);
+}
+
+//
+// WaitWarm
+//
+// Desc: Wait until the warm-up is not reading a file
+// In:   guard - holds the latch; it is released while waiting
+//       dev, ino - identity of the file
+//
+void PF_FileTable::WaitWarm(std::unique_lock<std::mutex> &guard, dev_t dev,
+      ino_t ino)
+{
+   warmed.wait(guard, [&]() {
+      return (!bWarming || warmDev != dev || warmIno != ino);
+   });
+}
+
+//
+// WaitWarm
+//
+// Desc: Wait until the warm-up is not reading any file
+// In:   guard - holds the latch; it is released while waiting
+//
+void PF_FileTable::WaitWarm(std::unique_lock<std::mutex> &guard)
+{
+   warmed.wait(guard, [&]() { return (!bWarming); });
+}
+
+//
+// LetGo
+//
+// Desc: Stop keeping a closed file: drop its pages, which are clean, and
+//       close its descriptor.  The entry goes too unless the file is open.
+// In:   e - entry of a kept file
+// Ret:  PF return code
+//
+RC PF_FileTable::LetGo(int e)
+{
+   RC rc;
+   PF_FileEntry &entry = files[e];
+
+   if ((rc = entry.pBufferMgr->FlushPages(entry.keptFd)))
+      return (rc);
+   if (close(entry.keptFd) < 0)
+      return (PF_UNIX);
+   entry.keptFd = -1;
+   if (entry.numOpen == 0)
+      files.erase(files.begin() + e);
+   return (0);
+}
+
+//
+// Trim
+//
+// Desc: Let go of the files kept longest ago until at most maxKept are
+// Ret:  PF return code
+//
+RC PF_FileTable::Trim()
+{
+   RC rc;
+
+   for (;;) {
+      int numKept = 0, oldest = -1;
+      for (unsigned e = 0; e < files.size(); e++)
+         if (files[e].keptFd >= 0) {
+            numKept++;
+            if (oldest < 0 || files[e].lastClose < files[oldest].lastClose)
+               oldest = e;
+         }
+      if (numKept <= maxKept)
+         return (0);
+      if ((rc = LetGo(oldest)))
+         return (rc);
+   }
+}
+
+//
+// PageClass
+//
+// Desc: Index of the buffer pool of a page size
+// In:   pageBytes - bytes per page, PF_PageHdr included
+// Ret:  0 for PF_MIN_PAGE_BYTES, 1 for twice that and so on; -1 if
+//       pageBytes is not a valid page size
+//
+static int PageClass(int pageBytes)
+{
+   int c = 0;
+   for (int bytes = PF_MIN_PAGE_BYTES; bytes <= PF_MAX_PAGE_BYTES;
+         bytes *= 2, c++)
+      if (bytes == pageBytes)
+         return (c);
+   return (-1);
+}
+
+//
+// PoolName
+//
+// Desc: Name of a buffer pool, for messages
+//
+static const char *PoolName(int pool)
+{
+   static const char *names[PF_NUM_POOLS] = {
+      "data", "catalog", "index", "temp"
+   };
+   return (names[pool]);
+}
 
 //
 // PF_Manager
 //
 // Desc: Constructor - intended to be called once at begin of program
 //       Handles creation, deletion, opening and closing of files.
-//       It is associated with a PF_BufferMgr that manages the page
-//       buffer and executes the page replacement policies.
+//       It is associated with a PF_BufferMgr for each pool and page size
+//       in use, which manages the page buffer for files of that pool
+//       with pages of that size and executes the page replacement
+//       policies.  The one of the data pool for pages of
+//       PF_MIN_PAGE_BYTES is created here, the others when a file that
+//       needs them is first opened.
+// In:   policy - page replacement policy of the data pool
+//       ioEngine - I/O engine of the buffer managers
 //
-PF_Manager::PF_Manager()
+PF_Manager::PF_Manager(PF_ReplacePolicy _policy, PF_IOEngineType _ioEngine)
 {
+   ioEngine = _ioEngine;
+   poolPages[PF_POOL_DATA] = PF_BUFFER_SIZE;
+   poolPolicy[PF_POOL_DATA] = _policy;
+   poolPages[PF_POOL_CATALOG] = PF_CATALOG_POOL_PAGES;
+   poolPolicy[PF_POOL_CATALOG] = PF_REPLACE_LRU;
+   poolPages[PF_POOL_INDEX] = PF_INDEX_POOL_PAGES;
+   poolPolicy[PF_POOL_INDEX] = PF_REPLACE_LRUK;
+   poolPages[PF_POOL_TEMP] = PF_TEMP_POOL_PAGES;
+   poolPolicy[PF_POOL_TEMP] = PF_REPLACE_LRU;
+   numShards = 0;
+   readAhead = PF_READAHEAD_PAGES;
+   cleanRatio = 0;
+   maxWritesPerSec = 0;
+   extentPages = PF_EXTENT_PAGES;
+   pFiles = new PF_FileTable;
+
    // Create Buffer Manager
-   pBufferMgr = new PF_BufferMgr(PF_BUFFER_SIZE);
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         pBufferMgrs[p][c] = NULL;
+   pBufferMgrs[PF_POOL_DATA][0] = new PF_BufferMgr(poolPages[PF_POOL_DATA],
+         poolPolicy[PF_POOL_DATA], ioEngine, PF_MIN_PAGE_BYTES);
 }
 
 //
 // ~PF_Manager
 //
 // Desc: Destructor - intended to be called once at end of program
-//       Destroys the buffer manager.
+//       Stops the warm-up, lets go of the kept files and destroys the
+//       buffer managers.
 //       All files are expected to be closed when this method is called.
 //
 PF_Manager::~PF_Manager()
 {
+   pFiles->bStopWarm = TRUE;
+   if (pFiles->warmer.joinable())
+      pFiles->warmer.join();
+   for (int e = pFiles->files.size() - 1; e >= 0; e--)
+      if (pFiles->files[e].keptFd >= 0)
+         pFiles->LetGo(e);
+   delete pFiles;
+
    // Destroy the buffer manager objects
-   delete pBufferMgr;
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         delete pBufferMgrs[p][c];
+}
+
+//
+// ClassPages
+//
+// Desc: Internal.  Size of the buffer of a pool for a page size.  It
+//       holds as many bytes as the pool's buffer of the smallest pages,
+//       but never fewer than PF_CLASS_MIN_PAGES pages.
+// In:   pool - the pool
+//       c - page class, as returned by PageClass
+// Ret:  # of pages
+//
+int PF_Manager::ClassPages(int pool, int c) const
+{
+   if (c == 0)
+      return (poolPages[pool]);
+   return (std::max(poolPages[pool] >> c, PF_CLASS_MIN_PAGES));
+}
+
+//
+// GetBuffer
+//
+// Desc: Internal.  Return the buffer of a pool for pages of the given
+//       size, creating it, with the current settings, if it does not exist
+//       yet.
+// In:   pool - the pool
+//       pageBytes - bytes per page, PF_PageHdr included
+// Out:  pBufferMgr - the buffer manager of that pool and page size
+// Ret:  PF_BADPAGESIZE if pageBytes is not a valid page size, or another
+//       PF return code
+//
+RC PF_Manager::GetBuffer(PF_PoolId pool, int pageBytes,
+      PF_BufferMgr *&pBufferMgr)
+{
+   RC rc;
+   int c = PageClass(pageBytes);
+
+   if (c < 0)
+      return (PF_BADPAGESIZE);
+
+   if (pBufferMgrs[pool][c] == NULL) {
+      int size = ClassPages(pool, c);
+      PF_BufferMgr *pNew = new PF_BufferMgr(size, poolPolicy[pool], ioEngine,
+            pageBytes);
+      if ((numShards && (rc = pNew->ResizeBuffer(size, numShards))) ||
+            (rc = pNew->SetReadAhead(readAhead)) ||
+            (rc = pNew->SetWriterRate(maxWritesPerSec)) ||
+            (rc = pNew->SetWriterTarget(cleanRatio))) {
+         delete pNew;
+         return (rc);
+      }
+      pBufferMgrs[pool][c] = pNew;
+   }
+
+   pBufferMgr = pBufferMgrs[pool][c];
+   return (0);
 }
 
 //
@@ -45,13 +318,18 @@ PF_Manager::~PF_Manager()
 //
 // Desc: Create a new PF file named fileName
 // In:   fileName - name of file to create
-// Ret:  PF return code
+//       pageBytes - bytes per page, PF_PageHdr included
+// Ret:  PF_BADPAGESIZE if pageBytes is not a valid page size, or another
+//       PF return code
 //
-RC PF_Manager::CreateFile (const char *fileName)
+RC PF_Manager::CreateFile (const char *fileName, int pageBytes)
 {
    int fd;		// unix file descriptor
    int numBytes;		// return code form write syscall
 
+   if (PageClass(pageBytes) < 0)
+      return (PF_BADPAGESIZE);
+
    // Create file for exclusive use
    if ((fd = open(fileName,
 #ifdef PC
@@ -71,6 +349,10 @@ RC PF_Manager::CreateFile (const char *fileName)
    PF_FileHdr *hdr = (PF_FileHdr*)hdrBuf;
    hdr->firstFree = PF_PAGE_LIST_END;
    hdr->numPages = 0;
+   hdr->pageBytes = pageBytes;
+   hdr->numReserved = 0;
+   hdr->bPageMap = TRUE;
+   hdr->firstDir = PF_PAGE_LIST_END;
 
    // Write header to file
    if((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
@@ -104,6 +386,19 @@ RC PF_Manager::CreateFile (const char *fileName)
 //
 RC PF_Manager::DestroyFile (const char *fileName)
 {
+   RC rc;
+   struct stat st;
+   std::unique_lock<std::mutex> guard(pFiles->latch);
+
+   // Its pages must not outlive it if it is kept
+   int e = -1;
+   if (stat(fileName, &st) == 0) {
+      pFiles->WaitWarm(guard, st.st_dev, st.st_ino);
+      e = pFiles->Find(st.st_dev, st.st_ino);
+   }
+   if (e >= 0 && pFiles->files[e].keptFd >= 0 && (rc = pFiles->LetGo(e)))
+      return (rc);
+
    // Remove the file
    if (unlink(fileName) < 0)
       return (PF_UNIX);
@@ -112,6 +407,29 @@ RC PF_Manager::DestroyFile (const char *fileName)
    return (0);
 }
 
+//
+// OpenFd
+//
+// Desc: Internal.  Open a file for reading and writing, with the flags
+//       the I/O engine needs.  A file system that refuses them (tmpfs and
+//       O_DIRECT, say) gets a plain open; the engine works either way.
+// In:   fileName - name of the file
+// Ret:  descriptor, or -1 with errno set
+//
+int PF_Manager::OpenFd(const char *fileName)
+{
+   int fd;
+   int flags = O_RDWR;
+#ifdef PC
+   flags |= O_BINARY;
+#endif
+   if ((fd = open(fileName,
+         flags | pBufferMgrs[PF_POOL_DATA][0]->OpenFlags())) < 0 &&
+         errno == EINVAL)
+      fd = open(fileName, flags);
+   return (fd);
+}
+
 //
 // OpenFile
 //
@@ -122,51 +440,127 @@ RC PF_Manager::DestroyFile (const char *fileName)
 //       circumstances, crash the PF layer. Note that even if only one instance
 //       of a file is for writing, problems may occur because some writes may
 //       not be seen by a reader of another instance of the file.
+//       A file kept since it was closed gets its old descriptor back, and
+//       with it the pages it left in the buffer.
+//       With PF_OPEN_MMAP the pages the file has when it is opened are
+//       also mapped read-only, and pages that are not in the buffer are
+//       pinned in that mapping rather than copied into a frame.  Writes
+//       still go through the buffer.
 // In:   fileName - name of file to open
-// Out:  fileHandle - refer to the open file
-//                    this function modifies local var's in fileHandle
-//       to point to the file data in the file table, and to point to the
-//       buffer manager object
-// Ret:  PF_FILEOPEN or other PF return code
+//       mode - PF_OPEN_BUFFERED or PF_OPEN_MMAP
+//       pool - buffer pool of the pages of the file
+// Out:  fileHandle - file handle
+//                    The file handle must not already refer to an open file
+// Ret:  PF_BADPARAM if pool is not a pool, or another PF return code
 //
-RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
+RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle,
+                         PF_OpenMode mode, PF_PoolId pool)
 {
    int rc;                   // return code
+   struct stat st;           // identity of the file
+   int e;                    // its entry in pFiles
+   std::unique_lock<std::mutex> guard(pFiles->latch);
 
    // Ensure file is not already open
    if (fileHandle.bFileOpen)
       return (PF_FILEOPEN);
+   if (pool < 0 || pool >= PF_NUM_POOLS)
+      return (PF_BADPARAM);
 
-   // Open the file
-   if ((fileHandle.unixfd = open(fileName,
-#ifdef PC
-         O_BINARY |
-#endif
-         O_RDWR)) < 0)
+   if ((fileHandle.unixfd = OpenFd(fileName)) < 0)
+      return (PF_UNIX);
+   if (fstat(fileHandle.unixfd, &st) < 0) {
+      close(fileHandle.unixfd);
       return (PF_UNIX);
+   }
 
-   // Read the file header
-   {
-      int numBytes = read(fileHandle.unixfd, (char *)&fileHandle.hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes != sizeof(PF_FileHdr)) {
-         rc = (numBytes < 0) ? PF_UNIX : PF_HDRREAD;
-         goto err;
-      }
+   // Take back the descriptor of a kept file
+   pFiles->WaitWarm(guard, st.st_dev, st.st_ino);
+   e = pFiles->Find(st.st_dev, st.st_ino);
+   if (e >= 0 && pFiles->files[e].keptFd >= 0) {
+      close(fileHandle.unixfd);
+      fileHandle.unixfd = pFiles->files[e].keptFd;
+      pFiles->files[e].keptFd = -1;
    }
 
+   // Read the file header page, which holds part of the page map too
+   char hdrBuf[PF_FILE_HDR_SIZE];
+   if ((rc = pBufferMgrs[PF_POOL_DATA][0]->ReadFileHdr(fileHandle.unixfd,
+         hdrBuf, PF_FILE_HDR_SIZE)))
+      goto err;
+   memcpy(&fileHandle.hdr, hdrBuf, sizeof(PF_FileHdr));
+
    // Set file header to be not changed
    fileHandle.bHdrChanged = FALSE;
 
+   // Its pages go to the buffer of their size
+   if (fileHandle.hdr.pageBytes == 0)
+      fileHandle.hdr.pageBytes = PF_MIN_PAGE_BYTES;
+   if ((rc = GetBuffer(pool, fileHandle.hdr.pageBytes,
+         fileHandle.pBufferMgr)))
+      goto err;
+
+   // The pages a kept file left in another pool are of no use here; they
+   // are clean
+   if (e >= 0 && pFiles->files[e].numOpen == 0 &&
+         pFiles->files[e].pBufferMgr != fileHandle.pBufferMgr &&
+         (rc = pFiles->files[e].pBufferMgr->FlushPages(fileHandle.unixfd)))
+      goto err;
+
+   // Read the page map.  The pages it reads have to leave the buffer if
+   // the file cannot be opened, before another file gets its descriptor.
+   fileHandle.extentPages = extentPages;
+   fileHandle.pPageMap = new PF_PageMap(fileHandle.hdr.pageBytes);
+   if ((rc = fileHandle.ReadPageMap(hdrBuf))) {
+      delete fileHandle.pPageMap;
+      fileHandle.pPageMap = NULL;
+      goto err;
+   }
+
+   // Map the pages of the file
+   fileHandle.pFileMap = NULL;
+   if (mode == PF_OPEN_MMAP) {
+      fileHandle.pFileMap = new PF_FileMap;
+      if ((rc = fileHandle.pFileMap->Map(fileHandle.unixfd,
+            fileHandle.hdr.numPages, fileHandle.hdr.pageBytes))) {
+         delete fileHandle.pFileMap;
+         fileHandle.pFileMap = NULL;
+         delete fileHandle.pPageMap;
+         fileHandle.pPageMap = NULL;
+         goto err;
+      }
+   }
+
+   // Count the handle on the file
+   if (e < 0) {
+      PF_FileEntry entry = { st.st_dev, st.st_ino, 0, -1, -1, pool, NULL, 0,
+                             "" };
+      pFiles->files.push_back(entry);
+      e = pFiles->files.size() - 1;
+   }
+   if (pFiles->files[e].numOpen++ == 0) {
+      pFiles->files[e].openFd = fileHandle.unixfd;
+      pFiles->files[e].pool = pool;
+      pFiles->files[e].pBufferMgr = fileHandle.pBufferMgr;
+   }
+   pFiles->files[e].fileName = fileName;
+
    // Set local variables in file handle object to refer to open file
-   fileHandle.pBufferMgr = pBufferMgr;
    fileHandle.bFileOpen = TRUE;
 
    // Return ok
    return 0;
 
 err:
-   // Close file
+   // Drop what the buffers hold of the file, a kept file's pages included,
+   // and close it
+   if (e >= 0 && pFiles->files[e].pBufferMgr != NULL)
+      pFiles->files[e].pBufferMgr->FlushPages(fileHandle.unixfd);
+   if (fileHandle.pBufferMgr != NULL)
+      fileHandle.pBufferMgr->FlushPages(fileHandle.unixfd);
+   if (e >= 0 && pFiles->files[e].numOpen == 0 &&
+         pFiles->files[e].keptFd < 0)
+      pFiles->files.erase(pFiles->files.begin() + e);
    close(fileHandle.unixfd);
    fileHandle.bFileOpen = FALSE;
 
@@ -179,7 +573,9 @@ err:
 //
 // Desc: Close file associated with fileHandle
 //       The file should have been opened with OpenFile().
-//       Also, flush all pages for the file from the page buffer
+//       Also, flush all pages for the file from the page buffer; if the
+//       file is to be kept (see SetKeepClosed) and no other handle has it
+//       open, the pages are only written and the descriptor stays open.
 //       It is an error to close a file with pages still fixed in the buffer.
 // In:   fileHandle - handle of file to close
 // Out:  fileHandle - no longer refers to an open file
@@ -189,27 +585,298 @@ err:
 RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
 {
    RC rc;
+   struct stat st;
+   std::unique_lock<std::mutex> guard(pFiles->latch);
 
    // Ensure fileHandle refers to open file
    if (!fileHandle.bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // Flush all buffers for this file and write out the header
-   if ((rc = fileHandle.FlushPages()))
+   int e = -1;
+   if (fstat(fileHandle.unixfd, &st) == 0) {
+      pFiles->WaitWarm(guard, st.st_dev, st.st_ino);
+      e = pFiles->Find(st.st_dev, st.st_ino);
+   }
+   int bKeep = (e >= 0 && pFiles->files[e].numOpen == 1 &&
+         pFiles->maxKept > 0);
+
+   // Write out the header and the dirty pages of the file, and unless it
+   // is kept flush all its pages from the buffer
+   if ((rc = fileHandle.WriteHdr()) ||
+         (rc = fileHandle.pBufferMgr->FlushPages(fileHandle.unixfd, bKeep)))
       return (rc);
 
-   // Close the file
-   if (close(fileHandle.unixfd) < 0)
-      return (PF_UNIX);
+   // Unmap the file; this fails if a mapped page is still pinned
+   if (fileHandle.pFileMap != NULL) {
+      if ((rc = fileHandle.pFileMap->Unmap()))
+         return (rc);
+      delete fileHandle.pFileMap;
+      fileHandle.pFileMap = NULL;
+   }
+
+   delete fileHandle.pPageMap;
+   fileHandle.pPageMap = NULL;
+
+   // Keep the file, or close it
+   if (bKeep) {
+      PF_FileEntry &entry = pFiles->files[e];
+      entry.numOpen = 0;
+      entry.openFd = -1;
+      entry.keptFd = fileHandle.unixfd;
+      entry.pBufferMgr = fileHandle.pBufferMgr;
+      entry.lastClose = ++pFiles->closeClock;
+   }
+   else {
+      if (close(fileHandle.unixfd) < 0)
+         return (PF_UNIX);
+      if (e >= 0 && pFiles->files[e].openFd == fileHandle.unixfd)
+         pFiles->files[e].openFd = -1;
+      if (e >= 0 && --pFiles->files[e].numOpen == 0 &&
+            pFiles->files[e].keptFd < 0)
+         pFiles->files.erase(pFiles->files.begin() + e);
+   }
    fileHandle.bFileOpen = FALSE;
 
    // Reset the buffer manager pointer in the file handle
    fileHandle.pBufferMgr = NULL;
 
+   // Let go of the file kept longest ago if there are too many now
+   if (bKeep)
+      return (pFiles->Trim());
+
    // Return ok
    return 0;
 }
 
+//
+// SetKeepClosed
+//
+// Desc: Sets the number of closed files whose pages stay in the buffer
+//       pools, letting go of the files kept longest ago if there are more
+// In:   numFiles - 0 or more
+// Ret:  PF_BADPARAM if numFiles is negative, or another PF return code
+//
+RC PF_Manager::SetKeepClosed(int numFiles)
+{
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   if (numFiles < 0)
+      return (PF_BADPARAM);
+   pFiles->maxKept = numFiles;
+   return (pFiles->Trim());
+}
+
+//
+// SaveWarmList
+//
+// Desc: Write the warm-up list: for each file open or kept, those open
+//       first, then the most recently closed first, a line with its name,
+//       pool, inode, size, modification time and number of resident
+//       pages, then a line with those pages, hottest first.  A warm-up
+//       still running is waited for, so that the files it has yet to warm
+//       up are not left out.  The list is written under another name and
+//       renamed, so a crash never leaves half of it.
+// In:   listName - name of the list file
+// Ret:  PF return code
+//
+RC PF_Manager::SaveWarmList(const char *listName)
+{
+   if (pFiles->warmer.joinable())
+      pFiles->warmer.join();
+
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   std::vector<std::pair<long, int> > listed;
+   for (unsigned e = 0; e < pFiles->files.size(); e++)
+      if (pFiles->files[e].openFd >= 0)
+         listed.push_back(std::make_pair(LONG_MIN, (int)e));
+      else if (pFiles->files[e].keptFd >= 0)
+         listed.push_back(std::make_pair(-pFiles->files[e].lastClose, (int)e));
+   std::sort(listed.begin(), listed.end());
+
+   std::string tmpName = std::string(listName) + ".tmp";
+   FILE *pList = fopen(tmpName.c_str(), "w");
+   if (pList == NULL)
+      return (PF_UNIX);
+
+   for (unsigned k = 0; k < listed.size(); k++) {
+      const PF_FileEntry &entry = pFiles->files[listed[k].second];
+      int fd = entry.openFd >= 0 ? entry.openFd : entry.keptFd;
+      struct stat st;
+      std::vector<PageNum> pageNums;
+
+      if (fstat(fd, &st) < 0)
+         continue;
+      entry.pBufferMgr->ResidentPages(fd, pageNums);
+      fprintf(pList, "%s %d %lld %lld %lld %d\n", entry.fileName.c_str(),
+            (int)entry.pool, (long long)st.st_ino, (long long)st.st_size,
+            (long long)st.st_mtime, (int)pageNums.size());
+      for (unsigned i = 0; i < pageNums.size(); i++)
+         fprintf(pList, i ? " %d" : "%d", pageNums[i]);
+      fprintf(pList, "\n");
+   }
+
+   if (fclose(pList) != 0 || rename(tmpName.c_str(), listName) < 0) {
+      unlink(tmpName.c_str());
+      return (PF_UNIX);
+   }
+   return (0);
+}
+
+//
+// WarmUp
+//
+// Desc: Start warming up the buffer pools from a list written by
+//       SaveWarmList, in a thread of its own.  Nothing is done if files
+//       are not kept after closing.
+// In:   listName - name of the list file; it need not exist
+// Ret:  PF return code
+//
+RC PF_Manager::WarmUp(const char *listName)
+{
+   pFiles->bStopWarm = TRUE;
+   if (pFiles->warmer.joinable())
+      pFiles->warmer.join();
+
+   if (pFiles->maxKept == 0)
+      return (0);
+
+   std::string name(listName);
+   pFiles->bStopWarm = FALSE;
+   pFiles->warmer = std::thread([this, name]() { WarmFiles(name.c_str()); });
+   return (0);
+}
+
+//
+// WarmFiles
+//
+// Desc: Internal.  Body of the warm-up thread: warm up the files of the
+//       list in turn, until the list ends or the warm-up is stopped.  A
+//       list that cannot be read is ignored.
+// In:   listName - name of the list file
+//
+void PF_Manager::WarmFiles(const char *listName)
+{
+   FILE *pList = fopen(listName, "r");
+   if (pList == NULL)
+      return;
+
+   char fileName[PATH_MAX];
+   long long ino, size, mtime;
+   int pool, numPages;
+   for (int rank = 0; !pFiles->bStopWarm &&
+         fscanf(pList, "%4095s %d %lld %lld %lld %d", fileName, &pool, &ino,
+            &size, &mtime, &numPages) == 6 && pool >= 0 &&
+         pool < PF_NUM_POOLS && numPages >= 0; rank++) {
+      std::vector<PageNum> pageNums(numPages);
+      for (int i = 0; i < numPages; i++)
+         if (fscanf(pList, "%d", &pageNums[i]) != 1) {
+            fclose(pList);
+            return;
+         }
+      if (numPages > 0)
+         WarmFile(fileName, (PF_PoolId)pool, ino, size, mtime, &pageNums[0],
+               numPages, rank);
+   }
+   fclose(pList);
+}
+
+//
+// WarmFile
+//
+// Desc: Internal.  Warm up one file of the list, if it is not kept and
+//       has not changed since the list was written: prefetch as many of
+//       its hottest pages as its pool has free frames for.  A file opened
+//       meanwhile gets them through the descriptor of its first handle;
+//       any other is kept.  Warmed up files rank below every file closed
+//       since the start, and among themselves in the order of the list.
+//       The latch is taken only to look the file up and to keep it; the
+//       reads are done without it.
+// In:   fileName - name of the file
+//       pool - its pool
+//       ino, size, mtime - its inode, size and modification time when the
+//       list was written
+//       pageNums - its pages that were resident, hottest first
+//       numPages - # of entries in pageNums
+//       rank - position of the file in the list
+//
+void PF_Manager::WarmFile(const char *fileName, PF_PoolId pool,
+      long long ino, long long size, long long mtime, PageNum *pageNums,
+      int numPages, int rank)
+{
+   PF_BufferMgr *pBufferMgr;
+   struct stat st;
+   char hdrBuf[PF_FILE_HDR_SIZE];
+   int fd;
+
+   if ((fd = OpenFd(fileName)) < 0)
+      return;
+   if (fstat(fd, &st) < 0 || (long long)st.st_ino != ino ||
+         (long long)st.st_size != size || (long long)st.st_mtime != mtime) {
+      close(fd);
+      return;
+   }
+
+   // The pages are read without the latch; until they are, the file may
+   // not be opened, closed or destroyed
+   std::unique_lock<std::mutex> guard(pFiles->latch);
+   pFiles->bWarming = TRUE;
+   pFiles->warmDev = st.st_dev;
+   pFiles->warmIno = st.st_ino;
+
+   // Pages read through the open handle's descriptor are the handle's
+   int e = pFiles->Find(st.st_dev, st.st_ino);
+   if (e >= 0) {
+      const PF_FileEntry &entry = pFiles->files[e];
+      int openFd = entry.openFd;
+      pBufferMgr = entry.pBufferMgr;
+      close(fd);
+      if (openFd >= 0 &&
+            (numPages = std::min(numPages, pBufferMgr->NumFree())) > 0) {
+         guard.unlock();
+         pBufferMgr->PrefetchPages(openFd, pageNums, numPages, TRUE);
+         guard.lock();
+      }
+      goto done;
+   }
+
+   // Any other is read through its own descriptor, and kept
+   guard.unlock();
+   if (pBufferMgrs[PF_POOL_DATA][0]->ReadFileHdr(fd, hdrBuf,
+         PF_FILE_HDR_SIZE)) {
+      guard.lock();
+      close(fd);
+      goto done;
+   }
+   guard.lock();
+   if (GetBuffer(pool, ((PF_FileHdr *)hdrBuf)->pageBytes ?
+            ((PF_FileHdr *)hdrBuf)->pageBytes : PF_MIN_PAGE_BYTES,
+            pBufferMgr) ||
+         (numPages = std::min(numPages, pBufferMgr->NumFree())) == 0) {
+      close(fd);
+      goto done;
+   }
+   guard.unlock();
+   if (pBufferMgr->PrefetchPages(fd, pageNums, numPages, TRUE)) {
+      pBufferMgr->FlushPages(fd);
+      guard.lock();
+      close(fd);
+      goto done;
+   }
+   guard.lock();
+
+   {
+      PF_FileEntry entry = { st.st_dev, st.st_ino, 0, fd, -1, pool,
+                             pBufferMgr, -1 - rank, fileName };
+      pFiles->files.push_back(entry);
+      pFiles->Trim();
+   }
+
+done:
+   pFiles->bWarming = FALSE;
+   pFiles->warmed.notify_all();
+}
+
 //
 // ClearBuffer
 //
@@ -224,13 +891,21 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
 //
 RC PF_Manager::ClearBuffer()
 {
-   return pBufferMgr->ClearBuffer();
+   RC rc;
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         if (pBufferMgrs[p][c] != NULL &&
+               (rc = pBufferMgrs[p][c]->ClearBuffer()))
+            return (rc);
+   return (0);
 }
 
 //
 // PrintBuffer
 //
-// Desc: Display all of the pages within the buffer.
+// Desc: Display all of the pages within the buffers.
 //       This routine will be called via the system command.
 // In:   Nothing
 // Out:  Nothing
@@ -239,23 +914,174 @@ RC PF_Manager::ClearBuffer()
 //
 RC PF_Manager::PrintBuffer()
 {
-   return pBufferMgr->PrintBuffer();
+   RC rc;
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         if (pBufferMgrs[p][c] != NULL) {
+            std::cout << "Pool " << PoolName(p) << ":\n";
+            if ((rc = pBufferMgrs[p][c]->PrintBuffer()))
+               return (rc);
+         }
+   return (0);
 }
 
 //
 // ResizeBuffer
 //
-// Desc: Resizes the buffer manager to the size passed in.
-//       This routine will be called via the system command.
-// In:   The new buffer size
+// Desc: Resizes the buffer managers of the data pool to the size passed
+//       in.  This routine will be called via the system command.
+// In:   The new buffer size, in pages of PF_MIN_PAGE_BYTES, and the
+//       number of shards (0 to let the buffer manager choose)
 // Out:  Nothing
 // Ret:  Returns the result of PF_BufferMgr::ResizeBuffer
 //       It is a code: 0 for success, PF_TOOSMALL when iNewSize
-//       would be too small.
+//       would be too small, PF_PAGEPINNED when a page is pinned,
+//       PF_BADPARAM when numShards is negative.
 //
-RC PF_Manager::ResizeBuffer(int iNewSize)
+RC PF_Manager::ResizeBuffer(int iNewSize, int _numShards)
 {
-   return pBufferMgr->ResizeBuffer(iNewSize);
+   RC rc;
+   std::unique_lock<std::mutex> guard(pFiles->latch);
+
+   // Resizing replaces the shards the warm-up may be reading into
+   pFiles->WaitWarm(guard);
+
+   // The buffer of the smallest pages checks the arguments
+   if ((rc = pBufferMgrs[PF_POOL_DATA][0]->ResizeBuffer(iNewSize,
+         _numShards)))
+      return (rc);
+   poolPages[PF_POOL_DATA] = iNewSize;
+   numShards = _numShards;
+
+   for (int c = 1; c < PF_PAGE_CLASSES; c++)
+      if (pBufferMgrs[PF_POOL_DATA][c] != NULL &&
+            (rc = pBufferMgrs[PF_POOL_DATA][c]->ResizeBuffer(
+               ClassPages(PF_POOL_DATA, c), numShards)))
+         return (rc);
+   return (0);
+}
+
+//
+// SetPool
+//
+// Desc: Sets the size and replacement policy of a pool, resizing its
+//       buffers and switching their policy if they exist already.  The
+//       pages that stay resident keep their order.
+// In:   pool - the pool
+//       numPages - its size, in pages of PF_MIN_PAGE_BYTES
+//       policy - its replacement policy
+// Ret:  PF_BADPARAM if pool or policy are unknown, PF_TOOSMALL if
+//       numPages is less than 1, PF_PAGEPINNED if a page of the pool is
+//       pinned, or another PF return code
+//
+RC PF_Manager::SetPool(PF_PoolId pool, int numPages, PF_ReplacePolicy policy)
+{
+   RC rc;
+   std::unique_lock<std::mutex> guard(pFiles->latch);
+
+   // Resizing or switching the policy replaces the shards the warm-up
+   // may be reading into
+   pFiles->WaitWarm(guard);
+
+   if (pool < 0 || pool >= PF_NUM_POOLS ||
+         policy < PF_REPLACE_LRU || policy > PF_REPLACE_LRUK)
+      return (PF_BADPARAM);
+   if (numPages < 1)
+      return (PF_TOOSMALL);
+
+   poolPages[pool] = numPages;
+   poolPolicy[pool] = policy;
+   for (int c = 0; c < PF_PAGE_CLASSES; c++)
+      if (pBufferMgrs[pool][c] != NULL &&
+            ((rc = pBufferMgrs[pool][c]->SetPolicy(policy)) ||
+             (rc = pBufferMgrs[pool][c]->ResizeBuffer(ClassPages(pool, c),
+                numShards))))
+         return (rc);
+   return (0);
+}
+
+//
+// SetReadAhead
+//
+// Desc: Sets the read-ahead window of the buffer managers.
+// In:   numPages - number of pages read at once by a sequential scan
+// Ret:  Returns the result of PF_BufferMgr::SetReadAhead
+//
+RC PF_Manager::SetReadAhead(int _numPages)
+{
+   RC rc;
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         if (pBufferMgrs[p][c] != NULL &&
+               (rc = pBufferMgrs[p][c]->SetReadAhead(_numPages)))
+            return (rc);
+   readAhead = _numPages;
+   return (0);
+}
+
+//
+// SetFileExtent
+//
+// Desc: Sets the number of pages the files opened from now on grow by
+//       on disk when their last page is used up.
+// In:   numPages - pages allocated at once, 1 or more
+// Ret:  PF_BADPARAM if numPages is less than 1, 0 otherwise
+//
+RC PF_Manager::SetFileExtent(int _numPages)
+{
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   if (_numPages < 1)
+      return (PF_BADPARAM);
+   extentPages = _numPages;
+   return (0);
+}
+
+//
+// SetWriterTarget
+//
+// Desc: Sets the fraction of each buffer the background writers keep
+//       clean, starting or stopping them as needed.
+// In:   cleanRatio - between 0 (no writer) and 1
+// Ret:  Returns the result of PF_BufferMgr::SetWriterTarget
+//
+RC PF_Manager::SetWriterTarget(double _cleanRatio)
+{
+   RC rc;
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         if (pBufferMgrs[p][c] != NULL &&
+               (rc = pBufferMgrs[p][c]->SetWriterTarget(_cleanRatio)))
+            return (rc);
+   cleanRatio = _cleanRatio;
+   return (0);
+}
+
+//
+// SetWriterRate
+//
+// Desc: Limits the number of pages written by each background writer.
+// In:   maxWritesPerSec - pages per second, 0 for no limit
+// Ret:  Returns the result of PF_BufferMgr::SetWriterRate
+//
+RC PF_Manager::SetWriterRate(int _maxWritesPerSec)
+{
+   RC rc;
+   std::lock_guard<std::mutex> guard(pFiles->latch);
+
+   for (int p = 0; p < PF_NUM_POOLS; p++)
+      for (int c = 0; c < PF_PAGE_CLASSES; c++)
+         if (pBufferMgrs[p][c] != NULL &&
+               (rc = pBufferMgrs[p][c]->SetWriterRate(_maxWritesPerSec)))
+            return (rc);
+   maxWritesPerSec = _maxWritesPerSec;
+   return (0);
 }
 
 //------------------------------------------------------------------------------
@@ -264,20 +1090,33 @@ RC PF_Manager::ResizeBuffer(int iNewSize)
 // associated with a particular file.  These should be used if you
 // want memory that is bounded by the size of the buffer pool.
 //
-// The PF_Manager just passes the calls down to the Buffer manager.
+// The PF_Manager just passes the calls down to the Buffer manager of the
+// smallest pages of a pool, the data pool unless another one is given.
 //------------------------------------------------------------------------------
 
 RC PF_Manager::GetBlockSize(int &length) const
 {
-   return pBufferMgr->GetBlockSize(length);
+   return pBufferMgrs[PF_POOL_DATA][0]->GetBlockSize(length);
 }
 
-RC PF_Manager::AllocateBlock(char *&buffer)
+RC PF_Manager::AllocateBlock(char *&buffer, PF_PoolId pool)
 {
+   RC rc;
+   PF_BufferMgr *pBufferMgr;
+
+   if (pool < 0 || pool >= PF_NUM_POOLS)
+      return (PF_BADPARAM);
+   {
+      std::lock_guard<std::mutex> guard(pFiles->latch);
+      if ((rc = GetBuffer(pool, PF_MIN_PAGE_BYTES, pBufferMgr)))
+         return (rc);
+   }
    return pBufferMgr->AllocateBlock(buffer);
 }
 
-RC PF_Manager::DisposeBlock(char *buffer)
+RC PF_Manager::DisposeBlock(char *buffer, PF_PoolId pool)
 {
-   return pBufferMgr->DisposeBlock(buffer);
+   if (pool < 0 || pool >= PF_NUM_POOLS || pBufferMgrs[pool][0] == NULL)
+      return (PF_PAGENOTINBUF);
+   return pBufferMgrs[pool][0]->DisposeBlock(buffer);
 }
@@ -0,0 +1,176 @@
+//
+// File:        pf_pageguard.cc
+// Description: PF_PageGuard class implementation
+//
+
+#include "pf_internal.h"
+#include "pf_buffermgr.h"
+#include "pf_filemap.h"
+
+//
+// Defines
+//
+#define INVALID_PAGE   (-1)
+
+//
+// PF_PageGuard
+//
+// Desc: Default constructor for a page guard object
+//       The guard is empty until it is passed to one of the PF_FileHandle
+//       methods that pin a page.
+//
+PF_PageGuard::PF_PageGuard()
+{
+  pBufferMgr = NULL;
+  pFileMap = NULL;
+  slot = INVALID_SLOT;
+  pageNum = INVALID_PAGE;
+  pPageData = NULL;
+}
+
+//
+// ~PF_PageGuard
+//
+// Desc: Destroy the page guard object.
+//       If the guard still holds a pin, the page is unpinned.  Errors
+//       cannot be reported from here; call UnpinPage() to see them.
+//
+PF_PageGuard::~PF_PageGuard()
+{
+  UnpinPage();
+}
+
+//
+// PF_PageGuard
+//
+// Desc: Move constructor.  The pin moves to the new guard.
+// In:   pageGuard - guard to take the pin from; it is left empty
+//
+PF_PageGuard::PF_PageGuard(PF_PageGuard &&pageGuard)
+{
+  pBufferMgr = pageGuard.pBufferMgr;
+  pFileMap = pageGuard.pFileMap;
+  slot = pageGuard.slot;
+  pageNum = pageGuard.pageNum;
+  pPageData = pageGuard.pPageData;
+
+  pageGuard.pPageData = NULL;
+}
+
+//
+// operator=
+//
+// Desc: Move assignment.  The page this guard held, if any, is unpinned
+//       and the pin of pageGuard moves to this guard.
+// In:   pageGuard - guard to take the pin from; it is left empty
+// Ret:  reference to *this
+//
+PF_PageGuard& PF_PageGuard::operator= (PF_PageGuard &&pageGuard)
+{
+  // Check for self-assignment
+  if (this != &pageGuard) {
+    UnpinPage();
+
+    pBufferMgr = pageGuard.pBufferMgr;
+    pFileMap = pageGuard.pFileMap;
+    slot = pageGuard.slot;
+    pageNum = pageGuard.pageNum;
+    pPageData = pageGuard.pPageData;
+
+    pageGuard.pPageData = NULL;
+  }
+
+  // Return a reference to this
+  return (*this);
+}
+
+//
+// GetData
+//
+// Desc: Access the contents of the page.  The guard must hold a pin.
+// Out:  pData - Set pData to point to the page contents
+// Ret:  PF return code
+//
+RC PF_PageGuard::GetData(char *&pData) const
+{
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  pData = pPageData;
+  return (0);
+}
+
+//
+// GetPageNum
+//
+// Desc: Access the page number.  The guard must hold a pin.
+// Out:  pageNum - contains the page number
+// Ret:  PF return code
+//
+RC PF_PageGuard::GetPageNum(PageNum &_pageNum) const
+{
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  _pageNum = this->pageNum;
+  return (0);
+}
+
+//
+// MarkDirty
+//
+// Desc: Mark the page dirty.  The buffer slot is known, so there is no
+//       hash table lookup.  The guard must hold a pin.
+// Ret:  PF_MAPPEDPAGE if the page is pinned in a file mapping, or another
+//       PF return code
+//
+RC PF_PageGuard::MarkDirty() const
+{
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  if (slot == INVALID_SLOT)
+    return (PF_MAPPEDPAGE);
+
+  return (pBufferMgr->MarkSlotDirty(slot));
+}
+
+//
+// UnpinPage
+//
+// Desc: Give up the pin before the guard goes out of scope.  The guard is
+//       empty afterwards, even if the buffer manager reports an error.
+// Ret:  PF_PAGEUNPINNED if the guard was empty, or another PF return code
+//
+RC PF_PageGuard::UnpinPage()
+{
+  if (pPageData == NULL)
+    return (PF_PAGEUNPINNED);
+
+  pPageData = NULL;
+  if (slot == INVALID_SLOT)
+    return (pFileMap->Unpin(pageNum));
+  return (pBufferMgr->UnpinSlot(slot));
+}
+
+//
+// Attach
+//
+// Desc: Internal.  Take over a pin obtained by PF_FileHandle.  The guard
+//       must be empty.
+// In:   _pBufferMgr - buffer manager holding the page
+//       _pFileMap - mapping of the file of the page, if it has one
+//       _slot - buffer slot of the page, INVALID_SLOT if it is pinned in
+//               the mapping
+//       _pageNum - page number
+//       _pPageData - page contents (after the PF header)
+//
+void PF_PageGuard::Attach(PF_BufferMgr *_pBufferMgr, PF_FileMap *_pFileMap,
+                          int _slot, PageNum _pageNum, char *_pPageData)
+{
+  pBufferMgr = _pBufferMgr;
+  pFileMap = _pFileMap;
+  slot = _slot;
+  pageNum = _pageNum;
+  pPageData = _pPageData;
+}
@@ -0,0 +1,248 @@
+//
+// File:        pf_pagemap.cc
+// Description: PF_PageMap class implementation
+//
+// The bits of each group of pages start at a multiple of 64 pages, so a
+// group is copied in and out of the in-memory words as it is.
+//
+
+#include <algorithm>
+#include "pf_pagemap.h"
+
+//
+// PF_PageMap
+//
+// Desc: Constructor.  The map is empty: no page is used.
+// In:   pageBytes - bytes per page of the file, PF_PageHdr included
+//
+PF_PageMap::PF_PageMap(int pageBytes)
+{
+   // A directory page holds whole 64-bit words of bits after its
+   // PF_PageHdr
+   dirPages = (pageBytes - (int)sizeof(PF_PageHdr)) / 8 * 64;
+   dirty.push_back(FALSE);
+   firstFree = 0;
+   Cover(PF_HDR_MAP_PAGES);
+}
+
+//
+// DirsNeeded
+//
+// Desc: Number of directory pages a file of numPages pages needs
+// In:   numPages - # of pages of the file
+// Ret:  # of directory pages
+//
+int PF_PageMap::DirsNeeded(PageNum numPages) const
+{
+   if (numPages <= PF_HDR_MAP_PAGES)
+      return (0);
+   return ((numPages - PF_HDR_MAP_PAGES + dirPages - 1) / dirPages);
+}
+
+//
+// AddDir
+//
+// Desc: Make a page the next directory page.  It holds the bits of the
+//       pages after those of the directory pages before it.  Also used
+//       when the directory pages of a file are read in.
+// In:   pageNum - a free page of the file
+//
+void PF_PageMap::AddDir(PageNum pageNum)
+{
+   dirs.push_back(pageNum);
+   dirty.push_back(TRUE);
+   Cover(GroupStart(NumDirs() + 1));
+
+   // The page holding the link to the new one changed too
+   dirty[NumDirs() - 1] = TRUE;
+
+   Cover(pageNum + 1);
+   used[pageNum >> 6] &= ~((uint64_t)1 << (pageNum & 63));
+   hidden[pageNum >> 6] |= (uint64_t)1 << (pageNum & 63);
+}
+
+//
+// Load
+//
+// Desc: Set the bits of a group of pages from their stored form
+// In:   group - 0 for the header, i + 1 for directory page i
+//       pBits - the bits, GroupBytes(group) bytes
+//
+void PF_PageMap::Load(int group, const char *pBits)
+{
+   memcpy(&used[GroupStart(group) >> 6], pBits, GroupBytes(group));
+   dirty[group] = FALSE;
+
+   // Directory pages are counted as used on disk
+   for (int i = 0; i < NumDirs(); i++)
+      if (Group(dirs[i]) == group)
+         used[dirs[i] >> 6] &= ~((uint64_t)1 << (dirs[i] & 63));
+   firstFree = 0;
+}
+
+//
+// Store
+//
+// Desc: Copy the bits of a group of pages out in their stored form.
+//       Directory pages are stored as used, so that a reader that does
+//       not know them leaves them alone.
+// In:   group - 0 for the header, i + 1 for directory page i
+// Out:  pBits - the bits, GroupBytes(group) bytes
+//
+void PF_PageMap::Store(int group, char *pBits) const
+{
+   PageNum start = GroupStart(group);
+   int numWords = GroupBytes(group) / 8;
+
+   for (int w = 0; w < numWords; w++) {
+      uint64_t word = used[(start >> 6) + w] | hidden[(start >> 6) + w];
+      memcpy(pBits + w * 8, &word, 8);
+   }
+}
+
+//
+// GroupBytes
+//
+// Desc: Size of the stored bits of a group
+// In:   group - 0 for the header, i + 1 for directory page i
+// Ret:  # of bytes
+//
+int PF_PageMap::GroupBytes(int group) const
+{
+   return ((group == 0 ? PF_HDR_MAP_PAGES : dirPages) / 8);
+}
+
+//
+// SetUsed
+//
+// Desc: Mark a page used or free
+// In:   pageNum - page of the file, not a directory page
+//       bUsed - TRUE if a client uses the page
+//
+void PF_PageMap::SetUsed(PageNum pageNum, int bUsed)
+{
+   Cover(pageNum + 1);
+
+   uint64_t bit = (uint64_t)1 << (pageNum & 63);
+   if (bUsed)
+      used[pageNum >> 6] |= bit;
+   else {
+      used[pageNum >> 6] &= ~bit;
+      if (pageNum < firstFree)
+         firstFree = pageNum;
+   }
+
+   int group = Group(pageNum);
+   if (group < (int)dirty.size())
+      dirty[group] = TRUE;
+}
+
+//
+// FindFree
+//
+// Desc: Find the lowest page of the file that is free, 64 pages at a time
+// In:   numPages - # of pages of the file
+// Ret:  page number, numPages if every page is taken
+//
+PageNum PF_PageMap::FindFree(PageNum numPages)
+{
+   Cover(numPages);
+   for (PageNum w = firstFree >> 6; w < (numPages + 63) >> 6; w++) {
+      uint64_t taken = used[w] | hidden[w];
+      if (taken == ~(uint64_t)0)
+         continue;
+
+      PageNum pageNum = (w << 6) + __builtin_ctzll(~taken);
+      if (pageNum >= numPages)
+         break;
+      firstFree = pageNum;
+      return (pageNum);
+   }
+
+   firstFree = numPages;
+   return (numPages);
+}
+
+//
+// NextUsed
+//
+// Desc: Find the next used page in either direction, skipping free and
+//       directory pages 64 at a time
+// In:   current - page to start from, excluded; may be -1 going forward
+//       and numPages going backward
+//       step - 1 or -1
+//       numPages - # of pages of the file
+// Ret:  page number, or -1 (backward) or numPages (forward) if none
+//
+PageNum PF_PageMap::NextUsed(PageNum current, int step,
+      PageNum numPages) const
+{
+   // Pages past the arrays are not used
+   PageNum end = std::min(numPages, (PageNum)used.size() * 64);
+
+   if (step > 0) {
+      PageNum pageNum = current + 1;
+      while (pageNum < end) {
+         uint64_t word = used[pageNum >> 6] >> (pageNum & 63);
+         if (word != 0) {
+            pageNum += __builtin_ctzll(word);
+            return (pageNum < end ? pageNum : numPages);
+         }
+         pageNum = (pageNum | 63) + 1;
+      }
+      return (numPages);
+   }
+
+   PageNum pageNum = current - 1;
+   if (pageNum >= end)
+      pageNum = end - 1;
+   while (pageNum >= 0) {
+      uint64_t word = used[pageNum >> 6] << (63 - (pageNum & 63));
+      if (word != 0)
+         return (pageNum - __builtin_clzll(word));
+      pageNum = (pageNum & ~(PageNum)63) - 1;
+   }
+   return (-1);
+}
+
+//
+// Group
+//
+// Desc: Internal.  Group whose stored bits hold the bit of a page
+// Ret:  0 for the header, i + 1 for directory page i
+//
+int PF_PageMap::Group(PageNum pageNum) const
+{
+   if (pageNum < PF_HDR_MAP_PAGES)
+      return (0);
+   return (1 + (pageNum - PF_HDR_MAP_PAGES) / dirPages);
+}
+
+//
+// GroupStart
+//
+// Desc: Internal.  First page of a group
+//
+PageNum PF_PageMap::GroupStart(int group) const
+{
+   if (group == 0)
+      return (0);
+   return (PF_HDR_MAP_PAGES + (PageNum)(group - 1) * dirPages);
+}
+
+//
+// Cover
+//
+// Desc: Internal.  Grow the bit arrays to hold the first numPages pages,
+//       and a whole number of groups
+//
+void PF_PageMap::Cover(PageNum numPages)
+{
+   PageNum end = GroupStart(Group(numPages - 1) + 1);
+   size_t numWords = (end + 63) >> 6;
+
+   if (numWords > used.size()) {
+      used.resize(numWords, 0);
+      hidden.resize(numWords, 0);
+   }
+}
@@ -0,0 +1,74 @@
+//
+// File:        pf_pagemap.h
+// Description: Allocation bitmap of the pages of a PF file
+//
+// Every page of a file has a bit telling whether a client uses it.  The
+// bits of the first PF_HDR_MAP_PAGES pages are stored in the file header
+// page, after PF_FileHdr; those of later pages in directory pages, each
+// holding the bits of the next DirPages() pages.  Directory pages are
+// pages of the file like any other, chained from PF_FileHdr.firstDir
+// through their PF_PageHdr, but clients never see them.  The whole map is
+// read when the file is opened and kept in memory, so allocating and
+// disposing of pages, and finding the used ones, takes no page I/O; the
+// parts that changed are written back when the file is flushed.
+//
+
+#ifndef PF_PAGEMAP_H
+#define PF_PAGEMAP_H
+
+#include <vector>
+#include <stdint.h>
+#include "pf_internal.h"
+
+class PF_PageMap {
+public:
+    PF_PageMap  (int pageBytes);                 // pageBytes of the file
+
+    // # of pages whose bits a directory page holds
+    int  DirPages   () const { return (dirPages); }
+    // # of directory pages a file of numPages pages needs
+    int  DirsNeeded (PageNum numPages) const;
+
+    // Directory pages, in the order of the pages they cover
+    int  NumDirs    () const { return ((int)dirs.size()); }
+    PageNum Dir     (int i) const { return (dirs[i]); }
+    void AddDir     (PageNum pageNum);
+    int  IsDir      (PageNum pageNum) const
+        { return (TestBit(hidden, pageNum)); }
+
+    // Bits of a group of pages as they are stored: group 0 in the file
+    // header, group i + 1 in directory page i
+    void Load       (int group, const char *pBits);
+    void Store      (int group, char *pBits) const;
+    int  GroupBytes (int group) const;
+    int  IsDirty    (int group) const { return (dirty[group]); }
+    void SetClean   (int group) { dirty[group] = FALSE; }
+
+    int  IsUsed     (PageNum pageNum) const
+        { return (TestBit(used, pageNum)); }
+    void SetUsed    (PageNum pageNum, int bUsed);
+
+    // Lowest page below numPages that is neither used nor a directory
+    // page; numPages if there is none
+    PageNum FindFree (PageNum numPages);
+    // First used page after (step 1) or before (step -1) current, and
+    // below numPages; -1 or numPages if there is none
+    PageNum NextUsed (PageNum current, int step, PageNum numPages) const;
+
+private:
+    static int TestBit (const std::vector<uint64_t> &bits, PageNum pageNum)
+        { return (pageNum >= 0 && pageNum < (PageNum)bits.size() * 64 &&
+                  ((bits[pageNum >> 6] >> (pageNum & 63)) & 1)); }
+    int  Group      (PageNum pageNum) const;     // group holding its bit
+    PageNum GroupStart(int group) const;         // first page of a group
+    void Cover      (PageNum numPages);          // grow the bit arrays
+
+    int dirPages;                                // pages per directory page
+    std::vector<uint64_t> used;                  // pages clients use
+    std::vector<uint64_t> hidden;                // directory pages
+    std::vector<PageNum> dirs;                   // directory pages in order
+    std::vector<char> dirty;                     // TRUE for changed groups
+    PageNum firstFree;                           // no free page below it
+};
+
+#endif
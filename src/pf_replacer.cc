@@ -0,0 +1,567 @@
+//
+// File:        pf_replacer.cc
+// Description: Page replacement policies for PF_BufferMgr
+//
+
+#include <algorithm>
+#include "pf_buffermgr.h"
+#include "pf_replacer.h"
+
+using namespace std;
+
+//
+// Create
+//
+// Desc: Factory for the replacer implementing a given policy
+// In:   policy - replacement policy
+// Ret:  new replacer (to be deleted by the caller), NULL if unknown
+//
+PF_Replacer *PF_Replacer::Create(PF_ReplacePolicy policy)
+{
+   switch (policy) {
+      case PF_REPLACE_LRU:   return new PF_LRUReplacer();
+      case PF_REPLACE_CLOCK: return new PF_ClockReplacer();
+      case PF_REPLACE_2Q:    return new PF_2QReplacer();
+      case PF_REPLACE_LRUK:  return new PF_LRUKReplacer();
+   }
+   return NULL;
+}
+
+//------------------------------------------------------------------------------
+// PF_LRUReplacer
+//------------------------------------------------------------------------------
+
+PF_LRUReplacer::PF_LRUReplacer()
+{
+   next = prev = NULL;
+   first = last = INVALID_SLOT;
+}
+
+PF_LRUReplacer::~PF_LRUReplacer()
+{
+   delete [] next;
+   delete [] prev;
+}
+
+RC PF_LRUReplacer::Resize(int numPages)
+{
+   delete [] next;
+   delete [] prev;
+   next = new int[numPages];
+   prev = new int[numPages];
+   for (int i = 0; i < numPages; i++)
+      next[i] = prev[i] = INVALID_SLOT;
+   first = last = INVALID_SLOT;
+   return (0);
+}
+
+void PF_LRUReplacer::Insert(int slot, int fd, PageNum pageNum)
+{
+   LinkHead(slot);
+}
+
+void PF_LRUReplacer::InsertCold(int slot, int fd, PageNum pageNum)
+{
+   LinkTail(slot);
+}
+
+//
+// Access, Touch
+//
+// Desc: Any use of the page makes it the most recently used one.  This
+//       keeps the order the buffer manager maintained before replacement
+//       policies became pluggable.
+//
+void PF_LRUReplacer::Access(int slot)
+{
+   Unlink(slot);
+   LinkHead(slot);
+}
+
+void PF_LRUReplacer::Touch(int slot)
+{
+   Unlink(slot);
+   LinkHead(slot);
+}
+
+void PF_LRUReplacer::Remove(int slot)
+{
+   Unlink(slot);
+}
+
+//
+// Victim
+//
+// Desc: Choose the least-recently used page that is unpinned
+//
+RC PF_LRUReplacer::Victim(const PF_BufPageDesc *bufTable, int &slot,
+      int &probes)
+{
+   probes = 0;
+   for (slot = last; slot != INVALID_SLOT; slot = prev[slot]) {
+      probes++;
+      if (bufTable[slot].pinCount == 0)
+         break;
+   }
+
+   // Return error if all buffers were pinned
+   if (slot == INVALID_SLOT)
+      return (PF_NOBUF);
+
+   Unlink(slot);
+   return (0);
+}
+
+int PF_LRUReplacer::Order(int *slots) const
+{
+   int n = 0;
+   for (int slot = first; slot != INVALID_SLOT; slot = next[slot])
+      slots[n++] = slot;
+   return (n);
+}
+
+void PF_LRUReplacer::LinkHead(int slot)
+{
+   next[slot] = first;
+   prev[slot] = INVALID_SLOT;
+   if (first != INVALID_SLOT)
+      prev[first] = slot;
+   first = slot;
+   if (last == INVALID_SLOT)
+      last = first;
+}
+
+void PF_LRUReplacer::LinkTail(int slot)
+{
+   prev[slot] = last;
+   next[slot] = INVALID_SLOT;
+   if (last != INVALID_SLOT)
+      next[last] = slot;
+   last = slot;
+   if (first == INVALID_SLOT)
+      first = last;
+}
+
+void PF_LRUReplacer::Unlink(int slot)
+{
+   if (first == slot)
+      first = next[slot];
+   if (last == slot)
+      last = prev[slot];
+   if (next[slot] != INVALID_SLOT)
+      prev[next[slot]] = prev[slot];
+   if (prev[slot] != INVALID_SLOT)
+      next[prev[slot]] = next[slot];
+   prev[slot] = next[slot] = INVALID_SLOT;
+}
+
+//------------------------------------------------------------------------------
+// PF_ClockReplacer
+//------------------------------------------------------------------------------
+
+PF_ClockReplacer::PF_ClockReplacer()
+{
+   numSlots = hand = numTracked = 0;
+   usage = NULL;
+}
+
+PF_ClockReplacer::~PF_ClockReplacer()
+{
+   delete [] usage;
+}
+
+RC PF_ClockReplacer::Resize(int numPages)
+{
+   delete [] usage;
+   usage = new char[numPages];
+   memset(usage, -1, numPages);
+   numSlots = numPages;
+   numTracked = hand = 0;
+   return (0);
+}
+
+void PF_ClockReplacer::Insert(int slot, int fd, PageNum pageNum)
+{
+   usage[slot] = 1;
+   numTracked++;
+}
+
+//
+// InsertCold
+//
+// Desc: A zero usage count: the hand takes the page the first time it
+//       gets to it unpinned
+//
+void PF_ClockReplacer::InsertCold(int slot, int fd, PageNum pageNum)
+{
+   usage[slot] = 0;
+   numTracked++;
+}
+
+void PF_ClockReplacer::Access(int slot)
+{
+   if (usage[slot] >= 0 && usage[slot] < PF_CLOCK_MAX_USAGE)
+      usage[slot]++;
+}
+
+void PF_ClockReplacer::Remove(int slot)
+{
+   if (usage[slot] >= 0)
+      numTracked--;
+   usage[slot] = -1;
+}
+
+//
+// Victim
+//
+// Desc: Sweep the hand until an unpinned page with a zero usage count is
+//       found.  After PF_CLOCK_MAX_USAGE + 1 full revolutions every
+//       unpinned page has reached zero, so if nothing was found by then
+//       all pages are pinned.
+//
+RC PF_ClockReplacer::Victim(const PF_BufPageDesc *bufTable, int &slot,
+      int &probes)
+{
+   int limit = numSlots * (PF_CLOCK_MAX_USAGE + 1);
+
+   if (numTracked == 0)
+      return (PF_NOBUF);
+
+   for (probes = 0; probes < limit; ) {
+      slot = hand;
+      hand = (hand + 1 == numSlots) ? 0 : hand + 1;
+
+      if (usage[slot] < 0)
+         continue;
+      probes++;
+
+      if (bufTable[slot].pinCount > 0)
+         continue;
+
+      if (usage[slot] == 0) {
+         usage[slot] = -1;
+         numTracked--;
+         return (0);
+      }
+      usage[slot]--;
+   }
+
+   return (PF_NOBUF);
+}
+
+int PF_ClockReplacer::Order(int *slots) const
+{
+   int n = 0;
+
+   // Highest usage count first, ties in the order the hand reaches them
+   // last (i.e. furthest from eviction first)
+   for (int u = PF_CLOCK_MAX_USAGE; u >= 0; u--)
+      for (int i = numSlots; i > 0; i--) {
+         int slot = (hand + i - 1) % numSlots;
+         if (usage[slot] == u)
+            slots[n++] = slot;
+      }
+   return (n);
+}
+
+//------------------------------------------------------------------------------
+// PF_2QReplacer
+//------------------------------------------------------------------------------
+
+PF_2QReplacer::PF_2QReplacer()
+{
+   next = prev = NULL;
+   queue = NULL;
+   key = NULL;
+   kIn = kOut = 0;
+}
+
+PF_2QReplacer::~PF_2QReplacer()
+{
+   delete [] next;
+   delete [] prev;
+   delete [] queue;
+   delete [] key;
+}
+
+//
+// Resize
+//
+// Desc: The sizes recommended by the 2Q paper: A1in holds a quarter of
+//       the buffer and A1out remembers half as many pages as fit in it.
+//
+RC PF_2QReplacer::Resize(int numPages)
+{
+   delete [] next;
+   delete [] prev;
+   delete [] queue;
+   delete [] key;
+   next  = new int[numPages];
+   prev  = new int[numPages];
+   queue = new char[numPages];
+   key   = new PageKey[numPages];
+   for (int i = 0; i < numPages; i++) {
+      next[i] = prev[i] = INVALID_SLOT;
+      queue[i] = Q_NONE;
+   }
+   for (int q = 0; q < 3; q++) {
+      head[q] = tail[q] = INVALID_SLOT;
+      size[q] = 0;
+   }
+
+   kIn  = max(1, numPages / 4);
+   kOut = max(1, numPages / 2);
+   a1out.clear();
+   a1outKeys.clear();
+   return (0);
+}
+
+//
+// Insert
+//
+// Desc: A page that was evicted from A1in a short while ago is hot; it goes
+//       straight to Am.  Everything else starts out on probation in A1in.
+//
+void PF_2QReplacer::Insert(int slot, int fd, PageNum pageNum)
+{
+   key[slot] = PageKey(fd, pageNum);
+
+   if (a1outKeys.find(key[slot]) != a1outKeys.end())
+      LinkHead(Q_AM, slot);
+   else
+      LinkHead(Q_A1IN, slot);
+}
+
+//
+// InsertCold
+//
+// Desc: The page goes to the tail of A1in, next in line for eviction, and
+//       is not remembered in A1out when it leaves (see Victim), so that
+//       scanning the file again does not promote it to Am.
+//
+void PF_2QReplacer::InsertCold(int slot, int fd, PageNum pageNum)
+{
+   key[slot] = PageKey(fd, pageNum);
+   LinkTail(Q_A1IN, slot);
+}
+
+//
+// Access
+//
+// Desc: Hits in A1in are ignored (they are usually correlated references
+//       right after the page was read); hits in Am are LRU.
+//
+void PF_2QReplacer::Access(int slot)
+{
+   if (queue[slot] == Q_AM) {
+      Unlink(slot);
+      LinkHead(Q_AM, slot);
+   }
+}
+
+void PF_2QReplacer::Remove(int slot)
+{
+   if (queue[slot] != Q_NONE)
+      Unlink(slot);
+}
+
+//
+// Victim
+//
+// Desc: Reclaim from A1in while it is over its target size, otherwise from
+//       the LRU end of Am.  Fall back on the other queue if every page of
+//       the chosen one is pinned.  Pages leaving A1in are remembered in
+//       A1out.
+//
+RC PF_2QReplacer::Victim(const PF_BufPageDesc *bufTable, int &slot,
+      int &probes)
+{
+   int first  = (size[Q_A1IN] > kIn || size[Q_AM] == 0) ? Q_A1IN : Q_AM;
+   int second = (first == Q_A1IN) ? Q_AM : Q_A1IN;
+
+   probes = 0;
+   if ((slot = FindTail(bufTable, first, probes)) == INVALID_SLOT &&
+         (slot = FindTail(bufTable, second, probes)) == INVALID_SLOT)
+      return (PF_NOBUF);
+
+   if (queue[slot] == Q_A1IN && !bufTable[slot].bScanOnce)
+      Remember(key[slot]);
+   Unlink(slot);
+   return (0);
+}
+
+int PF_2QReplacer::Order(int *slots) const
+{
+   int n = 0;
+   for (int slot = head[Q_AM]; slot != INVALID_SLOT; slot = next[slot])
+      slots[n++] = slot;
+   for (int slot = head[Q_A1IN]; slot != INVALID_SLOT; slot = next[slot])
+      slots[n++] = slot;
+   return (n);
+}
+
+int PF_2QReplacer::FindTail(const PF_BufPageDesc *bufTable, int q,
+      int &probes) const
+{
+   for (int slot = tail[q]; slot != INVALID_SLOT; slot = prev[slot]) {
+      probes++;
+      if (bufTable[slot].pinCount == 0)
+         return (slot);
+   }
+   return (INVALID_SLOT);
+}
+
+void PF_2QReplacer::Remember(const PageKey &k)
+{
+   a1out.push_front(k);
+   a1outKeys.insert(k);
+   if ((int)a1out.size() > kOut) {
+      a1outKeys.erase(a1outKeys.find(a1out.back()));
+      a1out.pop_back();
+   }
+}
+
+void PF_2QReplacer::LinkHead(int q, int slot)
+{
+   queue[slot] = q;
+   next[slot] = head[q];
+   prev[slot] = INVALID_SLOT;
+   if (head[q] != INVALID_SLOT)
+      prev[head[q]] = slot;
+   head[q] = slot;
+   if (tail[q] == INVALID_SLOT)
+      tail[q] = slot;
+   size[q]++;
+}
+
+void PF_2QReplacer::LinkTail(int q, int slot)
+{
+   queue[slot] = q;
+   prev[slot] = tail[q];
+   next[slot] = INVALID_SLOT;
+   if (tail[q] != INVALID_SLOT)
+      next[tail[q]] = slot;
+   tail[q] = slot;
+   if (head[q] == INVALID_SLOT)
+      head[q] = slot;
+   size[q]++;
+}
+
+void PF_2QReplacer::Unlink(int slot)
+{
+   int q = queue[slot];
+
+   if (head[q] == slot)
+      head[q] = next[slot];
+   if (tail[q] == slot)
+      tail[q] = prev[slot];
+   if (next[slot] != INVALID_SLOT)
+      prev[next[slot]] = prev[slot];
+   if (prev[slot] != INVALID_SLOT)
+      next[prev[slot]] = next[slot];
+   prev[slot] = next[slot] = INVALID_SLOT;
+   queue[slot] = Q_NONE;
+   size[q]--;
+}
+
+//------------------------------------------------------------------------------
+// PF_LRUKReplacer
+//------------------------------------------------------------------------------
+
+PF_LRUKReplacer::PF_LRUKReplacer()
+{
+   numSlots = 0;
+   clock = 0;
+   last = penult = NULL;
+}
+
+PF_LRUKReplacer::~PF_LRUKReplacer()
+{
+   delete [] last;
+   delete [] penult;
+}
+
+RC PF_LRUKReplacer::Resize(int numPages)
+{
+   delete [] last;
+   delete [] penult;
+   last   = new long[numPages];
+   penult = new long[numPages];
+   for (int i = 0; i < numPages; i++)
+      last[i] = penult[i] = -1;
+   numSlots = numPages;
+   return (0);
+}
+
+void PF_LRUKReplacer::Insert(int slot, int fd, PageNum pageNum)
+{
+   last[slot] = ++clock;
+   penult[slot] = 0;
+}
+
+//
+// InsertCold
+//
+// Desc: No reference time at all, so the page loses every comparison in
+//       Victim until it is referenced again
+//
+void PF_LRUKReplacer::InsertCold(int slot, int fd, PageNum pageNum)
+{
+   last[slot] = penult[slot] = 0;
+}
+
+void PF_LRUKReplacer::Access(int slot)
+{
+   penult[slot] = last[slot];
+   last[slot] = ++clock;
+}
+
+void PF_LRUKReplacer::Remove(int slot)
+{
+   last[slot] = penult[slot] = -1;
+}
+
+//
+// Victim
+//
+// Desc: Linear scan for the largest backward 2-distance, i.e. the smallest
+//       penultimate reference time, breaking ties by the last reference.
+//
+RC PF_LRUKReplacer::Victim(const PF_BufPageDesc *bufTable, int &slot,
+      int &probes)
+{
+   slot = INVALID_SLOT;
+   probes = 0;
+
+   for (int i = 0; i < numSlots; i++) {
+      if (last[i] < 0)
+         continue;
+      probes++;
+      if (bufTable[i].pinCount > 0)
+         continue;
+      if (slot == INVALID_SLOT || penult[i] < penult[slot] ||
+            (penult[i] == penult[slot] && last[i] < last[slot]))
+         slot = i;
+   }
+
+   if (slot == INVALID_SLOT)
+      return (PF_NOBUF);
+
+   Remove(slot);
+   return (0);
+}
+
+int PF_LRUKReplacer::Order(int *slots) const
+{
+   int n = 0;
+   for (int i = 0; i < numSlots; i++)
+      if (last[i] >= 0)
+         slots[n++] = i;
+
+   // Hottest first: most recent penultimate reference, then last reference
+   const long *p = penult, *l = last;
+   sort(slots, slots + n, [p, l](int a, int b) {
+      return (p[a] != p[b]) ? p[a] > p[b] : l[a] > l[b];
+   });
+   return (n);
+}
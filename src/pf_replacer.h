@@ -0,0 +1,198 @@
+//
+// File:        pf_replacer.h
+// Description: Page replacement policies for PF_BufferMgr
+//
+// The buffer manager keeps the resident pages of the pool in its own
+// table and asks a PF_Replacer object which unpinned page to throw out
+// when it runs out of free slots.  Each policy keeps whatever per-slot
+// bookkeeping it needs in its own arrays, so a buffer hit only costs the
+// policy's Access() instead of an unlink/relink of a shared list.
+//
+
+#ifndef PF_REPLACER_H
+#define PF_REPLACER_H
+
+#include <set>
+#include <deque>
+#include <utility>
+#include "pf_internal.h"
+
+struct PF_BufPageDesc;
+
+//
+// PF_Replacer - interface for a page replacement policy
+//
+// Slots are the indices of the buffer table.  A slot is known to the
+// policy from Insert() until it is either picked by Victim() or handed
+// back with Remove().
+//
+class PF_Replacer {
+public:
+    virtual ~PF_Replacer () {}
+
+    // Forget every slot and prepare for a buffer table of numPages slots
+    virtual RC   Resize  (int numPages) = 0;
+
+    // A page has been read (or allocated) into slot
+    virtual void Insert  (int slot, int fd, PageNum pageNum) = 0;
+    // A page a SEQUENTIAL_ONCE scan asked for has been read into slot.
+    // It goes at the cold end, ahead of every other page for eviction.
+    virtual void InsertCold(int slot, int fd, PageNum pageNum)
+        { Insert(slot, fd, pageNum); }
+    // A resident page has been requested again (buffer hit)
+    virtual void Access  (int slot) = 0;
+    // A resident page was dirtied or lost its last pin.  This is not a
+    // new reference; only policies that order on every touch care.
+    virtual void Touch   (int slot) { (void)slot; }
+    // The page in slot has been dropped by the buffer manager
+    virtual void Remove  (int slot) = 0;
+
+    // Choose an unpinned slot to evict and stop tracking it.  probes is
+    // set to the number of slots examined to find it.
+    virtual RC   Victim  (const PF_BufPageDesc *bufTable, int &slot,
+                          int &probes) = 0;
+
+    // Fill slots with the tracked slots, hottest first; return the count
+    virtual int  Order   (int *slots) const = 0;
+
+    virtual const char *Name() const = 0;
+
+    // Create the replacer that implements policy
+    static PF_Replacer *Create(PF_ReplacePolicy policy);
+};
+
+//
+// PF_LRUReplacer - least recently used, the historical RedBase policy
+//
+class PF_LRUReplacer : public PF_Replacer {
+public:
+    PF_LRUReplacer ();
+    ~PF_LRUReplacer();
+
+    RC   Resize  (int numPages);
+    void Insert  (int slot, int fd, PageNum pageNum);
+    void InsertCold(int slot, int fd, PageNum pageNum);
+    void Access  (int slot);
+    void Touch   (int slot);
+    void Remove  (int slot);
+    RC   Victim  (const PF_BufPageDesc *bufTable, int &slot, int &probes);
+    int  Order   (int *slots) const;
+    const char *Name() const { return "LRU"; }
+
+private:
+    void LinkHead(int slot);
+    void LinkTail(int slot);
+    void Unlink  (int slot);
+
+    int *next;                                    // towards the LRU end
+    int *prev;                                    // towards the MRU end
+    int first;                                    // MRU slot
+    int last;                                     // LRU slot
+};
+
+//
+// PF_ClockReplacer - CLOCK sweep with a saturating usage count per slot
+//
+// A hit bumps the usage count up to PF_CLOCK_MAX_USAGE; the hand
+// decrements counts as it passes and evicts the first unpinned slot whose
+// count is zero.  Pages touched once by a scan leave with one pass of the
+// hand while frequently used pages survive several.
+//
+class PF_ClockReplacer : public PF_Replacer {
+public:
+    PF_ClockReplacer ();
+    ~PF_ClockReplacer();
+
+    RC   Resize  (int numPages);
+    void Insert  (int slot, int fd, PageNum pageNum);
+    void InsertCold(int slot, int fd, PageNum pageNum);
+    void Access  (int slot);
+    void Remove  (int slot);
+    RC   Victim  (const PF_BufPageDesc *bufTable, int &slot, int &probes);
+    int  Order   (int *slots) const;
+    const char *Name() const { return "CLOCK"; }
+
+private:
+    int  numSlots;
+    int  hand;                                    // next slot to examine
+    int  numTracked;                              // # of tracked slots
+    char *usage;                                  // usage count, -1 = empty
+};
+
+//
+// PF_2QReplacer - the "full" 2Q policy of Johnson and Shasha
+//
+// Newly read pages enter the FIFO A1in.  A page is only promoted to the
+// LRU queue Am if it is read again after having been evicted from A1in
+// recently, which is remembered by its key in the ghost queue A1out.
+// One-shot scans therefore cycle through A1in and never reach Am.
+//
+class PF_2QReplacer : public PF_Replacer {
+public:
+    PF_2QReplacer ();
+    ~PF_2QReplacer();
+
+    RC   Resize  (int numPages);
+    void Insert  (int slot, int fd, PageNum pageNum);
+    void InsertCold(int slot, int fd, PageNum pageNum);
+    void Access  (int slot);
+    void Remove  (int slot);
+    RC   Victim  (const PF_BufPageDesc *bufTable, int &slot, int &probes);
+    int  Order   (int *slots) const;
+    const char *Name() const { return "2Q"; }
+
+private:
+    enum { Q_NONE, Q_A1IN, Q_AM };
+    typedef std::pair<int, PageNum> PageKey;
+
+    void LinkHead (int q, int slot);
+    void LinkTail (int q, int slot);
+    void Unlink   (int slot);
+    int  FindTail (const PF_BufPageDesc *bufTable, int q, int &probes) const;
+    void Remember (const PageKey &key);           // push key onto A1out
+
+    int *next;
+    int *prev;
+    char *queue;                                  // queue holding each slot
+    PageKey *key;                                 // page held by each slot
+    int head[3];
+    int tail[3];
+    int size[3];
+    int kIn;                                      // target size of A1in
+    int kOut;                                     // capacity of A1out
+
+    std::deque<PageKey> a1out;                    // ghost FIFO, newest first
+    std::multiset<PageKey> a1outKeys;             // membership of a1out
+};
+
+//
+// PF_LRUKReplacer - LRU-K with K = 2
+//
+// The victim is the unpinned page whose second most recent reference is
+// the oldest.  Pages referenced only once have an infinite backward
+// 2-distance and go first, in LRU order.  History is not retained for
+// evicted pages.
+//
+class PF_LRUKReplacer : public PF_Replacer {
+public:
+    PF_LRUKReplacer ();
+    ~PF_LRUKReplacer();
+
+    RC   Resize  (int numPages);
+    void Insert  (int slot, int fd, PageNum pageNum);
+    void InsertCold(int slot, int fd, PageNum pageNum);
+    void Access  (int slot);
+    void Remove  (int slot);
+    RC   Victim  (const PF_BufPageDesc *bufTable, int &slot, int &probes);
+    int  Order   (int *slots) const;
+    const char *Name() const { return "LRU-2"; }
+
+private:
+    int numSlots;
+    long clock;                                   // logical reference time
+    long *last;                                   // most recent reference
+    long *penult;                                 // reference before that
+                                                  // (0 if none, -1 if empty)
+};
+
+#endif
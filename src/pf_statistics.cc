@@ -30,6 +30,18 @@ void PF_Statistics()
    int *piRP = pStatisticsMgr->Get(PF_READPAGE);
    int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
    int *piFP = pStatisticsMgr->Get(PF_FLUSHPAGES);
+   int *piV = pStatisticsMgr->Get(PF_VICTIMS);
+   int *piVP = pStatisticsMgr->Get(PF_VICTIMPROBES);
+   int *piWV = pStatisticsMgr->Get(PF_WRITEV);
+   int *piRV = pStatisticsMgr->Get(PF_READV);
+   int *piPP = pStatisticsMgr->Get(PF_PREFETCHED);
+   int *piPH = pStatisticsMgr->Get(PF_PREFETCHHITS);
+   int *piPW = pStatisticsMgr->Get(PF_PREFETCHWASTED);
+   int *piDV = pStatisticsMgr->Get(PF_DIRTYVICTIMS);
+   int *piBW = pStatisticsMgr->Get(PF_BGWRITES);
+   int *piBV = pStatisticsMgr->Get(PF_BGWRITEV);
+   int *piMP = pStatisticsMgr->Get(PF_MAPPEDPINS);
+   int *piEX = pStatisticsMgr->Get(PF_EXTENTS);
 
    cout << "PF Layer Statistics\n";
    cout << "-------------------\n";
@@ -40,16 +52,41 @@ void PF_Statistics()
    if (piPF) cout << *piPF; else cout << "None";
    cout << "\n  Number not found: ";
    if (piPNF) cout << *piPNF; else cout << "None";
+   cout << "\nPages pinned in file mappings instead: ";
+   if (piMP) cout << *piMP; else cout << "None";
    cout << "\n-------------------\n";
 
    cout << "Number of read requests: ";
    if (piRP) cout << *piRP; else cout << "None";
+   cout << "\n  Issued as vectored reads: ";
+   if (piRV) cout << *piRV; else cout << "None";
+   cout << "\n  Pages read ahead: ";
+   if (piPP) cout << *piPP; else cout << "None";
+   cout << "\n    Later requested: ";
+   if (piPH) cout << *piPH; else cout << "None";
+   cout << "\n    Dropped unused: ";
+   if (piPW) cout << *piPW; else cout << "None";
    cout << "\nNumber of write requests: ";
    if (piWP) cout << *piWP; else cout << "None";
+   cout << "\n  Issued as vectored writes: ";
+   if (piWV) cout << *piWV; else cout << "None";
+   cout << "\nPages written by the background writer: ";
+   if (piBW) cout << *piBW; else cout << "None";
+   cout << "\n  In write requests: ";
+   if (piBV) cout << *piBV; else cout << "None";
+   cout << "\nFile extents preallocated: ";
+   if (piEX) cout << *piEX; else cout << "None";
    cout << "\n-------------------\n";
    cout << "Number of flushes: ";
    if (piFP) cout << *piFP; else cout << "None";
    cout << "\n-------------------\n";
+   cout << "Number of pages replaced: ";
+   if (piV) cout << *piV; else cout << "None";
+   cout << "\n  Slots examined to find them: ";
+   if (piVP) cout << *piVP; else cout << "None";
+   cout << "\n  Dirty, written out first: ";
+   if (piDV) cout << *piDV; else cout << "None";
+   cout << "\n-------------------\n";
 
    // Must delete the memory returned from StatisticsMgr::Get
    delete piGP;
@@ -58,6 +95,18 @@ void PF_Statistics()
    delete piRP;
    delete piWP;
    delete piFP;
+   delete piV;
+   delete piVP;
+   delete piWV;
+   delete piRV;
+   delete piPP;
+   delete piPH;
+   delete piPW;
+   delete piDV;
+   delete piBW;
+   delete piBV;
+   delete piMP;
+   delete piEX;
 }
 
 #endif
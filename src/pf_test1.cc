@@ -10,7 +10,9 @@
 #include <cstdio>
 #include <iostream>
 #include <cstring>
+#include <vector>
 #include <unistd.h>
+#include <fcntl.h>
 #include "pf.h"
 #include "pf_internal.h"
 #include "pf_hashtable.h"
@@ -114,6 +116,9 @@ RC PrintFile(PF_FileHandle &fh);
 RC ReadFile(PF_Manager &pfm, char* fname);
 RC TestPF();
 RC TestHash();
+RC WalkFile(PF_FileHandle &fh, const PageNum *pageNums, int numPages);
+RC AllocateExpect(PF_FileHandle &fh, PageNum expected);
+RC TestPageMap();
 
 RC WriteFile(PF_Manager &pfm, char *fname)
 {
@@ -507,6 +512,243 @@ RC TestHash()
    return (0);
 }
 
+//
+// WalkFile
+//
+// Desc: Check that the used pages of a file, from the first to the last
+//       and back, are exactly pageNums, and that each holds its number
+//
+RC WalkFile(PF_FileHandle &fh, const PageNum *pageNums, int numPages)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+   PageNum       pageNum, temp;
+   int           i;
+
+   for (i = 0, rc = fh.GetFirstPage(ph); !rc;
+         i++, rc = fh.GetNextPage(pageNum, ph)) {
+      if ((rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return(rc);
+      memcpy((char *)&temp, pData, sizeof(PageNum));
+      if (i >= numPages || pageNum != pageNums[i] || temp != pageNum) {
+         cout << "GetNextPage got page " << (int)pageNum << " holding "
+            << (int)temp << "\n";
+         exit(1);
+      }
+   }
+   if (rc != PF_EOF)
+      return(rc);
+   if (i != numPages) {
+      cout << "GetNextPage got " << i << " pages instead of " << numPages
+         << "\n";
+      exit(1);
+   }
+
+   for (i = numPages - 1, rc = fh.GetLastPage(ph); !rc;
+         i--, rc = fh.GetPrevPage(pageNum, ph)) {
+      if ((rc = ph.GetPageNum(pageNum)) ||
+            (rc = fh.UnpinPage(pageNum)))
+         return(rc);
+      if (i < 0 || pageNum != pageNums[i]) {
+         cout << "GetPrevPage got page " << (int)pageNum << "\n";
+         exit(1);
+      }
+   }
+   if (rc != PF_EOF)
+      return(rc);
+   if (i != -1) {
+      cout << "GetPrevPage missed " << i + 1 << " pages\n";
+      exit(1);
+   }
+
+   // Return ok
+   return (0);
+}
+
+//
+// AllocateExpect
+//
+// Desc: Allocate a page, which must be the given one, and write its
+//       number into it
+//
+RC AllocateExpect(PF_FileHandle &fh, PageNum expected)
+{
+   PF_PageHandle ph;
+   RC            rc;
+   char          *pData;
+   PageNum       pageNum;
+
+   if ((rc = fh.AllocatePage(ph)) ||
+         (rc = ph.GetData(pData)) ||
+         (rc = ph.GetPageNum(pageNum)))
+      return(rc);
+   if (pageNum != expected) {
+      cout << "Allocated page " << (int)pageNum << " instead of "
+         << (int)expected << "\n";
+      exit(1);
+   }
+   memcpy(pData, (char *)&pageNum, sizeof(PageNum));
+   if ((rc = fh.MarkDirty(pageNum)) ||
+         (rc = fh.UnpinPage(pageNum)))
+      return(rc);
+
+   // Return ok
+   return (0);
+}
+
+//
+// TestPageMap tests the page map that tracks the used pages of a file:
+// reuse of the lowest free page, scans skipping disposed pages, the
+// directory pages of a large file and the conversion of a file made
+// with a free list
+//
+RC TestPageMap()
+{
+   PF_Manager    pfm;
+   PF_FileHandle fh;
+   RC            rc;
+   PageNum       i;
+
+   cout << "Testing page map.  Disposing of pages and allocating again\n";
+
+   if ((rc = pfm.CreateFile(FILE1)) ||
+         (rc = pfm.OpenFile(FILE1, fh)))
+      return(rc);
+   for (i = 0; i < 10; i++)
+      if ((rc = AllocateExpect(fh, i)))
+         return(rc);
+
+   // The lowest free page comes first, whatever the order of disposal
+   if ((rc = fh.DisposePage(7)) ||
+         (rc = fh.DisposePage(3)) ||
+         (rc = fh.DisposePage(5)) ||
+         (rc = AllocateExpect(fh, 3)) ||
+         (rc = AllocateExpect(fh, 5)) ||
+         (rc = AllocateExpect(fh, 7)) ||
+         (rc = AllocateExpect(fh, 10)))
+      return(rc);
+
+   if ((rc = fh.DisposePage(3)))
+      return(rc);
+   if ((rc = fh.DisposePage(3)) != PF_PAGEFREE) {
+      cout << "Disposing of a free page should fail: ";
+      return(rc);
+   }
+
+   cout << "Scanning past disposed pages\n";
+
+   PageNum left[] = { 1, 2, 5, 6, 7, 8 };
+   if ((rc = fh.DisposePage(0)) ||
+         (rc = fh.DisposePage(4)) ||
+         (rc = fh.DisposePage(9)) ||
+         (rc = fh.DisposePage(10)) ||
+         (rc = WalkFile(fh, left, 6)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = WalkFile(fh, left, 6)) ||
+         (rc = AllocateExpect(fh, 0)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE1)))
+      return(rc);
+
+   // Past PF_HDR_MAP_PAGES pages the map needs directory pages, which
+   // take page numbers but are never seen by the client
+   cout << "Allocating " << PF_HDR_MAP_PAGES + 100 << " pages\n";
+
+   int numPages = PF_HDR_MAP_PAGES + 100;
+   vector<PageNum> pageNums(numPages);
+   PF_PageHandle ph;
+   if ((rc = pfm.CreateFile(FILE1)) ||
+         (rc = pfm.OpenFile(FILE1, fh)))
+      return(rc);
+   for (i = 0; i < numPages; i++) {
+      char *pData;
+      if ((rc = fh.AllocatePage(ph)) ||
+            (rc = ph.GetData(pData)) ||
+            (rc = ph.GetPageNum(pageNums[i])))
+         return(rc);
+      memcpy(pData, (char *)&pageNums[i], sizeof(PageNum));
+      if ((rc = fh.MarkDirty(pageNums[i])) ||
+            (rc = fh.UnpinPage(pageNums[i])))
+         return(rc);
+      if (i > 0 && pageNums[i] <= pageNums[i - 1]) {
+         cout << "Allocated page " << (int)pageNums[i] << " after "
+            << (int)pageNums[i - 1] << "\n";
+         exit(1);
+      }
+   }
+
+   // Free one page in the header's part of the map and one in a
+   // directory page's, and check that both stay free across close/open
+   cout << "Disposing of pages " << (int)pageNums[100] << " and "
+      << (int)pageNums[numPages - 50] << ", closing and reopening\n";
+   {
+      PageNum low = pageNums[100], high = pageNums[numPages - 50];
+      if ((rc = fh.DisposePage(low)) ||
+            (rc = fh.DisposePage(high)) ||
+            (rc = pfm.CloseFile(fh)) ||
+            (rc = pfm.OpenFile(FILE1, fh)))
+         return(rc);
+      vector<PageNum> kept;
+      for (i = 0; i < numPages; i++)
+         if (pageNums[i] != low && pageNums[i] != high)
+            kept.push_back(pageNums[i]);
+      if ((rc = WalkFile(fh, &kept[0], numPages - 2)) ||
+            (rc = AllocateExpect(fh, low)) ||
+            (rc = AllocateExpect(fh, high)) ||
+            (rc = pfm.CloseFile(fh)) ||
+            (rc = pfm.DestroyFile(FILE1)))
+         return(rc);
+   }
+
+   // A file made before the page map has its free pages linked from the
+   // header: here page 3, then page 1
+   cout << "Opening a file with a free list\n";
+   {
+      char page[PF_FILE_HDR_SIZE];
+      int fd = open(FILE1, O_CREAT | O_EXCL | O_WRONLY, 0600);
+      if (fd < 0)
+         return (PF_UNIX);
+      memset(page, 0, sizeof(page));
+      PF_FileHdr *pHdr = (PF_FileHdr *)page;
+      pHdr->firstFree = 3;
+      pHdr->numPages = 4;
+      if (write(fd, page, sizeof(page)) != sizeof(page))
+         return (PF_UNIX);
+      for (i = 0; i < 4; i++) {
+         memset(page, 0, sizeof(page));
+         ((PF_PageHdr *)page)->nextFree = i == 3 ? 1 :
+            i == 1 ? PF_PAGE_LIST_END : PF_PAGE_USED;
+         memcpy(page + sizeof(PF_PageHdr), (char *)&i, sizeof(PageNum));
+         if (write(fd, page, sizeof(page)) != sizeof(page))
+            return (PF_UNIX);
+      }
+      if (close(fd) < 0)
+         return (PF_UNIX);
+   }
+
+   PageNum used[] = { 0, 2 };
+   PageNum all[] = { 0, 1, 2, 3, 4 };
+   if ((rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = WalkFile(fh, used, 2)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.OpenFile(FILE1, fh)) ||
+         (rc = WalkFile(fh, used, 2)) ||
+         (rc = AllocateExpect(fh, 1)) ||
+         (rc = AllocateExpect(fh, 3)) ||
+         (rc = AllocateExpect(fh, 4)) ||
+         (rc = WalkFile(fh, all, 5)) ||
+         (rc = pfm.CloseFile(fh)) ||
+         (rc = pfm.DestroyFile(FILE1)))
+      return(rc);
+
+   // Return ok
+   return (0);
+}
+
 int main()
 {
    RC rc;
@@ -528,7 +770,8 @@ int main()
 
    // Do tests
    if ((rc = TestPF()) ||
-         (rc = TestHash())) {
+         (rc = TestHash()) ||
+         (rc = TestPageMap())) {
       PF_PrintError(rc);
       return (1);
    }
@@ -82,7 +82,12 @@ enum CompOp {
 // Pin Strategy Hint
 //
 enum ClientHint {
-    NO_HINT                                     // default value
+    NO_HINT,                                    // default value
+    SEQUENTIAL_ONCE,                            // pages read once, in order:
+                                                // evicted first, never
+                                                // displace other pages
+    KEEP_PINNED                                 // scans keep their current
+                                                // page pinned between calls
 };
 
 //
@@ -44,7 +44,8 @@ struct RM_FileHdr {
 //
 class RM_Record {
     friend class RM_FileHandle;     // FileHdl 可访问 Record中私有变量
-    // friend class RM_FileScan;    
+    friend class RM_FileScan;                            // 扫描时直接填充rec
+    friend class RM_RecordView;                          // CopyOut时填充rec
     // friend class QL_Manager;     // TODO 这仨有啥作用吗，反而是加强了耦合性
 public:
     RM_Record ();
@@ -65,6 +66,80 @@ private:
     int recordSize;
 };
 
+class RM_FileHandle;
+
+//
+// RM_RecordView: 指向缓冲区中record的只读视图，不拷贝
+//
+// view存在期间record所在page保持pin，GetData给出的指针一直有效；析构、
+// Release或被再次填充时unpin。可move不可copy（同PF_PageGuard）。文件关闭前
+// 须释放所有view。
+//
+class RM_RecordView {
+    friend class RM_FileHandle;
+    friend class RM_FileScan;
+public:
+    RM_RecordView ();
+    ~RM_RecordView();                               // 自动unpin
+
+    RM_RecordView (RM_RecordView &&view) = default;
+    RM_RecordView& operator=(RM_RecordView &&view) = default;
+
+    RC GetData    (const char *&pData) const;       // 指向page中的record
+    RC GetRid     (RID &rid) const;
+    int GetSize   () const { return (recordSize); }
+
+    // 按需拷贝：拷进rec，或拷进调用者的缓冲区（至少GetSize()字节）
+    RC CopyOut    (RM_Record &rec) const;
+    RC CopyOut    (char *pBuf) const;
+
+    RC Release    ();                               // 立即unpin
+
+private:
+    RM_RecordView (const RM_RecordView &) = delete;
+    RM_RecordView& operator=(const RM_RecordView &) = delete;
+
+    PF_PageGuard pageGuard;                         // record所在page的pin
+    const RM_FileHandle *pFileHandle;               // record所在文件
+    const char *pData;
+    RID rid;
+    int recordSize;
+};
+
+//
+// RM_RecordBatch: 一个page上满足扫描条件的全部record，不拷贝
+//
+// 由RM_FileScan::GetNextBatch一次填充一个page：batch持有page的pin，
+// selection vector中是各record在page中的地址和slot。析构、Release或被
+// 再次填充时unpin。可move不可copy。文件关闭前须释放所有batch。
+//
+class RM_RecordBatch {
+    friend class RM_FileScan;
+public:
+    RM_RecordBatch ();
+    ~RM_RecordBatch();                              // 自动unpin
+
+    RM_RecordBatch (RM_RecordBatch &&batch) = default;
+    RM_RecordBatch& operator=(RM_RecordBatch &&batch) = default;
+
+    int GetNumRecs () const { return (numRecs); }
+    // 第i个record（0 <= i < GetNumRecs()），batch存在期间有效
+    const char *GetData(int i) const { return (apData[i]); }
+    RID GetRid     (int i) const { return (RID(pageNum, aSlots[i])); }
+
+    RC Release     ();                              // 立即unpin
+
+private:
+    RM_RecordBatch (const RM_RecordBatch &) = delete;
+    RM_RecordBatch& operator=(const RM_RecordBatch &) = delete;
+
+    PF_PageGuard pageGuard;                         // record所在page的pin
+    PageNum pageNum;
+    int numRecs;                                    // selection vector长度
+    std::vector<const char *> apData;               // record地址
+    std::vector<SlotNum> aSlots;                    // record的slot
+};
+
 //
 // RM_FileHandle: RM File interface
 //
@@ -77,6 +152,12 @@ public:
 
     // Given a RID, return the record
     RC GetRec     (const RID &rid, RM_Record &rec) const;
+    // 同上，不拷贝：view指向page中的record，并保持page的pin
+    RC GetRec     (const RID &rid, RM_RecordView &view) const;
+    // 同上，拷进调用者的缓冲区pBuf（至少GetRecordSize()字节），不分配内存
+    RC GetRec     (const RID &rid, char *pBuf) const;
+
+    int GetRecordSize() const { return (hdr.recordSize); }
 
     RC InsertRec  (const char *pData, RID &rid);       // Insert a new record
 
@@ -93,6 +174,10 @@ private:
     bool bFileOpen;                                              // file open flag
     bool bHdrChanged;                                            // dirty flag for file hdr
     
+    // pin住rid所在page，并找到record在page中的地址
+    RC PinRec           (const RID &rid, PF_PageGuard &pg,
+                         char *&pRecData) const;
+
     // Functions for handling bitmap
     bool GetBit         (const char *pBitmap, SlotNum slotNum) const;
     void SetBit         (char *pBitmap, SlotNum slotNum) const;
@@ -105,26 +190,43 @@ private:
 //
 class RM_Manager {
     // friend class QL_Manager;        // for accessing pf manager TODO
+    friend class SM_Manager;          // for tuning the buffer pool
 public:
     RM_Manager    (PF_Manager &pfm);
     ~RM_Manager   ();
 
-    RC CreateFile (const char *fileName, int recordSize);
+    RC CreateFile (const char *fileName, int recordSize,
+                   int pageBytes = PF_MIN_PAGE_BYTES);
     RC DestroyFile(const char *fileName);
-    RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle);
+    // pool为文件页所在的缓冲池
+    RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle,
+                   PF_PoolId pool = PF_POOL_DATA);
 
     RC CloseFile  (RM_FileHandle &fileHandle);
     
 private:
     PF_Manager *pPfManager;
     
-    // 根据recordSize计算每个Page上容纳的record个数     TODO，测试是否需要加入调整bitmapSize的部分。
-    int GetRecNumPerPage(const int recordSize) const;
+    // 根据recordSize及RM page的可用空间计算每个Page上容纳的record个数     TODO，测试是否需要加入调整bitmapSize的部分。
+    int GetRecNumPerPage(const int recordSize, const int rmPageSize) const;
     
     // 根据每个Page上容纳的record个数计算bitmap size
     int GetBitmapSize(const int recNumPerPage) const;
 };
 
+//
+// RM_Condition: 扫描条件，record中的属性与常量或同一record中另一属性比较
+//
+struct RM_Condition {
+    AttrType attrType;      // 两侧的类型
+    int      attrLength;    // 两侧的长度
+    int      lhsOffset;     // 左侧属性在record中的offset
+    CompOp   op;
+    bool     bRhsIsAttr;    // TRUE时右侧为属性，否则为常量
+    int      rhsOffset;     // 右侧属性在record中的offset
+    void     *rhsValue;     // 右侧常量，OpenScan时拷贝
+};
+
 //
 // RM_FileScan： RM File Scan interface
 //
@@ -140,7 +242,14 @@ public:
                   CompOp     compOp,
                   void       *value,
                   ClientHint pinHint = NO_HINT); // Initialize a file scan
+    // 同上，record须满足全部numConds个条件（合取）
+    RC OpenScan  (const RM_FileHandle &fileHandle,
+                  int        numConds,
+                  const RM_Condition conds[],
+                  ClientHint pinHint = NO_HINT);
     RC GetNextRec(RM_Record &rec);               // Get next matching record
+    RC GetNextRec(RM_RecordView &view);          // 同上，不拷贝
+    RC GetNextBatch(RM_RecordBatch &batch);      // 下一个page上全部匹配的record
     RC CloseScan ();                             // Close the scan
 
 private:
@@ -148,18 +257,45 @@ private:
     bool bScanOpen;
 
     RM_FileHandle *pRmFh;
-    int      attrLength;
-    int      attrOffset;
-    AttrType attrType;
-    bool    (*Operate)(void *pValue1, void *pValue2, AttrType attrType, int attrLength);
-    void    *pValue;
+
+    // 一个扫描条件：lhs op rhs
+    struct Cond {
+        AttrType attrType;
+        int      attrLength;
+        int      lhsOffset;
+        int      rhsOffset;         // 右侧为属性时其offset，否则为-1
+        int      valueOffset;       // 右侧为常量时其拷贝在values中的位置，否则为-1
+        bool    (*Operate)(void *pValue1, void *pValue2, AttrType attrType, int attrLength);
+        // 整页求条件的kernel（rm_filter.cc），只用于与4字节INT/FLOAT常量
+        // 的比较，其他条件为NULL
+        void    (*Filter)(const char *pAttr, int recordSize, int numSlots,
+                          const void *pValue, const char *pBitmap, char *pMatch);
+        double   cost;              // 对一个rec求值的估计代价
+        double   selectivity;       // 没有统计时的估计选择率
+        long long numEvaluated;     // 求值过的rec数
+        long long numPassed;        // 其中满足条件的rec数
+    };
+    std::vector<Cond> conds;        // 按求值顺序排列，NO_OP的条件不在其中
+    std::vector<char> values;       // 各条件右侧常量的拷贝
+    std::vector<char> matchBits;    // kernel输出的匹配bitmap
     ClientHint pinHint = NO_HINT; 
 
     // 记录当前遍历位置
     PageNum currentPage;
-    SlotNum currentSlot;
+    SlotNum currentSlot;                         // 当前page扫描完时为RM_SLOT_EOF
+
+    // 当前page；pinHint为KEEP_PINNED时在两次GetNextRec之间保持pin
+    PF_PageGuard pageGuard;
+
+    RC AddCondition   (const RM_Condition &cond);  // 检查并加入一个条件
+    void OrderConditions();                        // 按代价和选择率排序
+    bool Matches      (const char *pRecData);      // rec是否满足全部条件
+    // 一个page上未返回过且满足全部条件的rec的slot，返回个数
+    int FilterPage    (const char *pBitmap, const char *pRecs, SlotNum *aSlots);
 
     SlotNum GetNextRecSlot(const char *pBitmap) const;
+    // 找到下一个满足条件的record，其page在pageGuard中保持pin
+    RC NextMatch (char *&pRecData);
 };
 
 //
@@ -183,7 +319,8 @@ void RM_PrintError(RC rc);
 #define RM_INVALIDATTROFFSET        (START_RM_WARN + 12)    // 属性值offset错误
 #define RM_UNDEFCOMPOP              (START_RM_WARN + 13)    // 未定义的运算符
 #define RM_EOF                      (START_RM_WARN + 14)    // End of file
-#define RM_LASTWARN                 RM_EOF
+#define RM_NULLVALUE                (START_RM_WARN + 15)    // 条件或比较的常量为NULL
+#define RM_LASTWARN                 RM_NULLVALUE
 
 // Errors
 #define RM_INVALIDRECORDNUM         (START_RM_ERR - 0) // Invalid PC recdor name
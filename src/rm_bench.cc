@@ -0,0 +1,650 @@
+//
+// File:        rm_bench.cc
+// Description: Benchmarks for the RM component
+//
+// Usage:  rm_bench [benchmark ...]
+//
+// With no arguments every benchmark is run.  The benchmarks are:
+//
+//   scan      - rows per second of a full scan of a file whose pages are
+//             all in the buffer, with every row copied into an RM_Record,
+//             with every row seen in place through an RM_RecordView, and
+//             a page of rows at a time through an RM_RecordBatch, for
+//             each pin hint
+//   fetch     - rows per second of fetching rows by RID in random order:
+//             into a new RM_Record each time (the way GetRec used to
+//             work), into one RM_Record reused, through an RM_RecordView
+//             and into a buffer of the caller
+//   filter    - nanoseconds per slot of evaluating a predicate over a page
+//             of slots, for each type and operator: through Operate one
+//             row at a time (as the scans did), with the scalar kernel
+//             and with the AVX2 kernel, checking they all agree
+//   operate   - nanoseconds per row of comparing an INT, FLOAT and STRING
+//             attribute with a constant through the comparison function
+//             that switches on the type (as the scans did), through the
+//             specialized one OpenScan now picks, and inlined; then rows
+//             per second of scans of the file with such a predicate,
+//             a row and a page at a time
+//   conj      - rows per second of a scan with three conditions, given
+//             worst first: a STRING and a FLOAT condition every row
+//             passes, and an INT condition 1 row in 100 passes.  With
+//             the scan taking the first condition and the caller
+//             testing the others on a copy of each row (as callers had
+//             to), and with the scan taking all three, a row and a page
+//             at a time
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+#include "rm_internal.h"
+#include "operations.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define BENCHFILE        "rm_bench.dat"
+#define NUM_RECS         200000         // rows in the benchmark file
+#define RECLEN           64             // bytes per row
+#define BUFFER_PAGES     4096           // buffer pages, more than the file
+#define SCAN_ROUNDS      20             // full scans per case
+#define FETCHES          1000000        // rows fetched per case
+#define STRLEN           16             // bytes of the STRING attribute
+#define FILTER_SLOTS     4096           // slots of the filtered page
+#define FILTER_RECLEN    16             // bytes per slot, attribute at 4
+#define FILTER_ROUNDS    2000           // passes over the page per case
+
+//
+// Now
+//
+// Desc: Wall clock time in seconds
+//
+static double Now()
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//
+// CreateBenchFile
+//
+// Desc: Create an RM file of NUM_RECS rows, each starting with its number
+//       as an INT, then as a FLOAT and as a STRING of STRLEN bytes
+// Out:  rids - RIDs of the rows, in insertion order
+//
+static RC CreateBenchFile(RM_Manager &rmm, vector<RID> &rids)
+{
+   RM_FileHandle fh;
+   char rec[RECLEN];
+   RID rid;
+   RC rc;
+
+   unlink(BENCHFILE);
+   if ((rc = rmm.CreateFile(BENCHFILE, RECLEN)) ||
+       (rc = rmm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   memset(rec, 'r', RECLEN);
+   rids.clear();
+   for (int i = 0; i < NUM_RECS; i++) {
+      float f = i;
+      memcpy(rec, &i, sizeof(i));
+      memcpy(rec + 4, &f, sizeof(f));
+      snprintf(rec + 8, STRLEN, "row%012d", i);
+      if ((rc = fh.InsertRec(rec, rid)))
+         return (rc);
+      rids.push_back(rid);
+   }
+
+   return (rmm.CloseFile(fh));
+}
+
+//
+// Checksum
+//
+// Desc: Fold the number at the start of a row into a sum, so that the
+//       rows are really read
+//
+static inline void Checksum(long long &sum, const char *pData)
+{
+   int i;
+   memcpy(&i, pData, sizeof(i));
+   sum += i;
+}
+
+//
+// BenchScan
+//
+static RC BenchScan()
+{
+   static const struct {
+      const char *name;
+      ClientHint hint;
+   } hints[] = {
+      { "none",     NO_HINT },
+      { "once",     SEQUENTIAL_ONCE },
+      { "pinned",   KEEP_PINNED },
+   };
+   PF_Manager pfm;
+   RM_Manager rmm(pfm);
+   RM_FileHandle fh;
+   vector<RID> rids;
+   RC rc;
+
+   if ((rc = pfm.ResizeBuffer(BUFFER_PAGES)) ||
+       (rc = CreateBenchFile(rmm, rids)) ||
+       (rc = rmm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   cout << "Scan of " << NUM_RECS << " rows of " << RECLEN
+        << " bytes, all pages buffered, " << SCAN_ROUNDS << " rounds\n";
+   cout << setw(8) << "hint" << setw(14) << "copy rows/s"
+        << setw(14) << "view rows/s" << setw(15) << "batch rows/s"
+        << setw(13) << "batch ns/row" << "\n";
+
+   for (unsigned h = 0; h < sizeof(hints) / sizeof(hints[0]); h++) {
+      double rate[3];
+
+      // 0 copies, 1 views, 2 batches
+      for (int mode = 0; mode < 3; mode++) {
+         RM_FileScan scan;
+         RM_Record rec;
+         RM_RecordView view;
+         RM_RecordBatch batch;
+         long long sum = 0, rows = 0;
+         const char *pData;
+         char *pCopy;
+
+         double start = Now();
+         for (int r = 0; r < SCAN_ROUNDS; r++) {
+            if ((rc = scan.OpenScan(fh, INT, sizeof(int), 0, NO_OP, NULL,
+                                    hints[h].hint)))
+               return (rc);
+            if (mode == 2) {
+               while ((rc = scan.GetNextBatch(batch)) == OK_RC) {
+                  for (int i = 0; i < batch.GetNumRecs(); i++)
+                     Checksum(sum, batch.GetData(i));
+                  rows += batch.GetNumRecs();
+               }
+            } else if (mode == 1) {
+               while ((rc = scan.GetNextRec(view)) == OK_RC) {
+                  view.GetData(pData);
+                  Checksum(sum, pData);
+                  rows++;
+               }
+            } else {
+               while ((rc = scan.GetNextRec(rec)) == OK_RC) {
+                  rec.GetData(pCopy);
+                  Checksum(sum, pCopy);
+                  rows++;
+               }
+            }
+            if (rc != RM_EOF || (rc = scan.CloseScan()))
+               return (rc);
+         }
+         rate[mode] = rows / (Now() - start);
+
+         if (rows != (long long)NUM_RECS * SCAN_ROUNDS ||
+             sum != (long long)NUM_RECS * (NUM_RECS - 1) / 2 * SCAN_ROUNDS) {
+            cout << "wrong rows returned\n";
+            exit(1);
+         }
+      }
+
+      cout << setw(8) << hints[h].name << fixed << setprecision(0)
+           << setw(14) << rate[0] << setw(14) << rate[1]
+           << setw(15) << rate[2] << setprecision(1)
+           << setw(13) << 1e9 / rate[2] << "\n";
+   }
+
+   if ((rc = rmm.CloseFile(fh)) ||
+       (rc = rmm.DestroyFile(BENCHFILE)))
+      return (rc);
+   return (0);
+}
+
+//
+// BenchFetch
+//
+static RC BenchFetch()
+{
+   static const char *names[] = {
+      "new RM_Record", "reused RM_Record", "RM_RecordView", "caller buffer"
+   };
+   PF_Manager pfm;
+   RM_Manager rmm(pfm);
+   RM_FileHandle fh;
+   vector<RID> rids;
+   vector<int> order(FETCHES);
+   char buf[RECLEN];
+   double rate[4];
+   RC rc;
+
+   if ((rc = pfm.ResizeBuffer(BUFFER_PAGES)) ||
+       (rc = CreateBenchFile(rmm, rids)) ||
+       (rc = rmm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   srand(1);
+   long long expect = 0;
+   for (int i = 0; i < FETCHES; i++) {
+      order[i] = rand() % NUM_RECS;
+      expect += order[i];
+   }
+
+   cout << "Fetch of " << FETCHES << " rows by RID in random order, "
+        << "all pages buffered\n";
+   cout << setw(20) << "into" << setw(14) << "rows/s"
+        << setw(10) << "speedup" << "\n";
+
+   for (int c = 0; c < 4; c++) {
+      RM_Record reused;
+      RM_RecordView view;
+      long long sum = 0;
+      const char *pData;
+      char *pCopy;
+
+      double start = Now();
+      for (int i = 0; i < FETCHES; i++) {
+         const RID &rid = rids[order[i]];
+         if (c == 0) {
+            RM_Record rec;
+            if ((rc = fh.GetRec(rid, rec)))
+               return (rc);
+            rec.GetData(pCopy);
+            Checksum(sum, pCopy);
+         } else if (c == 1) {
+            if ((rc = fh.GetRec(rid, reused)))
+               return (rc);
+            reused.GetData(pCopy);
+            Checksum(sum, pCopy);
+         } else if (c == 2) {
+            if ((rc = fh.GetRec(rid, view)))
+               return (rc);
+            view.GetData(pData);
+            Checksum(sum, pData);
+         } else {
+            if ((rc = fh.GetRec(rid, buf)))
+               return (rc);
+            Checksum(sum, buf);
+         }
+      }
+      rate[c] = FETCHES / (Now() - start);
+      if ((rc = view.Release()))
+         return (rc);
+
+      if (sum != expect) {
+         cout << "wrong rows returned\n";
+         exit(1);
+      }
+      cout << setw(20) << names[c] << fixed << setprecision(0)
+           << setw(14) << rate[c] << setprecision(2)
+           << setw(9) << rate[c] / rate[0] << "x\n";
+   }
+
+   if ((rc = rmm.CloseFile(fh)) ||
+       (rc = rmm.DestroyFile(BENCHFILE)))
+      return (rc);
+   return (0);
+}
+
+//
+// OperateFilter
+//
+// Desc: Evaluate a predicate over a page of slots one row at a time
+//       through the comparison function, writing a match bitmap as the
+//       kernels do
+//
+static void OperateFilter(bool (*Operate)(void *, void *, AttrType, int),
+                          AttrType attrType, const char *pAttr, int numSlots,
+                          void *pValue, const char *pBitmap, char *pMatch)
+{
+   for (int i = 0; i < (numSlots + 7) / 8; i++) {
+      unsigned int match = 0;
+      for (int j = 0; j < 8 && i * 8 + j < numSlots; j++)
+         if ((pBitmap[i] & (0x80 >> j)) &&
+             Operate((void *)(pAttr + (i * 8 + j) * FILTER_RECLEN), pValue,
+                     attrType, 4))
+            match |= 0x80 >> j;
+      pMatch[i] = (char)match;
+   }
+}
+
+//
+// BenchFilter
+//
+static RC BenchFilter()
+{
+   static const struct {
+      const char *name;
+      CompOp op;
+      bool (*Operate)(void *, void *, AttrType, int);
+   } ops[] = {
+      { "=",  EQ_OP, Equal },
+      { "<>", NE_OP, NotEqual },
+      { "<",  LT_OP, LessThan },
+      { ">",  GT_OP, GreaterThan },
+      { "<=", LE_OP, LessThanOrEqual },
+      { ">=", GE_OP, GreaterThanOrEqual },
+   };
+   static const RM_FilterImpl impls[] = { RM_FILTER_SCALAR, RM_FILTER_AVX2 };
+   vector<char> recs(FILTER_SLOTS * FILTER_RECLEN);
+   vector<char> bitmap(FILTER_SLOTS / 8), expect(FILTER_SLOTS / 8);
+   vector<char> match(FILTER_SLOTS / 8);
+   const char *pAttr = recs.data() + 4;
+
+   // Values 0..999, about 7 slots in 8 used; the constant is 500
+   srand(1);
+   for (int i = 0; i < FILTER_SLOTS / 8; i++)
+      bitmap[i] = (char)(rand() | rand());
+
+   cout << "Predicate over " << FILTER_SLOTS << " slots of "
+        << FILTER_RECLEN << " bytes, ns per slot\n";
+   cout << setw(6) << "type" << setw(4) << "op" << setw(10) << "Operate"
+        << setw(10) << "scalar" << setw(10) << "avx2" << "\n";
+
+   for (int t = 0; t < 2; t++) {
+      AttrType attrType = t == 0 ? INT : FLOAT;
+      int iValue = 500;
+      float fValue = 500;
+      void *pValue = t == 0 ? (void *)&iValue : (void *)&fValue;
+
+      for (int i = 0; i < FILTER_SLOTS; i++) {
+         int v = rand() % 1000;
+         float f = v;
+         memcpy(&recs[i * FILTER_RECLEN + 4], t == 0 ? (void *)&v : (void *)&f, 4);
+      }
+
+      for (unsigned o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+         double ns[3];
+
+         double start = Now();
+         for (int r = 0; r < FILTER_ROUNDS; r++)
+            OperateFilter(ops[o].Operate, attrType, pAttr, FILTER_SLOTS,
+                          pValue, bitmap.data(), expect.data());
+         ns[0] = (Now() - start) * 1e9 / FILTER_ROUNDS / FILTER_SLOTS;
+
+         for (int k = 0; k < 2; k++) {
+            RM_FilterKernel Filter = RM_GetFilterKernel(attrType, 4, ops[o].op,
+                                                        impls[k]);
+            ns[k + 1] = -1;
+            if (Filter == NULL)
+               continue;
+
+            start = Now();
+            for (int r = 0; r < FILTER_ROUNDS; r++)
+               Filter(pAttr, FILTER_RECLEN, FILTER_SLOTS, pValue,
+                      bitmap.data(), match.data());
+            ns[k + 1] = (Now() - start) * 1e9 / FILTER_ROUNDS / FILTER_SLOTS;
+
+            if (match != expect) {
+               cout << "kernel disagrees with Operate\n";
+               exit(1);
+            }
+         }
+
+         cout << setw(6) << (t == 0 ? "INT" : "FLOAT") << setw(4)
+              << ops[o].name << fixed << setprecision(2);
+         for (int k = 0; k < 3; k++)
+            if (ns[k] < 0)
+               cout << setw(10) << "-";
+            else
+               cout << setw(10) << ns[k];
+         cout << "\n";
+      }
+   }
+   return (0);
+}
+
+//
+// BenchOperate
+//
+static RC BenchOperate()
+{
+   static const struct {
+      const char *name;
+      AttrType attrType;
+      int attrLength;
+      int attrOffset;
+   } attrs[] = {
+      { "INT",    INT,    4,      0 },
+      { "FLOAT",  FLOAT,  4,      4 },
+      { "STRING", STRING, STRLEN, 8 },
+   };
+   PF_Manager pfm;
+   RM_Manager rmm(pfm);
+   RM_FileHandle fh;
+   vector<RID> rids;
+   RC rc;
+
+   if ((rc = pfm.ResizeBuffer(BUFFER_PAGES)) ||
+       (rc = CreateBenchFile(rmm, rids)) ||
+       (rc = rmm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   // Rows read straight from the pages for the comparison loops
+   vector<const char *> rows;
+   {
+      RM_FileScan scan;
+      RM_RecordBatch batch;
+      if ((rc = scan.OpenScan(fh, INT, 4, 0, NO_OP, NULL)))
+         return (rc);
+      while ((rc = scan.GetNextBatch(batch)) == OK_RC)
+         for (int i = 0; i < batch.GetNumRecs(); i++)
+            rows.push_back(batch.GetData(i));
+      if (rc != RM_EOF || (rc = scan.CloseScan()))
+         return (rc);
+   }
+
+   cout << "Predicate attr > constant (half the rows match) over "
+        << NUM_RECS << " rows\n";
+   cout << setw(8) << "type" << setw(11) << "generic" << setw(13)
+        << "specialized" << setw(10) << "inlined" << setw(14)
+        << "row rows/s" << setw(14) << "page rows/s" << "\n";
+
+   for (int a = 0; a < 3; a++) {
+      char value[STRLEN];
+      int half = NUM_RECS / 2;
+      float fHalf = half;
+      long long count[3] = { 0, 0, 0 };
+      double ns[3];
+
+      if (attrs[a].attrType == INT)
+         memcpy(value, &half, 4);
+      else if (attrs[a].attrType == FLOAT)
+         memcpy(value, &fHalf, 4);
+      else
+         snprintf(value, STRLEN, "row%012d", half);
+
+      // 0: switch on the type, 1: specialized pointer, 2: inlined
+      OperateFunc Specialized = GetOperation(attrs[a].attrType, GT_OP);
+      for (int k = 0; k < 3; k++) {
+         double start = Now();
+         for (int r = 0; r < SCAN_ROUNDS; r++)
+            for (size_t i = 0; i < rows.size(); i++) {
+               void *pAttr = (void *)(rows[i] + attrs[a].attrOffset);
+               bool b;
+               if (k == 0)
+                  b = GreaterThan(pAttr, value, attrs[a].attrType,
+                                  attrs[a].attrLength);
+               else if (k == 1)
+                  b = Specialized(pAttr, value, attrs[a].attrType,
+                                  attrs[a].attrLength);
+               else if (attrs[a].attrType == INT)
+                  b = Compare<INT, GT_OP>(pAttr, value, 4);
+               else if (attrs[a].attrType == FLOAT)
+                  b = Compare<FLOAT, GT_OP>(pAttr, value, 4);
+               else
+                  b = Compare<STRING, GT_OP>(pAttr, value, STRLEN);
+               count[k] += b;
+            }
+         ns[k] = (Now() - start) * 1e9 / SCAN_ROUNDS / rows.size();
+      }
+
+      // Scans with the predicate, a row and a page at a time
+      double rate[2];
+      long long matched[2] = { 0, 0 };
+      for (int bBatch = 0; bBatch < 2; bBatch++) {
+         RM_FileScan scan;
+         RM_RecordView view;
+         RM_RecordBatch batch;
+
+         double start = Now();
+         for (int r = 0; r < SCAN_ROUNDS; r++) {
+            if ((rc = scan.OpenScan(fh, attrs[a].attrType, attrs[a].attrLength,
+                                    attrs[a].attrOffset, GT_OP, value)))
+               return (rc);
+            if (bBatch)
+               while ((rc = scan.GetNextBatch(batch)) == OK_RC)
+                  matched[1] += batch.GetNumRecs();
+            else
+               while ((rc = scan.GetNextRec(view)) == OK_RC)
+                  matched[0]++;
+            if (rc != RM_EOF || (rc = scan.CloseScan()))
+               return (rc);
+         }
+         rate[bBatch] = (double)NUM_RECS * SCAN_ROUNDS / (Now() - start);
+      }
+
+      long long expect = (long long)(NUM_RECS - half - 1) * SCAN_ROUNDS;
+      if (count[0] != expect || count[1] != expect || count[2] != expect ||
+          matched[0] != expect || matched[1] != expect) {
+         cout << "wrong rows matched\n";
+         exit(1);
+      }
+      cout << setw(8) << attrs[a].name << fixed << setprecision(2)
+           << setw(11) << ns[0] << setw(13) << ns[1] << setw(10) << ns[2]
+           << setprecision(0) << setw(14) << rate[0] << setw(14) << rate[1]
+           << "\n";
+   }
+
+   if ((rc = rmm.CloseFile(fh)) ||
+       (rc = rmm.DestroyFile(BENCHFILE)))
+      return (rc);
+   return (0);
+}
+
+//
+// BenchConj
+//
+static RC BenchConj()
+{
+   PF_Manager pfm;
+   RM_Manager rmm(pfm);
+   RM_FileHandle fh;
+   vector<RID> rids;
+   char sValue[STRLEN] = "row";
+   float fValue = -1;
+   int iValue = NUM_RECS / 100;
+   RM_Condition conds[3] = {
+      { STRING, STRLEN, 8, GE_OP, false, 0, sValue },
+      { FLOAT,  4,      4, NE_OP, false, 0, &fValue },
+      { INT,    4,      0, LT_OP, false, 0, &iValue },
+   };
+   static const char *names[] = {
+      "first in scan, rest by caller", "all in scan, rows",
+      "all in scan, pages"
+   };
+   RC rc;
+
+   if ((rc = pfm.ResizeBuffer(BUFFER_PAGES)) ||
+       (rc = CreateBenchFile(rmm, rids)) ||
+       (rc = rmm.OpenFile(BENCHFILE, fh)))
+      return (rc);
+
+   cout << "Scan of " << NUM_RECS << " rows with 3 conditions, "
+        << iValue << " rows match\n";
+   cout << setw(30) << "" << setw(14) << "rows/s" << setw(10) << "speedup"
+        << "\n";
+
+   double rate[3];
+   for (int mode = 0; mode < 3; mode++) {
+      RM_FileScan scan;
+      RM_Record rec;
+      RM_RecordView view;
+      RM_RecordBatch batch;
+      long long matched = 0;
+      char *pData;
+
+      double start = Now();
+      for (int r = 0; r < SCAN_ROUNDS; r++) {
+         if ((rc = scan.OpenScan(fh, mode == 0 ? 1 : 3, conds)))
+            return (rc);
+         if (mode == 0) {
+            while ((rc = scan.GetNextRec(rec)) == OK_RC) {
+               rec.GetData(pData);
+               if (NotEqual(pData + 4, &fValue, FLOAT, 4) &&
+                   LessThan(pData, &iValue, INT, 4))
+                  matched++;
+            }
+         } else if (mode == 1) {
+            while ((rc = scan.GetNextRec(view)) == OK_RC)
+               matched++;
+         } else {
+            while ((rc = scan.GetNextBatch(batch)) == OK_RC)
+               matched += batch.GetNumRecs();
+         }
+         if (rc != RM_EOF || (rc = scan.CloseScan()))
+            return (rc);
+      }
+      rate[mode] = (double)NUM_RECS * SCAN_ROUNDS / (Now() - start);
+
+      if (matched != (long long)iValue * SCAN_ROUNDS) {
+         cout << "wrong rows matched\n";
+         exit(1);
+      }
+      cout << setw(30) << names[mode] << fixed << setprecision(0)
+           << setw(14) << rate[mode] << setprecision(2) << setw(9)
+           << rate[mode] / rate[0] << "x\n";
+   }
+
+   if ((rc = rmm.CloseFile(fh)) ||
+       (rc = rmm.DestroyFile(BENCHFILE)))
+      return (rc);
+   return (0);
+}
+
+//
+// Table of benchmarks
+//
+static struct {
+   const char *name;
+   RC (*run)();
+} benchmarks[] = {
+   { "scan",    BenchScan },
+   { "fetch",   BenchFetch },
+   { "filter",  BenchFilter },
+   { "operate", BenchOperate },
+   { "conj",    BenchConj },
+};
+
+int main(int argc, char *argv[])
+{
+   int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+   RC rc;
+
+   for (int b = 0; b < numBenchmarks; b++) {
+      bool bRun = (argc == 1);
+      for (int i = 1; i < argc; i++)
+         if (strcmp(argv[i], benchmarks[b].name) == 0)
+            bRun = true;
+      if (!bRun)
+         continue;
+
+      if ((rc = benchmarks[b].run())) {
+         RM_PrintError(rc);
+         return (1);
+      }
+      cout << "\n";
+   }
+
+   return (0);
+}
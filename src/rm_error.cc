@@ -28,7 +28,9 @@ static char *RM_WarnMsg[] = {
   (char*)"未定义的Type",
   (char*)"属性长度错误",
   (char*)"属性值offset错误",
-  (char*)"未定义的运算符"
+  (char*)"未定义的运算符",
+  (char*)"End of file",
+  (char*)"条件或比较的常量为NULL"
 };
 
 static char *RM_ErrorMsg[] = {
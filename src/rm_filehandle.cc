@@ -32,30 +32,32 @@ RM_FileHandle::~RM_FileHandle()
 }
 
 //
-// 
+// PinRec
 //
-// Desc: 根据RID获取对应的Record，对Record内容进行 **拷贝** 后，
-//       将该拷贝出的Record副本的地址赋给rec，再把rid也存入rec后作为返回值。
-// In:   
-// Ret:  
+// Desc: pin住rid所在page，检查rid合法后给出record在page中的地址。
+//       返回后page由pg保持pin。
+// In:   rid - record的RID
+// Out:  pg - 保持page的pin
+//       pRecData - record在page中的地址
+// Ret:  RM return code
 //
-RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const
+RC RM_FileHandle::PinRec(const RID &rid, PF_PageGuard &pg,
+                         char *&pRecData) const
 {
     // File must be open
     if (!bFileOpen)
       return (RM_CLOSEDFILE);
 
     RC rc;
-    PF_PageHandle ph;
     PageNum pageNum;
     SlotNum slotNum;
     RM_PageHdr *pPageHdr;
     char *pData;
 
-    // 打开对应page，并读出数据
+    // 打开对应page，并读出数据（pg析构时自动unpin）
     if((rc = rid.GetPageNum(pageNum))           ||
-       (rc = pfFh.GetThisPage(pageNum, ph))     ||
-       (rc = ph.GetData(pData)))
+       (rc = pfFh.GetThisPage(pageNum, pg))     ||
+       (rc = pg.GetData(pData)))
         return (rc);     
        
     // 检查page合法性
@@ -70,27 +72,116 @@ RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const
     // 检查slot合法性
     // 注：pData已经跳过PF_PageHdr部分了
     int offset = hdr.bitmapOffset;
-    if((FALSE == GetBit(pData + offset, slotNum))     ||
-       (slotNum >= hdr.recNumPerPage))
+    if((slotNum < 0) || (slotNum >= hdr.recNumPerPage) ||
+       (FALSE == GetBit(pData + offset, slotNum)))
         return (RM_INVALIDSLOTNUM);
 
-    // 根据slotNum计算Rec内容的起始地址     TODO 多次计算的话，就函数化。
-    offset = hdr.bitmapSize + hdr.recordSize * slotNum;
-        
+    // 根据slotNum计算Rec内容的起始地址
+    pRecData = pData + hdr.bitmapOffset + hdr.bitmapSize +
+               hdr.recordSize * slotNum;
+    return (OK_RC);
+}
+
+//
+// GetRec
+//
+// Desc: 根据RID获取对应的Record，对Record内容进行 **拷贝** 后存入rec，
+//       再把rid也存入rec。rec中已有同样大小的缓冲区时重用它。
+// In:   rid - record的RID
+// Out:  rec - record的拷贝
+// Ret:  RM return code
+//
+RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const
+{
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_GETREC);
+#endif
+
+    RC rc;
+    PF_PageGuard pg;
+    char *pRecData;
+
+    if((rc = PinRec(rid, pg, pRecData)))
+        return (rc);
+
     // 将Record内容拷贝后，把地址赋给rec中指针
+    if(rec.pData == NULL || rec.recordSize != hdr.recordSize)
+    {
+        delete [] rec.pData;
+        rec.pData = new char[hdr.recordSize];
+    }
     rec.recordSize = hdr.recordSize;
-    rec.pData = new char[hdr.recordSize];
-    strncpy(rec.pData, pData + offset, hdr.recordSize);     // 注：strncpy不加字符串终止符
+    memcpy(rec.pData, pRecData, hdr.recordSize);      // 注：rec中可能有0字节，不能用strncpy
 
     // 将rid存入rec
     rec.rid = rid;
 
     // unpinned page
-    rc = pfFh.UnpinPage(pageNum);
-    
+    return (pg.UnpinPage());
+}
+
+//
+// GetRec
+//
+// Desc: 根据RID获取对应的Record，不拷贝：view指向page中的record，并接管
+//       page的pin，直到view被释放。view原先的pin先被释放。
+// In:   rid - record的RID
+// Out:  view - 指向record
+// Ret:  RM return code
+//
+RC RM_FileHandle::GetRec(const RID &rid, RM_RecordView &view) const
+{
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_GETREC);
+#endif
+
+    RC rc;
+    char *pRecData;
+
+    if((rc = view.Release()))
+        return (rc);
+
+    // PinRec检查slot前page已经pin在view中，失败时须unpin
+    if((rc = PinRec(rid, view.pageGuard, pRecData)))
+    {
+        view.Release();
+        return (rc);
+    }
+
+    view.pFileHandle = this;
+    view.pData = pRecData;
+    view.rid = rid;
+    view.recordSize = hdr.recordSize;
     return (OK_RC);
 }
 
+//
+// GetRec
+//
+// Desc: 根据RID获取对应的Record，拷进调用者的缓冲区，不分配内存
+// In:   rid - record的RID
+// Out:  pBuf - record的拷贝，至少GetRecordSize()字节
+// Ret:  RM return code
+//
+RC RM_FileHandle::GetRec(const RID &rid, char *pBuf) const
+{
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_GETREC);
+#endif
+
+    RC rc;
+    PF_PageGuard pg;
+    char *pRecData;
+
+    if(pBuf == NULL)
+        return (RM_INVALIDRECORD);
+    if((rc = PinRec(rid, pg, pRecData)))
+        return (rc);
+
+    memcpy(pBuf, pRecData, hdr.recordSize);
+    return (pg.UnpinPage());
+}
+
 //
 // InsertRec
 //
@@ -104,6 +195,10 @@ RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const
 //
 RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
 {
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_INSERTREC);
+#endif
+
     // File must be open
     if (!bFileOpen)
       return (RM_CLOSEDFILE);
@@ -113,7 +208,7 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
     // 局部变量
     RC rc;
     RM_PageHdr *pPageHdr;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     PageNum pageNum;
     SlotNum slotNum;
     char *pPageData;
@@ -125,20 +220,20 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
     if(hdr.firstFree != RM_PAGE_LIST_END)
     {   // freeList中有未满的page...
         pageNum = hdr.firstFree;   
-        if((rc = pfFh.GetThisPage(pageNum, ph))     ||
-           (rc = ph.  GetData    (pPageData)))
+        if((rc = pfFh.GetThisPage(pageNum, pg))     ||
+           (rc = pg.  GetData    (pPageData)))
             return (rc);
     }
     else
     {   // freeList为空，需要分配新的page...
 
         // 分配新page
-        if((rc = pfFh.AllocatePage(ph))             ||
-           (rc = ph.  GetPageNum  (pageNum)))
+        if((rc = pfFh.AllocatePage(pg))             ||
+           (rc = pg.  GetPageNum  (pageNum)))
             return (rc);
 
         // 初始化新page的RM_PageHdr
-        if(rc = ph.GetData(pPageData))
+        if(rc = pg.GetData(pPageData))
             return (rc);
         
         pPageHdr = (RM_PageHdr*)pPageData;
@@ -158,7 +253,7 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
 
     // 插入数据并获取RID
     offset = hdr.bitmapOffset + hdr.bitmapSize + hdr.recordSize * slotNum;
-    strncpy(pPageData + offset, pData, hdr.recordSize);
+    memcpy(pPageData + offset, pData, hdr.recordSize);
     RID temp(pageNum, slotNum);
     rid = temp;
 
@@ -206,11 +301,10 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
 
 
 
-    // set dirty bit
-    pfFh.MarkDirty(pageNum);
-    
-    // unpinned page
-    pfFh.UnpinPage(pageNum);
+    // set dirty bit, unpinned page
+    if((rc = pg.MarkDirty())    ||
+       (rc = pg.UnpinPage()))
+        return (rc);
 
     return (OK_RC);
 }
@@ -227,6 +321,10 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid)
 //
 RC RM_FileHandle::DeleteRec(const RID &rid)
 {
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_DELETEREC);
+#endif
+
     // File must be open
     if (!bFileOpen)
       return (RM_CLOSEDFILE);
@@ -234,7 +332,7 @@ RC RM_FileHandle::DeleteRec(const RID &rid)
 
     // 局部变量
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     PageNum pageNum;
     SlotNum slotNum;
     RM_PageHdr *pPageHdr;
@@ -248,8 +346,8 @@ RC RM_FileHandle::DeleteRec(const RID &rid)
         return (rc);
 
     // 打开文件，获取指向page内容的指针
-    if((rc = pfFh.GetThisPage(pageNum, ph)) ||
-       (rc = ph.GetData(pData)))
+    if((rc = pfFh.GetThisPage(pageNum, pg)) ||
+       (rc = pg.GetData(pData)))
         return (rc);
 
     // 检查page内record数目合法性
@@ -273,11 +371,10 @@ RC RM_FileHandle::DeleteRec(const RID &rid)
 
 
 
-    // set dirty bit
-    pfFh.MarkDirty(pageNum);
-    
-    // unpinned page
-    pfFh.UnpinPage(pageNum);
+    // set dirty bit, unpinned page
+    if((rc = pg.MarkDirty())    ||
+       (rc = pg.UnpinPage()))
+        return (rc);
 
     return (OK_RC);
 }
@@ -294,6 +391,10 @@ RC RM_FileHandle::DeleteRec(const RID &rid)
 //
 RC RM_FileHandle::UpdateRec(const RM_Record &rec)
 {
+#ifdef PF_STATS
+    StatTimer timer(pStatisticsMgr, RM_LAT_UPDATEREC);
+#endif
+
     // File must be open
     if (!bFileOpen)
       return (RM_CLOSEDFILE);
@@ -302,7 +403,7 @@ RC RM_FileHandle::UpdateRec(const RM_Record &rec)
     
     // 局部变量
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     PageNum pageNum;
     SlotNum slotNum;
     char *pData;
@@ -315,22 +416,21 @@ RC RM_FileHandle::UpdateRec(const RM_Record &rec)
         return (rc);
 
     // 打开文件，获取指向page内容的指针
-    if((rc = pfFh.GetThisPage(pageNum, ph))     ||
-       (rc = ph.  GetData    (pData)))
+    if((rc = pfFh.GetThisPage(pageNum, pg))     ||
+       (rc = pg.  GetData    (pData)))
         return (rc);
 
     // 更新文件中相应记录
     int offset = hdr.bitmapOffset + hdr.bitmapSize + hdr.recordSize * slotNum;
-    strncpy(pData + offset, rec.pData, hdr.recordSize);
+    memcpy(pData + offset, rec.pData, hdr.recordSize);
 
 
 
 
-    // set dirty bit
-    pfFh.MarkDirty(pageNum);
-    
-    // unpinned page
-    pfFh.UnpinPage(pageNum);
+    // set dirty bit, unpinned page
+    if((rc = pg.MarkDirty())    ||
+       (rc = pg.UnpinPage()))
+        return (rc);
 
     return (OK_RC);
 }
@@ -346,7 +446,7 @@ RC RM_FileHandle::UpdateRec(const RM_Record &rec)
 RC RM_FileHandle::ForcePages(PageNum pageNum) const
 {
     RC rc;
-    PF_PageHandle ph;
+    PF_PageGuard pg;
     char *pData;
     PageNum hdrPageNum;
 
@@ -358,8 +458,8 @@ RC RM_FileHandle::ForcePages(PageNum pageNum) const
     if(bHdrChanged)
     {
         // 读入hdr对应page
-        if((rc = pfFh.GetFirstPage(ph))         ||
-           (rc = ph.GetPageNum(hdrPageNum)))
+        if((rc = pfFh.GetFirstPage(pg))         ||
+           (rc = pg.GetPageNum(hdrPageNum)))
             return (rc);
 
         // 检查存储hdr的page合法性
@@ -367,14 +467,14 @@ RC RM_FileHandle::ForcePages(PageNum pageNum) const
             return (RM_ISNOTHDRPAGE);
 
         // 更新hdr信息
-        if(rc = ph.GetData(pData))
+        if(rc = pg.GetData(pData))
             return (rc);
 
         *(RM_FileHdr*)pData = this->hdr;
 
         // set dirty, unpinned
-        if((rc = pfFh.MarkDirty(hdrPageNum))    ||
-           (rc = pfFh.UnpinPage(hdrPageNum)))
+        if((rc = pg.MarkDirty())    ||
+           (rc = pg.UnpinPage()))
             return (rc);
 
         // hdr信息落盘
@@ -404,8 +504,9 @@ bool RM_FileHandle::GetBit(const char *pBitmap, SlotNum slotNum) const
     int i = slotNum / 8;
     int j = slotNum % 8;
 
-    char temp = pBitmap[i];
-    char mask = 1<<j;
+    // bit顺序与SetBit一致：slot 0 对应最高位
+    unsigned char temp = pBitmap[i];
+    unsigned char mask = 0x80 >> j;
 
     if (temp & mask)
         return TRUE;
@@ -444,7 +545,7 @@ void RM_FileHandle::UnsetBit(char *pBitmap, SlotNum slotNum) const
     int j = slotNum % 8;
 
     char mask = ~(0x80 >> j);
-    pBitmap[i] |= mask;
+    pBitmap[i] &= mask;
 }
 
 //
@@ -462,7 +563,7 @@ SlotNum RM_FileHandle::FindFreeSlot(const char *pBitmap) const
     int limit = hdr.bitmapSize / 4;
     
     int i, j;
-    char temp, mask;
+    unsigned char temp, mask;                   // 有符号char右移会带上符号位
 
     // 按4B查找
     for(i = 0;i < limit;++i)
@@ -474,7 +575,7 @@ SlotNum RM_FileHandle::FindFreeSlot(const char *pBitmap) const
     // 按1B查找
     for(i*=4;i<hdr.bitmapSize - 1;i++)
     {
-        if(pBitmap[i] != 0xFFu)
+        if((unsigned char)pBitmap[i] != 0xFFu)
         {   // 当前1B中存在空位
             temp = pBitmap[i];
             mask = 0x80;                        // 1000 0000
@@ -487,7 +588,7 @@ SlotNum RM_FileHandle::FindFreeSlot(const char *pBitmap) const
     }
 
     // 最后一字节中bit位不一定全部可用，需要特别处理
-    limit = hdr.recNumPerPage % 8;
+    limit = hdr.recNumPerPage - i * 8;
     temp = pBitmap[i];
     mask = 0x80;
     for(j = 0; j < limit; ++j, mask >>= 1)
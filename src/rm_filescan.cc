@@ -4,6 +4,7 @@
 // Authors:     L0-0m (rzwang@mail.ustc.edu.cn)
 //
 
+#include <algorithm>
 #include "rm_internal.h"
 #include "operations.h"
 
@@ -34,9 +35,10 @@ RM_FileScan::~RM_FileScan ()
 }
 
 //
-// 
+// OpenScan
 //
 // Desc: 根据参数进行初始化，为扫描一个已经打开的 RM_FileHandle 做准备。
+//       record须满足 *(type *)(r + attrOffset) compOp *(type *)value
 // In:   
 // Out:
 // Ret:  
@@ -48,6 +50,34 @@ RC RM_FileScan::OpenScan  (const RM_FileHandle& _fileHandle,
 								 CompOp         _compOp,
 								 void*          _value,
 								 ClientHint     _pinHint)
+{
+	RM_Condition cond;
+
+	cond.attrType   = _attrType;
+	cond.attrLength = _attrLength;
+	cond.lhsOffset  = _attrOffset;
+	cond.op         = _compOp;
+	cond.bRhsIsAttr = FALSE;
+	cond.rhsOffset  = 0;
+	cond.rhsValue   = _value;
+	return OpenScan(_fileHandle, 1, &cond, _pinHint);
+}
+
+//
+// OpenScan
+//
+// Desc: 根据参数进行初始化，为扫描一个已经打开的 RM_FileHandle 做准备。
+//       record须满足全部条件；条件按代价和选择率排序后在page内求值，
+//       一个条件不满足即不再求其余条件，只有满足全部条件的rec离开page。
+// In:   numConds - 条件个数，0时返回全部rec
+//       conds    - 条件，右侧常量拷贝进scan
+// Out:
+// Ret:  RM return code
+//
+RC RM_FileScan::OpenScan  (const RM_FileHandle& _fileHandle,
+								 int                 numConds,
+								 const RM_Condition  _conds[],
+								 ClientHint          _pinHint)
 {
 	// 不能打开一个已经打开的scan
 	if(bScanOpen == TRUE)
@@ -60,122 +90,497 @@ RC RM_FileScan::OpenScan  (const RM_FileHandle& _fileHandle,
 
 	RC rc;
 
+	if(numConds > 0 && _conds == NULL)
+		return (RM_NULLVALUE);
+
+	// 分别对每个条件进行检查并加入
+	conds.clear();
+	values.clear();
+	for(int i = 0; i < numConds; i++)
+		if((rc = AddCondition(_conds[i])))
+		{
+			conds.clear();
+			return (rc);
+		}
+	OrderConditions();
+
+	matchBits.resize(_fileHandle.hdr.bitmapSize);
+	pinHint = _pinHint;
+	currentPage = 0;                // rec内容通过调用GetNextPage从 page 1 开始
+	currentSlot = RM_SLOT_EOF;      // 遍历时会从头开始
+
+	// 设置 scan 已打开
+	bScanOpen = TRUE;
+
+	return (OK_RC);
+} 
+
+//
+// AddCondition
+//
+// Desc: 检查一个条件并加入conds，NO_OP的条件检查后不加入。选出特化的比较
+//       函数和整页求值的kernel，估计求值代价和选择率（System R的默认值：
+//       = 为1/10，范围比较为1/3）。
+// In:   cond - 条件，右侧常量拷贝进values
+// Ret:  RM return code
+//
+RC RM_FileScan::AddCondition(const RM_Condition &cond)
+{
+	const RM_FileHdr &hdr = pRmFh->hdr;
+	Cond c;
+
 	// 分别对每个参数进行检查并赋值
-	if((_attrType < INT)    ||
-	   (_attrType > STRING))
+	if((cond.attrType < INT)    ||
+	   (cond.attrType > STRING))
 		return (RM_UNDEFATTRTYPE);
-	attrType = _attrType;
+	c.attrType = cond.attrType;
 
-	if((_attrType == INT)    && (_attrLength != 4)   			||
-	   (_attrType == STRING) && (_attrLength > MAXSTRINGLEN))        // TODO 支持新类型时需要改动
+	if(((cond.attrType == INT)    && (cond.attrLength != 4))   			||
+	   ((cond.attrType == FLOAT)  && (cond.attrLength != 4))   			||
+	   ((cond.attrType == STRING) && (cond.attrLength > MAXSTRINGLEN)))        // TODO 支持新类型时需要改动
 		return (RM_INVALIDATTRLEN);
-	attrLength = _attrLength;
+	c.attrLength = cond.attrLength;
 
-	if((_attrOffset < 0)    ||
-	   (_attrOffset >= _fileHandle.hdr.recordSize ))
+	if((cond.lhsOffset < 0)    ||
+	   (cond.lhsOffset >= hdr.recordSize))
 		return (RM_INVALIDATTROFFSET);
-	attrOffset = _attrOffset;
+	c.lhsOffset = cond.lhsOffset;
 
-	if((_compOp < NO_OP)    ||
-	   (_compOp > GE_OP))
+	if((cond.op < NO_OP)    ||
+	   (cond.op > GE_OP))
 	   return (RM_UNDEFCOMPOP);
 
-	// 根据比较算符初始化比较函数
-	// TODO 考虑泛型实现
-	switch (_compOp)
+	// 没有比较，所有rec都满足；属性不会被读取，不检查其长度是否越出rec
+	if(cond.op == NO_OP)
+		return (OK_RC);
+
+	// 两侧属性须整个落在rec内，否则会读到下一个rec，page上最后一个slot
+	// 还会读出page
+	if((cond.lhsOffset + cond.attrLength > hdr.recordSize) ||
+	   (cond.bRhsIsAttr && ((cond.rhsOffset < 0) ||
+	                        (cond.rhsOffset + cond.attrLength > hdr.recordSize))))
+		return (RM_INVALIDATTROFFSET);
+
+	// 根据属性类型和比较算符选出特化的比较函数
+	c.Operate = GetOperation(c.attrType, cond.op);
+	c.Filter = NULL;
+
+	if(cond.bRhsIsAttr)
+	{
+		c.rhsOffset = cond.rhsOffset;
+		c.valueOffset = -1;
+	}
+	else
 	{
-		case EQ_OP: Operate = Equal;                break;
-		case LT_OP: Operate = LessThan;             break;
-		case GT_OP: Operate = GreaterThan;          break;
-		case LE_OP: Operate = LessThanOrEqual;      break;
-		case GE_OP: Operate = GreaterThanOrEqual;   break;
-		case NE_OP: Operate = NotEqual;             break;
-		default:    Operate = NoComp;               break;
+		if(cond.rhsValue == NULL)
+			return (RM_NULLVALUE);
+
+		// 拷贝常量；STRING遇NUL即止，与strncmp的比较语义一致
+		c.rhsOffset = -1;
+		c.valueOffset = values.size();
+		values.resize(values.size() + c.attrLength, 0);
+		if(c.attrType == STRING)
+			strncpy(&values[c.valueOffset], (const char *)cond.rhsValue, c.attrLength);
+		else
+			memcpy(&values[c.valueOffset], cond.rhsValue, c.attrLength);
+		c.Filter = RM_GetFilterKernel(c.attrType, c.attrLength, cond.op);
 	}
 
-	pValue = _value;				// TODO 应该拷贝入私有变量
-	currentPage = 0;                // rec内容通过调用GetNextPage从 page 1 开始
-	currentSlot = RM_SLOT_EOF;      // 遍历时会从头开始
+	if(c.Filter != NULL)
+		c.cost = 1;
+	else if(c.attrType == STRING)
+		c.cost = 2 + c.attrLength / 16.0;
+	else
+		c.cost = 2;
 
-	// 设置 scan 已打开
-	bScanOpen = TRUE;
+	switch(cond.op)
+	{
+		case EQ_OP: c.selectivity = 0.1;       break;
+		case NE_OP: c.selectivity = 0.9;       break;
+		default:    c.selectivity = 1.0 / 3;   break;
+	}
+	c.numEvaluated = 0;
+	c.numPassed = 0;
 
+	conds.push_back(c);
 	return (OK_RC);
-} 
+}
+
+//
+// OrderConditions
+//
+// Desc: 按 代价 / (1 - 选择率) 从小到大排序，使代价低、淘汰rec多的条件先
+//       求值。选择率由已求值的rec统计，统计少时偏向估计值。能整页求值的
+//       条件总在最前。OpenScan及每扫描完一个page时调用。
+//
+void RM_FileScan::OrderConditions()
+{
+	if(conds.size() < 2)
+		return;
+
+	std::stable_sort(conds.begin(), conds.end(), [](const Cond &a, const Cond &b)
+	{
+		if((a.Filter != NULL) != (b.Filter != NULL))
+			return (a.Filter != NULL);
+
+		double selA = (a.numPassed + 16 * a.selectivity) / (a.numEvaluated + 16);
+		double selB = (b.numPassed + 16 * b.selectivity) / (b.numEvaluated + 16);
+		return (a.cost / std::max(1 - selA, 1e-3) < b.cost / std::max(1 - selB, 1e-3));
+	});
+}
+
+//
+// Matches
+//
+// Desc: 按顺序对rec求各条件，一个不满足即返回
+// In:   pRecData - rec内容
+// Ret:  rec是否满足全部条件
+//
+bool RM_FileScan::Matches(const char *pRecData)
+{
+	for(size_t k = 0; k < conds.size(); k++)
+	{
+		Cond &c = conds[k];
+		void *pRhs = c.rhsOffset >= 0 ? (void*)(pRecData + c.rhsOffset)
+		                              : (void*)&values[c.valueOffset];
+
+		c.numEvaluated++;
+		if(!c.Operate((void*)(pRecData + c.lhsOffset), pRhs, c.attrType, c.attrLength))
+			return (FALSE);
+		c.numPassed++;
+	}
+	return (TRUE);
+}
+
+//
+// CountBits
+//
+// Desc: bitmap中为1的bit数
+//
+static long long CountBits(const char *pBits, int numBytes)
+{
+	long long n = 0;
+	int i = 0;
+
+	for(; i + 8 <= numBytes; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, pBits + i, 8);
+		n += __builtin_popcountll(word);
+	}
+	for(; i < numBytes; i++)
+		n += __builtin_popcount((unsigned char)pBits[i]);
+	return (n);
+}
+
+//
+// FilterPage
+//
+// Desc: 对一个page求全部条件：先由kernel对整页求能整页求值的条件，各条件
+//       的匹配bitmap逐个相与；再由bitmap一次找出其余rec（跳过全0字节，
+//       slot 0 对应最高位），逐个条件对selection vector求值并就地压缩。
+//       没有rec剩下即不再求其余条件。
+// In:   pBitmap - page的bitmap
+//       pRecs   - slot 0 的rec地址
+// Out:  aSlots  - 满足全部条件的rec（slot在currentSlot之后）的slot
+// Ret:  满足条件的rec个数
+//
+int RM_FileScan::FilterPage(const char *pBitmap, const char *pRecs, SlotNum *aSlots)
+{
+	const RM_FileHdr &hdr = pRmFh->hdr;
+	int numBytes = (hdr.recNumPerPage + 7) / 8;
+	const char *pLive = pBitmap;
+	size_t k = 0;
+
+	// 能整页求值的条件排在最前
+	for(; k < conds.size() && conds[k].Filter != NULL; k++)
+	{
+		Cond &c = conds[k];
+		c.numEvaluated += CountBits(pLive, numBytes);
+		c.Filter(pRecs + c.lhsOffset, hdr.recordSize, hdr.recNumPerPage,
+		         &values[c.valueOffset], pLive, matchBits.data());
+		pLive = matchBits.data();
+
+		long long numPassed = CountBits(pLive, numBytes);
+		c.numPassed += numPassed;
+		if(numPassed == 0)
+			return (0);
+	}
+
+	// 由bitmap一次找出剩下的rec
+	int numRecs = 0;
+	SlotNum first = currentSlot + 1;
+	for(int i = first / 8; i < numBytes; i++)
+	{
+		unsigned int bits = (unsigned char)pLive[i];
+		if(i == first / 8)
+			bits &= 0xFFu >> (first % 8);
+		while(bits)
+		{
+			int j = __builtin_clz(bits) - 24;
+			bits &= ~(0x80u >> j);
+			aSlots[numRecs++] = i * 8 + j;
+		}
+	}
+	// bitmap末尾多余的bit不对应rec
+	while(numRecs > 0 && aSlots[numRecs - 1] >= hdr.recNumPerPage)
+		numRecs--;
+
+	// 其余条件逐个对selection vector求值
+	for(; k < conds.size() && numRecs > 0; k++)
+	{
+		Cond &c = conds[k];
+		void *pValue = c.valueOffset >= 0 ? (void*)&values[c.valueOffset] : NULL;
+		int numMatch = 0;
+
+		for(int r = 0; r < numRecs; r++)
+		{
+			const char *pRecData = pRecs + hdr.recordSize * aSlots[r];
+			void *pRhs = pValue != NULL ? pValue : (void*)(pRecData + c.rhsOffset);
+			if(c.Operate((void*)(pRecData + c.lhsOffset), pRhs, c.attrType, c.attrLength))
+				aSlots[numMatch++] = aSlots[r];
+		}
+		c.numEvaluated += numRecs;
+		c.numPassed += numMatch;
+		numRecs = numMatch;
+	}
+	return (numRecs);
+}
+
+//
+// NextMatch
+//
+// Desc: 遍历每个不空的page，对每个page根据bitmap判断rec位置，并按顺序求
+//       各条件，一个不满足即跳过该rec。
+//       找到符合全部条件的rec后返回，其page在pageGuard中保持pin。
+//       page按pinHint读取：SEQUENTIAL_ONCE时page读完即可被换出，不挤占
+//       buffer中的其他page。
+// Out:  pRecData - 符合条件的rec在page中的地址
+// Ret:  RM_EOF 若没有更多rec，或其他 RM/PF return code
+//
+RC RM_FileScan::NextMatch(char *&pRecData)
+{
+	RC rc;
+	char *pPageData;
+	char *pBitmap;
+	const RM_FileHdr &hdr = pRmFh->hdr;
+
+	// 进入外循环遍历page（除非读到PF_EOF），初始currentPage = 0
+	while(TRUE)
+	{
+		// 上次的page未扫描完则重新pin住它（KEEP_PINNED时仍被pin着），
+		// 否则取下一个page
+		if(!pageGuard.IsPinned())
+		{
+			if(currentSlot == RM_SLOT_EOF)
+				rc = pRmFh->pfFh.GetNextPage(currentPage, pageGuard, pinHint);
+			else
+				rc = pRmFh->pfFh.GetThisPage(currentPage, pageGuard, pinHint);
+			if(rc == PF_EOF)
+				return (RM_EOF);
+			if(rc || (rc = pageGuard.GetPageNum(currentPage)))
+				return (rc);
+		}
+
+		// 获得当前page内容，计算bitmap地址
+		if((rc = pageGuard.GetData(pPageData)))
+			return (rc);
+		pBitmap = pPageData + hdr.bitmapOffset;
+
+		// 遍历page中rec直到最后一个
+		while((currentSlot = GetNextRecSlot(pBitmap)) != RM_SLOT_EOF)
+		{
+			pRecData = pBitmap + hdr.bitmapSize + hdr.recordSize * currentSlot;
+
+			// 进行条件比较
+			if(Matches(pRecData))
+				return (OK_RC);
+		}// rec遍历结束
+
+		// 当前page扫描结束，Unpinned；按本page的统计重排条件
+		if((rc = pageGuard.UnpinPage()))
+			return (rc);
+		OrderConditions();
+	}
+}
 
 //
 // GetNextRec
 //
-// Desc: 遍历每个不空的page，对每个page根据bitmap判断rec位置，并进行一次比较：
-//       *(type *)(r + offset) op *(type *)value
-//       将符合条件的rec返回。
+// Desc: 返回下一个符合比较条件的rec的拷贝。
+//       KEEP_PINNED时当前page在两次调用之间保持pin，不必每条rec重新pin一次。
 // In:   
 // Out:  rec - 符合比较条件的rec，类中有Record内容的拷贝。
-// Ret:  RM return code
+//       rec中已有同样大小的缓冲区时重用它。
+// Ret:  RM_EOF 若没有更多rec，或其他 RM/PF return code
 //
 RC RM_FileScan::GetNextRec(RM_Record &rec)
 {
+#ifdef PF_STATS
+	StatTimer timer(pStatisticsMgr, RM_LAT_GETNEXTREC);
+#endif
+
 	RC rc;
-	PF_PageHandle pfPh;
-	char *pPageData;
 	char *pRecData;
-	char *pBitmap;
+	int recordSize = pRmFh ? pRmFh->hdr.recordSize : 0;
 
-	// 进入外循环遍历page（除非读到PF_EOF），初始currentPage = 0
-	while( (rc = pRmFh->pfFh.GetNextPage(currentPage, pfPh)) == OK_RC )   // 从上次page置开始
+	if(bScanOpen == FALSE)
+		return (RM_CLOSEDSCAN);
+
+	if((rc = NextMatch(pRecData)))
+		return (rc);
+
+	// 条件满足，返回rec的拷贝
+	if(rec.pData == NULL || rec.recordSize != recordSize)
 	{
-		// 获得当前page内容
-		if(rc == pfPh.GetData(pPageData))
-		  return (rc);
-	  
-		// 计算bitmap地址
-		pBitmap = pPageData + (pRmFh->hdr.bitmapOffset);
-
-		// 若page不空进入内循环，遍历page中rec
-		if(   ((RM_PageHdr*)pPageData)->recordNum != 0   )
+		delete [] rec.pData;
+		rec.pData = new char[recordSize];
+	}
+	rec.recordSize = recordSize;
+	memcpy(rec.pData, pRecData, recordSize);
+	rec.rid = RID(currentPage, currentSlot);
+
+	// rec不引用page内存，除KEEP_PINNED外都可Unpinned
+	if(pinHint != KEEP_PINNED && (rc = pageGuard.UnpinPage()))
+		return (rc);
+	return (OK_RC);
+}
+
+//
+// GetNextRec
+//
+// Desc: 返回下一个符合比较条件的rec，不拷贝：view指向page中的rec并pin住
+//       page。view仍指向本次scan当前page时，先接过它的pin，同一page上的
+//       rec因此不必重新pin。KEEP_PINNED时scan自己保持pin，view另pin一次，
+//       直到scan换page。
+// In:   view - 上次GetNextRec填充的view，或空view
+// Out:  view - 指向符合比较条件的rec
+// Ret:  RM_EOF 若没有更多rec（view为空），或其他 RM/PF return code
+//
+RC RM_FileScan::GetNextRec(RM_RecordView &view)
+{
+#ifdef PF_STATS
+	StatTimer timer(pStatisticsMgr, RM_LAT_GETNEXTREC);
+#endif
+
+	RC rc;
+	char *pRecData;
+	PageNum viewPage;
+
+	if(bScanOpen == FALSE)
+		return (RM_CLOSEDSCAN);
+
+	// view是否pin着本次scan的当前page
+	bool bOnPage = view.pFileHandle == pRmFh && view.pageGuard.IsPinned() &&
+	               view.pageGuard.GetPageNum(viewPage) == OK_RC &&
+	               viewPage == currentPage && currentSlot != RM_SLOT_EOF;
+
+	if(pinHint == KEEP_PINNED)
+	{
+		// scan自己保持pin，view的pin在换page时才重新pin
+		if((rc = NextMatch(pRecData)))
 		{
-			// 遍历直到最后一个rec
-			while(   (currentSlot = GetNextRecSlot(pBitmap)) != RM_SLOT_EOF   )
-			{
-				// Debug
-				// 位置3-5-7  对应下标2-4-6 有rec   共20个slot（最大下标19）
-				// currentSlot初始化为 RM_SLOT_EOF(-1)
-				// 每次先根据currentSlot(视为已访问) 更新得到nextSlot   调用GetNextRecSlot(pBitmap)
-				// 当 GetNextRecSlot(pBitmap) 返回  RM_SLOT_EOF(-1) --- 没有下一个了 
-
-				// 读取rec
-				if(rc = pRmFh->GetRec(RID(currentPage, currentSlot), rec))
-					return (rc);
-
-				// 进行条件比较
-				if(Operate((void*)(pRecData + attrOffset), pValue, attrType, attrLength) == TRUE)
-				{
-					// 返回的rec是一份拷贝，不引用内存，可Unpinned
-					pRmFh->pfFh.UnpinPage(currentPage);
-
-					// 条件满足，返回rec
-					return (OK_RC);
-				}
-			}
-		}// rec遍历结束
+			view.Release();
+			return (rc);
+		}
+		if(!bOnPage || viewPage != currentPage)
+		{
+			if((rc = view.Release()) ||
+			   (rc = pRmFh->pfFh.GetThisPage(currentPage, view.pageGuard)))
+				return (rc);
+		}
+	}
+	else
+	{
+		// 接过view对当前page的pin
+		if(bOnPage && !pageGuard.IsPinned())
+			pageGuard = std::move(view.pageGuard);
+		if((rc = view.Release()))
+			return (rc);
+
+		if((rc = NextMatch(pRecData)))
+			return (rc);
+		view.pageGuard = std::move(pageGuard);
+	}
 
-		// 检查slotNum遍历过程是否正常退出
-		if(currentSlot < ((RM_PageHdr*)pPageData)->recordNum)
-			return (RM_RECSCANERR);
+	view.pFileHandle = pRmFh;
+	view.pData = pRecData;
+	view.rid = RID(currentPage, currentSlot);
+	view.recordSize = pRmFh->hdr.recordSize;
+	return (OK_RC);
+}
 
-		// Unpinned
-		pRmFh->pfFh.UnpinPage(currentPage);
+//
+// GetNextBatch
+//
+// Desc: 一次处理一个page：pin住下一个有rec的page，由FilterPage对整页求
+//       全部条件，找出其中（未被GetNextRec返回过的）满足条件的rec，组成
+//       selection vector放入batch。page的pin交给batch，扫描不再
+//       回到该page。没有rec满足条件的page直接跳过。
+// In:   batch - 上次填充的batch，或空batch
+// Out:  batch - 下一个有匹配rec的page上的全部匹配rec
+// Ret:  RM_EOF 若没有更多rec（batch为空），或其他 RM/PF return code
+//
+RC RM_FileScan::GetNextBatch(RM_RecordBatch &batch)
+{
+	RC rc;
+	char *pPageData;
+	char *pBitmap;
+	char *pRecs;
+
+	if(bScanOpen == FALSE)
+		return (RM_CLOSEDSCAN);
+	if((rc = batch.Release()))
+		return (rc);
 
-		// 当前page扫描结束，更新pageNum
-		currentPage++;
+	const RM_FileHdr &hdr = pRmFh->hdr;
+	if((int)batch.aSlots.size() < hdr.recNumPerPage)
+	{
+		batch.aSlots.resize(hdr.recNumPerPage);
+		batch.apData.resize(hdr.recNumPerPage);
 	}
+	SlotNum *aSlots = batch.aSlots.data();
 
-	// 检查page遍历是否正常结束
-	if(rc != PF_EOF)
-	  return (rc);
+	while(TRUE)
+	{
+		// 上次的page未扫描完则重新pin住它，否则取下一个page
+		if(!pageGuard.IsPinned())
+		{
+			if(currentSlot == RM_SLOT_EOF)
+				rc = pRmFh->pfFh.GetNextPage(currentPage, pageGuard, pinHint);
+			else
+				rc = pRmFh->pfFh.GetThisPage(currentPage, pageGuard, pinHint);
+			if(rc == PF_EOF)
+				return (RM_EOF);
+			if(rc || (rc = pageGuard.GetPageNum(currentPage)))
+				return (rc);
+		}
 
-	return (RM_EOF);
-} 
+		if((rc = pageGuard.GetData(pPageData)))
+			return (rc);
+		pBitmap = pPageData + hdr.bitmapOffset;
+		pRecs = pBitmap + hdr.bitmapSize;
+
+		int numRecs = FilterPage(pBitmap, pRecs, aSlots);
+		OrderConditions();
+
+		// 当前page扫描结束
+		currentSlot = RM_SLOT_EOF;
+		if(numRecs == 0)
+		{
+			if((rc = pageGuard.UnpinPage()))
+				return (rc);
+			continue;
+		}
+
+		for(int k = 0; k < numRecs; k++)
+			batch.apData[k] = pRecs + hdr.recordSize * aSlots[k];
+		batch.numRecs = numRecs;
+		batch.pageNum = currentPage;
+		batch.pageGuard = std::move(pageGuard);
+		return (OK_RC);
+	}
+}
 
 //
 // CloseScan
@@ -191,6 +596,10 @@ RC RM_FileScan::CloseScan()
 	if(bScanOpen == FALSE)
 		return (RM_CLOSEDSCAN);
 
+	// 释放KEEP_PINNED时仍pin着的page
+	if(pageGuard.IsPinned())
+		pageGuard.UnpinPage();
+
 	pRmFh = NULL;
 
 	// 关闭 scan
@@ -203,75 +612,25 @@ RC RM_FileScan::CloseScan()
 //  GetNextRecSlot
 //
 //  Desc: 根据私有成员变量 currentSlot ，在 Bitmap 中搜索下一个rec的slotNum。
-//  In:
+//        bit顺序与 RM_FileHandle::GetBit 一致，整字节为空时一次跳过8个slot。
+//  In:   pBitmap - 当前page的bitmap
 //  Out:
-//  Ret:
+//  Ret:  下一个rec的slotNum，没有则返回 RM_SLOT_EOF
 SlotNum RM_FileScan::GetNextRecSlot(const char *pBitmap) const
 {
-	char temp, mask;
-	int i, j;
-	
 	// 未访问rec的起始slot位置
-	SlotNum nextSlot = currentSlot + 1;
-	
-
-
-	//// 循环展开以 4B 为周期，先处理完上一个周期的查找
-	//// 使 nextSlot 成为 32(4B) 的倍数...
+	SlotNum slot = currentSlot + 1;
 
-	// 按照1B查找
-	for(i = nextSlot / 8; (i < pRmFh->hdr.bitmapSize) && ((nextSlot / 32) != 0); ++i)
+	while(slot < pRmFh->hdr.recNumPerPage)
 	{
-		if(pBitmap[i] != 0x00u)
-		{   // 当前1B中存在rec
-			temp = pBitmap[i];
-			mask = 0x80;					// 1000 0000
-
-			for(j = nextSlot % 8; j < 8; ++j, mask >>= 1)
-			{
-				// 若当前slot存在rec，返回slotNum
-				if ((mask & temp) != 0)
-					return (i * 8 + j);
-			}
-		}
-	}
-
-	// 访问结束，返回RM_SLOT_EOF
-	if(i == pRmFh->hdr.bitmapSize)
-		return (RM_SLOT_EOF);
-
-
-
-	//// 开始新的查找，此时nextSlot已经是 32(4B) 的整数倍数了...
-
-	// 先按4B访问
-	unsigned int *bitArray = (unsigned int *)pBitmap;
-	
-	// 4B时的访问边界
-	int limit = pRmFh->hdr.bitmapSize / 4;
-
-	// 按照4B查找
-	for(i /= 4; i < limit; ++i)
-	{
-		// 当前4B中存在rec
-		if(bitArray[i] != 0x00000000u)
-			break;
-	}
-
-	// 按1B查找
-	for(i *= 4; i < pRmFh->hdr.bitmapSize; ++i)
-	{
-		if(pBitmap[i] != 0x00u)
-		{   // 当前1B中存在rec
-			temp = pBitmap[i];
-			mask = 0x80;	// 1000 0000
-
-			for(j = 0; j < 8; ++j, mask >>= 1)
-			{
-				if ((mask & temp) != 0)
-					return (i * 8 + j);
-			}
+		if((slot % 8) == 0 && pBitmap[slot / 8] == 0)
+		{
+			slot += 8;
+			continue;
 		}
+		if(pRmFh->GetBit(pBitmap, slot))
+			return (slot);
+		++slot;
 	}
 
 	// 访问结束，返回RM_SLOT_EOF
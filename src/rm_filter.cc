@@ -0,0 +1,199 @@
+//
+// File:        rm_filter.cc
+// Description: 页内过滤kernel：对定长record中定偏移的INT/FLOAT属性，一次
+//              求出一个page上全部slot的比较结果
+//
+// 每个kernel对page上的slot逐个按recordSize跨步取出属性，与常量比较，结果
+// 与page的bitmap相与后写成匹配bitmap（bit顺序同bitmap，slot 0 对应最高位）。
+// 有标量版本和AVX2版本，AVX2版本一次gather 8个slot，正好是bitmap的一个字节。
+// 运行时按CPU是否支持AVX2选用。
+//
+
+#include <type_traits>
+#include "rm_internal.h"
+#include "operations.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RM_FILTER_X86
+#endif
+
+//
+// ScalarFilter
+//
+// Desc: 标量kernel
+// In:   pAttr - slot 0 中属性的地址
+//       recordSize - 相邻slot的跨度
+//       numSlots - page上slot个数
+//       pValue - 比较的常量
+//       pBitmap - page的bitmap
+// Out:  pMatch - 匹配bitmap，(numSlots + 7) / 8 字节
+//
+template <typename T, CompOp op>
+static void ScalarFilter(const char *pAttr, int recordSize, int numSlots,
+                         const void *pValue, const char *pBitmap, char *pMatch)
+{
+    T value;
+    memcpy(&value, pValue, sizeof(T));
+
+    int numBytes = (numSlots + 7) / 8;
+    for(int i = 0; i < numBytes; i++)
+    {
+        unsigned int occupied = (unsigned char)pBitmap[i];
+        unsigned int match = 0;
+
+        // 全空的字节不必取属性
+        if(occupied)
+        {
+            int end = numSlots - i * 8 < 8 ? numSlots - i * 8 : 8;
+            const char *p = pAttr + (size_t)i * 8 * recordSize;
+            for(int j = 0; j < end; j++, p += recordSize)
+            {
+                T x;
+                memcpy(&x, p, sizeof(T));
+                if(CompareValues<T, op>(x, value))
+                    match |= 0x80u >> j;
+            }
+        }
+        pMatch[i] = (char)(match & occupied);
+    }
+}
+
+#ifdef RM_FILTER_X86
+
+//
+// Avx2Filter
+//
+// Desc: AVX2 kernel，参数同ScalarFilter。每个满8个slot的字节gather一次：
+//       索引倒序排列，使lane i 对应slot 7 - i，movemask的结果即为bitmap
+//       字节的bit顺序。整数的 !=、<=、>= 由 ==、>、< 的结果取反得到。
+//       末尾不满8个slot的部分用标量kernel，避免gather读出page。
+//
+template <typename T, CompOp op>
+__attribute__((target("avx2")))
+static void Avx2Filter(const char *pAttr, int recordSize, int numSlots,
+                       const void *pValue, const char *pBitmap, char *pMatch)
+{
+    __m256i vIndex = _mm256_mullo_epi32(_mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0),
+                                        _mm256_set1_epi32(recordSize));
+    int numFull = numSlots / 8;
+
+    if(std::is_same<T, float>::value)
+    {
+        float value;
+        memcpy(&value, pValue, sizeof(value));
+        __m256 vValue = _mm256_set1_ps(value);
+        for(int i = 0; i < numFull; i++)
+        {
+            unsigned int occupied = (unsigned char)pBitmap[i];
+            if(occupied == 0)
+            {
+                pMatch[i] = 0;
+                continue;
+            }
+
+            __m256 x = _mm256_i32gather_ps((const float *)(pAttr + (size_t)i * 8 * recordSize),
+                                           vIndex, 1);
+            __m256 m;
+            switch(op)
+            {
+                case EQ_OP: m = _mm256_cmp_ps(x, vValue, _CMP_EQ_OQ);  break;
+                case NE_OP: m = _mm256_cmp_ps(x, vValue, _CMP_NEQ_UQ); break;
+                case LT_OP: m = _mm256_cmp_ps(x, vValue, _CMP_LT_OQ);  break;
+                case GT_OP: m = _mm256_cmp_ps(x, vValue, _CMP_GT_OQ);  break;
+                case LE_OP: m = _mm256_cmp_ps(x, vValue, _CMP_LE_OQ);  break;
+                default:    m = _mm256_cmp_ps(x, vValue, _CMP_GE_OQ);  break;
+            }
+            pMatch[i] = (char)(_mm256_movemask_ps(m) & occupied);
+        }
+    }
+    else
+    {
+        int value;
+        memcpy(&value, pValue, sizeof(value));
+        __m256i vValue = _mm256_set1_epi32(value);
+        for(int i = 0; i < numFull; i++)
+        {
+            unsigned int occupied = (unsigned char)pBitmap[i];
+            if(occupied == 0)
+            {
+                pMatch[i] = 0;
+                continue;
+            }
+
+            __m256i x = _mm256_i32gather_epi32((const int *)(pAttr + (size_t)i * 8 * recordSize),
+                                               vIndex, 1);
+            __m256i m;
+            switch(op)
+            {
+                case EQ_OP: case NE_OP: m = _mm256_cmpeq_epi32(x, vValue); break;
+                case GT_OP: case LE_OP: m = _mm256_cmpgt_epi32(x, vValue); break;
+                default:                m = _mm256_cmpgt_epi32(vValue, x); break;
+            }
+            unsigned int match = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+            if(op == NE_OP || op == LE_OP || op == GE_OP)
+                match = ~match;
+            pMatch[i] = (char)(match & occupied);
+        }
+    }
+
+    // 末尾不满8个slot
+    if(numFull * 8 < numSlots)
+    {
+        ScalarFilter<T, op>(pAttr + (size_t)numFull * 8 * recordSize, recordSize,
+                            numSlots - numFull * 8, pValue,
+                            pBitmap + numFull, pMatch + numFull);
+    }
+}
+
+#endif
+
+//
+// Kernel表：[类型][比较算符 - EQ_OP]
+//
+static const RM_FilterKernel scalarKernels[2][6] = {
+    { ScalarFilter<int, EQ_OP>, ScalarFilter<int, NE_OP>, ScalarFilter<int, LT_OP>,
+      ScalarFilter<int, GT_OP>, ScalarFilter<int, LE_OP>, ScalarFilter<int, GE_OP> },
+    { ScalarFilter<float, EQ_OP>, ScalarFilter<float, NE_OP>, ScalarFilter<float, LT_OP>,
+      ScalarFilter<float, GT_OP>, ScalarFilter<float, LE_OP>, ScalarFilter<float, GE_OP> },
+};
+
+#ifdef RM_FILTER_X86
+static const RM_FilterKernel avx2Kernels[2][6] = {
+    { Avx2Filter<int, EQ_OP>, Avx2Filter<int, NE_OP>, Avx2Filter<int, LT_OP>,
+      Avx2Filter<int, GT_OP>, Avx2Filter<int, LE_OP>, Avx2Filter<int, GE_OP> },
+    { Avx2Filter<float, EQ_OP>, Avx2Filter<float, NE_OP>, Avx2Filter<float, LT_OP>,
+      Avx2Filter<float, GT_OP>, Avx2Filter<float, LE_OP>, Avx2Filter<float, GE_OP> },
+};
+#endif
+
+//
+// RM_GetFilterKernel
+//
+// Desc: 选出比较 attr op value 的kernel
+// In:   attrType, attrLength - 属性类型和长度，只支持4字节的INT和FLOAT
+//       compOp - 比较算符，NO_OP不需要kernel
+//       impl - RM_FILTER_BEST时按CPU选用最快的版本
+// Ret:  kernel，不支持时为NULL
+//
+RM_FilterKernel RM_GetFilterKernel(AttrType attrType, int attrLength,
+                                   CompOp compOp, RM_FilterImpl impl)
+{
+    if((attrType != INT && attrType != FLOAT) || attrLength != 4 ||
+       compOp < EQ_OP || compOp > GE_OP)
+        return (NULL);
+
+    int type = attrType == INT ? 0 : 1;
+    int op = compOp - EQ_OP;
+
+#ifdef RM_FILTER_X86
+    // CPU只检测一次
+    static const bool bAvx2 = __builtin_cpu_supports("avx2");
+    if(impl == RM_FILTER_AVX2 || (impl == RM_FILTER_BEST && bAvx2))
+        return (bAvx2 ? avx2Kernels[type][op] : NULL);
+#else
+    if(impl == RM_FILTER_AVX2)
+        return (NULL);
+#endif
+    return (scalarKernels[type][op]);
+}
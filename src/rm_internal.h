@@ -11,6 +11,12 @@
 #include <cstring>
 #include "rm.h"
 
+// 开启PF_STATS时，记录各操作的延迟。统计管理器定义在pf_buffermgr.cc中
+#ifdef PF_STATS
+#include "statistics.h"
+extern StatisticsMgr *pStatisticsMgr;
+#endif
+
 //
 // PF_PageHdr: Header structure for pages
 //
@@ -24,10 +30,28 @@ struct RM_PageHdr {
 //
 // Constants and defines
 //
-const int RM_PAGE_SIZE = PF_PAGE_SIZE - sizeof(RM_PageHdr);     // RM page的可用空间
+const int RM_PAGE_SIZE = PF_PAGE_SIZE - sizeof(RM_PageHdr);     // 默认page大小下RM page的可用空间
 const SlotNum RM_SLOT_EOF = -1;         // 为满足filescan逻辑功能，只能为-1
 
 #define RM_PAGE_LIST_END  (-1)       // end of list of free pages
 // #define RM_PAGE_NOT_FREE  (-2)       // full pages flag
 
+//
+// 页内过滤kernel（rm_filter.cc）：对一个page上全部slot求 attr op value，
+// 结果与bitmap相与，写成匹配bitmap
+//
+typedef void (*RM_FilterKernel)(const char *pAttr, int recordSize, int numSlots,
+                                const void *pValue, const char *pBitmap,
+                                char *pMatch);
+
+enum RM_FilterImpl {
+    RM_FILTER_BEST,                     // 按CPU选用最快的版本
+    RM_FILTER_SCALAR,
+    RM_FILTER_AVX2                      // CPU不支持时没有kernel
+};
+
+RM_FilterKernel RM_GetFilterKernel(AttrType attrType, int attrLength,
+                                   CompOp compOp,
+                                   RM_FilterImpl impl = RM_FILTER_BEST);
+
 #endif
\ No newline at end of file
@@ -38,15 +38,12 @@ RM_Manager::~RM_Manager()
 //       分配 page 0 并向其中存入RM文件头信息。
 // In:   fileName - name of file to create
 //       recordSize - Size of record in this file
+//       pageBytes - PF page size of the file (PF_MIN_PAGE_BYTES by default)
 // Ret:  RM return code
 //
-RC RM_Manager::CreateFile (const char *fileName, int recordSize)
+RC RM_Manager::CreateFile (const char *fileName, int recordSize,
+                           int pageBytes)
 {
-   // 检查record是否跨页
-   // 至少需要iB空间存储bitMap，故相等情况也不合法
-   if(recordSize >= RM_PAGE_SIZE)
-      return (RM_SIZEOUTOFPAGE);
-   
    // 检查recordSize合法性
    if(recordSize <= 0)
       return (RM_SIZETOSMALL);
@@ -56,16 +53,30 @@ RC RM_Manager::CreateFile (const char *fileName, int recordSize)
    PF_PageHandle ph;
    char *pData;
    PageNum hdrPageNum;
-   int recNumPerPage = GetRecNumPerPage(recordSize);
+
+   // RM page的可用空间由文件的page大小决定，去掉PF与RM的页头
+   // (PF_PageHdr的大小即PF_MIN_PAGE_BYTES - PF_PAGE_SIZE)
+   int pageSize = pageBytes - (PF_MIN_PAGE_BYTES - PF_PAGE_SIZE);
+   int rmPageSize = pageSize - sizeof(RM_PageHdr);
+
+   // 检查record是否跨页
+   // 至少需要iB空间存储bitMap，故相等情况也不合法
+   if(recordSize >= rmPageSize)
+      return (RM_SIZEOUTOFPAGE);
+
+   int recNumPerPage = GetRecNumPerPage(recordSize, rmPageSize);
    int bitmapSize = GetBitmapSize(recNumPerPage);
 
    // 校验计算结果
-   if(recNumPerPage * recordSize + bitmapSize > RM_PAGE_SIZE)
+   if(recNumPerPage * recordSize + bitmapSize > rmPageSize)
       return (RM_BITMAPSIZEERR);
 
-   if((rc = pPfManager->CreateFile(fileName))    ||
-      (rc = pPfManager->OpenFile(fileName, fh))  ||
-      (rc = fh.AllocatePage(ph))                 ||
+   // 参数合法后再创建文件
+   if((rc = pPfManager->CreateFile(fileName, pageBytes))    ||
+      (rc = pPfManager->OpenFile(fileName, fh)))
+     return (rc);
+
+   if((rc = fh.AllocatePage(ph))                 ||
       (rc = ph.GetData(pData)))
      return (rc);
 
@@ -114,10 +125,12 @@ RC RM_Manager::DestroyFile(const char *fileName)
 // Desc: 打开页式文件"fileName"，并对传入的RM_FileHandle类型fileHandle变量
 //       进行初始化。该过程中，RM文件头信息会被存入fileHandle。
 // In:   fileName - name of file to create
+//       pool - 文件页所在的缓冲池
 // Out:  fileHandle - TODO
 // Ret:  RM return code
 //
-RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle)
+RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle,
+                        PF_PoolId pool)
 {
    RC rc;
    PF_PageHandle ph;
@@ -129,7 +142,8 @@ RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle)
       return (RM_OPENEDFILE);
 
    // 设置Handle中PF_FileHandle对象指向打开文件
-   if((rc = pPfManager->OpenFile(fileName, fileHandle.pfFh)))
+   if((rc = pPfManager->OpenFile(fileName, fileHandle.pfFh,
+                                 PF_OPEN_BUFFERED, pool)))
       return (rc);
 
    // 读取头部信息            // TODO 等fileHande类写好在来检查一次
@@ -191,18 +205,20 @@ RC RM_Manager::CloseFile(RM_FileHandle &fileHandle)
 // ForcePages
 //
 // Desc: Internal. 根据record size 计算并返回每个page上容纳的record个数
-// In:   
+// In:   recordSize - record大小
+//       rmPageSize - RM page的可用空间
 // Ret:  
 //
-int RM_Manager::GetRecNumPerPage(const int recordSize) const
+int RM_Manager::GetRecNumPerPage(const int recordSize,
+                                 const int rmPageSize) const
 {
    // 计算一个 page 上能承载的 record 数量
-   int recNum = (RM_PAGE_SIZE * 8) / (8 * recordSize + 1);
+   int recNum = (rmPageSize * 8) / (8 * recordSize + 1);
 
 
    // 若计算出的recNum偏小，则+1进行调整
    int tempRecNum = recNum +1;
-   while( tempRecNum / 8 + !!(tempRecNum % 8) + tempRecNum * recordSize <= RM_PAGE_SIZE )
+   while( tempRecNum / 8 + !!(tempRecNum % 8) + tempRecNum * recordSize <= rmPageSize )
    {
       recNum = tempRecNum;
       tempRecNum++;
@@ -29,8 +29,7 @@ RM_Record::RM_Record ()
 //
 RM_Record::~RM_Record()
 {
-    if (pData != NULL)
-        delete pData;
+    delete [] pData;
 }
 
 //
@@ -48,10 +47,20 @@ RM_Record& RM_Record::operator=(const RM_Record &rec)
         // 拷贝RID
         this->rid = rec.rid;
 
-        // 深拷贝
+        // 深拷贝，大小相同时重用缓冲区
+        if(rec.pData == NULL)
+        {
+            delete [] this->pData;
+            this->pData = NULL;
+            return (*this);
+        }
+        if(this->pData == NULL || this->recordSize != rec.recordSize)
+        {
+            delete [] this->pData;
+            this->pData = new char[rec.recordSize];
+        }
         this->recordSize = rec.recordSize;
-        this->pData = new char[rec.recordSize];
-        strncpy(this->pData, rec.pData, rec.recordSize);
+        memcpy(this->pData, rec.pData, rec.recordSize);
     }
 
     return (*this);
@@ -100,3 +109,145 @@ RC RM_Record::GetRid (RID &rid) const
 
 
 
+
+//
+// RM_RecordView
+//
+// Desc: 默认构造，view为空，直到被GetRec或GetNextRec填充
+//
+RM_RecordView::RM_RecordView()
+{
+    pFileHandle = NULL;
+    pData = NULL;
+    recordSize = 0;
+}
+
+//
+// ~RM_RecordView
+//
+// Desc: pageGuard析构时unpin page
+//
+RM_RecordView::~RM_RecordView()
+{
+}
+
+//
+// GetData
+//
+// Desc: 给出page中record的地址，view存在期间有效
+// Out:  pData - record内容
+// Ret:  RM_INVALIDRECORD if the view is empty
+//
+RC RM_RecordView::GetData(const char *&pData) const
+{
+    if(!pageGuard.IsPinned())
+        return (RM_INVALIDRECORD);
+
+    pData = this->pData;
+    return (OK_RC);
+}
+
+//
+// GetRid
+//
+// Desc: 给出record的RID
+// Out:  rid
+// Ret:  RM_INVALIDRECORD if the view is empty
+//
+RC RM_RecordView::GetRid(RID &rid) const
+{
+    if(!pageGuard.IsPinned())
+        return (RM_INVALIDRECORD);
+
+    rid = this->rid;
+    return (OK_RC);
+}
+
+//
+// CopyOut
+//
+// Desc: 把record拷进rec，rec中已有同样大小的缓冲区时重用它
+// Out:  rec - record的拷贝
+// Ret:  RM_INVALIDRECORD if the view is empty
+//
+RC RM_RecordView::CopyOut(RM_Record &rec) const
+{
+    if(!pageGuard.IsPinned())
+        return (RM_INVALIDRECORD);
+
+    if(rec.pData == NULL || rec.recordSize != recordSize)
+    {
+        delete [] rec.pData;
+        rec.pData = new char[recordSize];
+    }
+    rec.recordSize = recordSize;
+    memcpy(rec.pData, pData, recordSize);
+    rec.rid = rid;
+    return (OK_RC);
+}
+
+//
+// CopyOut
+//
+// Desc: 把record拷进调用者的缓冲区
+// Out:  pBuf - record的拷贝，至少GetSize()字节
+// Ret:  RM_INVALIDRECORD if the view is empty
+//
+RC RM_RecordView::CopyOut(char *pBuf) const
+{
+    if(!pageGuard.IsPinned() || pBuf == NULL)
+        return (RM_INVALIDRECORD);
+
+    memcpy(pBuf, pData, recordSize);
+    return (OK_RC);
+}
+
+//
+// Release
+//
+// Desc: 立即unpin page，view变为空；view本就为空时什么也不做
+// Ret:  PF return code
+//
+RC RM_RecordView::Release()
+{
+    pFileHandle = NULL;
+    pData = NULL;
+    if(!pageGuard.IsPinned())
+        return (OK_RC);
+    return (pageGuard.UnpinPage());
+}
+
+//
+// RM_RecordBatch
+//
+// Desc: Constructor，batch为空
+//
+RM_RecordBatch::RM_RecordBatch()
+{
+    pageNum = -1;
+    numRecs = 0;
+}
+
+//
+// ~RM_RecordBatch
+//
+// Desc: pageGuard析构时unpin page
+//
+RM_RecordBatch::~RM_RecordBatch()
+{
+}
+
+//
+// Release
+//
+// Desc: 立即unpin page，batch变为空；batch本就为空时什么也不做
+// Ret:  PF return code
+//
+RC RM_RecordBatch::Release()
+{
+    numRecs = 0;
+    pageNum = -1;
+    if(!pageGuard.IsPinned())
+        return (OK_RC);
+    return (pageGuard.UnpinPage());
+}
@@ -21,6 +21,7 @@
 #include <cstring>
 #include <unistd.h>
 #include <cstdlib>
+#include <vector>
 
 #include "redbase.h"
 #include "pf.h"
@@ -53,6 +54,18 @@ struct TestRec {
     float r;
 };
 
+//
+// Records of the scan condition test, with two attributes of each type
+//
+#define CONDLEN     8                // length of strings in CondRec
+struct CondRec {
+    int   a;
+    int   b;
+    float x;
+    char  s[CONDLEN];
+    char  t[CONDLEN];
+};
+
 //
 // Global PF_Manager and RM_Manager variables
 //
@@ -66,6 +79,8 @@ RC Test1(void);
 RC Test2(void);
 RC Test3(void);
 RC Test4(void);
+RC Test5(void);
+RC Test6(void);
 
 void PrintError(RC rc);
 void LsFile(char *fileName);
@@ -82,17 +97,24 @@ RC InsertRec(RM_FileHandle &fh, char *record, RID &rid);
 RC UpdateRec(RM_FileHandle &fh, RM_Record &rec);
 RC DeleteRec(RM_FileHandle &fh, RID &rid);
 RC GetNextRecScan(RM_FileScan &fs, RM_Record &rec);
+RC CheckBatches(RM_FileHandle &fh, AttrType attrType, int attrLength,
+                int attrOffset, CompOp op, void *value);
+RC CheckConds(RM_FileHandle &fh, int numConds, const RM_Condition conds[],
+              int expected);
 
 //
 // Array of pointers to the test functions
 //
-#define NUM_TESTS       3               // number of tests
+#define NUM_TESTS       6               // number of tests
 // #define NUM_TESTS       ((int)((sizeof(tests)) / sizeof(tests[0])))    // number of tests
 int (*tests[])() =                      // RC doesn't work on some compilers
 {
     Test1,
     Test2,
-    Test3
+    Test3,
+    Test4,
+    Test5,
+    Test6
 };
 
 //
@@ -581,4 +603,447 @@ RC Test3(void)
     cout<<"\ncreating file with recsize = 0\n";
     if ((rc = CreateFile(fname, 0)))  RM_PrintError(rc);
 
+    return (0);
+}
+
+//
+// Test4 tests reading records in place through RM_RecordView, and
+// copying them into a caller's buffer
+//
+RC Test4(void)
+{
+    RC            rc;
+    RM_FileHandle fh;
+    RM_FileScan   fs;
+    RM_Record     rec, copy;
+    RID           rid, viewRid;
+    char          *pData, *pCopy;
+    const char    *pView;
+    char          buf[sizeof(TestRec)], buf2[sizeof(TestRec)];
+    int           n;
+
+    printf("test4 starting ****************\n");
+
+    if ((rc = CreateFile(FILENAME, sizeof(TestRec))) ||
+        (rc = OpenFile(FILENAME, fh)) ||
+        (rc = AddRecs(fh, FEW_RECS)))
+        return (rc);
+
+    printf("\ncomparing views of the records with their copies\n");
+
+    if ((rc = fs.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num),
+                          NO_OP, NULL, NO_HINT)))
+        return (rc);
+    for (rc = GetNextRecScan(fs, rec), n = 0;
+         rc == 0;
+         rc = GetNextRecScan(fs, rec), n++) {
+        RM_RecordView view;
+
+        if ((rc = rec.GetRid(rid)) ||
+            (rc = rec.GetData(pData)) ||
+            (rc = fh.GetRec(rid, view)) ||
+            (rc = view.GetData(pView)) ||
+            (rc = view.GetRid(viewRid)) ||
+            (rc = view.CopyOut(copy)) ||
+            (rc = copy.GetData(pCopy)) ||
+            (rc = view.CopyOut(buf2)) ||
+            (rc = fh.GetRec(rid, buf)))
+            return (rc);
+
+        if (!(viewRid == rid) || view.GetSize() != (int)sizeof(TestRec) ||
+            memcmp(pView, pData, sizeof(TestRec)) ||
+            memcmp(pCopy, pData, sizeof(TestRec)) ||
+            memcmp(buf2, pData, sizeof(TestRec)) ||
+            memcmp(buf, pData, sizeof(TestRec))) {
+            printf("Test4: view of record %d differs from its copy\n", n);
+            exit(1);
+        }
+    }
+    if (rc != RM_EOF || (rc = fs.CloseScan()))
+        return (rc);
+    if (n != FEW_RECS) {
+        printf("%d records in file (supposed to be %d)\n", n, FEW_RECS);
+        exit(1);
+    }
+
+    printf("\nreading a slot past the end of the page and a deleted slot\n");
+
+    PageNum pageNum;
+    RM_RecordView bad;
+    if ((rc = rid.GetPageNum(pageNum)))
+        return (rc);
+    if ((rc = fh.GetRec(RID(pageNum, PF_PAGE_SIZE), bad)) != RM_INVALIDSLOTNUM ||
+        (rc = fh.GetRec(RID(pageNum, PF_PAGE_SIZE), buf)) != RM_INVALIDSLOTNUM) {
+        printf("Test4: reading a slot past the end of the page should fail\n");
+        exit(1);
+    }
+    RM_PrintError(rc);
+    if ((rc = DeleteRec(fh, rid)))
+        return (rc);
+    if ((rc = fh.GetRec(rid, bad)) != RM_INVALIDSLOTNUM ||
+        (rc = fh.GetRec(rid, buf)) != RM_INVALIDSLOTNUM) {
+        printf("Test4: reading a deleted record should fail\n");
+        exit(1);
+    }
+    RM_PrintError(rc);
+    if (bad.GetData(pView) != RM_INVALIDRECORD) {
+        printf("Test4: failed GetRec left the view filled\n");
+        exit(1);
+    }
+
+    // The file cannot be closed while a view holds a page pinned
+    printf("\nreleasing views, then closing the file\n");
+
+    RM_RecordView held;
+    if ((rc = fh.GetRec(RID(pageNum, 0), held)) ||
+        (rc = held.Release()))
+        return (rc);
+    if (held.GetData(pView) != RM_INVALIDRECORD) {
+        printf("Test4: released view still points into the page\n");
+        exit(1);
+    }
+    {
+        RM_RecordView scoped;
+        if ((rc = fh.GetRec(RID(pageNum, 0), scoped)) ||
+            (rc = fh.GetRec(RID(pageNum, 1), scoped)))
+            return (rc);
+    }
+
+    if ((rc = CloseFile(FILENAME, fh)) ||
+        (rc = DestroyFile(FILENAME)))
+        return (rc);
+
+    printf("\ntest4 done ********************\n");
+    return (0);
+}
+
+//
+// CheckBatches
+//
+// Desc: Scan the file with a condition three times: by GetNextRec, by
+//       GetNextBatch, and alternating the two.  All three must return the
+//       same records in the same order, and every batch must hold the
+//       matching records of one page, none of them empty.
+//
+RC CheckBatches(RM_FileHandle &fh, AttrType attrType, int attrLength,
+                int attrOffset, CompOp op, void *value)
+{
+    RC               rc;
+    RM_FileScan      fs;
+    RM_Record        rec;
+    RM_RecordBatch   batch;
+    RID              rid;
+    PageNum          pageNum, lastPage;
+    char             *pData;
+    vector<RID>      rids;
+    vector<TestRec>  recs;
+    int              i, n, numPages, numBatches;
+
+    // The records one at a time
+    if ((rc = fs.OpenScan(fh, attrType, attrLength, attrOffset, op, value)))
+        return (rc);
+    for (numPages = 0, lastPage = -1;
+         (rc = GetNextRecScan(fs, rec)) == 0;) {
+        if ((rc = rec.GetRid(rid)) ||
+            (rc = rec.GetData(pData)) ||
+            (rc = rid.GetPageNum(pageNum)))
+            return (rc);
+        rids.push_back(rid);
+        recs.push_back(*(TestRec *)pData);
+        if (pageNum != lastPage)
+            numPages++;
+        lastPage = pageNum;
+    }
+    if (rc != RM_EOF || (rc = fs.CloseScan()))
+        return (rc);
+
+    // A page at a time
+    if ((rc = fs.OpenScan(fh, attrType, attrLength, attrOffset, op, value)))
+        return (rc);
+    for (n = 0, numBatches = 0, lastPage = -1;
+         (rc = fs.GetNextBatch(batch)) == 0;
+         numBatches++) {
+        if (batch.GetNumRecs() == 0) {
+            printf("CheckBatches: empty batch\n");
+            exit(1);
+        }
+        for (i = 0; i < batch.GetNumRecs(); i++, n++) {
+            if ((rc = batch.GetRid(i).GetPageNum(pageNum)))
+                return (rc);
+            if (n >= (int)rids.size() || !(batch.GetRid(i) == rids[n]) ||
+                memcmp(batch.GetData(i), &recs[n], sizeof(TestRec)) ||
+                (i == 0 && pageNum == lastPage) ||
+                (i > 0 && pageNum != lastPage)) {
+                printf("CheckBatches: batch record %d differs from scan\n", n);
+                exit(1);
+            }
+            lastPage = pageNum;
+        }
+    }
+    if (rc != RM_EOF || (rc = fs.CloseScan()) || (rc = batch.Release()))
+        return (rc);
+    if (n != (int)rids.size() || numBatches != numPages) {
+        printf("CheckBatches: %d records in %d batches, scan found %d on %d pages\n",
+               n, numBatches, (int)rids.size(), numPages);
+        exit(1);
+    }
+
+    // A record, then the rest of its page, then a record of the next one
+    if ((rc = fs.OpenScan(fh, attrType, attrLength, attrOffset, op, value)))
+        return (rc);
+    for (n = 0, i = 0; ; i++) {
+        if (i % 2 == 0) {
+            if ((rc = GetNextRecScan(fs, rec)) ||
+                (rc = rec.GetRid(rid)))
+                break;
+            if (n >= (int)rids.size() || !(rid == rids[n])) {
+                printf("CheckBatches: record %d repeated or skipped\n", n);
+                exit(1);
+            }
+            n++;
+        }
+        else {
+            if ((rc = fs.GetNextBatch(batch)))
+                break;
+            for (int j = 0; j < batch.GetNumRecs(); j++, n++)
+                if (n >= (int)rids.size() || !(batch.GetRid(j) == rids[n])) {
+                    printf("CheckBatches: record %d repeated or skipped\n", n);
+                    exit(1);
+                }
+        }
+    }
+    if (rc != RM_EOF || (rc = fs.CloseScan()) || (rc = batch.Release()))
+        return (rc);
+    if (n != (int)rids.size()) {
+        printf("CheckBatches: %d records mixing GetNextRec and GetNextBatch, "
+               "%d by GetNextRec\n", n, (int)rids.size());
+        exit(1);
+    }
+
+    printf("%d records on %d pages\n", n, numPages);
+    return (0);
+}
+
+//
+// Test5 tests scanning a page at a time with GetNextBatch
+//
+RC Test5(void)
+{
+    RC            rc;
+    RM_FileHandle fh;
+    int           num;
+    char          str[STRLEN];
+
+    printf("test5 starting ****************\n");
+
+    if ((rc = CreateFile(FILENAME, sizeof(TestRec))) ||
+        (rc = OpenFile(FILENAME, fh)) ||
+        (rc = AddRecs(fh, FEW_RECS * 25)))
+        return (rc);
+
+    // Only the last pages match
+    printf("\nbatches of num >= %d\n", FEW_RECS * 25 / 2);
+    num = FEW_RECS * 25 / 2;
+    if ((rc = CheckBatches(fh, INT, sizeof(int), offsetof(TestRec, num),
+                           GE_OP, &num)))
+        return (rc);
+
+    // "a3".."a9", "a30".."a99" and "a300" on: the second page has none
+    printf("\nbatches of str >= \"a3\"\n");
+    memset(str, 0, STRLEN);
+    strcpy(str, "a3");
+    if ((rc = CheckBatches(fh, STRING, STRLEN, offsetof(TestRec, str),
+                           GE_OP, str)))
+        return (rc);
+
+    printf("\nbatches of every record\n");
+    if ((rc = CheckBatches(fh, INT, sizeof(int), offsetof(TestRec, num),
+                           NO_OP, NULL)))
+        return (rc);
+
+    // No batch at all
+    printf("\nbatches of num < 0\n");
+    num = 0;
+    if ((rc = CheckBatches(fh, INT, sizeof(int), offsetof(TestRec, num),
+                           LT_OP, &num)))
+        return (rc);
+
+    if ((rc = CloseFile(FILENAME, fh)) ||
+        (rc = DestroyFile(FILENAME)))
+        return (rc);
+
+    printf("\ntest5 done ********************\n");
+    return (0);
+}
+
+//
+// CheckConds
+//
+// Desc: Scan the file with a list of conditions, by GetNextRec and by
+//       GetNextBatch, and check that both find the expected number of
+//       records
+//
+RC CheckConds(RM_FileHandle &fh, int numConds, const RM_Condition conds[],
+              int expected)
+{
+    RC             rc;
+    RM_FileScan    fs;
+    RM_Record      rec;
+    RM_RecordBatch batch;
+    int            n, nBatch;
+
+    if ((rc = fs.OpenScan(fh, numConds, conds)))
+        return (rc);
+    for (n = 0; (rc = GetNextRecScan(fs, rec)) == 0; n++)
+        ;
+    if (rc != RM_EOF || (rc = fs.CloseScan()))
+        return (rc);
+
+    if ((rc = fs.OpenScan(fh, numConds, conds)))
+        return (rc);
+    for (nBatch = 0; (rc = fs.GetNextBatch(batch)) == 0; )
+        nBatch += batch.GetNumRecs();
+    if (rc != RM_EOF || (rc = fs.CloseScan()) || (rc = batch.Release()))
+        return (rc);
+
+    printf("%d records, %d in batches, %d expected\n", n, nBatch, expected);
+    if (n != expected || nBatch != expected) {
+        printf("CheckConds: wrong number of records\n");
+        exit(1);
+    }
+    return (0);
+}
+
+//
+// Test6 tests scans with a list of conditions
+//
+#define COND_RECS   1000             // number of records in Test6
+RC Test6(void)
+{
+    RC            rc;
+    RM_FileHandle fh;
+    RM_FileScan   fs;
+    RM_Record     rec;
+    CondRec       cr;
+    RID           rid;
+    int           i, n;
+
+    printf("test6 starting ****************\n");
+
+    if ((rc = CreateFile(FILENAME, sizeof(CondRec))) ||
+        (rc = OpenFile(FILENAME, fh)))
+        return (rc);
+
+    printf("\nadding %d records\n", COND_RECS);
+    for (i = 0; i < COND_RECS; i++) {
+        memset((void *)&cr, 0, sizeof(cr));
+        cr.a = i % 50;
+        cr.b = (i * 7) % 50;
+        cr.x = i * 0.5f;
+        sprintf(cr.s, "s%03d", i % 100);
+        sprintf(cr.t, "s%03d", (i * 3) % 100);
+        if ((rc = InsertRec(fh, (char *)&cr, rid)))
+            return (rc);
+    }
+
+    int   aMax = 25, aEq = 10;
+    float xMin = 100.0f, xMax = 400.0f;
+    char  sNot[CONDLEN];
+    memset(sNot, 0, CONDLEN);
+    strcpy(sNot, "s007");
+
+    // a < 25 and x >= 100 and s != "s007"
+    printf("\nscanning with three conditions on constants\n");
+    RM_Condition three[] = {
+        { INT,    sizeof(int),   offsetof(CondRec, a), LT_OP, FALSE, 0, &aMax },
+        { FLOAT,  sizeof(float), offsetof(CondRec, x), GE_OP, FALSE, 0, &xMin },
+        { STRING, CONDLEN,       offsetof(CondRec, s), NE_OP, FALSE, 0, sNot },
+    };
+    for (i = 0, n = 0; i < COND_RECS; i++)
+        if (i % 50 < aMax && i * 0.5f >= xMin && i % 100 != 7)
+            n++;
+    if ((rc = CheckConds(fh, 3, three, n)))
+        return (rc);
+
+    // a > b
+    printf("\nscanning with conditions between two attributes\n");
+    RM_Condition attrs[] = {
+        { INT,    sizeof(int), offsetof(CondRec, a), GT_OP, TRUE,
+          offsetof(CondRec, b), NULL },
+    };
+    for (i = 0, n = 0; i < COND_RECS; i++)
+        if (i % 50 > (i * 7) % 50)
+            n++;
+    if ((rc = CheckConds(fh, 1, attrs, n)))
+        return (rc);
+
+    // s == t and x < 400
+    RM_Condition mixed[] = {
+        { STRING, CONDLEN,       offsetof(CondRec, s), EQ_OP, TRUE,
+          offsetof(CondRec, t), NULL },
+        { FLOAT,  sizeof(float), offsetof(CondRec, x), LT_OP, FALSE, 0, &xMax },
+    };
+    for (i = 0, n = 0; i < COND_RECS; i++)
+        if (i % 100 == (i * 3) % 100 && i * 0.5f < xMax)
+            n++;
+    if ((rc = CheckConds(fh, 2, mixed, n)))
+        return (rc);
+
+    // NO_OP conditions match every record, alone or with others
+    printf("\nscanning with NO_OP conditions\n");
+    RM_Condition noOps[] = {
+        { INT,    sizeof(int), offsetof(CondRec, a), NO_OP, FALSE, 0, NULL },
+        { INT,    sizeof(int), offsetof(CondRec, a), EQ_OP, FALSE, 0, &aEq },
+        { STRING, CONDLEN,     offsetof(CondRec, s), NO_OP, TRUE,
+          offsetof(CondRec, t), NULL },
+    };
+    if ((rc = CheckConds(fh, 1, noOps, COND_RECS)) ||
+        (rc = CheckConds(fh, 3, noOps, COND_RECS / 50)) ||
+        (rc = CheckConds(fh, 0, noOps, COND_RECS)))
+        return (rc);
+
+    // The scan stays closed after each of these
+    printf("\nopening scans with bad conditions\n");
+    RM_Condition noValue[] = {
+        { INT,    sizeof(int), offsetof(CondRec, a), LT_OP, FALSE, 0, &aMax },
+        { INT,    sizeof(int), offsetof(CondRec, b), EQ_OP, FALSE, 0, NULL },
+    };
+    if ((rc = fs.OpenScan(fh, 2, noValue)) != RM_NULLVALUE) {
+        printf("Test6: a condition without a value should fail\n");
+        exit(1);
+    }
+    RM_PrintError(rc);
+
+    RM_Condition badOffsets[] = {
+        // the int would run past the record
+        { INT,    sizeof(int), sizeof(CondRec) - 1, EQ_OP, FALSE, 0, &aEq },
+        // so would the string on the right
+        { STRING, CONDLEN,     offsetof(CondRec, s), EQ_OP, TRUE,
+          sizeof(CondRec) - CONDLEN + 1, NULL },
+        { INT,    sizeof(int), -1, EQ_OP, FALSE, 0, &aEq },
+    };
+    for (i = 0; i < 3; i++) {
+        if ((rc = fs.OpenScan(fh, 1, &badOffsets[i])) != RM_INVALIDATTROFFSET) {
+            printf("Test6: bad offset %d should fail\n", i);
+            exit(1);
+        }
+        RM_PrintError(rc);
+    }
+    if ((rc = fs.OpenScan(fh, INT, sizeof(int), sizeof(CondRec) - 2, GE_OP,
+                          &aEq)) != RM_INVALIDATTROFFSET) {
+        printf("Test6: bad offset should fail\n");
+        exit(1);
+    }
+    RM_PrintError(rc);
+    if ((rc = fs.GetNextRec(rec)) != RM_CLOSEDSCAN) {
+        printf("Test6: the scan should still be closed\n");
+        exit(1);
+    }
+
+    if ((rc = CloseFile(FILENAME, fh)) ||
+        (rc = DestroyFile(FILENAME)))
+        return (rc);
+
+    printf("\ntest6 done ********************\n");
+    return (0);
 }
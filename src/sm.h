@@ -22,6 +22,12 @@
 
 #define MAX_DB_NAME 255
 
+// Closed files whose pages stay in the buffer while a database is open,
+// and the file in the database directory listing the pages to warm the
+// buffer up with when it is next opened
+#define SM_KEPT_FILES 32
+#define SM_WARM_LIST "warmlist"
+
 // Define the catalog entry for a relation
 typedef struct RelCatEntry{
   char relName[MAXNAME + 1];
@@ -90,12 +90,19 @@ RC SM_Manager::OpenDb(const char *dbName)
     return (SM_INVALIDDB);
   }
 
+  // Keep the pages of closed files in the buffer, and start reading back
+  // in the background those that were there when the database was last
+  // closed
+  if((rc = rmm.pPfManager->SetKeepClosed(SM_KEPT_FILES)) ||
+     (rc = rmm.pPfManager->WarmUp(SM_WARM_LIST)))
+    return (rc);
+
   // Open and keep the relcat and attrcat filehandles stored
-  // during duration of database
-  if((rc = rmm.OpenFile("relcat", relcatFH) )){
+  // during duration of database, in the pool of the catalogs
+  if((rc = rmm.OpenFile("relcat", relcatFH, PF_POOL_CATALOG) )){
     return (SM_INVALIDDB);
   }
-  if((rc = rmm.OpenFile("attrcat", attrcatFH))) {
+  if((rc = rmm.OpenFile("attrcat", attrcatFH, PF_POOL_CATALOG))) {
     return (SM_INVALIDDB);
   }
   
@@ -117,6 +124,11 @@ RC SM_Manager::CloseDb()
   if((rc = rmm.CloseFile(attrcatFH))){
     return (rc);
   } 
+
+  // Remember which pages were in the buffer, for the next OpenDb
+  if((rc = rmm.pPfManager->SaveWarmList(SM_WARM_LIST))){
+    return (rc);
+  }
   
   return (0);
 }
@@ -458,7 +470,7 @@ RC SM_Manager::CreateIndex(const char *relName,
     return (rc);
 
   // scan through the entire file:
-  if((rc = fs.OpenScan(fh, INT, 4, 0, NO_OP, NULL))){
+  if((rc = fs.OpenScan(fh, INT, 4, 0, NO_OP, NULL, SEQUENTIAL_ONCE))){
     return (rc);
   }
   RM_Record rec;
@@ -839,7 +851,7 @@ RC SM_Manager::Print(const char *relName)
   // open the file, and a scan through the entire file
   RM_FileHandle fh;
   RM_FileScan fs;
-  if((rc = rmm.OpenFile(relName, fh)) || (rc = fs.OpenScan(fh, INT, 4, 0, NO_OP, NULL))){
+  if((rc = rmm.OpenFile(relName, fh)) || (rc = fs.OpenScan(fh, INT, 4, 0, NO_OP, NULL, SEQUENTIAL_ONCE))){
     free(attributes);
     return (rc);
   }
@@ -966,6 +978,36 @@ RC SM_Manager::Set(const char *paramName, const char *value)
       CalcStats(value);
       return (0);
     }
+    // Background writer of the buffer pool: fraction of the pool kept
+    // clean (0 turns it off) and most pages written per second (0 = any)
+    if(strcmp(paramName, "bgWriterClean") == 0){
+      if((rc = rmm.pPfManager->SetWriterTarget(atof(value))))
+        return (rc);
+      return (0);
+    }
+    if(strcmp(paramName, "bgWriterRate") == 0){
+      if((rc = rmm.pPfManager->SetWriterRate(atoi(value))))
+        return (rc);
+      return (0);
+    }
+    // Size in pages and replacement policy (lru, clock, 2q or lru2) of a
+    // buffer pool, e.g. set poolIndex = "64 lru2"
+    static const char *poolNames[PF_NUM_POOLS] = {
+      "poolData", "poolCatalog", "poolIndex", "poolTemp" };
+    static const char *policyNames[] = { "lru", "clock", "2q", "lru2" };
+    for(int p = 0; p < PF_NUM_POOLS; p++){
+      if(strcmp(paramName, poolNames[p]) != 0)
+        continue;
+      int numPages;
+      char policyName[16];
+      if(sscanf(value, "%d %15s", &numPages, policyName) != 2)
+        return (SM_BADSET);
+      for(int i = 0; i < 4; i++)
+        if(strcmp(policyName, policyNames[i]) == 0)
+          return (rmm.pPfManager->SetPool((PF_PoolId)p, numPages,
+                                          (PF_ReplacePolicy)i));
+      return (SM_BADSET);
+    }
 
 
     return (SM_BADSET);
@@ -1269,7 +1311,7 @@ RC SM_Manager::CalcStats(const char *relName){
   RM_FileScan fs;
   RM_FileHandle fh;
   RM_Record rec;
-  if((rc = rmm.OpenFile(relName, fh)) || (rc = fs.OpenScan(fh, INT, 0, 0, NO_OP, NULL)))
+  if((rc = rmm.OpenFile(relName, fh)) || (rc = fs.OpenScan(fh, INT, 0, 0, NO_OP, NULL, SEQUENTIAL_ONCE)))
     return (rc);
   while(RM_EOF != fs.GetNextRec(rec)){
     char * recData;
@@ -9,7 +9,8 @@
 // StatisticsMgr::Register.
 
 // There is no need to setup in advance which statistics that you want to
-// track.  The call to Register is sufficient.
+// track.  The call to Register is sufficient.  Each statistic is a row of
+// counters, one per stripe of threads, summed when it is read.
 
 // This is essentially a (poor-man's) simplified version of gprof.
 
@@ -18,6 +19,7 @@
 
 #include <cstring>
 #include <iostream>
+#include <iomanip>
 #include "statistics.h"
 
 using namespace std;
@@ -32,83 +34,180 @@ const char *PF_PAGENOTFOUND = "PAGENOTFOUND";
 const char *PF_READPAGE = "READPAGE";           // IO
 const char *PF_WRITEPAGE = "WRITEPAGE";         // IO
 const char *PF_FLUSHPAGES = "FLUSHPAGES";
+const char *PF_VICTIMS = "VICTIMS";
+const char *PF_VICTIMPROBES = "VICTIMPROBES";
+const char *PF_WRITEV = "WRITEV";
+const char *PF_READV = "READV";
+const char *PF_PREFETCHED = "PREFETCHED";
+const char *PF_PREFETCHHITS = "PREFETCHHITS";
+const char *PF_PREFETCHWASTED = "PREFETCHWASTED";
+const char *PF_DIRTYVICTIMS = "DIRTYVICTIMS";
+const char *PF_BGWRITES = "BGWRITES";
+const char *PF_BGWRITEV = "BGWRITEV";
+const char *PF_MAPPEDPINS = "MAPPEDPINS";
+const char *PF_EXTENTS = "EXTENTS";
+
+// The PF keys in the order of PF_StatHandle
+static const char *const *apsPFKeys[PF_NUM_STATS] = {
+   &PF_GETPAGE, &PF_PAGEFOUND, &PF_PAGENOTFOUND, &PF_READPAGE,
+   &PF_WRITEPAGE, &PF_FLUSHPAGES, &PF_VICTIMS, &PF_VICTIMPROBES,
+   &PF_WRITEV, &PF_READV, &PF_PREFETCHED, &PF_PREFETCHHITS,
+   &PF_PREFETCHWASTED, &PF_DIRTYVICTIMS, &PF_BGWRITES, &PF_BGWRITEV,
+   &PF_MAPPEDPINS, &PF_EXTENTS
+};
+
+// Names of the latencies, in the order of Stat_Latency
+static const char *apsLatencyNames[STAT_NUM_LATENCIES] = {
+   "PF GetPage", "PF read", "PF write", "RM GetRec", "RM InsertRec",
+   "RM DeleteRec", "RM UpdateRec", "RM GetNextRec", "IX InsertEntry",
+   "IX DeleteEntry", "IX GetNextEntry"
+};
+
+thread_local int iStatStripe = -1;
+
+//
+// MonotonicNs
+//
+// Desc: Current time of CLOCK_MONOTONIC, in nanoseconds
+//
+static long long MonotonicNs()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
 
+// Stripe the next thread to count gets
+static int iNextStripe = 0;
+
+//
+// StatLatch
 //
-// Statistic class
+// Holds the latch of a StatisticsMgr for the rest of the block
 //
-// This class will track a single statistic
+class StatLatch {
+public:
+   StatLatch(pthread_mutex_t *pLatch_) : pLatch(pLatch_)
+      { pthread_mutex_lock(pLatch); }
+   ~StatLatch() { pthread_mutex_unlock(pLatch); }
+private:
+   pthread_mutex_t *pLatch;
+};
 
 //
-// Default Constructor utilized by the templates
+// StatisticMgr class
+//
+// This class will track a fixed table of statistics, added as they are
+// first named and never removed, so that handles stay valid.
 //
-Statistic::Statistic()
-{
-   psKey = NULL;
-   iValue = 0;
-}
-
 
 //
-// Constructor utilized by the StatisticMgr class
+// StatisticsMgr
 //
-// We are assured by the StatisticMgr that psKey_ is not a NULL pointer.
+// Desc: Constructor.  The PF statistics get their handles right away.
 //
-Statistic::Statistic(const char *psKey_)
+StatisticsMgr::StatisticsMgr()
 {
-   psKey = new char[strlen(psKey_) + 1];
-   strcpy (psKey, psKey_);
-
-   iValue = 0;
+   memset(aStripes, 0, sizeof(aStripes));
+   memset(abChanged, FALSE, sizeof(abChanged));
+   numKeys = 0;
+   memset(apHists, 0, sizeof(apHists));
+   startTicks = StatTicks();
+   startNs = MonotonicNs();
+   pthread_mutex_init(&latch, NULL);
+
+   for (int i = 0; i < PF_NUM_STATS; i++)
+      Handle(*apsPFKeys[i]);
 }
 
 //
-// Copy constructor
+// ~StatisticsMgr
 //
-Statistic::Statistic(const Statistic &stat)
+// Desc: Destructor
+//
+StatisticsMgr::~StatisticsMgr()
 {
-    psKey = new char[strlen(stat.psKey)+1];
-    strcpy (psKey, stat.psKey);
-
-    iValue = stat.iValue;
+   for (int i = 0; i < numKeys; i++)
+      delete [] apsKey[i];
+   for (int s = 0; s < STAT_STRIPES; s++)
+      delete apHists[s];
+   pthread_mutex_destroy(&latch);
 }
 
 //
-// Equality constructor
+// Find
+//
+// Desc: Internal.  Look a statistic up by name.  Takes no latch: names
+//       are only ever appended, and numKeys is published after the name.
+// In:   psKey - name of the statistic
+// Ret:  its handle, -1 if it is not tracked
 //
-Statistic& Statistic::operator=(const Statistic &stat)
+StatHandle StatisticsMgr::Find(const char *psKey) const
 {
-   if (this==&stat)
-      return *this;
+   int n = __atomic_load_n(&numKeys, __ATOMIC_ACQUIRE);
 
-   delete [] psKey;
-   psKey = new char[strlen(stat.psKey)+1];
-   strcpy (psKey, stat.psKey);
-
-   iValue = stat.iValue;
-
-   return *this;
+   for (int i = 0; i < n; i++)
+      if (strcmp(apsKey[i], psKey) == 0)
+         return (i);
+   return (-1);
 }
 
 //
-// Destructor
+// Handle
+//
+// Desc: Get the handle of a statistic, adding it if it is new
+// In:   psKey - name of the statistic
+// Ret:  its handle, -1 if psKey is NULL or the table is full
 //
-Statistic::~Statistic()
+StatHandle StatisticsMgr::Handle(const char *psKey)
 {
-   delete [] psKey;
+   StatHandle h;
+
+   if (psKey == NULL)
+      return (-1);
+   if ((h = Find(psKey)) >= 0)
+      return (h);
+
+   // Someone may have added it while we were looking
+   StatLatch guard(&latch);
+   if ((h = Find(psKey)) >= 0)
+      return (h);
+   if (numKeys == STAT_MAX_KEYS)
+      return (-1);
+
+   apsKey[numKeys] = new char[strlen(psKey) + 1];
+   strcpy(apsKey[numKeys], psKey);
+   __atomic_store_n(&numKeys, numKeys + 1, __ATOMIC_RELEASE);
+   return (numKeys - 1);
 }
 
-Boolean Statistic::operator==(const char *psKey_) const
+//
+// Stripe
+//
+// Desc: Internal.  Give the calling thread its stripe; threads take the
+//       stripes in turn
+// Ret:  the stripe
+//
+int StatisticsMgr::Stripe()
 {
-   return (strcmp(psKey_, psKey)==0);
+   iStatStripe = __atomic_fetch_add(&iNextStripe, 1, __ATOMIC_RELAXED)
+      % STAT_STRIPES;
+   return (iStatStripe);
 }
 
-// --------------------------------------------------------------
-
 //
-// StatisticMgr class
+// Sum
 //
-// This class will track a dynamic list of statistics.
+// Desc: Internal.  Current value of a statistic: the sum of its counters
 //
+long long StatisticsMgr::Sum(StatHandle h) const
+{
+   long long lValue = 0;
+
+   for (int s = 0; s < STAT_STRIPES; s++)
+      lValue += __atomic_load_n(&aStripes[s].alValue[h], __ATOMIC_RELAXED);
+   return (lValue);
+}
 
 //
 // Register
@@ -121,59 +220,57 @@ Boolean Statistic::operator==(const char *psKey_) const
 // Note: if the statistic isn't found (as it will not be the very first
 // time) then it will be initialized to 0 - the default value.
 //
+// Adding and subtracting go through Add.  The other operations replace the
+// value, so they hold the latch; an add racing with them may be lost.
+//
 RC StatisticsMgr::Register (const char *psKey, const Stat_Operation op,
       const int *const piValue)
 {
-   int i, iCount;
-   Statistic *pStat = NULL;
-
    if (psKey==NULL || (op != STAT_ADDONE && piValue == NULL))
       return STAT_INVALID_ARGS;
+   if (op == STAT_DIVVALUE && *piValue == 0)
+      return STAT_INVALID_ARGS;
 
-   iCount = llStats.GetLength();
+   StatHandle h = Handle(psKey);
+   if (h < 0)
+      return STAT_TOO_MANY;
 
-   for (i=0; i < iCount; i++) {
-      pStat = llStats[i];
-      if (*pStat == psKey)
+   switch (op) {
+      case STAT_ADDONE:
+         Add(h);
+         return 0;
+      case STAT_ADDVALUE:
+         Add(h, *piValue);
+         return 0;
+      case STAT_SUBVALUE:
+         Add(h, -*piValue);
+         return 0;
+      default:
          break;
    }
 
-   // Check to see if we found the Stat
-   if (i==iCount)
-      // We haven't found it so create a new statistic
-      // with the key psKey and initial value of 0.
-      pStat = new Statistic( psKey );
+   StatLatch guard(&latch);
+   long long lValue = abChanged[h] ? Sum(h) : 0;
 
-   // Now perform the operation over the statistic
    switch (op) {
-      case STAT_ADDONE:
-         pStat->iValue++;
-         break;
-      case STAT_ADDVALUE:
-         pStat->iValue += *piValue;
-         break;
       case STAT_SETVALUE:
-         pStat->iValue = *piValue;
+         lValue = *piValue;
          break;
       case STAT_MULTVALUE:
-         pStat->iValue *= *piValue;
+         lValue *= *piValue;
          break;
       case STAT_DIVVALUE:
-         pStat->iValue = (int) (pStat->iValue/(*piValue));
+         lValue = (int) (lValue/(*piValue));
          break;
-      case STAT_SUBVALUE:
-         pStat->iValue -= *piValue;
+      default:
          break;
    };
 
-   // Finally, if the statistic wasn't in the original list then add it to
-   // the list.
-   //  JASON:: Confirm that it makes a copy of the object in line 229 of
-   //  linkedlist.h.
-   if (i==iCount) {
-      llStats.Append(*pStat);
-      delete pStat;
-   }
+   // The value ends up in the first stripe
+   for (int s = 0; s < STAT_STRIPES; s++)
+      __atomic_store_n(&aStripes[s].alValue[h], s == 0 ? lValue : 0,
+                       __ATOMIC_RELAXED);
+   __atomic_store_n(&abChanged[h], TRUE, __ATOMIC_RELAXED);
 
    return 0;
 }
@@ -204,28 +301,20 @@ RC StatisticsMgr::Print(const char *psKey)
 // Get
 //
 // The Get method will return a pointer to the integer value associated
-// with a particular statistic.  If it cannot find the statistic then it
-// will return NULL.  The caller must remember to delete the memory
-// returned when done.
+// with a particular statistic.  If it cannot find the statistic, or it
+// was not changed since it was last reset, then it will return NULL.  The
+// caller must remember to delete the memory returned when done.
 //
 int *StatisticsMgr::Get(const char *psKey)
 {
-   int i, iCount;
-   Statistic *pStat = NULL;
-
-   iCount = llStats.GetLength();
-
-   for (i=0; i < iCount; i++) {
-      pStat = llStats[i];
-      if (*pStat == psKey)
-         break;
-   }
+   if (psKey==NULL)
+      return NULL;
 
-   // Check to see if we found the Stat
-   if (i==iCount)
+   StatHandle h = Find(psKey);
+   if (h < 0 || !__atomic_load_n(&abChanged[h], __ATOMIC_RELAXED))
       return NULL;
 
-   return new int(pStat->iValue);
+   return new int((int)Sum(h));
 }
 
 //
@@ -235,56 +324,206 @@ int *StatisticsMgr::Get(const char *psKey)
 //
 void StatisticsMgr::Print()
 {
-   int i, iCount;
-   Statistic *pStat = NULL;
-
-   iCount = llStats.GetLength();
+   int n = __atomic_load_n(&numKeys, __ATOMIC_ACQUIRE);
 
-   for (i=0; i < iCount; i++) {
-      pStat = llStats[i];
-      cout << pStat->psKey << "::" << pStat->iValue << "\n";
-   }
+   for (int i=0; i < n; i++)
+      if (__atomic_load_n(&abChanged[i], __ATOMIC_RELAXED))
+         cout << apsKey[i] << "::" << Sum(i) << "\n";
+   PrintLatencies();
 }
 
 //
 // Reset
 //
-// Reset a specific statistic.  The easiest way to do this is to remove it
-// completely from the list
+// Reset a specific statistic.  It keeps its handle, but is reported as
+// unknown until it changes again.
 //
 RC StatisticsMgr::Reset(const char *psKey)
 {
-   int i, iCount;
-   Statistic *pStat = NULL;
-
    if (psKey==NULL)
       return STAT_INVALID_ARGS;
 
-   iCount = llStats.GetLength();
-
-   for (i=0; i < iCount; i++) {
-      pStat = llStats[i];
-      if (*pStat == psKey)
-         break;
-   }
-
-   // If we found the statistic then remove it from the list
-   if (i!=iCount)
-      llStats.Delete(i);
-   else
+   StatHandle h = Find(psKey);
+   if (h < 0 || !__atomic_load_n(&abChanged[h], __ATOMIC_RELAXED))
       return STAT_UNKNOWN_KEY;
 
+   StatLatch guard(&latch);
+   __atomic_store_n(&abChanged[h], FALSE, __ATOMIC_RELAXED);
+   for (int s = 0; s < STAT_STRIPES; s++)
+      __atomic_store_n(&aStripes[s].alValue[h], 0LL, __ATOMIC_RELAXED);
+
    return 0;
 }
 
 //
 // Reset
 //
-// Reset all of the statistics.  The easiest way is to tell the linklist of
-// elements to Erase itself.
+// Reset all of the statistics, and empty the latency histograms
 //
 void StatisticsMgr::Reset()
 {
-   llStats.Erase();
+   int n = __atomic_load_n(&numKeys, __ATOMIC_ACQUIRE);
+
+   StatLatch guard(&latch);
+   for (int i = 0; i < n; i++) {
+      __atomic_store_n(&abChanged[i], FALSE, __ATOMIC_RELAXED);
+      for (int s = 0; s < STAT_STRIPES; s++)
+         __atomic_store_n(&aStripes[s].alValue[i], 0LL, __ATOMIC_RELAXED);
+   }
+
+   for (int s = 0; s < STAT_STRIPES; s++) {
+      Histograms *pHists = __atomic_load_n(&apHists[s], __ATOMIC_ACQUIRE);
+      if (pHists == NULL)
+         continue;
+      for (int l = 0; l < STAT_NUM_LATENCIES; l++)
+         for (int b = 0; b < STAT_HIST_BUCKETS; b++)
+            __atomic_store_n(&pHists->aiCount[l][b], 0u, __ATOMIC_RELAXED);
+   }
 }
 
+//
+// NewHistograms
+//
+// Desc: Internal.  Give a stripe its latency histograms.  Two threads of
+//       the stripe may get here at once; one of them wins.
+// In:   stripe - the stripe, which has none yet
+// Ret:  the histograms of the stripe
+//
+StatisticsMgr::Histograms *StatisticsMgr::NewHistograms(int stripe)
+{
+   Histograms *pHists = new Histograms();
+   Histograms *pExpected = NULL;
+
+   if (!__atomic_compare_exchange_n(&apHists[stripe], &pExpected, pHists,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      delete pHists;
+      return (pExpected);
+   }
+   return (pHists);
+}
+
+//
+// BucketTicks
+//
+// Desc: Middle of the values a histogram bucket counts, in ticks
+//
+static double BucketTicks(int bucket)
+{
+   if (bucket < 16)
+      return (bucket);
+
+   int shift = bucket / 16 - 1;
+   double low = (double)((16LL + bucket % 16) << shift);
+   return (low + ((1LL << shift) - 1) / 2.0);
+}
+
+//
+// TicksPerUs
+//
+// Desc: Internal.  Rate of StatTicks, measured against the clock since
+//       the manager was built
+//
+double StatisticsMgr::TicksPerUs() const
+{
+#if defined(__x86_64__) || defined(__i386__)
+   long long ns = MonotonicNs() - startNs;
+   if (ns <= 0)
+      return (1000.0);
+   return ((double)(StatTicks() - startTicks) * 1000.0 / ns);
+#else
+   return (1000.0);
+#endif
+}
+
+//
+// GetLatencyCount
+//
+// Desc: Number of latencies recorded for an operation since the last reset
+// In:   lat - operation
+// Ret:  the count
+//
+long long StatisticsMgr::GetLatencyCount(Stat_Latency lat) const
+{
+   long long count = 0;
+
+   for (int s = 0; s < STAT_STRIPES; s++) {
+      Histograms *pHists = __atomic_load_n(&apHists[s], __ATOMIC_ACQUIRE);
+      if (pHists == NULL)
+         continue;
+      for (int b = 0; b < STAT_HIST_BUCKETS; b++)
+         count += __atomic_load_n(&pHists->aiCount[lat][b], __ATOMIC_RELAXED);
+   }
+   return (count);
+}
+
+//
+// GetLatency
+//
+// Desc: A percentile of the latencies recorded for an operation
+// In:   lat - operation
+//       fraction - 0.5 for the median, 0.99 for p99, etc.
+// Ret:  the latency, in microseconds; 0 if none was recorded
+//
+double StatisticsMgr::GetLatency(Stat_Latency lat, double fraction) const
+{
+   long long aCount[STAT_HIST_BUCKETS];
+   long long count = 0;
+
+   memset(aCount, 0, sizeof(aCount));
+   for (int s = 0; s < STAT_STRIPES; s++) {
+      Histograms *pHists = __atomic_load_n(&apHists[s], __ATOMIC_ACQUIRE);
+      if (pHists == NULL)
+         continue;
+      for (int b = 0; b < STAT_HIST_BUCKETS; b++)
+         aCount[b] += __atomic_load_n(&pHists->aiCount[lat][b],
+                                      __ATOMIC_RELAXED);
+   }
+   for (int b = 0; b < STAT_HIST_BUCKETS; b++)
+      count += aCount[b];
+   if (count == 0)
+      return (0.0);
+
+   // The smallest bucket holding the rank-th latency
+   long long rank = (long long)(fraction * count + 0.999999);
+   if (rank < 1)
+      rank = 1;
+   long long seen = 0;
+   int b = 0;
+   for (; b < STAT_HIST_BUCKETS - 1; b++) {
+      seen += aCount[b];
+      if (seen >= rank)
+         break;
+   }
+   return (BucketTicks(b) / TicksPerUs());
+}
+
+//
+// PrintLatencies
+//
+// Desc: Internal.  Print the median, p99 and p999 latency of each
+//       operation that recorded some since the last reset
+//
+void StatisticsMgr::PrintLatencies() const
+{
+   Boolean bHeader = FALSE;
+   streamsize precision = cout.precision();
+
+   for (int l = 0; l < STAT_NUM_LATENCIES; l++) {
+      Stat_Latency lat = (Stat_Latency)l;
+      long long count = GetLatencyCount(lat);
+      if (count == 0)
+         continue;
+
+      if (!bHeader) {
+         cout << "Latencies (us)" << setw(18) << "count" << setw(10)
+            << "p50" << setw(10) << "p99" << setw(10) << "p999" << "\n";
+         bHeader = TRUE;
+      }
+      cout << left << setw(16) << apsLatencyNames[l] << right << setw(16)
+         << count << fixed << setprecision(2) << setw(10)
+         << GetLatency(lat, 0.5) << setw(10) << GetLatency(lat, 0.99)
+         << setw(10) << GetLatency(lat, 0.999) << "\n";
+      cout.unsetf(ios::floatfield);
+      cout.precision(precision);
+   }
+}
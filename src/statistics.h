@@ -14,6 +14,10 @@
 // statistic as you go.  In the end the Print or Get methods will allow you
 // to report all the statistics.
 
+// Code that counts often (the PF layer counts on every page request) gets
+// a handle for its statistic once and adds through it, which costs an
+// atomic add on a counter of the calling thread's stripe and no search.
+
 // Andre Bergholz, who was the TA for the 2000 offering, has written
 // some (or probably all) of this code.
 
@@ -45,35 +49,46 @@ typedef int RC;
 const int STAT_BASE = 9000;
 #endif
 
-// This include must come after the common defines
-#include "linkedlist.h"    // Template class for the link list
-
-// A single statistic will be tracked by a Statistic class
-class Statistic {
-public:
-    Statistic();
-    ~Statistic();
-    Statistic(const char *psName);
-
-    // Copy constructor
-    Statistic(const Statistic &stat);
-
-    // Equality constructor
-    Statistic& operator=(const Statistic &stat);
-
-    // Check for equality between a Statistic and a name based upon the
-    // names given to the current statistic.
-    Boolean operator==(const char *psName_) const;
-
-    // The name or key given to the statistic that this structure is
-    // tracking
-    char *psKey;
-
-    // Currently, I have only allowed the statistic to track integer values.
-    // Initial value will be 0.
-    int iValue;
+#include <pthread.h>
+#include <time.h>
+
+// Most statistics a StatisticsMgr can track
+const int STAT_MAX_KEYS = 64;
+
+// Counters kept for each statistic.  Each thread adds to one of them, so
+// threads counting the same statistic mostly touch different cache lines;
+// reading a statistic sums them.
+const int STAT_STRIPES = 16;
+
+// Latency histograms are HDR-style: a bucket per value below 16, then 16
+// buckets per power of two, so a value is off by at most 1/16.  They
+// count TSC ticks up to 2^STAT_HIST_MAXBIT; longer times go in the last
+// bucket.
+const int STAT_HIST_MAXBIT = 40;
+const int STAT_HIST_BUCKETS = (STAT_HIST_MAXBIT - 2) * 16;
+
+// The operations whose latency every StatisticsMgr tracks.  A PF read or
+// write is one call to the I/O engine, however many pages it moves.
+enum Stat_Latency {
+    PF_LAT_GETPAGE,
+    PF_LAT_READ,
+    PF_LAT_WRITE,
+    RM_LAT_GETREC,
+    RM_LAT_INSERTREC,
+    RM_LAT_DELETEREC,
+    RM_LAT_UPDATEREC,
+    RM_LAT_GETNEXTREC,
+    IX_LAT_INSERTENTRY,
+    IX_LAT_DELETEENTRY,
+    IX_LAT_GETNEXTENTRY,
+    STAT_NUM_LATENCIES
 };
 
+// Handle of a statistic, for registering changes to it without looking it
+// up by name.  It stays valid for the life of the StatisticsMgr, across
+// Reset.
+typedef int StatHandle;
+
 // These are the different operations that a single statistic can undergo
 // duing a call to StatisticsMgr::Register.
 enum Stat_Operation {
@@ -85,12 +100,22 @@ enum Stat_Operation {
     STAT_SUBVALUE
 };
 
-// The StatisticsMgr will track a group of statistics
+// The StatisticsMgr will track a group of statistics.  It may be used by
+// several threads at once.  Counting (Add, and Register with STAT_ADDONE,
+// STAT_ADDVALUE or STAT_SUBVALUE) takes no latch.
 class StatisticsMgr {
 
 public:
-    StatisticsMgr() {};
-    ~StatisticsMgr() {};
+    StatisticsMgr();
+    ~StatisticsMgr();
+
+    // Handle of a statistic, added if it is new.  A statistic that has a
+    // handle but was never changed is not reported by Get and Print.
+    // Returns -1 if STAT_MAX_KEYS statistics are tracked already.
+    StatHandle Handle(const char *psKey);
+
+    // Add to a statistic.  This is the cheap way to count.
+    void Add(StatHandle h, int iValue = 1);
 
     // Add a new statistic or register a change to an existing statistic.
     // The piValue for can be NULL, except for those operations that require
@@ -112,18 +137,147 @@ public:
     // Reset a specific statistic
     RC Reset(const char *psKey);
 
-    // Reset all of the statistics
+    // Reset all of the statistics, latencies included
     void Reset();
 
+    // Record the latency of an operation, in ticks of StatTicks.  Cheap,
+    // and takes no latch.
+    void AddLatency(Stat_Latency lat, unsigned long long ticks);
+
+    // Number of latencies recorded for an operation
+    long long GetLatencyCount(Stat_Latency lat) const;
+
+    // Latency below which a fraction (0.99 for p99) of those recorded for
+    // an operation fall, in microseconds; 0 if none was recorded
+    double GetLatency(Stat_Latency lat, double fraction) const;
+
+private:
+    StatHandle Find(const char *psKey) const;   // -1 if not tracked
+    long long Sum(StatHandle h) const;          // over all stripes
+    static int Stripe();                        // of the calling thread
+    void PrintLatencies() const;
+    double TicksPerUs() const;                  // rate of StatTicks
+
+    // Latency histograms of the threads using a stripe, allocated when
+    // the first of them records one
+    struct Histograms {
+        unsigned int aiCount[STAT_NUM_LATENCIES][STAT_HIST_BUCKETS];
+    };
+    Histograms *NewHistograms(int stripe);
+
+    // One counter per statistic for the threads using a stripe.  Aligned
+    // so that two stripes never share a cache line.
+    struct Counters {
+        long long alValue[STAT_MAX_KEYS];
+    } __attribute__((aligned(64)));
+
+    Counters aStripes[STAT_STRIPES];
+    char *apsKey[STAT_MAX_KEYS];        // names, added once and kept
+    char abChanged[STAT_MAX_KEYS];      // TRUE once changed after a reset
+    int numKeys;                        // entries of apsKey in use
+    Histograms *apHists[STAT_STRIPES];  // NULL until used
+    unsigned long long startTicks;      // StatTicks and CLOCK_MONOTONIC
+    long long startNs;                  //   when the manager was built
+    pthread_mutex_t latch;              // serializes adding statistics and
+                                        // the operations that are not adds
+};
+
+// Stripe of the calling thread, -1 until it first counts something
+extern thread_local int iStatStripe;
+
+//
+// StatTicks
+//
+// Desc: Current time for latencies: the time stamp counter where there
+//       is one, as it is much cheaper to read than the clock, and
+//       nanoseconds otherwise.  StatisticsMgr finds the rate of the
+//       counter against the clock when it reports latencies.
+//
+inline unsigned long long StatTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return (__builtin_ia32_rdtsc());
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+//
+// StatTimer
+//
+// Records the time until the end of the block as a latency.  pMgr may be
+// NULL, in which case nothing is recorded.
+//
+class StatTimer {
+public:
+    StatTimer(StatisticsMgr *pMgr_, Stat_Latency lat_)
+        : pMgr(pMgr_), lat(lat_), start(StatTicks()) {}
+    ~StatTimer()
+        { if (pMgr) pMgr->AddLatency(lat, StatTicks() - start); }
 private:
-    LinkList<Statistic> llStats;
+    StatisticsMgr *pMgr;
+    Stat_Latency lat;
+    unsigned long long start;
 };
 
+//
+// Add
+//
+// Desc: Add to a statistic without taking the latch.  Other threads may
+//       add to the same counter, hence the atomic add; it is relaxed, as
+//       readers only need a total that is correct once counting stops.
+// In:   h - handle of the statistic, ignored if -1
+//       iValue - amount to add
+//
+inline void StatisticsMgr::Add(StatHandle h, int iValue)
+{
+   if (h < 0)
+      return;
+   if (!__atomic_load_n(&abChanged[h], __ATOMIC_RELAXED))
+      __atomic_store_n(&abChanged[h], TRUE, __ATOMIC_RELAXED);
+
+   int stripe = iStatStripe >= 0 ? iStatStripe : Stripe();
+   __atomic_fetch_add(&aStripes[stripe].alValue[h], (long long)iValue,
+                      __ATOMIC_RELAXED);
+}
+
+//
+// AddLatency
+//
+// Desc: Count a latency in the histogram of the calling thread's stripe
+// In:   lat - operation
+//       ticks - how long it took, in ticks of StatTicks
+//
+inline void StatisticsMgr::AddLatency(Stat_Latency lat,
+      unsigned long long ticks)
+{
+   int bucket;
+
+   if (ticks < 16)
+      bucket = (int)ticks;
+   else {
+      int bit = 63 - __builtin_clzll(ticks);
+      if (bit > STAT_HIST_MAXBIT)
+         bucket = STAT_HIST_BUCKETS - 1;
+      else
+         bucket = (bit - 3) * 16 + (int)((ticks >> (bit - 4)) & 15);
+   }
+
+   int stripe = iStatStripe >= 0 ? iStatStripe : Stripe();
+   Histograms *pHists = __atomic_load_n(&apHists[stripe], __ATOMIC_ACQUIRE);
+   if (pHists == NULL)
+      pHists = NewHistograms(stripe);
+   __atomic_fetch_add(&pHists->aiCount[lat][bucket], 1u, __ATOMIC_RELAXED);
+}
+
 //
 // Return codes
 //
 const int STAT_INVALID_ARGS = STAT_BASE+1;  // Bad Args in call to method
 const int STAT_UNKNOWN_KEY  = STAT_BASE+2;  // No such Key being tracked
+const int STAT_TOO_MANY     = STAT_BASE+3;  // STAT_MAX_KEYS keys tracked
 
 //
 // The following are specifically for tracking the statistics in the PF
@@ -136,6 +290,43 @@ extern const char *PF_PAGENOTFOUND;
 extern const char *PF_READPAGE;         // IO
 extern const char *PF_WRITEPAGE;        // IO
 extern const char *PF_FLUSHPAGES;
+extern const char *PF_VICTIMS;          // pages replaced
+extern const char *PF_VICTIMPROBES;     // slots examined to find victims
+extern const char *PF_WRITEV;           // vectored write calls
+extern const char *PF_READV;            // vectored read calls
+extern const char *PF_PREFETCHED;       // pages read ahead
+extern const char *PF_PREFETCHHITS;     // read-ahead pages requested later
+extern const char *PF_PREFETCHWASTED;   // read-ahead pages never requested
+extern const char *PF_DIRTYVICTIMS;     // victims written out by GetPage
+extern const char *PF_BGWRITES;         // pages written by the bg writer
+extern const char *PF_BGWRITEV;         // write requests of the bg writer
+extern const char *PF_MAPPEDPINS;       // pins of pages in a file mapping
+extern const char *PF_EXTENTS;          // extents preallocated in files
+
+// Handles of the PF statistics above.  Every StatisticsMgr tracks them
+// from the start, in this order, so the PF layer counts without looking
+// them up.
+enum PF_StatHandle {
+    PF_STAT_GETPAGE,
+    PF_STAT_PAGEFOUND,
+    PF_STAT_PAGENOTFOUND,
+    PF_STAT_READPAGE,
+    PF_STAT_WRITEPAGE,
+    PF_STAT_FLUSHPAGES,
+    PF_STAT_VICTIMS,
+    PF_STAT_VICTIMPROBES,
+    PF_STAT_WRITEV,
+    PF_STAT_READV,
+    PF_STAT_PREFETCHED,
+    PF_STAT_PREFETCHHITS,
+    PF_STAT_PREFETCHWASTED,
+    PF_STAT_DIRTYVICTIMS,
+    PF_STAT_BGWRITES,
+    PF_STAT_BGWRITEV,
+    PF_STAT_MAPPEDPINS,
+    PF_STAT_EXTENTS,
+    PF_NUM_STATS
+};
 
 #endif
 